@@ -0,0 +1,188 @@
+/*!
+ * @file    carga.c
+ * @brief   Generador de carga: simula usuarios concurrentes contra el servidor y reporta latencias.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Contiene la funcion main del generador de carga, que:
+ *          - Lee los parametros de la prueba (servidor, usuarios, duracion y mezcla de operaciones).
+ *          - Lanza un hilo por usuario simulado, cada uno con su propia conexion.
+ *          - Une los resultados y los imprime en JSON: cantidad, errores, operaciones por segundo,
+ *            bytes y percentiles p50/p99/p999 de latencia por operacion.
+ *          Uso: carga [-i ip] [-p puerto] [-u usuarios] [-d segundos] [-m mezcla] [-f artista] [-c cancion]
+ *          La mezcla se indica como "operacion=peso" separados por comas, por ejemplo
+ *          "registro=1,inicio=2,listar=10,filtrar=5,descarga=1".
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sesion.h"
+#include "estadisticas.h"
+#include "canciones.h"
+
+/*!
+ * @def MEZCLA_PREDETERMINADA
+ * @brief Mezcla de operaciones usada si no se indica otra.
+*/
+#define MEZCLA_PREDETERMINADA "registro=1,inicio=2,listar=10,filtrar=5,descarga=1"
+
+/*!
+ * @brief   Interpreta la mezcla de operaciones.
+ * @param texto  Mezcla con formato "operacion=peso,...".
+ * @param pesos  Pesos a completar (las operaciones no mencionadas quedan en 0).
+ * @return OK(0) si la mezcla es valida, ERROR(-1) si no.
+*/
+static int leer_mezcla(const char* texto, int pesos[OPERACIONES])
+{
+    int i, operacion, total = 0;
+    char copia[BUFFER_SIZE];
+    char* token = NULL;
+    char* resto = NULL;
+    char* igual = NULL;
+
+    for (i = 0; i < OPERACIONES; i++)
+    {
+        pesos[i] = 0;
+    }
+    snprintf(copia, sizeof(copia), "%s", texto);
+    for (token = strtok_r(copia, ",", &resto); token != NULL; token = strtok_r(NULL, ",", &resto))
+    {
+        if ((igual = strchr(token, '=')) == NULL)
+        {
+            return ERROR;
+        }
+        *igual++ = '\0';
+        if ((operacion = buscar_operacion(token)) < 0 || atoi(igual) < 0)
+        {
+            return ERROR;
+        }
+        pesos[operacion] = atoi(igual);
+        total += pesos[operacion];
+    }
+    return (total > 0) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Imprime los resultados de una operacion como objeto JSON.
+ * @param nombre   Nombre de la operacion.
+ * @param muestras Muestras de la operacion (se ordenan).
+ * @param duracion Duracion real de la prueba en segundos.
+ * @param ultima   1 si es la ultima operacion del reporte (sin coma final).
+*/
+static void imprimir_operacion(const char* nombre, Muestras* muestras, double duracion, int ultima)
+{
+    muestras_ordenar(muestras);
+    printf("    \"%s\": {\"cantidad\": %zu, \"errores\": %zu, \"por_segundo\": %.2f, \"bytes\": %llu, "
+           "\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"p999_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+           nombre, muestras->cantidad, muestras->errores, muestras->cantidad / duracion, muestras->bytes,
+           muestras_percentil(muestras, 50) * 1e3, muestras_percentil(muestras, 99) * 1e3,
+           muestras_percentil(muestras, 99.9) * 1e3, muestras_percentil(muestras, 100) * 1e3,
+           ultima ? "" : ",");
+}
+
+/*!
+ * @brief   Muestra el uso del programa.
+ * @param programa Nombre del ejecutable.
+*/
+static void mostrar_uso(const char* programa)
+{
+    fprintf(stderr, "Uso: %s [-i ip] [-p puerto] [-u usuarios] [-d segundos] [-m mezcla] [-f artista] [-c cancion]\n", programa);
+    fprintf(stderr, "Mezcla predeterminada: %s\n", MEZCLA_PREDETERMINADA);
+}
+
+/*!
+ * @brief   Funcion principal del generador de carga.
+ * @param cant_arg Cantidad de argumentos pasados al programa.
+ * @param arg      Arreglo de cadenas con los argumentos (ver mostrar_uso()).
+ * @return OK(0) si la prueba se ejecuta, ERROR(-1) si los argumentos son invalidos o falta memoria.
+*/
+int main(int cant_arg, char* arg[])
+{
+    int i, j, opcion;
+    double inicio, duracion;
+    const char* mezcla = MEZCLA_PREDETERMINADA;
+    Configuracion config = { SERVER_IP, SERVER_PORT, 8, 10, {0}, "Soda Stereo", "1", 0 };
+    Sesion* sesiones = NULL;
+    pthread_t* hilos = NULL;
+    Muestras total[OPERACIONES];
+    size_t reconexiones = 0, operaciones = 0;
+
+    while ((opcion = getopt(cant_arg, arg, "i:p:u:d:m:f:c:")) != -1)
+    {
+        switch (opcion)
+        {
+            case 'i': config.ip = optarg; break;
+            case 'p': config.puerto = atoi(optarg); break;
+            case 'u': config.usuarios = atoi(optarg); break;
+            case 'd': config.duracion = atof(optarg); break;
+            case 'm': mezcla = optarg; break;
+            case 'f': config.filtro = optarg; break;
+            case 'c': config.cancion = optarg; break;
+            default:
+                mostrar_uso(arg[0]);
+                return ERROR;
+        }
+    }
+    if (config.usuarios < 1 || config.duracion <= 0 || leer_mezcla(mezcla, config.pesos) != OK)
+    {
+        mostrar_uso(arg[0]);
+        return ERROR;
+    }
+    if ((sesiones = calloc(config.usuarios, sizeof(Sesion))) == NULL || (hilos = calloc(config.usuarios, sizeof(pthread_t))) == NULL)
+    {
+        perror("Error al reservar memoria para las sesiones.\n");
+        free(sesiones);
+        return ERROR;
+    }
+    // lanzamos un hilo por usuario simulado.
+    inicio = ahora();
+    config.fin = inicio + config.duracion;
+    for (i = 0; i < config.usuarios; i++)
+    {
+        sesiones[i].numero = i;
+        sesiones[i].config = &config;
+        sesiones[i].semilla = (unsigned int)(getpid() * 7919 + i);
+        if (pthread_create(&hilos[i], NULL, simular_sesion, &sesiones[i]) != 0)
+        {
+            perror("Error al crear hilo de usuario simulado.\n");
+            config.usuarios = i;
+            break;
+        }
+    }
+    for (i = 0; i < config.usuarios; i++)
+    {
+        pthread_join(hilos[i], NULL);
+    }
+    duracion = ahora() - inicio;
+    // unimos los resultados de todos los usuarios.
+    memset(total, 0, sizeof(total));
+    for (i = 0; i < config.usuarios; i++)
+    {
+        for (j = 0; j < OPERACIONES; j++)
+        {
+            muestras_unir(&total[j], &sesiones[i].muestras[j]);
+            muestras_liberar(&sesiones[i].muestras[j]);
+        }
+        reconexiones += sesiones[i].reconexiones;
+    }
+    for (j = 0; j < OPERACIONES; j++)
+    {
+        operaciones += total[j].cantidad;
+    }
+    printf("{\n  \"servidor\": \"%s:%d\",\n  \"usuarios\": %d,\n  \"duracion_s\": %.3f,\n  \"mezcla\": \"%s\",\n",
+           config.ip, config.puerto, config.usuarios, duracion, mezcla);
+    printf("  \"operaciones_por_segundo\": %.2f,\n  \"reconexiones\": %zu,\n  \"operaciones\": {\n",
+           operaciones / duracion, reconexiones);
+    for (j = 0; j < OPERACIONES; j++)
+    {
+        imprimir_operacion(nombre_operacion(j), &total[j], duracion, j == OPERACIONES - 1);
+        muestras_liberar(&total[j]);
+    }
+    printf("  }\n}\n");
+
+    free(hilos);
+    free(sesiones);
+    return OK;
+}
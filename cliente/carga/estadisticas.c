@@ -0,0 +1,175 @@
+/*!
+ * @file    estadisticas.c
+ * @brief   Registro de latencias y calculo de percentiles del generador de carga.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Acumular las latencias de cada operacion en el hilo de cada usuario simulado.
+ *          - Unir las muestras de todos los usuarios al finalizar.
+ *          - Calcular percentiles sobre las latencias ordenadas.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "estadisticas.h"
+#include "canciones.h"
+
+static const char* nombres[OPERACIONES] = { "registro", "inicio", "listar", "filtrar", "descarga" };
+
+/*!
+ * @brief   Devuelve el nombre de una operacion.
+ * @param operacion Operacion (OP_REGISTRO a OP_DESCARGA).
+ * @return Nombre de la operacion.
+*/
+const char* nombre_operacion(int operacion)
+{
+    return nombres[operacion];
+}
+
+/*!
+ * @brief   Busca una operacion por su nombre.
+ * @param nombre Nombre de la operacion.
+ * @return La operacion, o -1 si no existe.
+*/
+int buscar_operacion(const char* nombre)
+{
+    int i;
+
+    for (i = 0; i < OPERACIONES; i++)
+    {
+        if (strcmp(nombres[i], nombre) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*!
+ * @brief   Asegura lugar para una cantidad de latencias.
+ * @param muestras Muestras a agrandar.
+ * @param minimo   Capacidad necesaria.
+ * @return OK(0) si hay lugar, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int reservar(Muestras* muestras, size_t minimo)
+{
+    size_t capacidad = (muestras->capacidad > 0) ? muestras->capacidad : 1024;
+    double* latencias = NULL;
+
+    if (minimo <= muestras->capacidad)
+    {
+        return OK;
+    }
+    while (capacidad < minimo)
+    {
+        capacidad *= 2;
+    }
+    if ((latencias = realloc(muestras->latencias, capacidad * sizeof(double))) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    muestras->latencias = latencias;
+    muestras->capacidad = capacidad;
+    return OK;
+}
+
+/*!
+ * @brief   Registra la latencia de una operacion exitosa.
+ * @param muestras Muestras de la operacion.
+ * @param segundos Latencia en segundos.
+ * @return OK(0) si se registra, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int muestras_agregar(Muestras* muestras, double segundos)
+{
+    if (reservar(muestras, muestras->cantidad + 1) != OK)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    muestras->latencias[muestras->cantidad++] = segundos;
+    return OK;
+}
+
+/*!
+ * @brief   Agrega a un conjunto de muestras las de otro.
+ * @param destino Muestras donde se acumula.
+ * @param origen  Muestras a agregar.
+ * @return OK(0) si se agregan, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int muestras_unir(Muestras* destino, const Muestras* origen)
+{
+    if (reservar(destino, destino->cantidad + origen->cantidad) != OK)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    if (origen->cantidad > 0)
+    {
+        memcpy(destino->latencias + destino->cantidad, origen->latencias, origen->cantidad * sizeof(double));
+    }
+    destino->cantidad += origen->cantidad;
+    destino->errores += origen->errores;
+    destino->bytes += origen->bytes;
+    return OK;
+}
+
+/*!
+ * @brief   Compara dos latencias para qsort.
+ * @param a Primera latencia.
+ * @param b Segunda latencia.
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+/*!
+ * @brief   Ordena las latencias registradas, necesario antes de pedir percentiles.
+ * @param muestras Muestras a ordenar.
+*/
+void muestras_ordenar(Muestras* muestras)
+{
+    if (muestras->cantidad > 1)
+    {
+        qsort(muestras->latencias, muestras->cantidad, sizeof(double), comparar);
+    }
+}
+
+/*!
+ * @brief   Calcula un percentil de latencia (metodo del rango mas cercano).
+ * @param muestras   Muestras ya ordenadas.
+ * @param percentil  Percentil entre 0 y 100.
+ * @return Latencia en segundos, o 0 si no hay muestras.
+*/
+double muestras_percentil(const Muestras* muestras, double percentil)
+{
+    size_t rango;
+
+    if (muestras->cantidad == 0)
+    {
+        return 0;
+    }
+    rango = (size_t)ceil(percentil / 100.0 * muestras->cantidad);
+    if (rango < 1)
+    {
+        rango = 1;
+    }
+    if (rango > muestras->cantidad)
+    {
+        rango = muestras->cantidad;
+    }
+    return muestras->latencias[rango - 1];
+}
+
+/*!
+ * @brief   Libera la memoria de un conjunto de muestras.
+ * @param muestras Muestras a liberar.
+*/
+void muestras_liberar(Muestras* muestras)
+{
+    free(muestras->latencias);
+    memset(muestras, 0, sizeof(Muestras));
+}
@@ -0,0 +1,116 @@
+/*!
+ * @file    estadisticas.h
+ * @brief   Definiciones y declaraciones para registrar latencias del generador de carga.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Las operaciones que simula el generador de carga y sus nombres.
+ *          - La estructura Muestras, con las latencias, errores y bytes de una operacion.
+ *          - Declaraciones de funciones para agregar muestras, unirlas y calcular percentiles.
+*/
+
+#ifndef ESTADISTICAS_H
+#define ESTADISTICAS_H
+
+#include <stddef.h>
+
+/*!
+ * @def OP_REGISTRO
+ * @brief Operacion de registro de un usuario nuevo.
+*/
+#define OP_REGISTRO 0
+
+/*!
+ * @def OP_INICIO
+ * @brief Operacion de inicio de sesion.
+*/
+#define OP_INICIO 1
+
+/*!
+ * @def OP_LISTAR
+ * @brief Operacion de listado de canciones.
+*/
+#define OP_LISTAR 2
+
+/*!
+ * @def OP_FILTRAR
+ * @brief Operacion de filtrado de canciones.
+*/
+#define OP_FILTRAR 3
+
+/*!
+ * @def OP_DESCARGA
+ * @brief Operacion de descarga de una cancion.
+*/
+#define OP_DESCARGA 4
+
+/*!
+ * @def OPERACIONES
+ * @brief Cantidad de operaciones distintas.
+*/
+#define OPERACIONES 5
+
+/*!
+ * @struct Muestras
+ * @brief Resultados acumulados de una operacion.
+*/
+typedef struct Muestras
+{
+    double* latencias;        /**< Latencias de las operaciones exitosas, en segundos. */
+    size_t cantidad;          /**< Cantidad de latencias registradas. */
+    size_t capacidad;         /**< Capacidad reservada del arreglo de latencias. */
+    size_t errores;           /**< Operaciones que terminaron con error. */
+    unsigned long long bytes; /**< Bytes de carga util recibidos. */
+} Muestras;
+
+/*!
+ * @brief   Devuelve el nombre de una operacion.
+ * @param operacion Operacion (OP_REGISTRO a OP_DESCARGA).
+ * @return Nombre de la operacion.
+*/
+const char* nombre_operacion(int operacion);
+
+/*!
+ * @brief   Busca una operacion por su nombre.
+ * @param nombre Nombre de la operacion.
+ * @return La operacion, o -1 si no existe.
+*/
+int buscar_operacion(const char* nombre);
+
+/*!
+ * @brief   Registra la latencia de una operacion exitosa.
+ * @param muestras Muestras de la operacion.
+ * @param segundos Latencia en segundos.
+ * @return OK(0) si se registra, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int muestras_agregar(Muestras* muestras, double segundos);
+
+/*!
+ * @brief   Agrega a un conjunto de muestras las de otro.
+ * @param destino Muestras donde se acumula.
+ * @param origen  Muestras a agregar.
+ * @return OK(0) si se agregan, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int muestras_unir(Muestras* destino, const Muestras* origen);
+
+/*!
+ * @brief   Ordena las latencias registradas, necesario antes de pedir percentiles.
+ * @param muestras Muestras a ordenar.
+*/
+void muestras_ordenar(Muestras* muestras);
+
+/*!
+ * @brief   Calcula un percentil de latencia (metodo del rango mas cercano).
+ * @param muestras   Muestras ya ordenadas.
+ * @param percentil  Percentil entre 0 y 100.
+ * @return Latencia en segundos, o 0 si no hay muestras.
+*/
+double muestras_percentil(const Muestras* muestras, double percentil);
+
+/*!
+ * @brief   Libera la memoria de un conjunto de muestras.
+ * @param muestras Muestras a liberar.
+*/
+void muestras_liberar(Muestras* muestras);
+
+#endif
@@ -0,0 +1,257 @@
+/*!
+ * @file    sesion.c
+ * @brief   Sesion de un usuario simulado del generador de carga.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Conectar un usuario simulado con el servidor y registrar su cuenta.
+ *          - Elegir operaciones segun la mezcla configurada y ejecutarlas con el protocolo de tramas.
+ *          - Medir la latencia de cada operacion, desde el envio de la solicitud hasta su trama final.
+ *          Cada usuario simulado usa su propia conexion y envia una solicitud por vez, como el cliente interactivo.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "sesion.h"
+#include "protocolo.h"
+#include "transporte.h"
+#include "canciones.h"
+
+/*!
+ * @brief   Devuelve el instante actual del reloj monotono.
+ * @return Segundos desde un origen arbitrario.
+*/
+double ahora(void)
+{
+    struct timespec instante;
+
+    clock_gettime(CLOCK_MONOTONIC, &instante);
+    return instante.tv_sec + instante.tv_nsec / 1e9;
+}
+
+/*!
+ * @brief   Conecta la sesion con el servidor.
+ * @param sesion Sesion a conectar.
+ * @return OK(0) si se conecta, ERROR(-1) si ocurre un problema.
+*/
+static int conectar(Sesion* sesion)
+{
+    struct sockaddr_in server_addr;
+
+    if ((sesion->sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        return ERROR;
+    }
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(sesion->config->puerto);
+    if (inet_pton(AF_INET, sesion->config->ip, &server_addr.sin_addr) <= 0
+        || connect(sesion->sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        close(sesion->sock);
+        sesion->sock = -1;
+        return ERROR;
+    }
+    transporte_iniciar(sesion->sock);
+    return OK;
+}
+
+/*!
+ * @brief   Cierra la conexion de la sesion.
+ * @param sesion Sesion a desconectar.
+*/
+static void desconectar(Sesion* sesion)
+{
+    if (sesion->sock >= 0)
+    {
+        close(sesion->sock);
+        sesion->sock = -1;
+    }
+}
+
+/*!
+ * @brief   Envia una solicitud y recibe su respuesta completa.
+ *          En las descargas devuelve ventana al servidor a medida que recibe datos.
+ * @param sesion Sesion por la que se envia.
+ * @param tipo   Tipo de solicitud.
+ * @param carga  Carga de la solicitud.
+ * @param bytes  Bytes de datos recibidos en la respuesta.
+ * @return OK(0) si la respuesta termina en RESP_FIN, ERROR_USUARIO(-2) si termina en RESP_ERROR,
+ *         ERROR(-1) si falla la conexion.
+*/
+static int solicitar(Sesion* sesion, uint8_t tipo, const char* carga, unsigned long long* bytes)
+{
+    uint32_t id = ++sesion->ultima_solicitud;
+    uint32_t sin_devolver = 0, red;
+    Cabecera cabecera;
+
+    *bytes = 0;
+    if (enviar_texto(sesion->sock, id, tipo, carga) != OK)
+    {
+        return ERROR;
+    }
+    while (1)
+    {
+        if (recibir_trama(sesion->sock, &cabecera, sesion->buffer, CARGA_MAX) != OK)
+        {
+            return ERROR;
+        }
+        if (cabecera.id != id)
+        {
+            continue;
+        }
+        if (cabecera.tipo == RESP_FIN)
+        {
+            return OK;
+        }
+        if (cabecera.tipo == RESP_ERROR)
+        {
+            return ERROR_USUARIO;
+        }
+        *bytes += cabecera.longitud;
+        if (tipo != SOL_CANCION)
+        {
+            continue;
+        }
+        sin_devolver += cabecera.longitud;
+        if (sin_devolver >= VENTANA_INICIAL / 4)
+        {
+            red = htonl(sin_devolver);
+            if (enviar_trama(sesion->sock, id, SOL_VENTANA, &red, sizeof(red)) != OK)
+            {
+                return ERROR;
+            }
+            sin_devolver = 0;
+        }
+    }
+}
+
+/*!
+ * @brief   Ejecuta una operacion y registra su resultado.
+ * @param sesion    Sesion que ejecuta la operacion.
+ * @param operacion Operacion a ejecutar (OP_REGISTRO a OP_DESCARGA).
+ * @return OK(0) si la conexion sigue en pie (aunque el servidor haya respondido con error),
+ *         ERROR(-1) si falla la conexion.
+*/
+static int ejecutar(Sesion* sesion, int operacion)
+{
+    int estado;
+    double inicio;
+    unsigned long long bytes;
+    char carga[BUFFER_SIZE];
+    uint8_t tipo;
+
+    switch (operacion)
+    {
+        case OP_REGISTRO:
+            // cada registro usa un usuario nuevo; el ultimo registrado queda como usuario de la sesion.
+            snprintf(sesion->usuario, sizeof(sesion->usuario), "g%d_%d_%d", (int)getpid() % 100000, sesion->numero, sesion->registros++);
+            snprintf(carga, sizeof(carga), "%s:carga", sesion->usuario);
+            tipo = SOL_REGISTRO;
+            break;
+        case OP_INICIO:
+            snprintf(carga, sizeof(carga), "%s:carga", sesion->usuario);
+            tipo = SOL_INICIO;
+            break;
+        case OP_LISTAR:
+            carga[0] = '\0';
+            tipo = SOL_LISTAR;
+            break;
+        case OP_FILTRAR:
+            snprintf(carga, sizeof(carga), "%d:%s", 1, sesion->config->filtro);
+            tipo = SOL_FILTRAR;
+            break;
+        default:
+            snprintf(carga, sizeof(carga), "%s", sesion->config->cancion);
+            tipo = SOL_CANCION;
+            break;
+    }
+    inicio = ahora();
+    if ((estado = solicitar(sesion, tipo, carga, &bytes)) == OK)
+    {
+        muestras_agregar(&sesion->muestras[operacion], ahora() - inicio);
+        sesion->muestras[operacion].bytes += bytes;
+        return OK;
+    }
+    sesion->muestras[operacion].errores++;
+    return (estado == ERROR) ? ERROR : OK;
+}
+
+/*!
+ * @brief   Elige la proxima operacion segun los pesos de la mezcla.
+ * @param sesion Sesion que elige.
+ * @return Operacion elegida.
+*/
+static int elegir_operacion(Sesion* sesion)
+{
+    int i, total = 0, sorteo;
+
+    for (i = 0; i < OPERACIONES; i++)
+    {
+        total += sesion->config->pesos[i];
+    }
+    sorteo = rand_r(&sesion->semilla) % total;
+    for (i = 0; i < OPERACIONES - 1; i++)
+    {
+        if (sorteo < sesion->config->pesos[i])
+        {
+            break;
+        }
+        sorteo -= sesion->config->pesos[i];
+    }
+    return i;
+}
+
+/*!
+ * @brief   Hilo de un usuario simulado.
+ *          Se conecta, registra su propio usuario y ejecuta operaciones elegidas segun la mezcla
+ *          configurada hasta que termina la prueba, registrando la latencia de cada una.
+ * @param arg Sesion del usuario simulado.
+ * @return NULL al finalizar.
+*/
+void* simular_sesion(void* arg)
+{
+    Sesion* sesion = arg;
+    int autenticado = 0;
+
+    sesion->sock = -1;
+    if ((sesion->buffer = malloc(CARGA_MAX)) == NULL)
+    {
+        perror("Error al reservar buffer de recepcion.\n");
+        return NULL;
+    }
+    while (ahora() < sesion->config->fin)
+    {
+        // (re)conectar e iniciar sesion, sin contar estas operaciones si la conexion se habia caido.
+        if (sesion->sock < 0)
+        {
+            if (conectar(sesion) != OK)
+            {
+                usleep(100000);
+                continue;
+            }
+            if (autenticado)
+            {
+                sesion->reconexiones++;
+            }
+            if (ejecutar(sesion, autenticado ? OP_INICIO : OP_REGISTRO) != OK)
+            {
+                desconectar(sesion);
+                continue;
+            }
+            autenticado = 1;
+        }
+        if (ejecutar(sesion, elegir_operacion(sesion)) != OK)
+        {
+            desconectar(sesion);
+        }
+    }
+    desconectar(sesion);
+    free(sesion->buffer);
+    sesion->buffer = NULL;
+    return NULL;
+}
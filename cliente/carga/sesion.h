@@ -0,0 +1,67 @@
+/*!
+ * @file    sesion.h
+ * @brief   Definiciones y declaraciones de la sesion de un usuario simulado del generador de carga.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - La estructura Configuracion, con los parametros de la prueba de carga.
+ *          - La estructura Sesion, con el estado y los resultados de un usuario simulado.
+ *          - La declaracion del hilo que ejecuta la sesion.
+*/
+
+#ifndef SESION_H
+#define SESION_H
+
+#include <stdint.h>
+#include "estadisticas.h"
+
+/*!
+ * @struct Configuracion
+ * @brief Parametros de la prueba de carga, comunes a todos los usuarios simulados.
+*/
+typedef struct Configuracion
+{
+    const char* ip;           /**< Direccion IP del servidor. */
+    int puerto;               /**< Puerto del servidor. */
+    int usuarios;             /**< Cantidad de usuarios simulados concurrentes. */
+    double duracion;          /**< Duracion de la prueba en segundos. */
+    int pesos[OPERACIONES];   /**< Peso relativo de cada operacion en la mezcla. */
+    const char* filtro;       /**< Artista usado en las operaciones de filtrado. */
+    const char* cancion;      /**< Numero de cancion pedido en las operaciones de descarga. */
+    double fin;               /**< Instante (reloj monotono, en segundos) en que termina la prueba. */
+} Configuracion;
+
+/*!
+ * @struct Sesion
+ * @brief Estado y resultados de un usuario simulado.
+*/
+typedef struct Sesion
+{
+    int numero;                        /**< Numero del usuario simulado. */
+    const Configuracion* config;       /**< Parametros de la prueba. */
+    int sock;                          /**< Socket de la conexion con el servidor (-1 si no hay). */
+    uint32_t ultima_solicitud;         /**< Ultimo id de solicitud usado en la conexion. */
+    unsigned int semilla;              /**< Semilla para elegir operaciones. */
+    int registros;                     /**< Usuarios registrados por la sesion. */
+    char usuario[26];                  /**< Usuario con el que inicia sesion. */
+    char* buffer;                      /**< Buffer de recepcion (CARGA_MAX bytes). */
+    Muestras muestras[OPERACIONES];    /**< Resultados de cada operacion. */
+    size_t reconexiones;               /**< Veces que se volvio a conectar tras un error. */
+} Sesion;
+
+/*!
+ * @brief   Devuelve el instante actual del reloj monotono.
+ * @return Segundos desde un origen arbitrario.
+*/
+double ahora(void);
+
+/*!
+ * @brief   Hilo de un usuario simulado.
+ *          Se conecta, registra su propio usuario y ejecuta operaciones elegidas segun la mezcla
+ *          configurada hasta que termina la prueba, registrando la latencia de cada una.
+ * @param arg Sesion del usuario simulado.
+ * @return NULL al finalizar.
+*/
+void* simular_sesion(void* arg);
+
+#endif
@@ -7,40 +7,50 @@
  *          - Mostrar el menu de canciones del cliente.
  *          - Listar canciones disponibles en el servidor.
  *          - Filtrar canciones por artista o genero.
- *          - Solicitar y descargar canciones desde el servidor.
+ *          - Solicitar canciones al servidor, de a una o en lotes, que se descargan en segundo plano.
+ *          Cada operacion es una sola solicitud con su id; las respuestas llegan en tramas (ver protocolo.h)
+ *          y las recibe el hilo receptor (ver receptor.h). Los listados y los filtros simples se resuelven
+ *          sobre la copia local del catalogo (ver catalogo.h), que solo le pide al servidor lo que cambio.
 */
 
 #include <stdio.h>
 #include <string.h>
-#include <sys/socket.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include "canciones.h"
-#include <stdlib.h>
+#include "protocolo.h"
+#include "receptor.h"
+#include "precarga.h"
+#include "catalogo.h"
 
 /*!
  * @brief   Muestra menu de canciones y gestiona las opciones seleccionadas.
- *          Permite listar canciones, filtrarlas o pedirlas. Envia las opciones seleccionadas
- *          al servidor y maneja las respuestas correspondientes.
+ *          Permite listar canciones, filtrarlas o pedirlas. Envia cada operacion al servidor
+ *          como una solicitud; las canciones se descargan en segundo plano mientras se sigue usando el menu.
+ *          Al salir espera que terminen las descargas en curso.
  * @param sock   Descriptor del socket de conexion con el servidor.
- * @param buffer Buffer utilizado para enviar y recibir datos.
+ * @param buffer Buffer de CARGA_MAX bytes utilizado para enviar y recibir datos.
 */
 void menu_canciones_cliente(int sock, char* buffer)
 {
-    int opcion = op_menu_canciones(); // mostrar el menu de opciones.
+    int opcion;
 
-    while (opcion != 4)
+    // desde aqui las respuestas las recibe el hilo receptor, asi el menu no se bloquea durante las descargas.
+    if (receptor_iniciar(sock) != OK)
+    {
+        return;
+    }
+    // sin precargador se puede seguir: las canciones se descargan al elegirlas.
+    precarga_iniciar(sock);
+    // sin suscripcion tambien (solo se pide con AVISOS_CATALOGO): la copia del catalogo se sincroniza en cada listado.
+    catalogo_suscribir(sock);
+    opcion = op_menu_canciones(); // mostrar el menu de opciones.
+    while (opcion != 6)
     {
-        //enviamos opcion al servidor. 
-        snprintf(buffer, BUFFER_SIZE, "%d", opcion);
-        if (send(sock, buffer, strlen(buffer), 0) < 0)
-        {
-            perror("Error al enviar opcion elegida.\n");
-            break;
-        }
         // derivamos opcion seleccionada.
         if (opcion == 1)
         {
-            if (listar_cliente(sock, buffer) == ERROR)
+            if (listar_cliente(sock) == ERROR)
             {
                 break;
             }
@@ -52,20 +62,36 @@ void menu_canciones_cliente(int sock, char* buffer)
             }
         } else if (opcion == 3)
         {
-            if (escuchar_cancion_cliente(sock, buffer) == ERROR)
+            if (escuchar_cancion_cliente(sock) == ERROR)
+            {
+                break;
+            }
+        } else if (opcion == 4)
+        {
+            if (descargar_lote_cliente(sock, buffer) == ERROR)
+            {
+                break;
+            }
+        } else if (opcion == 5)
+        {
+            if (escuchar_desde_cliente(sock) == ERROR)
             {
                 break;
             }
         }
         opcion = op_menu_canciones();
     }
+    precarga_finalizar();
+    receptor_finalizar(sock);
+    catalogo_liberar();
 
     printf("Programa finalizado.\n");
 }
 
 /*!
  * @brief   Muestra las opciones del menu de canciones.
- *          Las opciones incluyen listar canciones, filtrarlas por artista o genero, o pedir una cancion.
+ *          Las opciones incluyen listar canciones, filtrarlas por artista o genero, pedir una cancion,
+ *          descargar varias canciones de una vez o escuchar una cancion desde un instante.
  *          Valida que la opcion ingresada sea valida.
  * @return  Opcion seleccionada por el cliente.
 */
@@ -73,13 +99,13 @@ int op_menu_canciones(void)
 {
     int opcion = 0;
 
-    printf("\nMenu de opciones.\n1. Listar canciones.\n2. Filtrar canciones.\n3. Escuchar cancion.\n4. Salir.\n");
+    printf("\nMenu de opciones.\n1. Listar canciones.\n2. Filtrar canciones.\n3. Escuchar cancion.\n4. Descargar varias canciones.\n5. Escuchar cancion desde un instante.\n6. Salir.\n");
     printf("Para seleccionar, ingrese valor correspondiente: ");
-    while (opcion < 1 || opcion > 4)
+    while (opcion < 1 || opcion > 6)
     {
         scanf("%d", &opcion);
         while (getchar() != '\n'); // limpiamos buffer de entrada.
-        if (opcion < 1 || opcion > 4)
+        if (opcion < 1 || opcion > 6)
         {
             printf("Opcion incorrecta. Intente nuevamente: \n");
         }
@@ -90,77 +116,86 @@ int op_menu_canciones(void)
 
 /*!
  * @brief   Lista las canciones disponibles en el servidor.
- *          Envia una solicitud al servidor para obtener el listado de canciones y muestra los resultados en pantalla.
+ *          Si la copia local del catalogo esta al dia, la lista en el cliente; si no (o para las mas escuchadas),
+ *          envia una solicitud al servidor para obtener el listado de canciones y muestra los resultados en pantalla.
  * @param sock   Descriptor del socket de conexion con el servidor.
- * @param buffer Buffer utilizado para recibir datos.
  * @return OK(0) si el listado es exitoso, ERROR(-1) si ocurre un error.
 */
-int listar_cliente(int sock, char* buffer)
+int listar_cliente(int sock)
 {
-    ssize_t bytes_received;
+    char orden[16];
+    int opcion = op_ordenar();
 
-    printf("\nLista de canciones. \nNo - Tema - Artista - Album - Genero - Anio\n");
-    while(1)
+    // el servidor numera los ordenes desde 0 (como en el catalogo).
+    snprintf(orden, sizeof(orden), "%d", opcion - 1);
+    if (opcion < 7 && catalogo_sincronizar(sock) == OK)
     {
-        // recibir listado del servidor.
-        if ((bytes_received = recv(sock, buffer, BUFFER_SIZE, 0)) <= 0)
-        {
-            perror("Error al recibir listado.\n");
-            return ERROR;
-        }
-        buffer[bytes_received] = '\0'; // otorgamos fin de linea al buffer. 
-        if (strcmp(buffer, FIN) == 0) // verificamos si lo que se recibio es senial de fin. 
+        printf("\nLista de canciones. \nNo - Tema - Artista - Album - Genero - Anio\n");
+        return catalogo_listar(opcion - 1);
+    }
+    printf("\nLista de canciones. \nNo - Tema - Artista - Album - Genero - Anio%s\n", (opcion == 7) ? " - Reproducciones" : "");
+    // el receptor muestra el listado a medida que llega.
+    return receptor_solicitar(sock, SOL_LISTAR, orden);
+}
+
+/*!
+ * @brief   Muestra las opciones de orden del listado.
+ *          Presenta un menu con los ordenes disponibles y valida que la entrada sea correcta.
+ * @return  La opcion seleccionada (1 como en el catalogo, 2 por anio, 3 por tema, 4 por artista, 5 por genero, 6 por album,
+ *          7 las mas escuchadas).
+*/
+int op_ordenar(void)
+{
+    int opcion = 0;
+
+    printf("\nOrden del listado.\n1. Como en el catalogo.\n2. Por anio.\n3. Por tema.\n4. Por artista.\n5. Por genero.\n6. Por album.\n7. Mas escuchadas.\n");
+    printf("Para seleccionar, ingrese valor correspondiente: ");
+    while (opcion < 1 || opcion > 7)
+    {
+        scanf("%d", &opcion);
+        while (getchar() != '\n'); // limpiamos buffer de entrada.
+        if (opcion < 1 || opcion > 7)
         {
-            printf("\n");
-            break;
+            printf("Opcion incorrecta. Intente nuevamente:\n");
         }
-        printf("%s", buffer);
     }
 
-    return OK;
+    return opcion;
 }
 
 /*!
- * @brief   Envia una opcion de filtro al servidor y solicita canciones filtradas.
- *          Esta funcion permite al cliente seleccionar un criterio de filtrado
- *          y envia esta opcion al servidor. Luego llama a filtrar_cliente() para manejar los resultados
+ * @brief   Elige un criterio de filtrado y solicita las canciones filtradas.
+ *          Esta funcion permite al cliente seleccionar un criterio de filtrado y
+ *          luego llama a filtrar_cliente() para pedir el filtro y manejar los resultados
  *          recibidos desde el servidor.
  * @param sock   Descriptor del socket de conexion con el servidor.
- * @param buffer Buffer utilizado para enviar y recibir datos.
+ * @param buffer Buffer de CARGA_MAX bytes utilizado para enviar y recibir datos.
  * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
 */
 int menu_filtrar_cliente(int sock, char* buffer)
 {
     int opcion = op_filtrar();
 
-    // enviar opcion al servidor.
-    snprintf(buffer, BUFFER_SIZE, "%d", opcion);
-    if (send(sock, buffer, strlen(buffer), 0) < 0)
-    {
-        perror("Error al enviar opcion elegida. \n");
-        return ERROR;
-    }
-    
-    return filtrar_cliente(sock, buffer);
+    return filtrar_cliente(sock, buffer, opcion);
 }
 
 /*!
  * @brief   Muestra las opciones de filtrado al cliente.
- *          Presenta un menu con las opciones disponibles para filtrar canciones (por artista o por genero)
- *          y valida que la entrada sea correcta.
- * @return  La opcion seleccionada por el cliente (1 para artista, 2 para genero).
+ *          Presenta un menu con las opciones disponibles para filtrar canciones (por artista, por genero,
+ *          por rango de anios, con una consulta combinada o con una busqueda aproximada) y valida que la entrada sea correcta.
+ * @return  La opcion seleccionada por el cliente (1 para artista, 2 para genero, 3 para rango de anios, 4 para consulta combinada, 5 para busqueda aproximada).
 */
 int op_filtrar(void)
 {
     int opcion = 0;
 
-    printf("\nOpciones para filtrar.\n1. Por artista.\n2. Por genero.\n");
+    printf("\nOpciones para filtrar.\n1. Por artista.\n2. Por genero.\n3. Por rango de anios.\n4. Consulta combinada.\n5. Busqueda aproximada (tolera errores de tipeo).\n");
     printf("Para seleccionar, ingrese valor correspondiente: ");
-    while (opcion != 1 && opcion != 2)
+    while (opcion < 1 || opcion > 5)
     {
         scanf("%d", &opcion);
-        while (getchar() != '\n'); // limpiamos buffer de entrada. 
-        if (opcion != 1 && opcion != 2)
+        while (getchar() != '\n'); // limpiamos buffer de entrada.
+        if (opcion < 1 || opcion > 5)
         {
             printf("Opcion incorrecta. Intente nuevamente:\n");
         }
@@ -171,72 +206,72 @@ int op_filtrar(void)
 
 /*!
  * @brief   Solicita y envia un filtro para listar canciones especificas.
- *          Envia un filtro (por artista o genero) al servidor y recibe las canciones que cumplen con ese criterio.
+ *          Envia en una sola solicitud el criterio y el filtro (por artista o genero) al servidor
+ *          y recibe las canciones que cumplen con ese criterio.
  * @param sock   Descriptor del socket de conexion con el servidor.
- * @param buffer Buffer utilizado para enviar y recibir datos.
+ * @param buffer Buffer de CARGA_MAX bytes utilizado para enviar y recibir datos.
+ * @param opcion Criterio de filtrado (1 para artista, 2 para genero, 3 para rango de anios, 4 para consulta combinada, 5 para busqueda aproximada).
  * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
 */
-int filtrar_cliente(int sock, char* buffer)
+int filtrar_cliente(int sock, char* buffer, int opcion)
 {
-    ssize_t bytes_received;
+    char filtro[FILTRO_MAX];
 
     while (1)
     {
-        printf("Ingrese filtro: ");
+        if (opcion == 3)
+        {
+            printf("Ingrese rango de anios (ej: 1976-1986, 1979 o 1990-): ");
+        } else if (opcion == 4)
+        {
+            printf("Combine condiciones con & (y) y | (o): campo=valor, campo~texto o anio=rango.\n"
+                   "Campos: titulo, artista, album, genero, anio. Ej: artista=Soda Stereo & anio=1985-1990\n");
+            printf("Ingrese consulta: ");
+        } else if (opcion == 5)
+        {
+            printf("Ingrese titulo, artista o album (ej: pink floid): ");
+        } else
+        {
+            printf("Ingrese filtro: ");
+        }
         // leer entrada.
-        if (fgets(buffer, BUFFER_SIZE, stdin) == NULL)
+        if (fgets(filtro, FILTRO_MAX, stdin) == NULL)
         {
             printf("Error al leer entrada. Intente nuevamente.\n");
             continue;
         }
         // eliminar salto de linea y validar entrada vacia.
-        buffer[strcspn(buffer, "\n")] = '\0';
-        if (strlen(buffer) == 0)
+        filtro[strcspn(filtro, "\n")] = '\0';
+        if (strlen(filtro) == 0)
         {
             printf("Entrada vacia. Intente nuevamente.\n");
             continue;
         }
-        break;    
+        break;
     }
-    // enviar filtro al servidor.
-    if (send(sock, buffer, strlen(buffer), 0) < 0)
+    // artista, genero y rango de anios se resuelven en la copia local si esta al dia.
+    if (opcion <= 3 && catalogo_sincronizar(sock) == OK)
     {
-        perror("Error al enviar filtro a servidor.\n");
-        return ERROR;
+        printf("\nLista de canciones. \nNo - Tema - Artista - Album - Genero - Anio\n");
+        return catalogo_filtrar(opcion, filtro);
     }
+    // enviar criterio y filtro al servidor.
+    snprintf(buffer, BUFFER_SIZE, "%d:%s", opcion, filtro);
     printf("\nLista de canciones. \nNo - Tema - Artista - Album - Genero - Anio\n");
-    while(1)
-    {
-        if ((bytes_received = recv(sock, buffer, BUFFER_SIZE, 0)) <= 0)
-        {
-            perror("Error al recibir listado.\n");
-            return ERROR;
-        }
-        buffer[bytes_received] = '\0';
-        if (strcmp(buffer, FIN) == 0) // verificamos si lo que se recibio es senial de fin. 
-        {
-            printf("\n");
-            break;
-        }
-        printf("%s", buffer);
-    }
-    return OK;
+    return receptor_solicitar(sock, SOL_FILTRAR, buffer);
 }
 
 /*!
- * @brief   Solicita y descarga una cancion desde el servidor.
- *          Envia al servidor el numero de la cancion solicitada, recibe los datos de la cancion y los guarda en un archivo local.
+ * @brief   Solicita una cancion al servidor para descargarla en segundo plano.
+ *          Envia al servidor el numero de la cancion solicitada y vuelve al menu; el receptor
+ *          guarda los datos en un archivo local y reproduce la cancion al terminar.
+ *          Si la cancion ya esta en el sistema (por ejemplo, porque se precargo) suena enseguida.
  * @param sock   Descriptor del socket de conexion con el servidor.
- * @param buffer Buffer utilizado para enviar y recibir datos.
  * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
 */
-int escuchar_cancion_cliente(int sock, char* buffer)
+int escuchar_cancion_cliente(int sock)
 {
     int eleccion;
-    ssize_t bytes_received;
-    char cancion[50];
-    FILE* archivo = NULL;
-    char comando[100];
 
     while (1)
     {
@@ -251,11 +286,6 @@ int escuchar_cancion_cliente(int sock, char* buffer)
         while (getchar() != '\n');
         if (eleccion == 0) // salir si se elige 0.
         {
-            if (send(sock, FIN, strlen(FIN), 0) < 0)
-            {
-                perror("Error al enviar senial de salida.\n");
-                return ERROR;
-            }
             return OK;
         }
         if (eleccion < 0) // validar que no sea negativo.
@@ -263,70 +293,113 @@ int escuchar_cancion_cliente(int sock, char* buffer)
             printf("Numero de cancion no puede ser negativo. Intente nuevamente.\n");
             continue;
         }
-        snprintf(cancion, sizeof(cancion), "%d.mp3", eleccion); // Dar formato al nombre.
-        if (access(cancion, F_OK) == 0) // Verificar si el archivo ya existe.
+        break;
+    }
+
+    return receptor_escuchar(sock, eleccion);
+}
+
+/*!
+ * @brief   Solicita una cancion al servidor a partir de un instante, para descargarla en segundo plano.
+ *          El cliente ingresa el numero de la cancion y el instante (minutos:segundos o segundos); el servidor
+ *          envia la cancion desde el marco que suena en ese instante y el receptor la reproduce al terminar.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
+*/
+int escuchar_desde_cliente(int sock)
+{
+    int eleccion, minutos, segundos;
+    char instante[NOMBRE_MAX];
+
+    printf("Ingrese numero de cancion (para salir, ingrese 0): ");
+    if (scanf("%d", &eleccion) != 1)
+    {
+        eleccion = -1;
+    }
+    while (getchar() != '\n');
+    if (eleccion <= 0)
+    {
+        if (eleccion < 0)
         {
-            printf("Cancion ya en sistema.\n");
-            continue;
+            printf("Numero de cancion invalido.\n");
         }
-        strcpy(buffer, cancion);
-        if (send(sock, buffer, strlen(buffer), 0) < 0) // Enviar numero de cancion al servidor.
+        return OK;
+    }
+    while (1)
+    {
+        printf("Ingrese instante (minutos:segundos o segundos): ");
+        if (fgets(instante, sizeof(instante), stdin) == NULL)
         {
-            perror("Error al enviar numero de cancion.\n");
-            return ERROR;
+            return OK;
         }
-        // Recibir respuesta del servidor.
-        if ((bytes_received = recv(sock, buffer, BUFFER_SIZE, 0)) <= 0)
+        if (sscanf(instante, "%d:%d", &minutos, &segundos) == 2 && minutos >= 0 && segundos >= 0 && segundos < 60)
         {
-            perror("Error al recibir respuesta del servidor.\n");
-            return ERROR;
+            segundos += minutos * 60;
+            break;
         }
-        buffer[bytes_received] = '\0';
-        if (strcmp(buffer, FIN) == 0) // validar respuesta de existencia desde el servidor.
+        if (strchr(instante, ':') == NULL && sscanf(instante, "%d", &segundos) == 1 && segundos >= 0)
         {
-            printf("Cancion inexistente.\n");
-            return OK;
+            break;
         }
-        else if (strcmp(buffer, "ERROR") == 0)
+        printf("Instante invalido (ej: 1:35 o 95). Intente nuevamente.\n");
+    }
+
+    return receptor_descargar_desde(sock, eleccion, segundos);
+}
+
+/*!
+ * @brief   Solicita varias canciones al servidor en un solo lote.
+ *          El cliente ingresa los numeros separados por comas, o nada para usar el resultado del ultimo
+ *          listado o filtrado. Las canciones que ya estan en el sistema no se vuelven a pedir.
+ *          El lote se descarga en segundo plano y las canciones quedan guardadas sin reproducirse.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param buffer Buffer de CARGA_MAX bytes utilizado para armar la solicitud.
+ * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
+*/
+int descargar_lote_cliente(int sock, char* buffer)
+{
+    int numero;
+    size_t largo = 0;
+    char* token = NULL;
+    char* resto = NULL;
+    char lista[BUFFER_SIZE];
+    char cancion[NOMBRE_MAX];
+
+    printf("Ingrese numeros de cancion separados por comas (Enter para usar el ultimo resultado): ");
+    if (fgets(lista, sizeof(lista), stdin) == NULL)
+    {
+        return OK;
+    }
+    lista[strcspn(lista, "\n")] = '\0';
+    if (strlen(lista) == 0)
+    {
+        receptor_ultimo_resultado(lista, sizeof(lista));
+    }
+    // armamos el lote con las canciones que todavia no estan en el sistema.
+    buffer[0] = '\0';
+    for (token = strtok_r(lista, ",", &resto); token != NULL; token = strtok_r(NULL, ",", &resto))
+    {
+        if ((numero = atoi(token)) <= 0)
         {
-            printf("Error al abrir archivo en el servidor.\n");
-            return ERROR;
+            continue;
         }
-        if ((archivo = fopen(cancion, "wb")) == NULL)
+        snprintf(cancion, sizeof(cancion), "%d.mp3", numero);
+        if (access(cancion, F_OK) == 0)
         {
-            perror("Error al crear archivo de cancion.\n");
-            return ERROR;
+            continue;
         }
-        while (1)
+        largo += snprintf(buffer + largo, BUFFER_SIZE - largo, "%s%d", (largo > 0) ? "," : "", numero);
+        if (largo >= BUFFER_SIZE)
         {
-            if ((bytes_received = recv(sock, buffer, BUFFER_SIZE, 0)) <= 0)
-            {
-                perror("Error al recibir datos del servidor.\n");
-                fclose(archivo);
-                return ERROR;
-            }
-            if (strncmp(buffer, FIN, strlen(FIN)) == 0 && bytes_received == strlen(FIN)) // Verificar si es el fin de la transmision.
-            {
-                printf("Descarga finalizada.\n");
-                break;
-            }
-            if (fwrite(buffer, 1, bytes_received, archivo) != (size_t)bytes_received)
-            {
-                perror("Error al escribir en archivo.\n");
-                fclose(archivo);
-                return ERROR;
-            }
+            printf("Lista demasiado larga.\n");
+            return OK;
         }
-        break;
     }
-
-    fclose(archivo);
-
-    snprintf(comando, sizeof(comando), "mpg123 \"%s\"", cancion); // Reemplaza "mpg123" con el reproductor que prefieras
-    if (system(comando) != 0) {
-        printf("No se pudo reproducir la cancion. Verifique que tenga un reproductor instalado.\n");
+    if (largo == 0)
+    {
+        printf("No hay canciones nuevas para descargar.\n");
+        return OK;
     }
-    return OK;
 
-    
-}
\ No newline at end of file
+    return receptor_descargar_lote(sock, buffer);
+}
@@ -8,6 +8,8 @@
  *          - Declaraciones de funciones para listar, filtrar y pasar canciones.
 */
 
+#include <stdint.h>
+
 /*!
  * @def OK
  * @brief Codigo de retorno para indicar exito.
@@ -32,9 +34,15 @@
 */
 #define ERROR_DE_MEMORIA -3
 
+/*!
+ * @def SALIR
+ * @brief Codigo de retorno para indicar que el otro extremo cerro la conexion.
+*/
+#define SALIR -4
+
 /*!
  * @def BUFFER_SIZE
- * @brief Tamanio maximo del buffer para enviar y recibir datos.
+ * @brief Tamanio maximo de un mensaje de control enviado al servidor. Las respuestas se reciben en buffers de CARGA_MAX (protocolo.h).
 */
 #define BUFFER_SIZE 1024
 
@@ -62,6 +70,13 @@
 */
 #define SERVER_IP "127.0.0.1"
 
+/*!
+ * @def SERVER_LOCAL_ENTORNO
+ * @brief Variable de entorno con la ruta del socket Unix del servidor (LOCAL_RUTA en su directorio). Si esta
+ *        definida, el cliente se conecta por ese socket en lugar de TCP y recibe las canciones por descriptor.
+*/
+#define SERVER_LOCAL_ENTORNO "SERVIDOR_LOCAL"
+
 /*!
  * @def LINEA_MAX
  * @brief Tamanio maximo de una linea de texto procesada.
@@ -70,19 +85,13 @@
 
 /*!
  * @def FILTRO_MAX
- * @brief Tamanio maximo de un filtro de texto.
-*/
-#define FILTRO_MAX 128
-
-/*!
- * @def FIN
- * @brief Senial utilizada para indicar el fin de transmision de datos.
+ * @brief Tamanio maximo de un filtro de texto (o de una consulta combinada).
 */
-#define FIN "FIN"
+#define FILTRO_MAX 512
 
 /*!
  * @brief   Muestra menu de opciones para gestionar canciones.
- *          Presenta opciones disponibles (listar, filtrar, escuchar o salir)
+ *          Presenta opciones disponibles (listar, filtrar, escuchar, descargar varias, escuchar desde un instante o salir)
  *          y valida que la entrada sea correcta.
  * @return  Opcion seleccionada por el cliente.
 */
@@ -101,23 +110,30 @@ void menu_canciones_cliente(int sock, char* buffer);
  * @brief   Lista las canciones disponibles en el servidor.
  *          Envia una solicitud al servidor para obtener el listado de canciones y muestra los resultados en pantalla.
  * @param sock   Descriptor del socket de conexion con el servidor.
- * @param buffer Buffer utilizado para recibir datos.
  * @return OK(0) si el listado es exitoso, ERROR(-1) si ocurre un error.
 */
-int listar_cliente(int sock, char* buffer);
+int listar_cliente(int sock);
+
+/*!
+ * @brief   Muestra las opciones de orden del listado.
+ *          Presenta un menu con los ordenes disponibles y valida que la entrada sea correcta.
+ * @return  La opcion seleccionada (1 como en el catalogo, 2 por anio, 3 por tema, 4 por artista, 5 por genero, 6 por album,
+ *          7 las mas escuchadas).
+*/
+int op_ordenar(void);
 
 /*!
  * @brief   Muestra opciones de filtrado al cliente.
- *          Presenta un menu con opciones disponibles para filtrar canciones (por artista o genero)
- *          y valida que la entrada sea correcta.
- * @return  Opcion seleccionada por el cliente (1 para artista, 2 para genero).
+ *          Presenta un menu con opciones disponibles para filtrar canciones (por artista, genero,
+ *          rango de anios, consulta combinada o busqueda aproximada) y valida que la entrada sea correcta.
+ * @return  Opcion seleccionada por el cliente (1 para artista, 2 para genero, 3 para rango de anios, 4 para consulta combinada, 5 para busqueda aproximada).
 */
 int op_filtrar(void);
 
 /*!
- * @brief   Envia una opcion de filtro al servidor y solicita canciones filtradas.
+ * @brief   Elige un criterio de filtrado y solicita las canciones filtradas.
  *          Permite al cliente seleccionar un criterio de filtrado (por artista o por genero)
- *          y envia esta opcion al servidor. Luego llama a filtrar_cliente() para manejar los resultados
+ *          y luego llama a filtrar_cliente() para pedir el filtro y manejar los resultados
  *          recibidos desde el servidor.
  * @param sock   Descriptor del socket de conexion con el servidor.
  * @param buffer Buffer utilizado para enviar y recibir datos.
@@ -127,18 +143,39 @@ int menu_filtrar_cliente(int sock, char* buffer);
 
 /*!
  * @brief   Solicita y envia un filtro para listar canciones especificas.
- *          Envia un filtro al servidor y recibe las canciones que cumplen con ese criterio.
+ *          Envia en una sola solicitud el criterio y el filtro al servidor y recibe las canciones que cumplen con ese criterio.
  * @param sock   Descriptor del socket de conexion con el servidor.
  * @param buffer Buffer utilizado para enviar y recibir datos.
+ * @param opcion Criterio de filtrado (1 para artista, 2 para genero, 3 para rango de anios, 4 para consulta combinada, 5 para busqueda aproximada).
  * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
 */
-int filtrar_cliente(int sock, char *buffer);
+int filtrar_cliente(int sock, char *buffer, int opcion);
 
 /*!
- * @brief   Solicita y descarga una cancion desde el servidor.
- *          Envia al servidor el numero de la cancion solicitada, recibe los datos de la cancion y los guarda en un archivo local.
+ * @brief   Solicita una cancion al servidor para descargarla en segundo plano.
+ *          Envia al servidor el numero de la cancion solicitada y vuelve al menu; el receptor
+ *          guarda los datos en un archivo local y reproduce la cancion al terminar.
+ *          Si la cancion ya esta en el sistema (por ejemplo, porque se precargo) suena enseguida.
  * @param sock   Descriptor del socket de conexion con el servidor.
- * @param buffer Buffer utilizado para enviar y recibir datos.
  * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
 */
-int escuchar_cancion_cliente(int sock, char* buffer);
\ No newline at end of file
+int escuchar_cancion_cliente(int sock);
+/*!
+ * @brief   Solicita una cancion al servidor a partir de un instante, para descargarla en segundo plano.
+ *          El cliente ingresa el numero de la cancion y el instante (minutos:segundos o segundos); el servidor
+ *          envia la cancion desde el marco que suena en ese instante y el receptor la reproduce al terminar.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
+*/
+int escuchar_desde_cliente(int sock);
+
+/*!
+ * @brief   Solicita varias canciones al servidor en un solo lote.
+ *          El cliente ingresa los numeros separados por comas, o nada para usar el resultado del ultimo
+ *          listado o filtrado. Las canciones que ya estan en el sistema no se vuelven a pedir.
+ *          El lote se descarga en segundo plano y las canciones quedan guardadas sin reproducirse.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param buffer Buffer de CARGA_MAX bytes utilizado para armar la solicitud.
+ * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un error.
+*/
+int descargar_lote_cliente(int sock, char* buffer);
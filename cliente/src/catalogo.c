@@ -0,0 +1,708 @@
+/*!
+ * @file    catalogo.c
+ * @brief   Copia local del catalogo de canciones del cliente, sincronizada con el servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Leer y guardar la copia del catalogo en disco con su version.
+ *          - Aplicar las filas agregadas, cambiadas o quitadas que envia el servidor (ver SOL_CATALOGO).
+ *          - Aplicar los cambios que avisa el servidor a la conexion suscripta (ver SOL_SUSCRIBIR).
+ *          - Listar la copia en cada orden y filtrarla por artista, genero o rango de anios, con el mismo
+ *            orden y formato de filas que el servidor: a igual valor, en el orden del archivo.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "canciones.h"
+#include "catalogo.h"
+#include "protocolo.h"
+#include "receptor.h"
+
+static Fila* filas = NULL;             // canciones de la copia: la cancion N esta en filas[N - 1].
+static int cantidad = 0;               // cantidad de canciones de la copia.
+static int capacidad = 0;              // posiciones reservadas en filas.
+static char version[VERSION_MAX] = ""; // version de la copia (vacia si no hay copia valida).
+static int leida = 0;                  // 1 si ya se intento leer CATALOGO_COPIA.
+static int fallida = 0;                // 1 si no hubo memoria para aplicar una fila de la sincronizacion en curso.
+static int campo_orden = ANIO;         // campo por el que compara comparar_filas().
+static int suscripta = 0;              // 1 mientras el servidor avisa los cambios del catalogo.
+static int al_dia = 0;                 // 1 si la copia no cambio en el servidor desde la ultima sincronizacion.
+static int perdidos = 0;               // cambios avisados que no se pudieron aplicar a la copia.
+static char* aviso = NULL;             // filas del cambio que se esta recibiendo.
+static size_t aviso_largo = 0;         // bytes de filas en aviso.
+static size_t aviso_capacidad = 0;     // bytes reservados en aviso.
+static int aviso_fallido = 0;          // 1 si no hubo memoria para guardar una trama del cambio.
+// protege la copia entre el menu y los avisos, que llegan por el hilo receptor sin receptor_mutex tomado.
+// La sincronizacion no lo toma mientras espera: sus filas las aplica el mismo hilo que los avisos.
+static pthread_mutex_t catalogo_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*!
+ * @brief   Convierte el campo de anio a numero, como el servidor.
+ * @param texto Campo de anio.
+ * @return Anio, o 0 si el campo no es un numero.
+*/
+static int leer_anio(const char* texto)
+{
+    int anio = 0;
+
+    if (*texto == '\0')
+    {
+        return 0;
+    }
+    for (; *texto != '\0'; texto++)
+    {
+        if (!isdigit((unsigned char)*texto) || anio > 99999)
+        {
+            return 0;
+        }
+        anio = anio * 10 + (*texto - '0');
+    }
+    return anio;
+}
+
+/*!
+ * @brief   Libera una fila y deja su posicion libre.
+ * @param fila Fila a liberar.
+*/
+static void liberar_fila(Fila* fila)
+{
+    free(fila->texto);
+    memset(fila, 0, sizeof(Fila));
+}
+
+/*!
+ * @brief   Deja la copia con las canciones 1 a total, liberando las que sobran.
+ * @param total Cantidad de canciones.
+*/
+static void recortar(int total)
+{
+    while (cantidad > total)
+    {
+        liberar_fila(&filas[--cantidad]);
+    }
+    cantidad = total;
+}
+
+/*!
+ * @brief   Aplica una fila de la sincronizacion: "+N,C,titulo,artista,album,genero,anio" o "-N".
+ * @param linea Fila sin salto de linea.
+ * @return OK(0) si se aplica o se ignora (fila mal formada), ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int aplicar_fila(const char* linea)
+{
+    int i, numero, completa;
+    char* resto = NULL;
+    char* texto = NULL;
+    Fila* nuevas = NULL;
+
+    numero = (int)strtol(linea + 1, &resto, 10);
+    if (numero <= 0 || (linea[0] != '+' && linea[0] != '-'))
+    {
+        return OK;
+    }
+    if (linea[0] == '-')
+    {
+        if (numero <= cantidad)
+        {
+            liberar_fila(&filas[numero - 1]);
+        }
+        return OK;
+    }
+    if (sscanf(resto, ",%d,", &completa) != 1 || (resto = strchr(resto + 1, ',')) == NULL)
+    {
+        return OK;
+    }
+    if (numero > capacidad)
+    {
+        // duplicamos la capacidad: el catalogo completo llega en orden creciente.
+        if ((nuevas = realloc(filas, (size_t)(numero > 2 * capacidad ? numero : 2 * capacidad) * sizeof(Fila))) == NULL)
+        {
+            return ERROR_DE_MEMORIA;
+        }
+        filas = nuevas;
+        i = capacidad;
+        capacidad = (numero > 2 * capacidad) ? numero : 2 * capacidad;
+        memset(filas + i, 0, (size_t)(capacidad - i) * sizeof(Fila));
+    }
+    if ((texto = strdup(resto + 1)) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    while (cantidad < numero)
+    {
+        memset(&filas[cantidad++], 0, sizeof(Fila));
+    }
+    liberar_fila(&filas[numero - 1]);
+    filas[numero - 1].numero = numero;
+    filas[numero - 1].completa = completa;
+    filas[numero - 1].texto = texto;
+    // los campos no tienen comas (media.csv las usa de separador): se separan en el lugar.
+    for (i = 0; i < CAMPOS; i++)
+    {
+        filas[numero - 1].campos[i] = (texto != NULL) ? strsep(&texto, ",") : "";
+    }
+    filas[numero - 1].anio = leer_anio(filas[numero - 1].campos[ANIO]);
+    return OK;
+}
+
+/*!
+ * @brief   Aplica filas terminadas en '\n' y cuenta las agregadas o cambiadas y las quitadas.
+ * @param datos    Filas a aplicar.
+ * @param agregadas Filas "+N,..." aplicadas.
+ * @param quitadas  Filas "-N" aplicadas.
+ * @return OK(0) si se aplican todas, ERROR_DE_MEMORIA(-3) si falto memoria para alguna.
+*/
+static int aplicar_filas(const char* datos, int* agregadas, int* quitadas)
+{
+    int estado = OK;
+    size_t largo;
+    const char* fin = NULL;
+    char linea[2 * BUFFER_SIZE];
+
+    for (; *datos != '\0'; datos = (*fin == '\n') ? fin + 1 : fin)
+    {
+        fin = datos + strcspn(datos, "\n");
+        largo = (size_t)(fin - datos);
+        if (largo >= sizeof(linea))
+        {
+            continue;
+        }
+        memcpy(linea, datos, largo);
+        linea[largo] = '\0';
+        if (aplicar_fila(linea) != OK)
+        {
+            estado = ERROR_DE_MEMORIA;
+        } else if (linea[0] == '+')
+        {
+            (*agregadas)++;
+        } else if (linea[0] == '-')
+        {
+            (*quitadas)++;
+        }
+    }
+    return estado;
+}
+
+/*!
+ * @brief   Recibe una trama de datos de la sincronizacion y aplica sus filas. La llama el hilo receptor.
+ *          Al llegar la primera fila la copia deja de tener version: si la sincronizacion no termina, la
+ *          proxima pide el catalogo completo.
+ * @param datos Filas terminadas en '\n'.
+*/
+static void recibir_filas(const char* datos)
+{
+    int agregadas = 0, quitadas = 0;
+
+    version[0] = '\0';
+    if (aplicar_filas(datos, &agregadas, &quitadas) != OK)
+    {
+        fallida = 1;
+    }
+}
+
+/*!
+ * @brief   Libera la copia en memoria y la deja sin version.
+*/
+static void vaciar(void)
+{
+    recortar(0);
+    free(filas);
+    filas = NULL;
+    capacidad = 0;
+    version[0] = '\0';
+}
+
+/*!
+ * @brief   Lee la copia de CATALOGO_COPIA: una linea "version cantidad" seguida de las filas en el formato
+ *          de la sincronizacion. Si el archivo esta incompleto la copia se descarta.
+*/
+static void leer_copia(void)
+{
+    int total = 0;
+    char linea[2 * BUFFER_SIZE];
+    char leida_version[VERSION_MAX];
+    FILE* archivo = fopen(CATALOGO_COPIA, "r");
+
+    if (archivo == NULL)
+    {
+        return;
+    }
+    if (fgets(linea, sizeof(linea), archivo) == NULL || sscanf(linea, "%31s %d", leida_version, &total) != 2)
+    {
+        fclose(archivo);
+        return;
+    }
+    while (fgets(linea, sizeof(linea), archivo) != NULL)
+    {
+        linea[strcspn(linea, "\n")] = '\0';
+        if (aplicar_fila(linea) != OK)
+        {
+            break;
+        }
+    }
+    fclose(archivo);
+    if (cantidad != total)
+    {
+        vaciar();
+        return;
+    }
+    snprintf(version, sizeof(version), "%s", leida_version);
+}
+
+/*!
+ * @brief   Guarda la copia en CATALOGO_COPIA. Se escribe en un archivo temporal que despues reemplaza al
+ *          anterior, asi un corte a mitad de camino no deja una copia a medias.
+*/
+static void guardar_copia(void)
+{
+    int i;
+    FILE* archivo = fopen(CATALOGO_COPIA ".tmp", "w");
+    const Fila* fila = NULL;
+
+    if (archivo == NULL)
+    {
+        return;
+    }
+    fprintf(archivo, "%s %d\n", version, cantidad);
+    for (i = 0; i < cantidad; i++)
+    {
+        fila = &filas[i];
+        if (fila->numero > 0)
+        {
+            fprintf(archivo, "+%d,%d,%s,%s,%s,%s,%s\n", fila->numero, fila->completa, fila->campos[TITULO],
+                    fila->campos[ARTISTA], fila->campos[ALBUM], fila->campos[GENERO], fila->campos[ANIO]);
+        }
+    }
+    if (fclose(archivo) != 0 || rename(CATALOGO_COPIA ".tmp", CATALOGO_COPIA) != 0)
+    {
+        remove(CATALOGO_COPIA ".tmp");
+    }
+}
+
+/*!
+ * @brief   Sincroniza la copia local del catalogo con el servidor. La primera vez la lee de CATALOGO_COPIA.
+ *          Si la copia cambia, se vuelve a guardar.
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si la copia quedo al dia, ERROR(-1) si no (el listado o filtrado se pide al servidor).
+*/
+int catalogo_sincronizar(int sock)
+{
+    int total, vistos, estado = OK;
+    char fin[BUFFER_SIZE];
+    char pedida[VERSION_MAX];
+    char nueva[VERSION_MAX];
+    char modo[16];
+
+    pthread_mutex_lock(&catalogo_mutex);
+    if (!leida)
+    {
+        leida = 1;
+        leer_copia();
+    }
+    // con la suscripcion, el servidor avisa cada cambio: si no hubo ninguno sin aplicar, no hace falta preguntar.
+    if (al_dia && version[0] != '\0')
+    {
+        pthread_mutex_unlock(&catalogo_mutex);
+        return OK;
+    }
+    snprintf(pedida, sizeof(pedida), "%s", version);
+    vistos = perdidos;
+    fallida = 0;
+    pthread_mutex_unlock(&catalogo_mutex);
+    if (receptor_consultar(sock, SOL_CATALOGO, pedida, recibir_filas, fin, sizeof(fin)) != OK
+        || sscanf(fin, "%31s %d %15s", nueva, &total, modo) != 3 || total < 0)
+    {
+        return ERROR;
+    }
+    pthread_mutex_lock(&catalogo_mutex);
+    if (fallida)
+    {
+        // sin version, la proxima sincronizacion trae el catalogo completo.
+        version[0] = '\0';
+        estado = ERROR;
+    } else if (strcmp(modo, "igual") != 0)
+    {
+        recortar(total);
+        snprintf(version, sizeof(version), "%s", nueva);
+        guardar_copia();
+    }
+    // un cambio que no se pudo aplicar mientras se sincronizaba puede ser posterior a esta version.
+    al_dia = (estado == OK && suscripta && perdidos == vistos);
+    pthread_mutex_unlock(&catalogo_mutex);
+    return estado;
+}
+
+/*!
+ * @brief   Guarda una trama de filas del cambio avisado que se esta recibiendo. La llama el hilo receptor.
+ * @param datos Filas terminadas en '\n'.
+*/
+static void recibir_aviso(const char* datos)
+{
+    size_t largo = strlen(datos);
+    size_t nueva = (aviso_capacidad > 0) ? aviso_capacidad : BUFFER_SIZE;
+    char* ampliado = NULL;
+
+    pthread_mutex_lock(&catalogo_mutex);
+    while (nueva < aviso_largo + largo + 1)
+    {
+        nueva *= 2;
+    }
+    if (!aviso_fallido && nueva > aviso_capacidad)
+    {
+        if ((ampliado = realloc(aviso, nueva)) == NULL)
+        {
+            aviso_fallido = 1;
+        } else
+        {
+            aviso = ampliado;
+            aviso_capacidad = nueva;
+        }
+    }
+    if (!aviso_fallido)
+    {
+        memcpy(aviso + aviso_largo, datos, largo + 1);
+        aviso_largo += largo;
+    }
+    pthread_mutex_unlock(&catalogo_mutex);
+}
+
+/*!
+ * @brief   Aplica el cambio avisado si parte de la version de la copia, y lo anuncia. Si no (la copia es de
+ *          otra version, el cambio es completo o falto memoria), la proxima sincronizacion pregunta al servidor.
+ *          La llama el hilo receptor.
+ * @param fin Carga de la trama RESP_EVENTO ("anterior nueva cantidad modo"), o NULL si la suscripcion termino.
+*/
+static void recibir_evento(const char* fin)
+{
+    int total, agregadas = 0, quitadas = 0;
+    char anterior[VERSION_MAX];
+    char nueva[VERSION_MAX];
+    char modo[16];
+
+    pthread_mutex_lock(&catalogo_mutex);
+    if (fin == NULL)
+    {
+        suscripta = 0;
+        al_dia = 0;
+    } else if (sscanf(fin, "%31s %31s %d %15s", anterior, nueva, &total, modo) != 4 || total < 0)
+    {
+        al_dia = 0;
+        perdidos++;
+    } else if (strcmp(nueva, version) == 0)
+    {
+        // la copia ya se sincronizo con esta version.
+    } else if (!aviso_fallido && strcmp(modo, "cambios") == 0 && strcmp(anterior, version) == 0)
+    {
+        version[0] = '\0';
+        if (aviso_largo == 0 || aplicar_filas(aviso, &agregadas, &quitadas) == OK)
+        {
+            recortar(total);
+            snprintf(version, sizeof(version), "%s", nueva);
+            guardar_copia();
+            printf("\nCatalogo actualizado: %d canciones nuevas o cambiadas, %d quitadas.\n", agregadas, quitadas);
+        } else
+        {
+            al_dia = 0;
+            perdidos++;
+        }
+    } else
+    {
+        al_dia = 0;
+        perdidos++;
+        printf("\nEl catalogo cambio en el servidor: la copia se actualiza en el proximo listado.\n");
+    }
+    free(aviso);
+    aviso = NULL;
+    aviso_largo = 0;
+    aviso_capacidad = 0;
+    aviso_fallido = 0;
+    pthread_mutex_unlock(&catalogo_mutex);
+}
+
+/*!
+ * @brief   Suscribe la conexion a los cambios del catalogo (ver SOL_SUSCRIBIR), si la variable AVISOS_ENTORNO
+ *          lo pide. Mientras dure, los cambios se aplican a la copia al llegar y los listados no preguntan al
+ *          servidor por la version.
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si se pide la suscripcion o no esta activada, ERROR(-1) si no se pudo pedir (la copia se sigue
+ *         sincronizando en cada listado).
+*/
+int catalogo_suscribir(int sock)
+{
+    const char* entorno = getenv(AVISOS_ENTORNO);
+
+    if (entorno == NULL || atoi(entorno) <= 0)
+    {
+        return OK;
+    }
+    // se marca antes de pedirla: el rechazo puede llegar enseguida.
+    pthread_mutex_lock(&catalogo_mutex);
+    suscripta = 1;
+    pthread_mutex_unlock(&catalogo_mutex);
+    if (receptor_suscribir(sock, recibir_aviso, recibir_evento) != OK)
+    {
+        pthread_mutex_lock(&catalogo_mutex);
+        suscripta = 0;
+        pthread_mutex_unlock(&catalogo_mutex);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Compara dos filas por el campo campo_orden sin distinguir mayusculas (el anio, como numero) y,
+ *          a igual valor, por numero de cancion.
+ * @param a Primera fila (const Fila**).
+ * @param b Segunda fila (const Fila**).
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_filas(const void* a, const void* b)
+{
+    const Fila* primera = *(const Fila* const*)a;
+    const Fila* segunda = *(const Fila* const*)b;
+    int resultado;
+
+    if (campo_orden == ANIO)
+    {
+        resultado = (primera->anio > segunda->anio) - (primera->anio < segunda->anio);
+    } else
+    {
+        resultado = strcasecmp(primera->campos[campo_orden], segunda->campos[campo_orden]);
+    }
+    return (resultado != 0) ? resultado : primera->numero - segunda->numero;
+}
+
+/*!
+ * @brief   Arma una fila del listado como la muestra el servidor.
+ *          Las canciones completas llevan sus cinco campos; las demas, como el listado del archivo, los que tienen.
+ * @param fila  Cancion.
+ * @param texto Buffer destino (BUFFER_SIZE bytes).
+*/
+static void formatear(const Fila* fila, char* texto)
+{
+    int i;
+
+    if (fila->completa)
+    {
+        snprintf(texto, BUFFER_SIZE, "%d - %s - %s - %s - %s - %s\n", fila->numero, fila->campos[TITULO],
+                 fila->campos[ARTISTA], fila->campos[ALBUM], fila->campos[GENERO], fila->campos[ANIO]);
+        return;
+    }
+    snprintf(texto, BUFFER_SIZE, "%d - %s - ", fila->numero, fila->campos[TITULO]);
+    for (i = 1; i < CAMPOS && fila->campos[i][0] != '\0'; i++)
+    {
+        strncat(texto, fila->campos[i], BUFFER_SIZE - strlen(texto) - 1);
+        strncat(texto, (i < CAMPOS - 1) ? " - " : "", BUFFER_SIZE - strlen(texto) - 1);
+    }
+    strncat(texto, "\n", BUFFER_SIZE - strlen(texto) - 1);
+}
+
+/*!
+ * @brief   Muestra filas como resultado del ultimo listado o filtrado, agrupandolas en bloques.
+ * @param seleccion Filas a mostrar, en orden.
+ * @param total     Cantidad de filas.
+*/
+static void mostrar(Fila* const* seleccion, int total)
+{
+    int i, nuevo = 1;
+    size_t usados = 0, largo;
+    char bloque[4 * BUFFER_SIZE];
+    char texto[BUFFER_SIZE];
+
+    bloque[0] = '\0';
+    for (i = 0; i < total; i++)
+    {
+        formatear(seleccion[i], texto);
+        largo = strlen(texto);
+        if (usados + largo >= sizeof(bloque))
+        {
+            receptor_mostrar(bloque, nuevo);
+            nuevo = 0;
+            usados = 0;
+        }
+        memcpy(bloque + usados, texto, largo + 1);
+        usados += largo;
+    }
+    receptor_mostrar(bloque, nuevo);
+    printf("\n");
+}
+
+/*!
+ * @brief   Reune las canciones de la copia en el orden del archivo.
+ * @param completas 1 para reunir solo las que tienen los cinco campos.
+ * @param total     Cantidad de canciones reunidas.
+ * @return Canciones (se liberan con free()), o NULL si no hay memoria.
+*/
+static Fila** reunir(int completas, int* total)
+{
+    int i;
+    Fila** seleccion = malloc((size_t)(cantidad + 1) * sizeof(Fila*));
+
+    *total = 0;
+    for (i = 0; seleccion != NULL && i < cantidad; i++)
+    {
+        // una fila sin titulo es el numero de una cancion que se quito.
+        if (filas[i].numero > 0 && filas[i].campos[TITULO][0] != '\0' && (filas[i].completa || !completas))
+        {
+            seleccion[(*total)++] = &filas[i];
+        }
+    }
+    return seleccion;
+}
+
+/*!
+ * @brief   Muestra el listado de la copia local en un orden, como lo enviaria el servidor.
+ * @param orden Orden del listado (0 como en el catalogo, 1 por anio, 2 por titulo, 3 por artista, 4 por genero,
+ *              5 por album). Los ordenados solo muestran las canciones con los cinco campos.
+ * @return OK(0) si se muestra (o se avisa que no hay memoria), ERROR(-1) si el orden no se resuelve en el cliente.
+*/
+int catalogo_listar(int orden)
+{
+    int total;
+    // campo de cada orden, en el orden de los listados del servidor.
+    static const int campos_orden[] = { TITULO, ANIO, TITULO, ARTISTA, GENERO, ALBUM };
+    Fila** seleccion = NULL;
+
+    if (orden < 0 || orden > 5)
+    {
+        return ERROR;
+    }
+    pthread_mutex_lock(&catalogo_mutex);
+    if ((seleccion = reunir(orden != 0, &total)) == NULL)
+    {
+        pthread_mutex_unlock(&catalogo_mutex);
+        printf("No hay memoria para el listado.\n");
+        return OK;
+    }
+    if (orden != 0)
+    {
+        campo_orden = campos_orden[orden];
+        qsort(seleccion, total, sizeof(Fila*), comparar_filas);
+    }
+    mostrar(seleccion, total);
+    pthread_mutex_unlock(&catalogo_mutex);
+    free(seleccion);
+    return OK;
+}
+
+/*!
+ * @brief   Lee un anio de un rango, salteando los espacios de alrededor.
+ * @param texto Texto desde donde leer (avanza hasta despues del anio).
+ * @param anio  Anio leido.
+ * @return 1 si se leyo un anio, 0 si no hay digitos.
+*/
+static int leer_extremo(const char** texto, int* anio)
+{
+    int digitos = 0;
+
+    while (**texto == ' ')
+    {
+        (*texto)++;
+    }
+    for (*anio = 0; isdigit((unsigned char)**texto) && digitos < 6; (*texto)++, digitos++)
+    {
+        *anio = *anio * 10 + (**texto - '0');
+    }
+    while (**texto == ' ')
+    {
+        (*texto)++;
+    }
+    return digitos > 0;
+}
+
+/*!
+ * @brief   Interpreta un rango de anios como el servidor: "1976-1986", "1979", "1976-" o "-1986".
+ * @param texto Rango a interpretar.
+ * @param desde Primer anio del rango.
+ * @param hasta Ultimo anio del rango.
+ * @return OK(0) si el rango es valido, ERROR(-1) si no.
+*/
+static int leer_rango(const char* texto, int* desde, int* hasta)
+{
+    int hay_desde = leer_extremo(&texto, desde);
+    int hay_hasta;
+
+    if (*texto != '-')
+    {
+        *hasta = *desde;
+        return (hay_desde && *texto == '\0') ? OK : ERROR;
+    }
+    texto++;
+    hay_hasta = leer_extremo(&texto, hasta);
+    if (*texto != '\0' || (!hay_desde && !hay_hasta))
+    {
+        return ERROR;
+    }
+    *desde = hay_desde ? *desde : 1;
+    *hasta = hay_hasta ? *hasta : 999999;
+    return (*desde <= *hasta) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Muestra las canciones de la copia local que cumplen un filtro, como las enviaria el servidor.
+ * @param opcion Criterio (1 artista, 2 genero, 3 rango de anios).
+ * @param filtro Valor exacto sin distinguir mayusculas, o rango de anios (ej: 1976-1986, 1979 o 1990-).
+ * @return OK(0) si se resuelve (aunque el rango sea invalido o no haya memoria, que se avisan), ERROR(-1) si el
+ *         criterio no se resuelve en el cliente.
+*/
+int catalogo_filtrar(int opcion, const char* filtro)
+{
+    int i, total, elegidas = 0, desde = 0, hasta = 0;
+    int campo = (opcion == 1) ? ARTISTA : GENERO;
+    Fila** seleccion = NULL;
+
+    if (opcion < 1 || opcion > 3)
+    {
+        return ERROR;
+    }
+    if (opcion == 3 && leer_rango(filtro, &desde, &hasta) != OK)
+    {
+        printf("Rango de anios invalido (ej: 1976-1986).\n");
+        return OK;
+    }
+    pthread_mutex_lock(&catalogo_mutex);
+    if ((seleccion = reunir(1, &total)) == NULL)
+    {
+        pthread_mutex_unlock(&catalogo_mutex);
+        printf("No hay memoria para el filtrado.\n");
+        return OK;
+    }
+    for (i = 0; i < total; i++)
+    {
+        if ((opcion == 3) ? (seleccion[i]->anio >= desde && seleccion[i]->anio <= hasta)
+                          : strcasecmp(seleccion[i]->campos[campo], filtro) == 0)
+        {
+            seleccion[elegidas++] = seleccion[i];
+        }
+    }
+    // el rango se muestra por anio, como en el servidor; artista y genero, en el orden del archivo.
+    if (opcion == 3)
+    {
+        campo_orden = ANIO;
+        qsort(seleccion, elegidas, sizeof(Fila*), comparar_filas);
+    }
+    mostrar(seleccion, elegidas);
+    pthread_mutex_unlock(&catalogo_mutex);
+    free(seleccion);
+    return OK;
+}
+
+/*!
+ * @brief   Libera la copia local en memoria (la de CATALOGO_COPIA se conserva).
+*/
+void catalogo_liberar(void)
+{
+    pthread_mutex_lock(&catalogo_mutex);
+    vaciar();
+    free(aviso);
+    aviso = NULL;
+    aviso_largo = 0;
+    aviso_capacidad = 0;
+    suscripta = 0;
+    al_dia = 0;
+    pthread_mutex_unlock(&catalogo_mutex);
+}
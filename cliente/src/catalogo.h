@@ -0,0 +1,121 @@
+/*!
+ * @file    catalogo.h
+ * @brief   Definiciones y declaraciones de la copia local del catalogo de canciones del cliente.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los campos de cada cancion y la estructura Fila.
+ *          - Declaraciones de funciones para sincronizar la copia, suscribirse a sus cambios, listarla, filtrarla y liberarla.
+ *          El cliente guarda en CATALOGO_COPIA una copia del catalogo del servidor con su version. Antes de cada
+ *          listado o filtrado le pregunta al servidor si la version cambio (SOL_CATALOGO): si no cambio, la
+ *          respuesta es una sola trama de fin; si cambio, llegan solo las canciones agregadas, cambiadas o
+ *          quitadas. Los listados (salvo el de las mas escuchadas) y los filtros por artista, genero y rango de
+ *          anios se resuelven sobre la copia, con el mismo orden y formato que usa el servidor. La consulta
+ *          combinada, la busqueda aproximada y las mas escuchadas se siguen pidiendo al servidor, igual que todo
+ *          si la sincronizacion falla.
+ *          Si la variable AVISOS_ENTORNO vale 1, ademas el cliente se suscribe a los cambios del catalogo
+ *          (SOL_SUSCRIBIR): el servidor le avisa cada cambio con sus filas, que se aplican a la copia al llegar, y
+ *          mientras la copia siga al dia los listados no le preguntan la version. Si un aviso no se puede aplicar,
+ *          el proximo listado vuelve a preguntar. Es opcional porque cada suscripcion ocupa al servidor (una cola
+ *          de eventos y su vigia revisando media.csv cada segundo) y la sincronizacion por listado ya basta.
+*/
+
+#ifndef CATALOGO_H
+#define CATALOGO_H
+
+/*!
+ * @def CATALOGO_COPIA
+ * @brief Archivo con la copia local del catalogo, relativo al directorio del cliente.
+*/
+#define CATALOGO_COPIA "catalogo.copia"
+
+/*!
+ * @def AVISOS_ENTORNO
+ * @brief Variable de entorno que activa la suscripcion a los cambios del catalogo (1 la activa).
+*/
+#define AVISOS_ENTORNO "AVISOS_CATALOGO"
+
+/*!
+ * @def VERSION_MAX
+ * @brief Tamanio maximo de la version del catalogo en hexadecimal, con el terminador.
+*/
+#define VERSION_MAX 32
+
+/*!
+ * @def TITULO
+ * @brief Campo del titulo de la cancion (ARTISTA y GENERO estan en canciones.h).
+*/
+#define TITULO 0
+
+/*!
+ * @def ALBUM
+ * @brief Campo del album de la cancion.
+*/
+#define ALBUM 2
+
+/*!
+ * @def ANIO
+ * @brief Campo del anio de la cancion.
+*/
+#define ANIO 4
+
+/*!
+ * @def CAMPOS
+ * @brief Cantidad de campos de cada cancion (titulo, artista, album, genero y anio).
+*/
+#define CAMPOS 5
+
+/*!
+ * @struct Fila
+ * @brief Cancion de la copia local del catalogo.
+*/
+typedef struct Fila
+{
+    int numero;                   /**< Numero de la cancion (0 si la posicion esta libre). */
+    int completa;                 /**< 1 si la linea de media.csv tiene los cinco campos. */
+    int anio;                     /**< Anio como numero (0 si falta o no es valido). */
+    char* texto;                  /**< Campos separados por '\0' (se libera con free()). */
+    const char* campos[CAMPOS];   /**< Cada campo, apuntando a texto (vacio si falta). */
+} Fila;
+
+/*!
+ * @brief   Sincroniza la copia local del catalogo con el servidor. La primera vez la lee de CATALOGO_COPIA.
+ *          Si la copia cambia, se vuelve a guardar.
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si la copia quedo al dia, ERROR(-1) si no (el listado o filtrado se pide al servidor).
+*/
+int catalogo_sincronizar(int sock);
+
+/*!
+ * @brief   Suscribe la conexion a los cambios del catalogo (ver SOL_SUSCRIBIR), si la variable AVISOS_ENTORNO
+ *          lo pide. Mientras dure, los cambios se aplican a la copia al llegar y los listados no preguntan al
+ *          servidor por la version.
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si se pide la suscripcion o no esta activada, ERROR(-1) si no se pudo pedir (la copia se sigue
+ *         sincronizando en cada listado).
+*/
+int catalogo_suscribir(int sock);
+
+/*!
+ * @brief   Muestra el listado de la copia local en un orden, como lo enviaria el servidor.
+ * @param orden Orden del listado (0 como en el catalogo, 1 por anio, 2 por titulo, 3 por artista, 4 por genero,
+ *              5 por album). Los ordenados solo muestran las canciones con los cinco campos.
+ * @return OK(0) si se muestra (o se avisa que no hay memoria), ERROR(-1) si el orden no se resuelve en el cliente.
+*/
+int catalogo_listar(int orden);
+
+/*!
+ * @brief   Muestra las canciones de la copia local que cumplen un filtro, como las enviaria el servidor.
+ * @param opcion Criterio (1 artista, 2 genero, 3 rango de anios).
+ * @param filtro Valor exacto sin distinguir mayusculas, o rango de anios (ej: 1976-1986, 1979 o 1990-).
+ * @return OK(0) si se resuelve (aunque el rango sea invalido o no haya memoria, que se avisan), ERROR(-1) si el
+ *         criterio no se resuelve en el cliente.
+*/
+int catalogo_filtrar(int opcion, const char* filtro);
+
+/*!
+ * @brief   Libera la copia local en memoria (la de CATALOGO_COPIA se conserva).
+*/
+void catalogo_liberar(void);
+
+#endif
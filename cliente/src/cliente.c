@@ -12,8 +12,10 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "menu.h"
 #include "canciones.h"
+#include "transporte.h"
 
 /*!
  * @brief   Funcion principal del cliente.
@@ -33,7 +35,13 @@ int main(void)
     {
         return ERROR;
     }
-    printf("Conectado al servidor en %s:%d\n", SERVER_IP, SERVER_PORT);
+    if (transporte_local())
+    {
+        printf("Conectado al servidor por %s\n", getenv(SERVER_LOCAL_ENTORNO));
+    } else
+    {
+        printf("Conectado al servidor en %s:%d\n", SERVER_IP, SERVER_PORT);
+    }
     // ingresamos al bucle del cliente.
     menu_cliente(sock);
 
@@ -4,7 +4,7 @@
  * @author  Grupo 3
  * @date    18/12/2024
  * @details Este archivo implementa las funciones necesarias para:
- *          - Enlazar una conexion TCP con el servidor.
+ *          - Enlazar una conexion TCP con el servidor, o por su socket Unix si esta en la misma maquina.
  *          - Exponer el menu principal del cliente.
  *          - Gestionar operaciones de inicio de sesion y registro.
  *          Dependencias:
@@ -14,16 +14,56 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include "menu.h"
 #include "canciones.h"
 #include "usuarios.h"
+#include "transporte.h"
+#include "protocolo.h"
+
+/*!
+ * @brief   Enlaza conexion con el socket Unix del servidor, en la misma maquina.
+ * @param ruta Ruta del socket del servidor.
+ * @return  Retorna el descriptor del socket si la conexion es exitosa.
+ *          Retorna ERROR (-1) si ocurre un error.
+*/
+static int conexion_local(const char* ruta)
+{
+    int sock;
+    struct sockaddr_un server_addr;
+
+    if (strlen(ruta) >= sizeof(server_addr.sun_path))
+    {
+        fprintf(stderr, "Ruta del socket local demasiado larga.\n");
+        return ERROR;
+    }
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+        perror("Error al crear el socket.\n");
+        return ERROR;
+    }
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sun_family = AF_UNIX;
+    strcpy(server_addr.sun_path, ruta);
+    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        perror("Error de conexion con el servidor.\n");
+        close(sock);
+        return ERROR;
+    }
+    transporte_iniciar(sock);
+
+    return sock;
+}
 
 /*!
  * @brief   Enlaza conexion TCP con el servidor. Crea un socket, configura la direccion del
- *          servidor y establece una conexion.
+ *          servidor y establece una conexion. Si esta definida SERVER_LOCAL_ENTORNO, se conecta
+ *          en cambio por el socket Unix del servidor.
  * @return  Retorna el descriptor del socket si la conexion es exitosa. 
  *          Retorna ERROR (-1) si ocurre un error.
 */
@@ -31,7 +71,12 @@ int conexion(void)
 {
     int sock;
     struct sockaddr_in server_addr;
-    
+    const char* local = getenv(SERVER_LOCAL_ENTORNO);
+
+    if (local != NULL && *local != '\0')
+    {
+        return conexion_local(local);
+    }
     // crear el socket.
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
     {
@@ -54,6 +99,7 @@ int conexion(void)
         close(sock);
         return ERROR;
     }
+    transporte_iniciar(sock);
 
     return sock;
 }
@@ -67,10 +113,17 @@ int conexion(void)
 void menu_cliente(int sock)
 {
     int opcion;
-    ssize_t bytes_received;
-    char buffer[BUFFER_SIZE];
+    char* buffer = NULL;
     Cuenta credencial;
+    Cabecera cabecera;
 
+    // las respuestas pueden traer bloques grandes de datos, el buffer se reserva una sola vez.
+    if ((buffer = malloc(CARGA_MAX)) == NULL)
+    {
+        perror("Error al reservar buffer de recepcion.\n");
+        close(sock);
+        return;
+    }
     do
     {
         if ((opcion = op_menu()) == 3) // mostrar el menu de opciones, en caso de ser igual a 3, finalizamos.
@@ -78,21 +131,20 @@ void menu_cliente(int sock)
             printf("Desconectando...\n");
             break;  
         }
-        // enviar usuario, contrasenia y opcion al servidor.
+        // enviar usuario y contrasenia en una solicitud de inicio de sesion o registro.
         ingresar_datos(credencial.usuario, credencial.contrasenia);
-        snprintf(buffer, BUFFER_SIZE, "%d:%s:%s", opcion, credencial.usuario, credencial.contrasenia);
-        if (send(sock, buffer, strlen(buffer), 0) < 0)
+        snprintf(buffer, BUFFER_SIZE, "%s:%s", credencial.usuario, credencial.contrasenia);
+        if (enviar_texto(sock, nueva_solicitud(), (opcion == 1) ? SOL_INICIO : SOL_REGISTRO, buffer) != OK)
         {
             perror("Error al enviar datos de usuario.\n");
             break;
         }
         // recibir respuesta del servidor
-        if ((bytes_received = recv(sock, buffer, BUFFER_SIZE, 0)) <= 0)
+        if (recibir_trama(sock, &cabecera, buffer, CARGA_MAX) != OK)
         {
             perror("Error al recibir respuesta del servidor.\n");
             break;
         }
-        buffer[bytes_received] = '\0';
         if (opcion == 1) // iniciar sesion.
         {
             if (strcmp(buffer, EXITO) == 0)
@@ -118,6 +170,7 @@ void menu_cliente(int sock)
     } while (opcion != 3);
 
     // cerrar el socket.
+    free(buffer);
     close(sock);
 }
 
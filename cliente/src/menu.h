@@ -11,6 +11,7 @@
 /*!
  * @brief   Establece una conexion TCP con el servidor.
  *          Esta funcion crea un socket, configura la direccion del servidor y establece una conexion.
+ *          Si esta definida SERVER_LOCAL_ENTORNO, se conecta en cambio por el socket Unix del servidor.
  * @return  Retorna el descriptor del socket si la conexion es exitosa.
  *          Retorna ERROR (-1) si ocurre un error.
 */
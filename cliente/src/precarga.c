@@ -0,0 +1,183 @@
+/*!
+ * @file    precarga.c
+ * @brief   Precargador de canciones del cliente: descarga las siguientes mientras suena una cancion.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Elegir las canciones que siguen a la que suena en el ultimo listado o filtrado mostrado.
+ *          - Pedirlas de a una como precarga, salteando las que ya estan en el sistema.
+ *          - Limitar su ancho de banda devolviendo la ventana de a poco.
+ *          - Cancelar las precargas que dejan de hacer falta cuando cambia la cancion que suena.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "precarga.h"
+#include "receptor.h"
+#include "canciones.h"
+
+static pthread_t hilo_precarga;                                    // hilo que pide las precargas.
+static pthread_mutex_t precarga_mutex = PTHREAD_MUTEX_INITIALIZER; // protege sonando y terminar.
+static pthread_cond_t precarga_cond = PTHREAD_COND_INITIALIZER;    // avisa una cancion nueva o el fin.
+static int sonando = 0;                                            // cancion que empezo a sonar (0 si ya se atendio).
+static int terminar = 0;                                           // 1 si el hilo debe terminar.
+static int activo = 0;                                             // 1 si el hilo esta en marcha.
+static long tasa = PRECARGA_TASA;                                  // bytes por segundo de la precarga.
+
+/*!
+ * @brief   Busca las canciones que siguen a una en el ultimo listado o filtrado mostrado.
+ *          No saltea las que tienen archivo: puede ser el de una precarga en curso, que hay que conservar.
+ * @param numero   Numero de la cancion que suena.
+ * @param numeros  Canciones a completar (PRECARGA_CANTIDAD elementos).
+ * @return Cantidad de canciones (0 si la cancion no esta en el ultimo resultado).
+*/
+static int buscar_siguientes(int numero, int* numeros)
+{
+    int siguiente, encontrada = 0, cantidad = 0;
+    char lista[BUFFER_SIZE];
+    char* token = NULL;
+    char* resto = NULL;
+
+    receptor_ultimo_resultado(lista, sizeof(lista));
+    for (token = strtok_r(lista, ",", &resto); token != NULL && cantidad < PRECARGA_CANTIDAD; token = strtok_r(NULL, ",", &resto))
+    {
+        siguiente = atoi(token);
+        if (!encontrada)
+        {
+            encontrada = (siguiente == numero);
+            continue;
+        }
+        if (siguiente > 0 && siguiente != numero)
+        {
+            numeros[cantidad++] = siguiente;
+        }
+    }
+    return cantidad;
+}
+
+/*!
+ * @brief   Hilo precargador: cada PRECARGA_PASO milisegundos atiende la cancion que empezo a sonar, pide la
+ *          siguiente precarga si no hay ninguna en curso y devuelve la ventana que permite la tasa.
+ * @param arg Puntero (reservado con malloc) al descriptor del socket. Se libera aqui.
+ * @return NULL al finalizar.
+*/
+static void* precargar(void* arg)
+{
+    int sock = *(int*)arg;
+    int numero, cantidad = 0, siguiente = 0;
+    int pendientes[PRECARGA_CANTIDAD];
+    char nombre[NOMBRE_MAX];
+    struct timespec limite;
+
+    free(arg);
+    pthread_mutex_lock(&precarga_mutex);
+    while (!terminar)
+    {
+        clock_gettime(CLOCK_REALTIME, &limite);
+        limite.tv_nsec += PRECARGA_PASO * 1000000L;
+        if (limite.tv_nsec >= 1000000000L)
+        {
+            limite.tv_sec++;
+            limite.tv_nsec -= 1000000000L;
+        }
+        while (sonando == 0 && !terminar && pthread_cond_timedwait(&precarga_cond, &precarga_mutex, &limite) == 0);
+        if (terminar)
+        {
+            break;
+        }
+        numero = sonando;
+        sonando = 0;
+        pthread_mutex_unlock(&precarga_mutex);
+        if (numero > 0)
+        {
+            // cambio la cancion que suena: se cancelan las precargas que ya no le siguen.
+            cantidad = buscar_siguientes(numero, pendientes);
+            siguiente = 0;
+            receptor_cancelar_precargas(sock, pendientes, cantidad);
+        }
+        // de a una precarga por vez, asi la primera que se va a necesitar llega antes. Sin precargas en curso,
+        // un archivo que existe es una cancion completa o una descarga comun en curso: no hace falta pedirla.
+        while (siguiente < cantidad && receptor_precargas() == 0)
+        {
+            snprintf(nombre, sizeof(nombre), "%d.mp3", pendientes[siguiente]);
+            if (access(nombre, F_OK) != 0)
+            {
+                receptor_precargar(sock, pendientes[siguiente++]);
+                break;
+            }
+            siguiente++;
+        }
+        receptor_devolver_precargas(sock, tasa * PRECARGA_PASO / 1000);
+        pthread_mutex_lock(&precarga_mutex);
+    }
+    pthread_mutex_unlock(&precarga_mutex);
+    return NULL;
+}
+
+/*!
+ * @brief   Inicia el hilo precargador. Debe llamarse despues de receptor_iniciar().
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si se inicia o esta desactivado, ERROR(-1) si no se pudo crear el hilo.
+*/
+int precarga_iniciar(int sock)
+{
+    int* sock_hilo = NULL;
+    const char* entorno = getenv(PRECARGA_ENTORNO);
+
+    if (entorno != NULL)
+    {
+        tasa = atol(entorno) * 1024;
+    }
+    if (tasa <= 0)
+    {
+        return OK;
+    }
+    if ((sock_hilo = malloc(sizeof(int))) == NULL)
+    {
+        perror("Error al reservar memoria para el precargador.\n");
+        return ERROR;
+    }
+    *sock_hilo = sock;
+    terminar = 0;
+    if (pthread_create(&hilo_precarga, NULL, precargar, sock_hilo) != 0)
+    {
+        perror("Error al crear hilo precargador.\n");
+        free(sock_hilo);
+        return ERROR;
+    }
+    activo = 1;
+    return OK;
+}
+
+/*!
+ * @brief   Avisa que empezo a sonar una cancion, para precargar las que le siguen.
+ * @param numero Numero de la cancion.
+*/
+void precarga_sonando(int numero)
+{
+    pthread_mutex_lock(&precarga_mutex);
+    sonando = numero;
+    pthread_cond_signal(&precarga_cond);
+    pthread_mutex_unlock(&precarga_mutex);
+}
+
+/*!
+ * @brief   Finaliza el hilo precargador. Las precargas en curso las cancela receptor_finalizar().
+*/
+void precarga_finalizar(void)
+{
+    if (!activo)
+    {
+        return;
+    }
+    pthread_mutex_lock(&precarga_mutex);
+    terminar = 1;
+    pthread_cond_signal(&precarga_cond);
+    pthread_mutex_unlock(&precarga_mutex);
+    pthread_join(hilo_precarga, NULL);
+    activo = 0;
+}
@@ -0,0 +1,62 @@
+/*!
+ * @file    precarga.h
+ * @brief   Definiciones y declaraciones del precargador de canciones del cliente.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros del precargador.
+ *          - Declaraciones de funciones para iniciarlo, avisarle que empezo a sonar una cancion y finalizarlo.
+ *          Mientras suena una cancion, un hilo aparte descarga (SOL_PRECARGA) las PRECARGA_CANTIDAD canciones que
+ *          le siguen en el ultimo listado o filtrado mostrado (con el listado por album, las siguientes del album),
+ *          de a una y sin reproducirlas: si despues se elige una de ellas, ya esta en el sistema y suena enseguida.
+ *          El ancho de banda se limita devolviendo la ventana de la precarga de a poco, a PRECARGA_TASA bytes por
+ *          segundo (o los KiB/s de la variable PRECARGA_ENTORNO; 0 desactiva el precargador). Si empieza a sonar
+ *          otra cancion, las precargas que ya no hacen falta se cancelan (SOL_CANCELAR) y se borran.
+*/
+
+#ifndef PRECARGA_H
+#define PRECARGA_H
+
+/*!
+ * @def PRECARGA_CANTIDAD
+ * @brief Canciones siguientes a la que suena que se precargan.
+*/
+#define PRECARGA_CANTIDAD 2
+
+/*!
+ * @def PRECARGA_TASA
+ * @brief Bytes por segundo que puede usar la precarga.
+*/
+#define PRECARGA_TASA (1024 * 1024)
+
+/*!
+ * @def PRECARGA_PASO
+ * @brief Milisegundos entre dos devoluciones de ventana de la precarga.
+*/
+#define PRECARGA_PASO 100
+
+/*!
+ * @def PRECARGA_ENTORNO
+ * @brief Variable de entorno con la tasa de la precarga en KiB/s (0 la desactiva).
+*/
+#define PRECARGA_ENTORNO "PRECARGA_KIBS"
+
+/*!
+ * @brief   Inicia el hilo precargador. Debe llamarse despues de receptor_iniciar().
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si se inicia o esta desactivado, ERROR(-1) si no se pudo crear el hilo.
+*/
+int precarga_iniciar(int sock);
+
+/*!
+ * @brief   Avisa que empezo a sonar una cancion, para precargar las que le siguen.
+ * @param numero Numero de la cancion.
+*/
+void precarga_sonando(int numero);
+
+/*!
+ * @brief   Finaliza el hilo precargador. Las precargas en curso las cancela receptor_finalizar().
+*/
+void precarga_finalizar(void);
+
+#endif
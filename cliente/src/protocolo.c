@@ -0,0 +1,242 @@
+/*!
+ * @file    protocolo.c
+ * @brief   Envio y recepcion de tramas del protocolo entre cliente y servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Serializar la cabecera de una trama y enviarla junto a su carga en una sola llamada.
+ *          - Recibir tramas completas, aunque lleguen partidas en varias recepciones, con el descriptor que
+ *            el servidor adjunte por el socket Unix (ver SOL_DESCRIPTOR).
+ *          - Asignar identificadores a las solicitudes del cliente.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include "protocolo.h"
+#include "canciones.h"
+
+static uint32_t ultima_solicitud = 0; // ultimo identificador de solicitud asignado.
+
+/*!
+ * @brief   Toma el descriptor adjunto a un mensaje recibido, si trae. Si ya habia uno, el nuevo se cierra.
+ * @param mensaje    Mensaje recibido con recvmsg.
+ * @param descriptor Descriptor recibido (-1 si todavia no hay).
+*/
+static void tomar_descriptor(struct msghdr* mensaje, int* descriptor)
+{
+    int recibido;
+    struct cmsghdr* control = NULL;
+
+    for (control = CMSG_FIRSTHDR(mensaje); control != NULL; control = CMSG_NXTHDR(mensaje, control))
+    {
+        if (control->cmsg_level != SOL_SOCKET || control->cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+        memcpy(&recibido, CMSG_DATA(control), sizeof(int));
+        if (*descriptor < 0)
+        {
+            *descriptor = recibido;
+        } else
+        {
+            close(recibido);
+        }
+    }
+}
+
+/*!
+ * @brief   Recibe exactamente la cantidad de bytes pedida.
+ * @param sock       Descriptor del socket.
+ * @param datos      Buffer destino.
+ * @param largo      Cantidad de bytes a recibir.
+ * @param descriptor Descriptor adjunto a los bytes recibidos (-1 si no trae).
+ * @return OK(0) si se reciben todos, SALIR(-4) si el otro extremo cerro, ERROR(-1) ante un error.
+*/
+static int recibir_todo(int sock, void* datos, size_t largo, int* descriptor)
+{
+    ssize_t recibidos;
+    size_t total = 0;
+    struct iovec parte;
+    struct msghdr mensaje;
+    union
+    {
+        struct cmsghdr alineado;
+        char espacio[CMSG_SPACE(sizeof(int))];
+    } adjunto;
+
+    while (total < largo)
+    {
+        parte.iov_base = (char*)datos + total;
+        parte.iov_len = largo - total;
+        memset(&mensaje, 0, sizeof(mensaje));
+        mensaje.msg_iov = &parte;
+        mensaje.msg_iovlen = 1;
+        mensaje.msg_control = adjunto.espacio;
+        mensaje.msg_controllen = sizeof(adjunto.espacio);
+        // sin MSG_CMSG_CLOEXEC el reproductor, que se lanza con system(), heredaria los descriptores.
+        if ((recibidos = recvmsg(sock, &mensaje, MSG_CMSG_CLOEXEC)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return ERROR;
+        } else if (recibidos == 0)
+        {
+            return SALIR;
+        }
+        tomar_descriptor(&mensaje, descriptor);
+        total += recibidos;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Envia una trama completa (cabecera y carga) en una sola llamada al sistema.
+ *          Reintenta hasta enviar todos los bytes.
+ * @param sock     Descriptor del socket.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param carga    Carga util (puede ser NULL si longitud es 0).
+ * @param longitud Bytes de carga util.
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int enviar_trama(int sock, uint32_t id, uint8_t tipo, const void* carga, size_t longitud)
+{
+    unsigned char cabecera[CABECERA_TAMANIO];
+    uint32_t red;
+    struct iovec partes[2];
+    struct msghdr mensaje;
+    ssize_t enviados;
+
+    // serializamos la cabecera en orden de red.
+    red = htonl(id);
+    memcpy(cabecera, &red, 4);
+    cabecera[4] = tipo;
+    red = htonl((uint32_t)longitud);
+    memcpy(cabecera + 5, &red, 4);
+    partes[0].iov_base = cabecera;
+    partes[0].iov_len = CABECERA_TAMANIO;
+    partes[1].iov_base = (void*)carga;
+    partes[1].iov_len = longitud;
+    memset(&mensaje, 0, sizeof(mensaje));
+    mensaje.msg_iov = partes;
+    mensaje.msg_iovlen = (longitud > 0) ? 2 : 1;
+    while (mensaje.msg_iovlen > 0)
+    {
+        if ((enviados = sendmsg(sock, &mensaje, MSG_NOSIGNAL)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return ERROR;
+        }
+        // avanzamos sobre lo ya enviado por si el envio fue parcial.
+        while (mensaje.msg_iovlen > 0 && (size_t)enviados >= mensaje.msg_iov[0].iov_len)
+        {
+            enviados -= mensaje.msg_iov[0].iov_len;
+            mensaje.msg_iov++;
+            mensaje.msg_iovlen--;
+        }
+        if (mensaje.msg_iovlen > 0)
+        {
+            mensaje.msg_iov[0].iov_base = (char*)mensaje.msg_iov[0].iov_base + enviados;
+            mensaje.msg_iov[0].iov_len -= enviados;
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Envia una trama cuya carga es una cadena de texto.
+ * @param sock  Descriptor del socket.
+ * @param id    Identificador de la solicitud.
+ * @param tipo  Tipo de trama.
+ * @param texto Cadena a enviar (sin el terminador).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int enviar_texto(int sock, uint32_t id, uint8_t tipo, const char* texto)
+{
+    return enviar_trama(sock, id, tipo, texto, strlen(texto));
+}
+
+/*!
+ * @brief   Recibe una trama completa y el descriptor que el servidor le haya adjuntado (ver SOL_DESCRIPTOR).
+ * @param sock       Descriptor del socket.
+ * @param cabecera   Cabecera recibida.
+ * @param carga      Buffer donde se copia la carga util.
+ * @param maximo     Tamanio del buffer de carga (incluye lugar para el terminador).
+ * @param descriptor Descriptor recibido con la trama (se cierra con close()), o -1 si no trae.
+ * @return OK(0) si se recibe la trama, SALIR(-4) si el otro extremo cerro la conexion,
+ *         ERROR(-1) si ocurre un problema o la carga no entra en el buffer.
+*/
+int recibir_trama_descriptor(int sock, Cabecera* cabecera, char* carga, size_t maximo, int* descriptor)
+{
+    int estado;
+    uint32_t red;
+    unsigned char datos[CABECERA_TAMANIO];
+
+    *descriptor = -1;
+    if ((estado = recibir_todo(sock, datos, CABECERA_TAMANIO, descriptor)) == OK)
+    {
+        memcpy(&red, datos, 4);
+        cabecera->id = ntohl(red);
+        cabecera->tipo = datos[4];
+        memcpy(&red, datos + 5, 4);
+        cabecera->longitud = ntohl(red);
+        if (cabecera->longitud >= maximo)
+        {
+            fprintf(stderr, "Trama demasiado grande (%u bytes).\n", cabecera->longitud);
+            estado = ERROR;
+        } else if ((estado = recibir_todo(sock, carga, cabecera->longitud, descriptor)) == OK)
+        {
+            carga[cabecera->longitud] = '\0';
+            return OK;
+        }
+    }
+    // la trama no se completo: su descriptor no le sirve a nadie.
+    if (*descriptor >= 0)
+    {
+        close(*descriptor);
+        *descriptor = -1;
+    }
+    return estado;
+}
+
+/*!
+ * @brief   Recibe una trama completa.
+ *          La carga se termina con '\0' para poder tratarla como texto.
+ * @param sock     Descriptor del socket.
+ * @param cabecera Cabecera recibida.
+ * @param carga    Buffer donde se copia la carga util.
+ * @param maximo   Tamanio del buffer de carga (incluye lugar para el terminador).
+ * @return OK(0) si se recibe la trama, SALIR(-4) si el otro extremo cerro la conexion,
+ *         ERROR(-1) si ocurre un problema o la carga no entra en el buffer.
+*/
+int recibir_trama(int sock, Cabecera* cabecera, char* carga, size_t maximo)
+{
+    int descriptor;
+    int estado = recibir_trama_descriptor(sock, cabecera, carga, maximo, &descriptor);
+
+    // nadie espera un descriptor con esta trama: no se deja abierto.
+    if (descriptor >= 0)
+    {
+        close(descriptor);
+    }
+    return estado;
+}
+
+/*!
+ * @brief   Devuelve un identificador nuevo para una solicitud.
+ * @return  Identificador no usado antes en esta ejecucion.
+*/
+uint32_t nueva_solicitud(void)
+{
+    return ++ultima_solicitud;
+}
@@ -0,0 +1,260 @@
+/*!
+ * @file    protocolo.h
+ * @brief   Definiciones y declaraciones del protocolo de tramas entre cliente y servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Cada mensaje viaja en una trama con cabecera fija:
+ *          - id (4 bytes): identificador de la solicitud, elegido por el cliente.
+ *          - tipo (1 byte): tipo de solicitud o de respuesta.
+ *          - longitud (4 bytes): bytes de carga util que siguen a la cabecera.
+ *          Los enteros viajan en orden de red. El cliente puede enviar varias solicitudes sin esperar
+ *          respuesta; el servidor las procesa en orden y responde a cada una con cero o mas tramas
+ *          RESP_DATOS seguidas de una trama RESP_FIN o RESP_ERROR, todas con el id de la solicitud.
+ *          Cada descarga (SOL_CANCION o SOL_DESDE) abre un canal: sus tramas se intercalan con las de otras
+ *          descargas y respuestas, y el servidor no envia mas bytes de datos que la ventana que el
+ *          cliente le concede para ese canal (VENTANA_INICIAL mas lo devuelto con SOL_VENTANA).
+ *          Un lote (SOL_LOTE) usa un solo canal: cada archivo empieza con una trama RESP_ARCHIVO
+ *          seguida de sus tramas RESP_DATOS, y el lote termina con una unica trama RESP_FIN.
+ *          Una precarga (SOL_PRECARGA) es una descarga de fondo: empieza con PRECARGA_VENTANA bytes de ventana
+ *          y cede el ancho de banda a las demas descargas. SOL_CANCELAR cierra cualquier canal sin trama de fin.
+ *          SOL_CATALOGO sincroniza la copia local del catalogo del cliente: con ella el cliente lista y filtra
+ *          sin pedirle las filas al servidor. Con SOL_SUSCRIBIR el servidor le avisa, sin que lo pida, cada cambio
+ *          del catalogo.
+ *          Ademas del puerto TCP, el servidor escucha en un socket Unix para los clientes de la misma maquina
+ *          (LOCAL_RUTA en el servidor). Por ese socket las tramas son las mismas, y con SOL_DESCRIPTOR el cliente
+ *          recibe el descriptor del archivo de una cancion en lugar de sus bytes.
+*/
+
+#ifndef PROTOCOLO_H
+#define PROTOCOLO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "transporte.h"
+
+/*!
+ * @def CARGA_MAX
+ * @brief Tamanio del buffer de recepcion de tramas: la mayor carga que envia el servidor mas el terminador.
+*/
+#define CARGA_MAX (BLOQUE_MAX + 1)
+
+/*!
+ * @def CABECERA_TAMANIO
+ * @brief Tamanio en bytes de la cabecera serializada de una trama.
+*/
+#define CABECERA_TAMANIO 9
+
+/*!
+ * @def SOL_INICIO
+ * @brief Solicitud de inicio de sesion. Carga: "usuario:contrasenia".
+*/
+#define SOL_INICIO 1
+
+/*!
+ * @def SOL_REGISTRO
+ * @brief Solicitud de registro de usuario. Carga: "usuario:contrasenia".
+*/
+#define SOL_REGISTRO 2
+
+/*!
+ * @def SOL_LISTAR
+ * @brief Solicitud de listado de canciones. Carga: orden del listado (vacia o 0 como en el catalogo,
+ *        1 por anio, 2 por titulo, 3 por artista, 4 por genero, 5 por album, 6 las mas escuchadas
+ *        con sus reproducciones al final de cada fila).
+*/
+#define SOL_LISTAR 3
+
+/*!
+ * @def SOL_FILTRAR
+ * @brief Solicitud de filtrado de canciones. Carga: "opcion:filtro" (1 artista, 2 genero,
+ *        3 rango de anios, ej: "3:1976-1986", 4 consulta combinada, ej: "4:artista=Soda Stereo & anio=1985-1990",
+ *        5 busqueda aproximada, ej: "5:pink floid").
+*/
+#define SOL_FILTRAR 4
+
+/*!
+ * @def SOL_CANCION
+ * @brief Solicitud de descarga de una cancion. Carga: numero de la cancion, ej: "12"
+ *        (por compatibilidad tambien se acepta "12.mp3"; no se aceptan otros nombres de archivo).
+*/
+#define SOL_CANCION 5
+
+/*!
+ * @def SOL_VENTANA
+ * @brief Devuelve ventana a un canal de descarga. El id es el de la solicitud SOL_CANCION, SOL_DESDE, SOL_LOTE
+ *        o SOL_PRECARGA.
+ *        Carga: 4 bytes en orden de red con la cantidad de bytes que el cliente ya consumio.
+*/
+#define SOL_VENTANA 6
+
+/*!
+ * @def SOL_LOTE
+ * @brief Solicitud de descarga de varias canciones en un solo canal.
+ *        Carga: numeros de cancion separados por comas (ej. "1,4,7").
+*/
+#define SOL_LOTE 7
+
+/*!
+ * @def SOL_DESDE
+ * @brief Solicitud de descarga de una cancion a partir de un instante. Carga: numero de la cancion y
+ *        segundos desde el comienzo, ej: "12:95.5". La respuesta es como la de SOL_CANCION, pero empieza
+ *        en el marco MP3 que suena en ese instante, asi el reproductor puede empezar por el primer byte.
+*/
+#define SOL_DESDE 8
+
+/*!
+ * @def SOL_PRECARGA
+ * @brief Solicitud de descarga anticipada de una cancion que el cliente todavia no pidio escuchar.
+ *        Carga: numero de la cancion, ej: "12". La respuesta es como la de SOL_CANCION, pero no cuenta como
+ *        reproduccion, el canal empieza con PRECARGA_VENTANA bytes de ventana y en el reparto del ancho de
+ *        banda pesa menos que las demas descargas.
+*/
+#define SOL_PRECARGA 9
+
+/*!
+ * @def SOL_CANCELAR
+ * @brief Cancela un canal de descarga. El id es el de la solicitud SOL_CANCION, SOL_DESDE, SOL_LOTE o SOL_PRECARGA.
+ *        Sin carga ni respuesta: el servidor deja de enviar y no envia la trama de fin (las tramas que ya
+ *        estaban en camino pueden llegar igual).
+*/
+#define SOL_CANCELAR 10
+
+/*!
+ * @def SOL_CATALOGO
+ * @brief Solicitud de sincronizacion del catalogo. Carga: version de la copia del cliente en hexadecimal
+ *        (vacia si no tiene copia). Cada trama RESP_DATOS trae filas completas, una por linea:
+ *        "+N,C,titulo,artista,album,genero,anio" agrega o reemplaza la cancion N (C es 1 si la linea de media.csv
+ *        tiene los cinco campos) y "-N" la quita. La trama RESP_FIN trae "version cantidad modo": con modo "igual"
+ *        la copia ya esta al dia y no hay filas; con "cambios" solo vienen las filas que cambiaron desde la version
+ *        del cliente; con "completo" vienen todas (la version del cliente es desconocida o demasiado vieja).
+ *        En todos los casos la copia queda con las canciones 1 a cantidad.
+*/
+#define SOL_CATALOGO 11
+
+/*!
+ * @def SOL_SUSCRIBIR
+ * @brief Suscripcion a los cambios del catalogo. Sin carga. La respuesta no termina: cada vez que el catalogo
+ *        cambia, el servidor envia con el id de la suscripcion las filas que cambiaron (tramas RESP_DATOS, en el
+ *        formato de SOL_CATALOGO) seguidas de una trama RESP_EVENTO. Una conexion tiene una sola suscripcion,
+ *        que dura hasta que se cierra; si no se acepta, la respuesta es RESP_ERROR.
+*/
+#define SOL_SUSCRIBIR 12
+
+/*!
+ * @def SOL_DESCRIPTOR
+ * @brief Solicitud del archivo de una cancion por descriptor. Carga: numero de cancion ("12").
+ *        Solo por el socket Unix: la respuesta es una trama RESP_FIN con el tamanio del archivo en bytes, que
+ *        lleva adjunto (SCM_RIGHTS) un descriptor de solo lectura del archivo; el cliente lo lee o lo copia sin
+ *        que los bytes pasen por el socket. Si la cancion no existe o la conexion no es local, RESP_ERROR.
+*/
+#define SOL_DESCRIPTOR 13
+
+/*!
+ * @def VENTANA_INICIAL
+ * @brief Bytes de datos que el servidor puede enviar por un canal antes de recibir SOL_VENTANA.
+*/
+#define VENTANA_INICIAL (4 * 1024 * 1024)
+
+/*!
+ * @def PRECARGA_VENTANA
+ * @brief Bytes de datos que el servidor puede enviar por un canal de SOL_PRECARGA antes de recibir SOL_VENTANA.
+*/
+#define PRECARGA_VENTANA (256 * 1024)
+
+/*!
+ * @def RESP_DATOS
+ * @brief Respuesta parcial: filas de un listado o bytes de una cancion.
+*/
+#define RESP_DATOS 0x80
+
+/*!
+ * @def RESP_FIN
+ * @brief Fin exitoso de una respuesta. Carga: mensaje de estado (puede estar vacia).
+*/
+#define RESP_FIN 0x81
+
+/*!
+ * @def RESP_ERROR
+ * @brief Fin con error de una respuesta. Carga: mensaje de error.
+*/
+#define RESP_ERROR 0x82
+
+/*!
+ * @def RESP_ARCHIVO
+ * @brief Comienzo de un archivo dentro de la respuesta a un lote. Carga: nombre del archivo.
+*/
+#define RESP_ARCHIVO 0x83
+
+/*!
+ * @def RESP_EVENTO
+ * @brief Fin de un cambio del catalogo dentro de una suscripcion (SOL_SUSCRIBIR).
+ *        Carga: "anterior nueva cantidad modo". Las filas que la preceden llevan el catalogo de la version anterior
+ *        a la nueva, que tiene las canciones 1 a cantidad; con modo "completo" no hay filas (la version anterior
+ *        ya no se guarda) y el cliente debe sincronizar su copia con SOL_CATALOGO.
+*/
+#define RESP_EVENTO 0x84
+
+/*!
+ * @struct Cabecera
+ * @brief Cabecera de una trama del protocolo.
+*/
+typedef struct Cabecera
+{
+    uint32_t id;       /**< Identificador de la solicitud a la que pertenece la trama. */
+    uint8_t tipo;      /**< Tipo de solicitud (SOL_*) o de respuesta (RESP_*). */
+    uint32_t longitud; /**< Bytes de carga util. */
+} Cabecera;
+
+/*!
+ * @brief   Envia una trama completa (cabecera y carga) en una sola llamada al sistema.
+ *          Reintenta hasta enviar todos los bytes.
+ * @param sock     Descriptor del socket.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param carga    Carga util (puede ser NULL si longitud es 0).
+ * @param longitud Bytes de carga util.
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int enviar_trama(int sock, uint32_t id, uint8_t tipo, const void* carga, size_t longitud);
+
+/*!
+ * @brief   Envia una trama cuya carga es una cadena de texto.
+ * @param sock  Descriptor del socket.
+ * @param id    Identificador de la solicitud.
+ * @param tipo  Tipo de trama.
+ * @param texto Cadena a enviar (sin el terminador).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int enviar_texto(int sock, uint32_t id, uint8_t tipo, const char* texto);
+
+/*!
+ * @brief   Recibe una trama completa.
+ *          La carga se termina con '\0' para poder tratarla como texto.
+ * @param sock     Descriptor del socket.
+ * @param cabecera Cabecera recibida.
+ * @param carga    Buffer donde se copia la carga util.
+ * @param maximo   Tamanio del buffer de carga (incluye lugar para el terminador).
+ * @return OK(0) si se recibe la trama, SALIR(-4) si el otro extremo cerro la conexion,
+ *         ERROR(-1) si ocurre un problema o la carga no entra en el buffer.
+*/
+int recibir_trama(int sock, Cabecera* cabecera, char* carga, size_t maximo);
+
+/*!
+ * @brief   Recibe una trama completa y el descriptor que el servidor le haya adjuntado (ver SOL_DESCRIPTOR).
+ * @param sock       Descriptor del socket.
+ * @param cabecera   Cabecera recibida.
+ * @param carga      Buffer donde se copia la carga util.
+ * @param maximo     Tamanio del buffer de carga (incluye lugar para el terminador).
+ * @param descriptor Descriptor recibido con la trama (se cierra con close()), o -1 si no trae.
+ * @return OK(0) si se recibe la trama, SALIR(-4) si el otro extremo cerro la conexion,
+ *         ERROR(-1) si ocurre un problema o la carga no entra en el buffer.
+*/
+int recibir_trama_descriptor(int sock, Cabecera* cabecera, char* carga, size_t maximo, int* descriptor);
+
+/*!
+ * @brief   Devuelve un identificador nuevo para una solicitud.
+ * @return  Identificador no usado antes en esta ejecucion.
+*/
+uint32_t nueva_solicitud(void);
+
+#endif
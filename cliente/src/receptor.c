@@ -0,0 +1,862 @@
+/*!
+ * @file    receptor.c
+ * @brief   Hilo receptor del cliente: reparte las tramas del servidor y gestiona las descargas en segundo plano.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Recibir todas las tramas del servidor en un hilo propio.
+ *          - Mostrar la respuesta de la solicitud en primer plano (listado o filtrado), o entregarla a quien la
+ *            pidio (sincronizacion del catalogo).
+ *          - Escribir cada cancion en su archivo y devolver ventana al servidor a medida que se consume.
+ *          - Guardar las canciones de un lote, que llegan una detras de otra por un mismo canal.
+ *          - Recibir, promover y cancelar las precargas que pide el precargador (ver precarga.h).
+ *          - Entregar los avisos de cambios del catalogo de la suscripcion (ver catalogo.h).
+ *          - Copiar las canciones que llegan por descriptor (socket Unix) sin que sus bytes pasen por el cliente.
+ *          Asi el menu sigue respondiendo mientras una o varias canciones se descargan.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <arpa/inet.h>
+#include "receptor.h"
+#include "protocolo.h"
+#include "transporte.h"
+#include "canciones.h"
+#include "precarga.h"
+
+static pthread_t hilo_receptor;                           // hilo que lee del socket.
+static pthread_mutex_t receptor_mutex = PTHREAD_MUTEX_INITIALIZER; // protege el estado compartido con el menu.
+static pthread_cond_t receptor_cond = PTHREAD_COND_INITIALIZER;    // avisa fin de respuesta o de descarga.
+static Descarga* descargas = NULL;                        // descargas en curso.
+static uint32_t esperada = 0;                             // id de la solicitud en primer plano (0 si no hay).
+static int conexion_caida = 0;                            // 1 si el servidor cerro la conexion.
+static char ultimo_resultado[BUFFER_SIZE] = "";           // numeros de cancion del ultimo listado o filtrado.
+static void (*procesar_datos)(const char*) = NULL;        // recibe los datos en primer plano en lugar de mostrarlos.
+static char* respuesta = NULL;                            // destino de la carga de fin si hay procesar_datos.
+static size_t respuesta_tamanio = 0;                      // tamanio de respuesta.
+static uint8_t respuesta_tipo = 0;                        // tipo de la trama que termino la solicitud en primer plano.
+static uint32_t suscripcion = 0;                          // id de la suscripcion a los cambios del catalogo (0 si no hay).
+static void (*aviso_filas)(const char*) = NULL;           // recibe las filas de cada cambio del catalogo.
+static void (*aviso_evento)(const char*) = NULL;          // recibe el fin de cada cambio, o NULL si la suscripcion termina.
+static pthread_mutex_t envio_mutex = PTHREAD_MUTEX_INITIALIZER; // el menu y el receptor envian por el mismo socket.
+
+/*!
+ * @brief   Envia una trama sin mezclarla con las que envia el otro hilo.
+ * @param sock     Descriptor del socket de conexion con el servidor.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param carga    Carga util.
+ * @param longitud Bytes de carga util.
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+static int enviar_exclusivo(int sock, uint32_t id, uint8_t tipo, const void* carga, size_t longitud)
+{
+    int estado;
+
+    pthread_mutex_lock(&envio_mutex);
+    estado = enviar_trama(sock, id, tipo, carga, longitud);
+    pthread_mutex_unlock(&envio_mutex);
+    return estado;
+}
+
+/*!
+ * @brief   Busca una descarga en curso por su id. Debe llamarse con receptor_mutex tomado.
+ * @param id Identificador del canal.
+ * @return La descarga, o NULL si no hay ninguna con ese id.
+*/
+static Descarga* buscar_descarga(uint32_t id)
+{
+    Descarga* descarga = NULL;
+
+    for (descarga = descargas; descarga != NULL; descarga = descarga->sig)
+    {
+        if (descarga->id == id)
+        {
+            break;
+        }
+    }
+    return descarga;
+}
+
+/*!
+ * @brief   Quita una descarga de la lista y la libera. Debe llamarse con receptor_mutex tomado.
+ *          Si se indica, borra el archivo parcial.
+ * @param descarga Descarga a quitar.
+ * @param borrar   1 para borrar el archivo local, 0 para conservarlo.
+*/
+static void quitar_descarga(Descarga* descarga, int borrar)
+{
+    Descarga** actual = &descargas;
+
+    while (*actual != NULL && *actual != descarga)
+    {
+        actual = &(*actual)->sig;
+    }
+    if (*actual != NULL)
+    {
+        *actual = descarga->sig;
+    }
+    if (descarga->archivo != NULL)
+    {
+        fclose(descarga->archivo);
+        if (borrar)
+        {
+            remove(descarga->nombre);
+        }
+    }
+    free(descarga);
+    pthread_cond_broadcast(&receptor_cond);
+}
+
+/*!
+ * @brief   Reproduce una cancion descargada sin bloquear el menu, y avisa al precargador que empezo a sonar.
+ * @param nombre Nombre del archivo de la cancion (empieza con su numero).
+*/
+static void reproducir(const char* nombre)
+{
+    char comando[100];
+
+    precarga_sonando(atoi(nombre));
+    snprintf(comando, sizeof(comando), "mpg123 -q \"%s\" > /dev/null 2>&1 &", nombre); // Reemplaza "mpg123" con el reproductor que prefieras
+    if (system(comando) != 0)
+    {
+        printf("No se pudo reproducir la cancion. Verifique que tenga un reproductor instalado.\n");
+    }
+}
+
+/*!
+ * @brief   Crea el archivo local de la cancion actual de una descarga.
+ *          Si no se puede crear, el resto de la cancion se descarta.
+ * @param descarga Descarga cuyo archivo se crea.
+*/
+static void abrir_archivo(Descarga* descarga)
+{
+    descarga->fallida = 0;
+    if ((descarga->archivo = fopen(descarga->nombre, "wb")) == NULL)
+    {
+        perror("Error al crear archivo de cancion.\n");
+        descarga->fallida = 1;
+    }
+    transporte_reiniciar_medicion();
+}
+
+/*!
+ * @brief   Cierra el archivo local de la cancion actual de una descarga, ya completa.
+ * @param descarga Descarga cuyo archivo se cierra.
+ * @return OK(0) si la cancion quedo guardada, ERROR(-1) si no se pudo escribir.
+*/
+static int cerrar_archivo(Descarga* descarga)
+{
+    if (descarga->archivo == NULL)
+    {
+        return ERROR;
+    }
+    fclose(descarga->archivo);
+    descarga->archivo = NULL;
+    descarga->completadas++;
+    return OK;
+}
+
+/*!
+ * @brief   Copia una cancion recibida por descriptor en su archivo local, dentro del kernel: copy_file_range
+ *          (que puede compartir los bloques si el sistema de archivos lo permite) o, entre sistemas de archivos
+ *          que no la admiten, sendfile.
+ * @param origen  Descriptor del archivo de la cancion (no se mueve su posicion).
+ * @param destino Archivo local, recien creado.
+ * @param tamanio Bytes a copiar.
+ * @return OK(0) si se copia entera, ERROR(-1) si no.
+*/
+static int copiar_descriptor(int origen, FILE* destino, long long tamanio)
+{
+    int fd = fileno(destino);
+    off_t desde = 0;
+    ssize_t copiados;
+
+    while (desde < tamanio)
+    {
+        copiados = copy_file_range(origen, &desde, fd, NULL, (size_t)(tamanio - desde), 0);
+        if (copiados < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+        {
+            copiados = sendfile(fd, origen, &desde, (size_t)(tamanio - desde));
+        }
+        if (copiados < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (copiados <= 0) // error, o el archivo es mas corto de lo anunciado.
+        {
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Devuelve al servidor ventana de una descarga. Debe llamarse con receptor_mutex tomado.
+ * @param sock     Descriptor del socket de conexion con el servidor.
+ * @param descarga Descarga cuyo canal recibe la ventana.
+ * @param bytes    Bytes a devolver (no mas de los recibidos sin devolver).
+*/
+static void devolver_ventana(int sock, Descarga* descarga, uint32_t bytes)
+{
+    uint32_t red = htonl(bytes);
+
+    if (enviar_exclusivo(sock, descarga->id, SOL_VENTANA, &red, sizeof(red)) != OK)
+    {
+        perror("Error al devolver ventana al servidor.\n");
+    }
+    descarga->sin_devolver -= bytes;
+}
+
+/*!
+ * @brief   Procesa una trama de una descarga en curso. Debe llamarse con receptor_mutex tomado.
+ *          Escribe los datos en el archivo, devuelve ventana al servidor y cierra la descarga al terminar.
+ *          En un lote, cada trama RESP_ARCHIVO cierra la cancion anterior y abre la siguiente.
+ *          Con SOL_DESCRIPTOR la cancion se copia desde el descriptor adjunto a la trama de fin.
+ * @param sock       Descriptor del socket de conexion con el servidor.
+ * @param descarga   Descarga a la que pertenece la trama.
+ * @param cabecera   Cabecera de la trama.
+ * @param carga      Carga de la trama.
+ * @param descriptor Descriptor adjunto a la trama, o -1 (lo cierra quien llama).
+*/
+static void procesar_descarga(int sock, Descarga* descarga, Cabecera* cabecera, char* carga, int descriptor)
+{
+    if (cabecera->tipo == RESP_ERROR) // la cancion no existe o no se pudo enviar.
+    {
+        if (!descarga->precarga)
+        {
+            printf("\n%s: %s\n", descarga->lote ? "Lote" : descarga->nombre, carga);
+        }
+        quitar_descarga(descarga, 1);
+        return;
+    }
+    if (cabecera->tipo == RESP_ARCHIVO) // comienza la siguiente cancion del lote.
+    {
+        cerrar_archivo(descarga);
+        if (!descarga->lote || strchr(carga, '/') != NULL || snprintf(descarga->nombre, NOMBRE_MAX, "%s", carga) >= NOMBRE_MAX)
+        {
+            printf("\nNombre de archivo invalido recibido: %s\n", carga);
+            descarga->fallida = 1;
+            return;
+        }
+        abrir_archivo(descarga);
+        return;
+    }
+    // el archivo se crea al llegar la primera trama, asi no quedan archivos de canciones inexistentes.
+    if (!descarga->lote && descarga->archivo == NULL && !descarga->fallida)
+    {
+        abrir_archivo(descarga);
+    }
+    if (cabecera->tipo == RESP_FIN && descarga->descriptor && !descarga->fallida
+        && (descriptor < 0 || copiar_descriptor(descriptor, descarga->archivo, atoll(carga)) != OK))
+    {
+        perror("Error al copiar la cancion recibida por descriptor.\n");
+        fclose(descarga->archivo);
+        remove(descarga->nombre);
+        descarga->archivo = NULL;
+        descarga->fallida = 1;
+    }
+    if (cabecera->tipo == RESP_FIN) // Verificar si es el fin de la transmision.
+    {
+        if (descarga->lote)
+        {
+            cerrar_archivo(descarga);
+            printf("\n%s (%d guardadas)\n", carga, descarga->completadas);
+        } else if (descarga->precarga)
+        {
+            cerrar_archivo(descarga); // queda en el sistema para cuando se elija.
+        } else if (cerrar_archivo(descarga) == OK)
+        {
+            printf("\nDescarga finalizada: %s\n", descarga->nombre);
+            reproducir(descarga->nombre);
+        } else
+        {
+            printf("\nDescarga fallida: %s\n", descarga->nombre);
+        }
+        quitar_descarga(descarga, 0);
+        return;
+    }
+    // si no se puede escribir se siguen consumiendo las tramas, para no frenar al resto de la conexion.
+    if (!descarga->fallida && descarga->archivo != NULL
+        && fwrite(carga, 1, cabecera->longitud, descarga->archivo) != cabecera->longitud)
+    {
+        perror("Error al escribir en archivo.\n");
+        fclose(descarga->archivo);
+        remove(descarga->nombre);
+        descarga->archivo = NULL;
+        descarga->fallida = 1;
+    }
+    transporte_medir(sock, cabecera->longitud);
+    // devolvemos ventana de a tramos, para no enviar una trama por cada bloque recibido.
+    // la de las precargas la devuelve el precargador, al ritmo de su tasa.
+    descarga->sin_devolver += cabecera->longitud;
+    if (!descarga->precarga && descarga->sin_devolver >= VENTANA_INICIAL / 4)
+    {
+        devolver_ventana(sock, descarga, descarga->sin_devolver);
+    }
+}
+
+/*!
+ * @brief   Registra los numeros de cancion de las filas de un listado o filtrado.
+ *          Cada fila empieza con su numero ("N - Tema - ..."). Debe llamarse con receptor_mutex tomado.
+ * @param filas Filas recibidas en una trama de datos.
+*/
+static void registrar_resultado(const char* filas)
+{
+    int numero;
+    const char* fila = filas;
+    size_t largo = strlen(ultimo_resultado);
+
+    while (fila != NULL && *fila != '\0')
+    {
+        if ((numero = atoi(fila)) > 0 && largo + 12 < sizeof(ultimo_resultado))
+        {
+            largo += snprintf(ultimo_resultado + largo, sizeof(ultimo_resultado) - largo, "%s%d", (largo > 0) ? "," : "", numero);
+        }
+        if ((fila = strchr(fila, '\n')) != NULL)
+        {
+            fila++;
+        }
+    }
+}
+
+/*!
+ * @brief   Entrega una trama de la suscripcion a los cambios del catalogo. Se llama sin receptor_mutex tomado,
+ *          asi quien la recibe puede tomar sus propios mutex y mostrar resultados.
+ * @param tipo  Tipo de la trama.
+ * @param carga Carga de la trama.
+*/
+static void entregar_aviso(uint8_t tipo, const char* carga)
+{
+    if (tipo == RESP_DATOS)
+    {
+        aviso_filas(carga);
+    } else if (tipo == RESP_EVENTO)
+    {
+        aviso_evento(carga);
+    } else // el servidor rechazo o termino la suscripcion.
+    {
+        printf("\nSin avisos de cambios del catalogo: %s\n", carga);
+        aviso_evento(NULL);
+    }
+}
+
+/*!
+ * @brief   Hilo receptor: recibe tramas hasta que se cierra la conexion y las reparte segun su id.
+ * @param arg Puntero al descriptor del socket.
+ * @return NULL al finalizar.
+*/
+static void* recibir(void* arg)
+{
+    int sock = *(int*)arg;
+    int aviso, suscripta, descriptor = -1;
+    char* buffer = NULL;
+    Cabecera cabecera;
+    Descarga* descarga = NULL;
+
+    free(arg);
+    if ((buffer = malloc(CARGA_MAX)) == NULL)
+    {
+        perror("Error al reservar buffer de recepcion.\n");
+    }
+    while (buffer != NULL && recibir_trama_descriptor(sock, &cabecera, buffer, CARGA_MAX, &descriptor) == OK)
+    {
+        aviso = 0;
+        pthread_mutex_lock(&receptor_mutex);
+        if (cabecera.id == esperada) // respuesta de la solicitud en primer plano.
+        {
+            if (cabecera.tipo == RESP_DATOS && procesar_datos != NULL)
+            {
+                procesar_datos(buffer);
+            } else if (cabecera.tipo == RESP_DATOS)
+            {
+                printf("%s", buffer);
+                registrar_resultado(buffer);
+            } else
+            {
+                if (procesar_datos != NULL)
+                {
+                    snprintf(respuesta, respuesta_tamanio, "%s", buffer);
+                } else
+                {
+                    printf("%s\n", buffer);
+                }
+                respuesta_tipo = cabecera.tipo;
+                esperada = 0;
+                pthread_cond_broadcast(&receptor_cond);
+            }
+        } else if (suscripcion != 0 && cabecera.id == suscripcion)
+        {
+            aviso = 1;
+            if (cabecera.tipo != RESP_DATOS && cabecera.tipo != RESP_EVENTO)
+            {
+                suscripcion = 0;
+            }
+        } else if ((descarga = buscar_descarga(cabecera.id)) != NULL)
+        {
+            procesar_descarga(sock, descarga, &cabecera, buffer, descriptor);
+        }
+        pthread_mutex_unlock(&receptor_mutex);
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+        }
+        if (aviso)
+        {
+            entregar_aviso(cabecera.tipo, buffer);
+        }
+    }
+    // el servidor cerro la conexion: se descartan las descargas incompletas.
+    pthread_mutex_lock(&receptor_mutex);
+    conexion_caida = 1;
+    suscripta = (suscripcion != 0);
+    suscripcion = 0;
+    while (descargas != NULL)
+    {
+        printf("\nDescarga interrumpida: %s\n", descargas->nombre);
+        quitar_descarga(descargas, 1);
+    }
+    pthread_cond_broadcast(&receptor_cond);
+    pthread_mutex_unlock(&receptor_mutex);
+    if (suscripta)
+    {
+        aviso_evento(NULL);
+    }
+    free(buffer);
+    return NULL;
+}
+
+/*!
+ * @brief   Inicia el hilo receptor sobre la conexion con el servidor.
+ *          Desde este momento solo el hilo receptor lee del socket.
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si el hilo se inicia, ERROR(-1) si ocurre un problema.
+*/
+int receptor_iniciar(int sock)
+{
+    int* sock_hilo = NULL;
+
+    if ((sock_hilo = malloc(sizeof(int))) == NULL)
+    {
+        perror("Error al reservar memoria para el receptor.\n");
+        return ERROR;
+    }
+    *sock_hilo = sock;
+    conexion_caida = 0;
+    if (pthread_create(&hilo_receptor, NULL, recibir, sock_hilo) != 0)
+    {
+        perror("Error al crear hilo receptor.\n");
+        free(sock_hilo);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Cancela las precargas, espera que terminen las demas descargas en curso y finaliza el hilo receptor.
+ * @param sock Descriptor del socket de conexion con el servidor.
+*/
+void receptor_finalizar(int sock)
+{
+    receptor_cancelar_precargas(sock, NULL, 0);
+    pthread_mutex_lock(&receptor_mutex);
+    if (descargas != NULL)
+    {
+        printf("Esperando descargas en curso...\n");
+    }
+    while (descargas != NULL && !conexion_caida)
+    {
+        pthread_cond_wait(&receptor_cond, &receptor_mutex);
+    }
+    pthread_mutex_unlock(&receptor_mutex);
+    // al apagar el socket el hilo receptor deja de recibir y termina.
+    shutdown(sock, SHUT_RDWR);
+    pthread_join(hilo_receptor, NULL);
+}
+
+/*!
+ * @brief   Envia una solicitud y espera su respuesta.
+ * @param sock    Descriptor del socket de conexion con el servidor.
+ * @param tipo    Tipo de solicitud.
+ * @param texto   Carga de la solicitud (cadena vacia si no lleva).
+ * @param procesar Funcion que recibe cada trama de datos (con receptor_mutex tomado), o NULL para mostrarlas.
+ * @param fin     Buffer donde copiar la carga de la trama de fin si hay procesar (puede ser NULL si no hay).
+ * @param tamanio Tamanio de fin.
+ * @return Tipo de la trama que termino la respuesta (RESP_FIN o RESP_ERROR), o 0 si se pierde la conexion.
+*/
+static uint8_t solicitar(int sock, uint8_t tipo, const char* texto, void (*procesar)(const char*), char* fin, size_t tamanio)
+{
+    uint32_t id = nueva_solicitud();
+    uint8_t terminada = 0;
+
+    // registramos el id antes de enviar, la respuesta puede llegar enseguida.
+    pthread_mutex_lock(&receptor_mutex);
+    esperada = id;
+    procesar_datos = procesar;
+    respuesta = fin;
+    respuesta_tamanio = tamanio;
+    if (procesar == NULL)
+    {
+        ultimo_resultado[0] = '\0';
+    }
+    pthread_mutex_unlock(&receptor_mutex);
+    if (enviar_exclusivo(sock, id, tipo, texto, strlen(texto)) != OK)
+    {
+        perror("Error al enviar solicitud.\n");
+        pthread_mutex_lock(&receptor_mutex);
+        esperada = 0;
+        procesar_datos = NULL;
+        pthread_mutex_unlock(&receptor_mutex);
+        return 0;
+    }
+    pthread_mutex_lock(&receptor_mutex);
+    while (esperada == id && !conexion_caida)
+    {
+        pthread_cond_wait(&receptor_cond, &receptor_mutex);
+    }
+    if (esperada == id) // se cerro la conexion antes de terminar la respuesta.
+    {
+        perror("Error al recibir respuesta del servidor.\n");
+        esperada = 0;
+    } else
+    {
+        terminada = respuesta_tipo;
+    }
+    procesar_datos = NULL;
+    pthread_mutex_unlock(&receptor_mutex);
+    return terminada;
+}
+
+/*!
+ * @brief   Envia una solicitud y espera su respuesta, que el hilo receptor muestra en pantalla.
+ *          Las descargas en curso siguen recibiendose mientras tanto.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param tipo  Tipo de solicitud (SOL_LISTAR o SOL_FILTRAR).
+ * @param texto Carga de la solicitud (cadena vacia si no lleva).
+ * @return OK(0) si se recibe la respuesta completa, ERROR(-1) si se pierde la conexion.
+*/
+int receptor_solicitar(int sock, uint8_t tipo, const char* texto)
+{
+    return (solicitar(sock, tipo, texto, NULL, NULL, 0) != 0) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Envia una solicitud y espera su respuesta sin mostrarla: cada trama de datos se entrega a una funcion.
+ *          Las descargas en curso siguen recibiendose mientras tanto.
+ * @param sock     Descriptor del socket de conexion con el servidor.
+ * @param tipo     Tipo de solicitud (SOL_CATALOGO).
+ * @param texto    Carga de la solicitud (cadena vacia si no lleva).
+ * @param procesar Funcion que recibe cada trama de datos, terminada en '\0'. La llama el hilo receptor mientras
+ *                 el que consulta espera, asi que puede usar los datos del que consulta sin otra sincronizacion.
+ * @param fin      Buffer donde se copia la carga de la trama de fin (o el mensaje de error).
+ * @param tamanio  Tamanio de fin.
+ * @return OK(0) si la respuesta termina con RESP_FIN, ERROR(-1) si termina con RESP_ERROR o se pierde la conexion.
+*/
+int receptor_consultar(int sock, uint8_t tipo, const char* texto, void (*procesar)(const char*), char* fin, size_t tamanio)
+{
+    return (solicitar(sock, tipo, texto, procesar, fin, tamanio) == RESP_FIN) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Muestra filas de un listado o filtrado resuelto en el cliente y registra sus numeros de cancion
+ *          como el ultimo resultado, igual que si las hubiera enviado el servidor.
+ * @param filas Filas "N - Tema - ...", una por linea.
+ * @param nuevo 1 si son las primeras filas del resultado (se descarta el anterior).
+*/
+void receptor_mostrar(const char* filas, int nuevo)
+{
+    pthread_mutex_lock(&receptor_mutex);
+    if (nuevo)
+    {
+        ultimo_resultado[0] = '\0';
+    }
+    printf("%s", filas);
+    registrar_resultado(filas);
+    pthread_mutex_unlock(&receptor_mutex);
+}
+
+/*!
+ * @brief   Suscribe la conexion a los cambios del catalogo (SOL_SUSCRIBIR). Cada cambio llega como tramas de
+ *          filas y una de fin, que el hilo receptor entrega a las funciones indicadas sin receptor_mutex tomado.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param filas  Funcion que recibe cada trama de filas de un cambio, terminada en '\0'.
+ * @param evento Funcion que recibe la carga de fin de cada cambio ("anterior nueva cantidad modo"), o NULL
+ *               cuando la suscripcion termina (rechazada por el servidor o conexion perdida).
+ * @return OK(0) si se envia la solicitud, ERROR(-1) si ya hay una suscripcion o ocurre un problema.
+*/
+int receptor_suscribir(int sock, void (*filas)(const char*), void (*evento)(const char*))
+{
+    uint32_t id = nueva_solicitud();
+
+    // registramos el id antes de enviar, el primer aviso puede llegar enseguida.
+    pthread_mutex_lock(&receptor_mutex);
+    if (suscripcion != 0 || conexion_caida)
+    {
+        pthread_mutex_unlock(&receptor_mutex);
+        return ERROR;
+    }
+    suscripcion = id;
+    aviso_filas = filas;
+    aviso_evento = evento;
+    pthread_mutex_unlock(&receptor_mutex);
+    if (enviar_exclusivo(sock, id, SOL_SUSCRIBIR, NULL, 0) != OK)
+    {
+        perror("Error al enviar suscripcion.\n");
+        pthread_mutex_lock(&receptor_mutex);
+        suscripcion = 0;
+        pthread_mutex_unlock(&receptor_mutex);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Registra una descarga y envia la solicitud que abre su canal.
+ *          Si la cancion se estaba precargando y ahora se pide escucharla, la precarga pasa a ser una descarga
+ *          comun: se le devuelve la ventana pendiente y suena al terminar.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param tipo   SOL_CANCION, SOL_DESCRIPTOR, SOL_DESDE, SOL_LOTE o SOL_PRECARGA.
+ * @param nombre Nombre del archivo de la cancion (en un lote, una descripcion).
+ * @param carga  Carga de la solicitud.
+ * @return OK(0) si la descarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+static int iniciar_descarga(int sock, uint8_t tipo, const char* nombre, const char* carga)
+{
+    uint32_t id = nueva_solicitud();
+    Descarga* descarga = NULL;
+    Descarga* actual = NULL;
+
+    pthread_mutex_lock(&receptor_mutex);
+    for (actual = descargas; tipo != SOL_LOTE && actual != NULL; actual = actual->sig)
+    {
+        if (!actual->lote && strcmp(actual->nombre, nombre) == 0)
+        {
+            if (actual->precarga && (tipo == SOL_CANCION || tipo == SOL_DESCRIPTOR))
+            {
+                // su ventana empezo mas chica: se agranda a la de una descarga comun, si no nunca junta
+                // los bytes que hacen falta para devolverla.
+                actual->precarga = 0;
+                actual->sin_devolver += VENTANA_INICIAL - PRECARGA_VENTANA;
+                devolver_ventana(sock, actual, actual->sin_devolver);
+                printf("Cancion ya en descarga, se reproducira al terminar.\n");
+            } else if (tipo != SOL_PRECARGA)
+            {
+                printf("Cancion ya en descarga.\n");
+            }
+            pthread_mutex_unlock(&receptor_mutex);
+            return OK;
+        }
+    }
+    if (conexion_caida || (descarga = calloc(1, sizeof(Descarga))) == NULL)
+    {
+        pthread_mutex_unlock(&receptor_mutex);
+        perror("Error al iniciar descarga.\n");
+        return ERROR;
+    }
+    // registramos la descarga antes de enviar, la primera trama puede llegar enseguida.
+    descarga->id = id;
+    descarga->lote = (tipo == SOL_LOTE);
+    descarga->precarga = (tipo == SOL_PRECARGA);
+    descarga->descriptor = (tipo == SOL_DESCRIPTOR);
+    snprintf(descarga->nombre, NOMBRE_MAX, "%s", nombre);
+    descarga->sig = descargas;
+    descargas = descarga;
+    pthread_mutex_unlock(&receptor_mutex);
+    if (enviar_exclusivo(sock, id, tipo, carga, strlen(carga)) != OK)
+    {
+        perror("Error al enviar solicitud de descarga.\n");
+        return ERROR;
+    }
+    if (tipo != SOL_PRECARGA)
+    {
+        printf("Descargando %s en segundo plano.\n", nombre);
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Escucha una cancion: si ya esta en el sistema suena enseguida; si no, se descarga en segundo plano
+ *          y suena al terminar. Si se estaba precargando, la precarga pasa a ser una descarga comun.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param numero Numero de la cancion.
+ * @return OK(0) si la cancion suena o la descarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_escuchar(int sock, int numero)
+{
+    char nombre[NOMBRE_MAX];
+    Descarga* actual = NULL;
+
+    snprintf(nombre, sizeof(nombre), "%d.mp3", numero);
+    // un archivo que se esta descargando ya existe, pero todavia no esta completo.
+    pthread_mutex_lock(&receptor_mutex);
+    for (actual = descargas; actual != NULL && strcmp(actual->nombre, nombre) != 0; actual = actual->sig);
+    pthread_mutex_unlock(&receptor_mutex);
+    if (actual == NULL && access(nombre, F_OK) == 0)
+    {
+        printf("Cancion ya en sistema: %s\n", nombre);
+        reproducir(nombre);
+        return OK;
+    }
+    return receptor_descargar(sock, numero);
+}
+
+/*!
+ * @brief   Pide una cancion que se descarga en segundo plano.
+ *          La cancion se pide por su numero; el archivo (numero.mp3) se crea al llegar la primera trama
+ *          y se reproduce al finalizar la descarga. Por el socket Unix se pide con SOL_DESCRIPTOR.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param numero Numero de la cancion.
+ * @return OK(0) si la descarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_descargar(int sock, int numero)
+{
+    char nombre[NOMBRE_MAX];
+    char carga[NOMBRE_MAX];
+
+    snprintf(nombre, sizeof(nombre), "%d.mp3", numero);
+    snprintf(carga, sizeof(carga), "%d", numero);
+    // en la misma maquina el servidor pasa el archivo por descriptor en lugar de enviar sus bytes.
+    return iniciar_descarga(sock, transporte_local() ? SOL_DESCRIPTOR : SOL_CANCION, nombre, carga);
+}
+
+/*!
+ * @brief   Pide una cancion a partir de un instante, que se descarga en segundo plano.
+ *          El servidor la envia desde el marco MP3 que suena en ese instante, asi el archivo
+ *          (numero_desde_segundos.mp3) se reproduce como una cancion completa al finalizar la descarga.
+ * @param sock     Descriptor del socket de conexion con el servidor.
+ * @param numero   Numero de la cancion.
+ * @param segundos Segundos desde el comienzo de la cancion.
+ * @return OK(0) si la descarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_descargar_desde(int sock, int numero, int segundos)
+{
+    char nombre[NOMBRE_MAX];
+    char carga[NOMBRE_MAX];
+
+    snprintf(nombre, sizeof(nombre), "%d_desde_%d.mp3", numero, segundos);
+    snprintf(carga, sizeof(carga), "%d:%d", numero, segundos);
+    return iniciar_descarga(sock, SOL_DESDE, nombre, carga);
+}
+
+/*!
+ * @brief   Pide un lote de canciones que se descargan en segundo plano por un solo canal.
+ *          Las canciones se guardan en el directorio actual sin reproducirse.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param lista Numeros de cancion separados por comas.
+ * @return OK(0) si la descarga se inicia, ERROR(-1) si ocurre un problema.
+*/
+int receptor_descargar_lote(int sock, const char* lista)
+{
+    return iniciar_descarga(sock, SOL_LOTE, "lote de canciones", lista);
+}
+
+/*!
+ * @brief   Pide la precarga de una cancion (SOL_PRECARGA), que se guarda sin anunciarse ni reproducirse.
+ *          Si la cancion ya se esta descargando no se pide de nuevo.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param numero Numero de la cancion.
+ * @return OK(0) si la precarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_precargar(int sock, int numero)
+{
+    char nombre[NOMBRE_MAX];
+    char carga[NOMBRE_MAX];
+
+    snprintf(nombre, sizeof(nombre), "%d.mp3", numero);
+    snprintf(carga, sizeof(carga), "%d", numero);
+    return iniciar_descarga(sock, SOL_PRECARGA, nombre, carga);
+}
+
+/*!
+ * @brief   Devuelve la cantidad de precargas en curso.
+ * @return Precargas en curso.
+*/
+int receptor_precargas(void)
+{
+    int cantidad = 0;
+    Descarga* descarga = NULL;
+
+    pthread_mutex_lock(&receptor_mutex);
+    for (descarga = descargas; descarga != NULL; descarga = descarga->sig)
+    {
+        cantidad += descarga->precarga;
+    }
+    pthread_mutex_unlock(&receptor_mutex);
+    return cantidad;
+}
+
+/*!
+ * @brief   Devuelve al servidor ventana de las precargas en curso, hasta una cantidad de bytes.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param bytes Bytes de ventana que se pueden devolver.
+*/
+void receptor_devolver_precargas(int sock, uint32_t bytes)
+{
+    uint32_t devolver;
+    Descarga* descarga = NULL;
+
+    pthread_mutex_lock(&receptor_mutex);
+    for (descarga = descargas; descarga != NULL && bytes > 0; descarga = descarga->sig)
+    {
+        if (descarga->precarga && descarga->sin_devolver > 0)
+        {
+            devolver = (descarga->sin_devolver < bytes) ? descarga->sin_devolver : bytes;
+            devolver_ventana(sock, descarga, devolver);
+            bytes -= devolver;
+        }
+    }
+    pthread_mutex_unlock(&receptor_mutex);
+}
+
+/*!
+ * @brief   Cancela (SOL_CANCELAR) las precargas en curso, salvo las de las canciones indicadas, y borra sus archivos.
+ * @param sock      Descriptor del socket de conexion con el servidor.
+ * @param conservar Numeros de las canciones cuya precarga sigue (puede ser NULL).
+ * @param cantidad  Cantidad de numeros en conservar.
+*/
+void receptor_cancelar_precargas(int sock, const int* conservar, int cantidad)
+{
+    int i, conservada;
+    Descarga* descarga = NULL;
+    Descarga* sig = NULL;
+
+    pthread_mutex_lock(&receptor_mutex);
+    for (descarga = descargas; descarga != NULL; descarga = sig)
+    {
+        sig = descarga->sig;
+        for (i = 0, conservada = 0; i < cantidad && !conservada; i++)
+        {
+            conservada = (atoi(descarga->nombre) == conservar[i]);
+        }
+        if (!descarga->precarga || conservada)
+        {
+            continue;
+        }
+        // las tramas que ya estaban en camino llegan con un id que ya no se conoce y se descartan.
+        if (enviar_exclusivo(sock, descarga->id, SOL_CANCELAR, NULL, 0) != OK)
+        {
+            perror("Error al cancelar precarga.\n");
+        }
+        quitar_descarga(descarga, 1);
+    }
+    pthread_mutex_unlock(&receptor_mutex);
+}
+
+/*!
+ * @brief   Copia los numeros de cancion del ultimo listado o filtrado mostrado, separados por comas.
+ * @param lista   Buffer destino.
+ * @param tamanio Tamanio del buffer destino.
+*/
+void receptor_ultimo_resultado(char* lista, size_t tamanio)
+{
+    pthread_mutex_lock(&receptor_mutex);
+    snprintf(lista, tamanio, "%s", ultimo_resultado);
+    pthread_mutex_unlock(&receptor_mutex);
+}
@@ -0,0 +1,182 @@
+/*!
+ * @file    receptor.h
+ * @brief   Definiciones y declaraciones del hilo receptor del cliente y de las descargas en segundo plano.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - La estructura Descarga, con el estado de una cancion que se esta recibiendo.
+ *          - Declaraciones de funciones para iniciar y finalizar el hilo receptor, hacer solicitudes
+ *            cuya respuesta se muestra en pantalla y pedir canciones o lotes que se descargan en segundo plano.
+ *          Una vez iniciada la sesion, solo el hilo receptor lee del socket y reparte cada trama
+ *          segun su id: las de la solicitud en primer plano se muestran, las de cada descarga se
+ *          escriben en su archivo y devuelven ventana al servidor (ver SOL_VENTANA en protocolo.h).
+ *          Las precargas (ver precarga.h) se reciben igual, pero no se anuncian ni se reproducen, y su ventana
+ *          se devuelve de a poco con receptor_devolver_precargas(). Por el socket Unix del servidor las canciones
+ *          que se escuchan se piden con SOL_DESCRIPTOR y se copian desde el descriptor recibido. Las de la suscripcion a los cambios del
+ *          catalogo se entregan a las funciones registradas con receptor_suscribir().
+*/
+
+#ifndef RECEPTOR_H
+#define RECEPTOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*!
+ * @def NOMBRE_MAX
+ * @brief Tamanio maximo del nombre de archivo de una cancion.
+*/
+#define NOMBRE_MAX 50
+
+/*!
+ * @struct Descarga
+ * @brief Estado de una cancion que se esta recibiendo en segundo plano.
+*/
+typedef struct Descarga
+{
+    uint32_t id;              /**< Identificador de la solicitud SOL_CANCION o SOL_LOTE (id del canal). */
+    int lote;                 /**< 1 si es un lote: cada RESP_ARCHIVO abre el archivo siguiente. */
+    int completadas;          /**< Canciones del lote ya guardadas. */
+    char nombre[NOMBRE_MAX];  /**< Nombre del archivo local de la cancion (en un lote, la actual). */
+    FILE* archivo;            /**< Archivo local (NULL hasta recibir la primera trama). */
+    int fallida;              /**< 1 si no se pudo escribir el archivo local; el resto se descarta. */
+    int precarga;             /**< 1 si es una precarga: no se reproduce y su ventana la devuelve el precargador. */
+    int descriptor;           /**< 1 si responde a SOL_DESCRIPTOR: el archivo llega adjunto a la trama de fin. */
+    uint32_t sin_devolver;    /**< Bytes recibidos cuya ventana todavia no se devolvio al servidor. */
+    struct Descarga* sig;     /**< Siguiente descarga en curso. */
+} Descarga;
+
+/*!
+ * @brief   Inicia el hilo receptor sobre la conexion con el servidor.
+ *          Desde este momento solo el hilo receptor lee del socket.
+ * @param sock Descriptor del socket de conexion con el servidor.
+ * @return OK(0) si el hilo se inicia, ERROR(-1) si ocurre un problema.
+*/
+int receptor_iniciar(int sock);
+
+/*!
+ * @brief   Cancela las precargas, espera que terminen las demas descargas en curso y finaliza el hilo receptor.
+ * @param sock Descriptor del socket de conexion con el servidor.
+*/
+void receptor_finalizar(int sock);
+
+/*!
+ * @brief   Envia una solicitud y espera su respuesta, que el hilo receptor muestra en pantalla.
+ *          Las descargas en curso siguen recibiendose mientras tanto.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param tipo  Tipo de solicitud (SOL_LISTAR o SOL_FILTRAR).
+ * @param texto Carga de la solicitud (cadena vacia si no lleva).
+ * @return OK(0) si se recibe la respuesta completa, ERROR(-1) si se pierde la conexion.
+*/
+int receptor_solicitar(int sock, uint8_t tipo, const char* texto);
+
+/*!
+ * @brief   Envia una solicitud y espera su respuesta sin mostrarla: cada trama de datos se entrega a una funcion.
+ *          Las descargas en curso siguen recibiendose mientras tanto.
+ * @param sock     Descriptor del socket de conexion con el servidor.
+ * @param tipo     Tipo de solicitud (SOL_CATALOGO).
+ * @param texto    Carga de la solicitud (cadena vacia si no lleva).
+ * @param procesar Funcion que recibe cada trama de datos, terminada en '\0'. La llama el hilo receptor mientras
+ *                 el que consulta espera, asi que puede usar los datos del que consulta sin otra sincronizacion.
+ * @param fin      Buffer donde se copia la carga de la trama de fin (o el mensaje de error).
+ * @param tamanio  Tamanio de fin.
+ * @return OK(0) si la respuesta termina con RESP_FIN, ERROR(-1) si termina con RESP_ERROR o se pierde la conexion.
+*/
+int receptor_consultar(int sock, uint8_t tipo, const char* texto, void (*procesar)(const char*), char* fin, size_t tamanio);
+
+/*!
+ * @brief   Muestra filas de un listado o filtrado resuelto en el cliente y registra sus numeros de cancion
+ *          como el ultimo resultado, igual que si las hubiera enviado el servidor.
+ * @param filas Filas "N - Tema - ...", una por linea.
+ * @param nuevo 1 si son las primeras filas del resultado (se descarta el anterior).
+*/
+void receptor_mostrar(const char* filas, int nuevo);
+
+/*!
+ * @brief   Suscribe la conexion a los cambios del catalogo (SOL_SUSCRIBIR). Cada cambio llega como tramas de
+ *          filas y una de fin, que el hilo receptor entrega a las funciones indicadas sin receptor_mutex tomado.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param filas  Funcion que recibe cada trama de filas de un cambio, terminada en '\0'.
+ * @param evento Funcion que recibe la carga de fin de cada cambio ("anterior nueva cantidad modo"), o NULL
+ *               cuando la suscripcion termina (rechazada por el servidor o conexion perdida).
+ * @return OK(0) si se envia la solicitud, ERROR(-1) si ya hay una suscripcion o ocurre un problema.
+*/
+int receptor_suscribir(int sock, void (*filas)(const char*), void (*evento)(const char*));
+
+/*!
+ * @brief   Escucha una cancion: si ya esta en el sistema suena enseguida; si no, se descarga en segundo plano
+ *          y suena al terminar. Si se estaba precargando, la precarga pasa a ser una descarga comun.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param numero Numero de la cancion.
+ * @return OK(0) si la cancion suena o la descarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_escuchar(int sock, int numero);
+
+/*!
+ * @brief   Pide una cancion que se descarga en segundo plano.
+ *          La cancion se pide por su numero; el archivo (numero.mp3) se crea al llegar la primera trama
+ *          y se reproduce al finalizar la descarga. Por el socket Unix se pide con SOL_DESCRIPTOR.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param numero Numero de la cancion.
+ * @return OK(0) si la descarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_descargar(int sock, int numero);
+
+/*!
+ * @brief   Pide una cancion a partir de un instante, que se descarga en segundo plano.
+ *          El servidor la envia desde el marco MP3 que suena en ese instante, asi el archivo
+ *          (numero_desde_segundos.mp3) se reproduce como una cancion completa al finalizar la descarga.
+ * @param sock     Descriptor del socket de conexion con el servidor.
+ * @param numero   Numero de la cancion.
+ * @param segundos Segundos desde el comienzo de la cancion.
+ * @return OK(0) si la descarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_descargar_desde(int sock, int numero, int segundos);
+
+/*!
+ * @brief   Pide un lote de canciones que se descargan en segundo plano por un solo canal.
+ *          Las canciones se guardan en el directorio actual sin reproducirse.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param lista Numeros de cancion separados por comas.
+ * @return OK(0) si la descarga se inicia, ERROR(-1) si ocurre un problema.
+*/
+int receptor_descargar_lote(int sock, const char* lista);
+
+/*!
+ * @brief   Pide la precarga de una cancion (SOL_PRECARGA), que se guarda sin anunciarse ni reproducirse.
+ *          Si la cancion ya se esta descargando no se pide de nuevo.
+ * @param sock   Descriptor del socket de conexion con el servidor.
+ * @param numero Numero de la cancion.
+ * @return OK(0) si la precarga se inicia o ya estaba en curso, ERROR(-1) si ocurre un problema.
+*/
+int receptor_precargar(int sock, int numero);
+
+/*!
+ * @brief   Devuelve la cantidad de precargas en curso.
+ * @return Precargas en curso.
+*/
+int receptor_precargas(void);
+
+/*!
+ * @brief   Devuelve al servidor ventana de las precargas en curso, hasta una cantidad de bytes.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param bytes Bytes de ventana que se pueden devolver.
+*/
+void receptor_devolver_precargas(int sock, uint32_t bytes);
+
+/*!
+ * @brief   Cancela (SOL_CANCELAR) las precargas en curso, salvo las de las canciones indicadas, y borra sus archivos.
+ * @param sock      Descriptor del socket de conexion con el servidor.
+ * @param conservar Numeros de las canciones cuya precarga sigue (puede ser NULL).
+ * @param cantidad  Cantidad de numeros en conservar.
+*/
+void receptor_cancelar_precargas(int sock, const int* conservar, int cantidad);
+
+/*!
+ * @brief   Copia los numeros de cancion del ultimo listado o filtrado mostrado, separados por comas.
+ * @param lista   Buffer destino.
+ * @param tamanio Tamanio del buffer destino.
+*/
+void receptor_ultimo_resultado(char* lista, size_t tamanio);
+
+#endif
@@ -0,0 +1,104 @@
+/*!
+ * @file    transporte.c
+ * @brief   Ajuste del transporte TCP del cliente: modo de control y tamanio del buffer de recepcion.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Configurar TCP_NODELAY en el socket de conexion con el servidor (salvo el socket Unix local).
+ *          - Medir RTT y rendimiento durante las descargas y agrandar SO_RCVBUF cuando hace falta.
+*/
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "transporte.h"
+
+static size_t bytes_ventana = 0;       // bytes recibidos en la ventana actual.
+static struct timespec inicio_ventana; // inicio de la ventana actual.
+static double rendimiento = 0;         // bytes por segundo (promedio movil).
+static int buffer_recepcion = 0;       // tamanio pedido para SO_RCVBUF (0 si se deja al kernel).
+static int local = 0;                  // 1 si la conexion es por el socket Unix del servidor.
+
+/*!
+ * @brief   Configura el socket recien conectado para mensajes de control.
+ *          Si es TCP, activa TCP_NODELAY para que las opciones y filtros salgan sin demora.
+ * @param sock Descriptor del socket de conexion con el servidor.
+*/
+void transporte_iniciar(int sock)
+{
+    int activo = 1, dominio = AF_INET;
+    socklen_t largo = sizeof(dominio);
+
+    getsockopt(sock, SOL_SOCKET, SO_DOMAIN, &dominio, &largo);
+    local = (dominio == AF_UNIX);
+    if (!local && setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &activo, sizeof(activo)) < 0)
+    {
+        perror("Error al activar TCP_NODELAY.\n");
+    }
+}
+
+/*!
+ * @brief   Indica si la conexion con el servidor es por su socket Unix (ver SOL_DESCRIPTOR).
+ * @return 1 si es local, 0 si es TCP.
+*/
+int transporte_local(void)
+{
+    return local;
+}
+
+/*!
+ * @brief   Reinicia la ventana de medicion al comenzar una descarga.
+*/
+void transporte_reiniciar_medicion(void)
+{
+    bytes_ventana = 0;
+    clock_gettime(CLOCK_MONOTONIC, &inicio_ventana);
+}
+
+/*!
+ * @brief   Registra bytes recibidos y, al cerrar cada ventana de medicion, agranda SO_RCVBUF
+ *          si el producto ancho de banda por demora medido lo requiere.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param bytes Cantidad de bytes recibidos.
+*/
+void transporte_medir(int sock, size_t bytes)
+{
+    int buffer, actual;
+    double transcurrido, bdp;
+    struct tcp_info info;
+    struct timespec ahora;
+    socklen_t largo = sizeof(info);
+
+    bytes_ventana += bytes;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    transcurrido = (ahora.tv_sec - inicio_ventana.tv_sec) + (ahora.tv_nsec - inicio_ventana.tv_nsec) / 1e9;
+    if (transcurrido < VENTANA_MEDICION)
+    {
+        return;
+    }
+    rendimiento = (rendimiento == 0) ? bytes_ventana / transcurrido : 0.75 * rendimiento + 0.25 * (bytes_ventana / transcurrido);
+    bytes_ventana = 0;
+    inicio_ventana = ahora;
+    if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &largo) < 0)
+    {
+        return;
+    }
+    // pedimos el doble del BDP, solo si supera lo que el kernel ya asigno. El primer setsockopt apaga el
+    // autoajuste del kernel para este socket: el buffer queda fijo en lo pedido aunque despues el BDP baje.
+    bdp = rendimiento * (info.tcpi_rtt / 1e6);
+    buffer = (2 * bdp > BUFFER_SOCKET_MAX) ? BUFFER_SOCKET_MAX : (int)(2 * bdp);
+    if (buffer > buffer_recepcion)
+    {
+        largo = sizeof(actual);
+        if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &actual, &largo) == 0 && actual >= buffer)
+        {
+            return;
+        }
+        if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer)) == 0)
+        {
+            buffer_recepcion = buffer;
+        }
+    }
+}
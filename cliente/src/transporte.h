@@ -0,0 +1,62 @@
+/*!
+ * @file    transporte.h
+ * @brief   Definiciones y declaraciones para el ajuste del transporte TCP del cliente.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Constantes para el tamanio del bloque de recepcion y del buffer del socket.
+ *          - Declaraciones de funciones para configurar el socket y ajustar SO_RCVBUF segun el RTT
+ *            y el rendimiento medidos durante las descargas.
+ *          Con el socket Unix del servidor no hay opciones TCP que ajustar.
+*/
+
+#ifndef TRANSPORTE_H
+#define TRANSPORTE_H
+
+#include <stddef.h>
+
+/*!
+ * @def BLOQUE_MAX
+ * @brief Tamanio del bloque de recepcion de datos masivos (descargas).
+*/
+#define BLOQUE_MAX (256 * 1024)
+
+/*!
+ * @def BUFFER_SOCKET_MAX
+ * @brief Tamanio maximo que se pide para el buffer de recepcion del socket.
+*/
+#define BUFFER_SOCKET_MAX (8 * 1024 * 1024)
+
+/*!
+ * @def VENTANA_MEDICION
+ * @brief Duracion minima en segundos de cada ventana de medicion de rendimiento.
+*/
+#define VENTANA_MEDICION 0.02
+
+/*!
+ * @brief   Configura el socket recien conectado para mensajes de control.
+ *          Si es TCP, activa TCP_NODELAY para que las opciones y filtros salgan sin demora.
+ * @param sock Descriptor del socket de conexion con el servidor.
+*/
+void transporte_iniciar(int sock);
+
+/*!
+ * @brief   Indica si la conexion con el servidor es por su socket Unix (ver SOL_DESCRIPTOR).
+ * @return 1 si es local, 0 si es TCP.
+*/
+int transporte_local(void);
+
+/*!
+ * @brief   Reinicia la ventana de medicion al comenzar una descarga.
+*/
+void transporte_reiniciar_medicion(void);
+
+/*!
+ * @brief   Registra bytes recibidos y, al cerrar cada ventana de medicion, agranda SO_RCVBUF
+ *          si el producto ancho de banda por demora medido lo requiere.
+ * @param sock  Descriptor del socket de conexion con el servidor.
+ * @param bytes Cantidad de bytes recibidos.
+*/
+void transporte_medir(int sock, size_t bytes);
+
+#endif
@@ -0,0 +1,620 @@
+/*!
+ * @file    bench.c
+ * @brief   Mediciones de rendimiento del catalogo de canciones y de la base de usuarios del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Contiene la funcion main de las mediciones, que:
+ *          - Genera (si no existen) registros de canciones y bases de usuarios sinteticos de varios tamanios.
+ *          - Mide listar_servidor(), listar_ordenado_servidor(), filtrar_servidor(), filtrar_anios_servidor(),
+ *            filtrar_consulta_servidor(), filtrar_aproximado_servidor(), catalogo_buscar(), validar_inicio() y validar_registro()
+ *            con el mismo codigo que usa el servidor, enviando las respuestas por una conexion TCP local
+ *            cuyo otro extremo se descarta en un hilo aparte.
+ *          - Imprime por cada medicion el tiempo por operacion, las unidades (filas o registros) por segundo
+ *            y las asignaciones de memoria por operacion.
+ *          - Con -c, compara cada medicion con la salida guardada de otra corrida e informa la aceleracion.
+ *          Uso: bench [-f filas] [-u usuarios] [-t segundos] [-s sesgo] [-d directorio] [-m patron] [-c referencia]
+ *          Las listas de tamanios se separan con comas o espacios, por ejemplo -f "1000,100000".
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include "transporte.h"
+#include "protocolo.h"
+#include "planificador.h"
+#include "canciones.h"
+#include "catalogo.h"
+#include "usuarios.h"
+#include "generador.h"
+#include "medicion.h"
+
+/*!
+ * @def TAMANIOS_MAX
+ * @brief Cantidad maxima de tamanios de datos por medicion.
+*/
+#define TAMANIOS_MAX 16
+
+/*!
+ * @def MUESTRAS_BUSCAR
+ * @brief Cantidad de valores distintos con los que se mide catalogo_buscar().
+*/
+#define MUESTRAS_BUSCAR 256
+
+/*!
+ * @struct Contexto
+ * @brief Datos que reciben las operaciones medidas.
+*/
+typedef struct Contexto
+{
+    Conexion* conexion;                      /**< Conexion por la que se envian las respuestas. */
+    uint32_t id;                             /**< Ultimo identificador de solicitud usado. */
+    char filtro[FILTRO_MAX];                 /**< Filtro de las mediciones de filtrado. */
+    int sector;                              /**< Campo filtrado (ARTISTA o GENERO). */
+    int orden;                               /**< Orden de las mediciones de listado ordenado. */
+    long usuarios;                           /**< Cantidad de usuarios de la base. */
+    char* datos[MUESTRAS_BUSCAR];            /**< Valores buscados en la medicion de catalogo_buscar(). */
+    Catalogo* catalogo;                      /**< Catalogo de la medicion de catalogo_buscar(). */
+    const Base* base;                        /**< Corrida de referencia, o NULL si no se compara. */
+} Contexto;
+
+/*!
+ * @brief   Hilo que lee y descarta todo lo que llega por un socket, haciendo de cliente.
+ * @param arg Puntero al descriptor del socket.
+ * @return NULL al cerrarse el socket.
+*/
+static void* descartar(void* arg)
+{
+    int sock = *(int*)arg;
+    char buffer[65536];
+
+    while (recv(sock, buffer, sizeof(buffer), 0) > 0)
+    {
+    }
+    return NULL;
+}
+
+/*!
+ * @brief   Abre una conexion TCP local e inicia su estado de servidor.
+ * @param conexion Conexion (extremo del servidor) a iniciar.
+ * @param cliente  Descriptor del extremo del cliente.
+ * @return OK(0) si se conecta, ERROR(-1) si ocurre un problema.
+*/
+static int conectar_local(Conexion* conexion, int* cliente)
+{
+    int escucha, aceptado;
+    struct sockaddr_in direccion;
+    socklen_t largo = sizeof(direccion);
+
+    memset(&direccion, 0, sizeof(direccion));
+    direccion.sin_family = AF_INET;
+    direccion.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    direccion.sin_port = 0; // puerto libre cualquiera.
+    if ((escucha = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        perror("Error al crear el socket de medicion.\n");
+        return ERROR;
+    }
+    if (bind(escucha, (struct sockaddr*)&direccion, sizeof(direccion)) < 0 || listen(escucha, 1) < 0
+        || getsockname(escucha, (struct sockaddr*)&direccion, &largo) < 0
+        || (*cliente = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        perror("Error al preparar la conexion de medicion.\n");
+        close(escucha);
+        return ERROR;
+    }
+    if (connect(*cliente, (struct sockaddr*)&direccion, sizeof(direccion)) < 0
+        || (aceptado = accept(escucha, NULL, NULL)) < 0)
+    {
+        perror("Error al conectar la conexion de medicion.\n");
+        close(*cliente);
+        close(escucha);
+        return ERROR;
+    }
+    close(escucha);
+    if (conexion_iniciar(conexion, aceptado) != OK)
+    {
+        close(aceptado);
+        close(*cliente);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Mide un listado completo del catalogo.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion (no se usa).
+ * @return El resultado de listar_servidor().
+*/
+static int operacion_listar(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+
+    (void)iteracion;
+    return listar_servidor(datos->conexion, ++datos->id);
+}
+
+/*!
+ * @brief   Mide un filtrado completo del catalogo.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion (no se usa).
+ * @return El resultado de filtrar_servidor().
+*/
+static int operacion_filtrar(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+
+    (void)iteracion;
+    return filtrar_servidor(datos->conexion, ++datos->id, datos->filtro, datos->sector);
+}
+
+/*!
+ * @brief   Mide un listado completo del catalogo en un orden precalculado.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion (no se usa).
+ * @return El resultado de listar_ordenado_servidor().
+*/
+static int operacion_listar_ordenado(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+
+    (void)iteracion;
+    return listar_ordenado_servidor(datos->conexion, ++datos->id, datos->orden);
+}
+
+/*!
+ * @brief   Mide un filtrado por rango de anios.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion (no se usa).
+ * @return El resultado de filtrar_anios_servidor().
+*/
+static int operacion_filtrar_anios(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+
+    (void)iteracion;
+    return filtrar_anios_servidor(datos->conexion, ++datos->id, datos->filtro);
+}
+
+/*!
+ * @brief   Mide una consulta combinada.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion (no se usa).
+ * @return El resultado de filtrar_consulta_servidor().
+*/
+static int operacion_consulta(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+
+    (void)iteracion;
+    return filtrar_consulta_servidor(datos->conexion, ++datos->id, datos->filtro);
+}
+
+/*!
+ * @brief   Mide una busqueda aproximada.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion (no se usa).
+ * @return El resultado de filtrar_aproximado_servidor().
+*/
+static int operacion_aproximada(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+
+    (void)iteracion;
+    return filtrar_aproximado_servidor(datos->conexion, ++datos->id, datos->filtro);
+}
+
+/*!
+ * @brief   Mide la busqueda de un artista en el diccionario del catalogo, la que usa filtrar_servidor().
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion, que elige el valor a buscar.
+ * @return OK(0) siempre; la cantidad de canciones encontradas no importa.
+*/
+static int operacion_buscar(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+    int inicio;
+    volatile int cantidad = catalogo_buscar(datos->catalogo, ARTISTA, datos->datos[iteracion % MUESTRAS_BUSCAR], &inicio);
+
+    (void)cantidad;
+    return OK;
+}
+
+/*!
+ * @brief   Mide un inicio de sesion exitoso de un usuario elegido segun la iteracion.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion, que elige el usuario.
+ * @return OK(0) si el inicio es aceptado, ERROR(-1) si no.
+*/
+static int operacion_inicio(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+    char usuario[32], contrasenia[32];
+    long numero = (iteracion * 7919) % datos->usuarios;
+
+    snprintf(usuario, sizeof(usuario), FORMATO_USUARIO, numero);
+    snprintf(contrasenia, sizeof(contrasenia), FORMATO_CONTRASENIA, numero);
+    return (strcmp(validar_inicio(usuario, contrasenia), EXITO) == 0) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Mide un inicio de sesion rechazado (contrasenia incorrecta): recorre toda la base.
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion, que elige el usuario.
+ * @return OK(0) si el inicio es rechazado, ERROR(-1) si no.
+*/
+static int operacion_inicio_fallido(void* contexto, long iteracion)
+{
+    Contexto* datos = contexto;
+    char usuario[32];
+
+    snprintf(usuario, sizeof(usuario), FORMATO_USUARIO, (iteracion * 7919) % datos->usuarios);
+    return (strcmp(validar_inicio(usuario, "incorrecta"), ERROR_USUARIO_USUARIOS) == 0) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Mide la validacion de un registro nuevo: recorre toda la base (no se guarda el usuario).
+ * @param contexto  Contexto de la medicion.
+ * @param iteracion Numero de iteracion, que elige el nombre nuevo.
+ * @return OK(0) si el registro es aceptado, ERROR(-1) si no.
+*/
+static int operacion_registro(void* contexto, long iteracion)
+{
+    char usuario[32];
+
+    (void)contexto;
+    snprintf(usuario, sizeof(usuario), "nuevo%ld", iteracion);
+    return (strcmp(validar_registro(usuario), EXITO) == 0) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Interpreta una lista de tamanios separados por comas o espacios.
+ * @param texto     Lista a interpretar.
+ * @param tamanios  Tamanios leidos.
+ * @return Cantidad de tamanios leidos, o ERROR(-1) si alguno es invalido.
+*/
+static int leer_tamanios(const char* texto, long tamanios[TAMANIOS_MAX])
+{
+    int cantidad = 0;
+    char copia[BUFFER_SIZE];
+    char* token = NULL;
+    char* resto = NULL;
+
+    snprintf(copia, sizeof(copia), "%s", texto);
+    for (token = strtok_r(copia, ", ", &resto); token != NULL; token = strtok_r(NULL, ", ", &resto))
+    {
+        if (cantidad == TAMANIOS_MAX || (tamanios[cantidad++] = atol(token)) < 1)
+        {
+            return ERROR;
+        }
+    }
+    return cantidad;
+}
+
+/*!
+ * @brief   Se ubica en el directorio de datos de una medicion, generando los datos si no existen.
+ * @param base    Directorio base de los datos.
+ * @param tipo    "canciones" o "usuarios".
+ * @param tamanio Filas del registro o cantidad de usuarios.
+ * @param sesgo   Sesgo de Zipf del registro de canciones.
+ * @return OK(0) si los datos estan listos, ERROR(-1) si no se pudieron generar.
+*/
+static int preparar_datos(const char* base, const char* tipo, long tamanio, double sesgo)
+{
+    char directorio[PATH_MAX];
+    int es_canciones = (strcmp(tipo, "canciones") == 0);
+    const char* archivo = es_canciones ? "media.csv" : "usuarios.db";
+
+    if (es_canciones)
+    {
+        snprintf(directorio, sizeof(directorio), "%s/canciones_%ld_%.2f", base, tamanio, sesgo);
+    } else
+    {
+        snprintf(directorio, sizeof(directorio), "%s/usuarios_%ld", base, tamanio);
+    }
+    if ((mkdir(directorio, 0755) < 0 && access(directorio, F_OK) != 0) || chdir(directorio) < 0)
+    {
+        perror("Error al preparar el directorio de datos.\n");
+        return ERROR;
+    }
+    if (access(archivo, F_OK) == 0)
+    {
+        return OK;
+    }
+    fprintf(stderr, "Generando %s/%s...\n", directorio, archivo);
+    if (es_canciones)
+    {
+        return (generar_canciones(archivo, tamanio, sesgo, SEMILLA_PREDETERMINADA) == OK) ? OK : ERROR;
+    }
+    return (generar_usuarios(archivo, tamanio, SEMILLA_PREDETERMINADA) == OK) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Mide una operacion si su nombre coincide con el patron, e imprime el resultado.
+ * @param patron     Patron de nombres a medir (NULL mide todas).
+ * @param nombre     Nombre de la medicion.
+ * @param operacion  Operacion a medir.
+ * @param contexto   Contexto de la operacion.
+ * @param unidades   Unidades por operacion.
+ * @param tiempo_min Duracion minima de cada repeticion.
+ * @return OK(0) si se mide u omite, ERROR(-1) si la operacion falla.
+*/
+static int correr(const char* patron, const char* nombre, Operacion operacion, Contexto* contexto, double unidades, double tiempo_min)
+{
+    Resultado resultado;
+
+    if (patron != NULL && strstr(nombre, patron) == NULL)
+    {
+        return OK;
+    }
+    if (medir(&resultado, nombre, operacion, contexto, unidades, tiempo_min) != OK)
+    {
+        fprintf(stderr, "Fallo la medicion %s.\n", nombre);
+        return ERROR;
+    }
+    imprimir_resultado(&resultado, contexto->base);
+    return OK;
+}
+
+/*!
+ * @brief   Mide catalogo_buscar() en el catalogo del directorio actual con valores que existen con otras
+ *          mayusculas, que no existen o que solo comparten el principio con uno que existe.
+ * @param contexto   Contexto de la medicion.
+ * @param nombre     Nombre de la medicion.
+ * @param tiempo_min Duracion minima de cada repeticion.
+ * @param patron     Patron de nombres a medir (NULL mide todas).
+ * @return OK(0) si la medicion termina, ERROR(-1) si falla o no hay memoria.
+*/
+static int medir_buscar(Contexto* contexto, const char* nombre, double tiempo_min, const char* patron)
+{
+    int i, estado;
+    char dato[FILTRO_MAX];
+    const char* variantes[4] = { "ARTISTA 1", "Artista %d", "Bartista 1", "Artista 1 y amigos" };
+
+    if (patron != NULL && strstr(nombre, patron) == NULL)
+    {
+        return OK;
+    }
+    if ((contexto->catalogo = catalogo_obtener()) == NULL)
+    {
+        fprintf(stderr, "No se pudo cargar el catalogo de la medicion %s.\n", nombre);
+        return ERROR;
+    }
+    for (i = 0; i < MUESTRAS_BUSCAR; i++)
+    {
+        snprintf(dato, sizeof(dato), variantes[i % 4], i);
+        if ((contexto->datos[i] = strdup(dato)) == NULL)
+        {
+            perror("Error al reservar los valores a buscar.\n");
+            break;
+        }
+    }
+    estado = (i == MUESTRAS_BUSCAR) ? correr(patron, nombre, operacion_buscar, contexto, 1, tiempo_min) : ERROR;
+    while (i-- > 0)
+    {
+        free(contexto->datos[i]);
+    }
+    catalogo_soltar(contexto->catalogo);
+    contexto->catalogo = NULL;
+    return estado;
+}
+
+/*!
+ * @brief   Mide las operaciones sobre el registro de canciones de cada tamanio.
+ * @param contexto   Contexto de las mediciones.
+ * @param base       Directorio base de los datos.
+ * @param filas      Tamanios del registro.
+ * @param cantidad   Cantidad de tamanios.
+ * @param sesgo      Sesgo de Zipf de los registros.
+ * @param tiempo_min Duracion minima de cada repeticion.
+ * @param patron     Patron de nombres a medir (NULL mide todas).
+ * @return OK(0) si todas las mediciones terminan, ERROR(-1) si alguna falla.
+*/
+static int medir_canciones(Contexto* contexto, const char* base, const long* filas, int cantidad,
+                           double sesgo, double tiempo_min, const char* patron)
+{
+    int i;
+    char nombre[64];
+
+    for (i = 0; i < cantidad; i++)
+    {
+        if (preparar_datos(base, "canciones", filas[i], sesgo) != OK)
+        {
+            return ERROR;
+        }
+        snprintf(nombre, sizeof(nombre), "listar/%ld", filas[i]);
+        if (correr(patron, nombre, operacion_listar, contexto, filas[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        // filtramos por el artista y el genero mas frecuentes, en minusculas para ejercitar la comparacion sin mayusculas.
+        snprintf(contexto->filtro, sizeof(contexto->filtro), "artista 1");
+        contexto->sector = ARTISTA;
+        snprintf(nombre, sizeof(nombre), "filtrar_artista/%ld", filas[i]);
+        if (correr(patron, nombre, operacion_filtrar, contexto, filas[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        snprintf(contexto->filtro, sizeof(contexto->filtro), "genero 1");
+        contexto->sector = GENERO;
+        snprintf(nombre, sizeof(nombre), "filtrar_genero/%ld", filas[i]);
+        if (correr(patron, nombre, operacion_filtrar, contexto, filas[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        // los anios del generador son uniformes entre 1950 y 2024: el rango abarca unas 11 de cada 75 filas.
+        snprintf(contexto->filtro, sizeof(contexto->filtro), "1976-1986");
+        snprintf(nombre, sizeof(nombre), "filtrar_anios/%ld", filas[i]);
+        if (correr(patron, nombre, operacion_filtrar_anios, contexto, filas[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        // el genero mas frecuente es poco selectivo: el planificador parte del artista y galopa sobre el genero.
+        snprintf(contexto->filtro, sizeof(contexto->filtro), "artista=artista 1 & genero=genero 1 & anio=1976-1986");
+        snprintf(nombre, sizeof(nombre), "consulta/%ld", filas[i]);
+        if (correr(patron, nombre, operacion_consulta, contexto, filas[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        // todos los titulos del generador empiezan con "Cancion": sus trigramas agotan el presupuesto de la busqueda.
+        snprintf(contexto->filtro, sizeof(contexto->filtro), "cancoin 12345");
+        snprintf(nombre, sizeof(nombre), "aproximada/%ld", filas[i]);
+        if (correr(patron, nombre, operacion_aproximada, contexto, filas[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        // la busqueda en el diccionario que reemplazo a comparar el filtro con cada fila.
+        snprintf(nombre, sizeof(nombre), "buscar/%ld", filas[i]);
+        if (medir_buscar(contexto, nombre, tiempo_min, patron) != OK)
+        {
+            return ERROR;
+        }
+        contexto->orden = ORDEN_ARTISTA;
+        snprintf(nombre, sizeof(nombre), "listar_artista/%ld", filas[i]);
+        if (correr(patron, nombre, operacion_listar_ordenado, contexto, filas[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Mide la validacion de inicios de sesion y registros sobre la base de usuarios de cada tamanio.
+ * @param contexto   Contexto de las mediciones.
+ * @param base       Directorio base de los datos.
+ * @param usuarios   Tamanios de la base.
+ * @param cantidad   Cantidad de tamanios.
+ * @param tiempo_min Duracion minima de cada repeticion.
+ * @param patron     Patron de nombres a medir (NULL mide todas).
+ * @return OK(0) si todas las mediciones terminan, ERROR(-1) si alguna falla.
+*/
+static int medir_usuarios(Contexto* contexto, const char* base, const long* usuarios, int cantidad,
+                          double tiempo_min, const char* patron)
+{
+    int i;
+    char nombre[64];
+
+    for (i = 0; i < cantidad; i++)
+    {
+        if (preparar_datos(base, "usuarios", usuarios[i], 0) != OK)
+        {
+            return ERROR;
+        }
+        contexto->usuarios = usuarios[i];
+        // un usuario existente se encuentra en promedio a mitad de la base; los rechazos la recorren entera.
+        snprintf(nombre, sizeof(nombre), "validar_inicio/%ld", usuarios[i]);
+        if (correr(patron, nombre, operacion_inicio, contexto, usuarios[i] / 2.0, tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        snprintf(nombre, sizeof(nombre), "validar_inicio_fallido/%ld", usuarios[i]);
+        if (correr(patron, nombre, operacion_inicio_fallido, contexto, usuarios[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+        snprintf(nombre, sizeof(nombre), "validar_registro/%ld", usuarios[i]);
+        if (correr(patron, nombre, operacion_registro, contexto, usuarios[i], tiempo_min) != OK)
+        {
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Muestra el uso del programa.
+ * @param programa Nombre del ejecutable.
+*/
+static void mostrar_uso(const char* programa)
+{
+    fprintf(stderr, "Uso: %s [-f filas] [-u usuarios] [-t segundos] [-s sesgo] [-d directorio] [-m patron] [-c referencia]\n", programa);
+}
+
+/*!
+ * @brief   Funcion principal de las mediciones.
+ * @param cant_arg Cantidad de argumentos pasados al programa.
+ * @param arg      Arreglo de cadenas con los argumentos (ver mostrar_uso()).
+ * @return OK(0) si todas las mediciones terminan, ERROR(-1) si alguna falla.
+*/
+int main(int cant_arg, char* arg[])
+{
+    int opcion, estado, cliente, cant_filas, cant_usuarios;
+    long filas[TAMANIOS_MAX], usuarios[TAMANIOS_MAX];
+    double tiempo_min = 0.5, sesgo = SESGO_PREDETERMINADO;
+    const char* datos = "bench_datos";
+    const char* patron = NULL;
+    const char* referencia = NULL;
+    char base[PATH_MAX];
+    static Base corrida_base;
+    pthread_t hilo;
+    Conexion conexion;
+    Contexto contexto;
+
+    cant_filas = leer_tamanios("1000,100000,1000000", filas);
+    cant_usuarios = leer_tamanios("1000,10000,100000", usuarios);
+    while ((opcion = getopt(cant_arg, arg, "f:u:t:s:d:m:c:")) != -1)
+    {
+        switch (opcion)
+        {
+            case 'f': cant_filas = leer_tamanios(optarg, filas); break;
+            case 'u': cant_usuarios = leer_tamanios(optarg, usuarios); break;
+            case 't': tiempo_min = atof(optarg); break;
+            case 's': sesgo = atof(optarg); break;
+            case 'd': datos = optarg; break;
+            case 'm': patron = optarg; break;
+            case 'c': referencia = optarg; break;
+            default:
+                mostrar_uso(arg[0]);
+                return ERROR;
+        }
+    }
+    if (cant_filas < 0 || cant_usuarios < 0 || tiempo_min <= 0 || sesgo < 0)
+    {
+        mostrar_uso(arg[0]);
+        return ERROR;
+    }
+    if (referencia != NULL && base_cargar(&corrida_base, referencia) != OK)
+    {
+        return ERROR;
+    }
+    if ((mkdir(datos, 0755) < 0 && access(datos, F_OK) != 0) || realpath(datos, base) == NULL)
+    {
+        perror("Error al crear el directorio de datos.\n");
+        return ERROR;
+    }
+    planificador_iniciar(SIN_LIMITE, SIN_LIMITE);
+    if (conectar_local(&conexion, &cliente) != OK)
+    {
+        return ERROR;
+    }
+    if (pthread_create(&hilo, NULL, descartar, &cliente) != 0)
+    {
+        perror("Error al crear el hilo de descarte.\n");
+        conexion_finalizar(&conexion);
+        close(cliente);
+        return ERROR;
+    }
+    memset(&contexto, 0, sizeof(contexto));
+    contexto.conexion = &conexion;
+    contexto.base = (referencia != NULL) ? &corrida_base : NULL;
+
+    printf("# datos: %s  sesgo: %.2f  tiempo minimo: %.2f s  repeticiones: %d\n", base, sesgo, tiempo_min, REPETICIONES);
+    imprimir_cabecera(contexto.base);
+    estado = medir_canciones(&contexto, base, filas, cant_filas, sesgo, tiempo_min, patron);
+    if (estado == OK)
+    {
+        estado = medir_usuarios(&contexto, base, usuarios, cant_usuarios, tiempo_min, patron);
+    }
+
+    // cerramos la conexion: el hilo de descarte termina al leer el fin.
+    conexion_finalizar(&conexion);
+    pthread_join(hilo, NULL);
+    close(cliente);
+    return (estado == OK) ? OK : ERROR;
+}
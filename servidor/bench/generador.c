@@ -0,0 +1,219 @@
+/*!
+ * @file    generador.c
+ * @brief   Generadores de datos sinteticos para las mediciones del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Generar registros de canciones de cualquier tamanio, con artistas y generos sesgados (Zipf).
+ *          - Generar bases de usuarios con nombres y contrasenias conocidos por las mediciones.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "usuarios.h"
+#include "generador.h"
+
+/*!
+ * @def GENEROS
+ * @brief Cantidad de generos distintos del registro generado.
+*/
+#define GENEROS 40
+
+/*!
+ * @def CANCIONES_POR_ARTISTA
+ * @brief Cantidad media de canciones por artista, que fija cuantos artistas distintos hay.
+*/
+#define CANCIONES_POR_ARTISTA 20
+
+/*!
+ * @brief   Devuelve el siguiente numero pseudoaleatorio (splitmix64).
+ * @param estado Estado del generador.
+ * @return Numero de 64 bits.
+*/
+static unsigned long long siguiente(unsigned long long* estado)
+{
+    unsigned long long z = (*estado += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*!
+ * @brief   Devuelve un numero pseudoaleatorio uniforme en [0, 1).
+ * @param estado Estado del generador.
+ * @return Numero real.
+*/
+static double uniforme(unsigned long long* estado)
+{
+    return (siguiente(estado) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*!
+ * @brief   Arma la distribucion acumulada de Zipf sobre n rangos.
+ * @param n     Cantidad de rangos.
+ * @param sesgo Exponente de Zipf.
+ * @return Arreglo de n probabilidades acumuladas (liberar con free), o NULL si no hay memoria.
+*/
+static double* zipf_iniciar(long n, double sesgo)
+{
+    long i;
+    double total = 0;
+    double* acumulada = malloc(n * sizeof(double));
+
+    if (acumulada == NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i < n; i++)
+    {
+        total += 1.0 / pow(i + 1, sesgo);
+        acumulada[i] = total;
+    }
+    for (i = 0; i < n; i++)
+    {
+        acumulada[i] /= total;
+    }
+    return acumulada;
+}
+
+/*!
+ * @brief   Elige un rango segun la distribucion acumulada.
+ * @param acumulada Distribucion acumulada (ver zipf_iniciar()).
+ * @param n         Cantidad de rangos.
+ * @param estado    Estado del generador.
+ * @return Rango entre 1 y n.
+*/
+static long zipf_elegir(const double* acumulada, long n, unsigned long long* estado)
+{
+    double sorteo = uniforme(estado);
+    long bajo = 0, alto = n - 1, medio;
+
+    while (bajo < alto)
+    {
+        medio = bajo + (alto - bajo) / 2;
+        if (acumulada[medio] < sorteo)
+        {
+            bajo = medio + 1;
+        } else
+        {
+            alto = medio;
+        }
+    }
+    return bajo + 1;
+}
+
+/*!
+ * @brief   Genera un registro de canciones con el formato de media.csv.
+ *          Cada fila tiene titulo, artista, album, genero y anio. Artistas y generos siguen una
+ *          distribucion de Zipf con el sesgo indicado: pocos artistas y generos concentran la mayoria de las filas.
+ * @param ruta    Archivo a crear.
+ * @param filas   Cantidad de canciones.
+ * @param sesgo   Exponente de Zipf (0 = uniforme).
+ * @param semilla Semilla del generador pseudoaleatorio.
+ * @return OK(0) si se genera, ERROR(-1) si ocurre un problema de escritura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int generar_canciones(const char* ruta, long filas, double sesgo, unsigned long semilla)
+{
+    long i, artista, artistas = filas / CANCIONES_POR_ARTISTA + 1;
+    unsigned long long estado = semilla;
+    double* zipf_artistas = zipf_iniciar(artistas, sesgo);
+    double* zipf_generos = zipf_iniciar(GENEROS, sesgo);
+    FILE* archivo = NULL;
+
+    if (zipf_artistas == NULL || zipf_generos == NULL)
+    {
+        perror("Error al reservar distribuciones del generador.\n");
+        free(zipf_artistas);
+        free(zipf_generos);
+        return ERROR_DE_MEMORIA;
+    }
+    if ((archivo = fopen(ruta, "w")) == NULL)
+    {
+        perror("No se pudo crear el registro de canciones.\n");
+        free(zipf_artistas);
+        free(zipf_generos);
+        return ERROR;
+    }
+    for (i = 1; i <= filas; i++)
+    {
+        artista = zipf_elegir(zipf_artistas, artistas, &estado);
+        fprintf(archivo, "Cancion %ld," FORMATO_ARTISTA ",Album %ld-%d," FORMATO_GENERO ",%d\n",
+                i, artista, artista, (int)(siguiente(&estado) % 8) + 1,
+                zipf_elegir(zipf_generos, GENEROS, &estado), 1950 + (int)(siguiente(&estado) % 75));
+    }
+    free(zipf_artistas);
+    free(zipf_generos);
+    if (fclose(archivo) != 0)
+    {
+        perror("Error al escribir el registro de canciones.\n");
+        return ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Genera una base de usuarios con el formato de usuarios.db.
+ *          El usuario k se llama FORMATO_USUARIO y su contrasenia es FORMATO_CONTRASENIA; el orden
+ *          de los registros en el archivo se mezcla con la semilla.
+ * @param ruta     Archivo a crear.
+ * @param cantidad Cantidad de usuarios.
+ * @param semilla  Semilla del generador pseudoaleatorio.
+ * @return OK(0) si se genera, ERROR(-1) si ocurre un problema de escritura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int generar_usuarios(const char* ruta, long cantidad, unsigned long semilla)
+{
+    long i, j, auxiliar;
+    unsigned long long estado = semilla;
+    long* orden = malloc(cantidad * sizeof(long));
+    Cuenta cuenta;
+    FILE* archivo = NULL;
+
+    if (orden == NULL)
+    {
+        perror("Error al reservar orden de usuarios.\n");
+        return ERROR_DE_MEMORIA;
+    }
+    // mezclamos el orden (Fisher-Yates) para que la posicion de cada usuario no dependa de su numero.
+    for (i = 0; i < cantidad; i++)
+    {
+        orden[i] = i;
+    }
+    for (i = cantidad - 1; i > 0; i--)
+    {
+        j = siguiente(&estado) % (i + 1);
+        auxiliar = orden[i];
+        orden[i] = orden[j];
+        orden[j] = auxiliar;
+    }
+    if ((archivo = fopen(ruta, "wb")) == NULL)
+    {
+        perror("No se pudo crear la base de usuarios.\n");
+        free(orden);
+        return ERROR;
+    }
+    for (i = 0; i < cantidad; i++)
+    {
+        memset(&cuenta, 0, sizeof(cuenta));
+        snprintf(cuenta.usuario, sizeof(cuenta.usuario), FORMATO_USUARIO, orden[i]);
+        snprintf(cuenta.contrasenia, sizeof(cuenta.contrasenia), FORMATO_CONTRASENIA, orden[i]);
+        if (fwrite(&cuenta, sizeof(Cuenta), 1, archivo) != 1)
+        {
+            perror("Error al escribir la base de usuarios.\n");
+            fclose(archivo);
+            free(orden);
+            return ERROR;
+        }
+    }
+    free(orden);
+    if (fclose(archivo) != 0)
+    {
+        perror("Error al escribir la base de usuarios.\n");
+        return ERROR;
+    }
+    return OK;
+}
@@ -0,0 +1,74 @@
+/*!
+ * @file    generador.h
+ * @brief   Definiciones y declaraciones de los generadores de datos sinteticos para las mediciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los formatos de nombres de artistas, generos y usuarios que usan los generadores.
+ *          - Declaraciones de funciones para generar registros de canciones (media.csv) y de usuarios (usuarios.db).
+ *          Los datos son deterministas: con los mismos parametros y semilla se obtiene el mismo archivo.
+*/
+
+#ifndef GENERADOR_H
+#define GENERADOR_H
+
+/*!
+ * @def FORMATO_ARTISTA
+ * @brief Nombre del artista de rango r (el rango 1 es el mas frecuente).
+*/
+#define FORMATO_ARTISTA "Artista %ld"
+
+/*!
+ * @def FORMATO_GENERO
+ * @brief Nombre del genero de rango r (el rango 1 es el mas frecuente).
+*/
+#define FORMATO_GENERO "Genero %ld"
+
+/*!
+ * @def FORMATO_USUARIO
+ * @brief Nombre del usuario numero k de la base generada.
+*/
+#define FORMATO_USUARIO "usuario%ld"
+
+/*!
+ * @def FORMATO_CONTRASENIA
+ * @brief Contrasenia del usuario numero k de la base generada.
+*/
+#define FORMATO_CONTRASENIA "clave%ld"
+
+/*!
+ * @def SESGO_PREDETERMINADO
+ * @brief Exponente de la distribucion de Zipf de artistas y generos.
+*/
+#define SESGO_PREDETERMINADO 1.1
+
+/*!
+ * @def SEMILLA_PREDETERMINADA
+ * @brief Semilla usada si no se indica otra.
+*/
+#define SEMILLA_PREDETERMINADA 20241218
+
+/*!
+ * @brief   Genera un registro de canciones con el formato de media.csv.
+ *          Cada fila tiene titulo, artista, album, genero y anio. Artistas y generos siguen una
+ *          distribucion de Zipf con el sesgo indicado: pocos artistas y generos concentran la mayoria de las filas.
+ * @param ruta    Archivo a crear.
+ * @param filas   Cantidad de canciones.
+ * @param sesgo   Exponente de Zipf (0 = uniforme).
+ * @param semilla Semilla del generador pseudoaleatorio.
+ * @return OK(0) si se genera, ERROR(-1) si ocurre un problema de escritura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int generar_canciones(const char* ruta, long filas, double sesgo, unsigned long semilla);
+
+/*!
+ * @brief   Genera una base de usuarios con el formato de usuarios.db.
+ *          El usuario k se llama FORMATO_USUARIO y su contrasenia es FORMATO_CONTRASENIA; el orden
+ *          de los registros en el archivo se mezcla con la semilla.
+ * @param ruta     Archivo a crear.
+ * @param cantidad Cantidad de usuarios.
+ * @param semilla  Semilla del generador pseudoaleatorio.
+ * @return OK(0) si se genera, ERROR(-1) si ocurre un problema de escritura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int generar_usuarios(const char* ruta, long cantidad, unsigned long semilla);
+
+#endif
@@ -0,0 +1,57 @@
+/*!
+ * @file    generar.c
+ * @brief   Programa que genera registros de canciones y bases de usuarios sinteticos.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Contiene la funcion main del generador de datos, que crea archivos con el formato
+ *          de media.csv o usuarios.db para probar el servidor con catalogos y bases grandes.
+ *          Uso:
+ *          - generar canciones <archivo> <filas> [sesgo] [semilla]
+ *          - generar usuarios <archivo> <cantidad> [semilla]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "generador.h"
+
+/*!
+ * @brief   Muestra el uso del programa.
+ * @param programa Nombre del ejecutable.
+*/
+static void mostrar_uso(const char* programa)
+{
+    fprintf(stderr, "Uso: %s canciones <archivo> <filas> [sesgo] [semilla]\n", programa);
+    fprintf(stderr, "     %s usuarios <archivo> <cantidad> [semilla]\n", programa);
+}
+
+/*!
+ * @brief   Funcion principal del generador de datos.
+ * @param cant_arg Cantidad de argumentos pasados al programa.
+ * @param arg      Arreglo de cadenas con los argumentos (ver mostrar_uso()).
+ * @return OK(0) si se genera el archivo, ERROR(-1) si los argumentos son invalidos o falla la generacion.
+*/
+int main(int cant_arg, char* arg[])
+{
+    long cantidad;
+
+    if (cant_arg < 4 || (cantidad = atol(arg[3])) < 1)
+    {
+        mostrar_uso(arg[0]);
+        return ERROR;
+    }
+    if (strcmp(arg[1], "canciones") == 0 && cant_arg <= 6)
+    {
+        return (generar_canciones(arg[2], cantidad, (cant_arg > 4) ? atof(arg[4]) : SESGO_PREDETERMINADO,
+                                  (cant_arg > 5) ? strtoul(arg[5], NULL, 10) : SEMILLA_PREDETERMINADA) == OK) ? OK : ERROR;
+    }
+    if (strcmp(arg[1], "usuarios") == 0 && cant_arg <= 5)
+    {
+        return (generar_usuarios(arg[2], cantidad,
+                                 (cant_arg > 4) ? strtoul(arg[4], NULL, 10) : SEMILLA_PREDETERMINADA) == OK) ? OK : ERROR;
+    }
+    mostrar_uso(arg[0]);
+    return ERROR;
+}
@@ -0,0 +1,272 @@
+/*!
+ * @file    medicion.c
+ * @brief   Medicion de tiempos y asignaciones de memoria de las operaciones del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Contar las asignaciones de memoria de todo el programa, incluidas las internas de la
+ *            biblioteca de C (por ejemplo los buffers de fopen), reemplazando malloc por una version que cuenta.
+ *          - Calibrar la cantidad de iteraciones de una operacion y medirla varias veces.
+ *          - Imprimir los resultados en una tabla de columnas fijas, facil de comparar entre corridas.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "medicion.h"
+
+static unsigned long long total_asignaciones = 0; // llamadas a malloc/calloc/realloc.
+static unsigned long long total_bytes = 0;        // bytes pedidos en esas llamadas.
+
+#ifdef __GLIBC__
+// glibc exporta sus funciones de memoria con estos nombres: las usamos para reemplazar malloc y contar.
+extern void* __libc_malloc(size_t tamanio);
+extern void* __libc_calloc(size_t cantidad, size_t tamanio);
+extern void* __libc_realloc(void* puntero, size_t tamanio);
+
+/*!
+ * @brief   Registra una asignacion de memoria.
+ * @param bytes Bytes pedidos.
+*/
+static void contar(size_t bytes)
+{
+    __atomic_fetch_add(&total_asignaciones, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t tamanio)
+{
+    contar(tamanio);
+    return __libc_malloc(tamanio);
+}
+
+void* calloc(size_t cantidad, size_t tamanio)
+{
+    contar(cantidad * tamanio);
+    return __libc_calloc(cantidad, tamanio);
+}
+
+void* realloc(void* puntero, size_t tamanio)
+{
+    contar(tamanio);
+    return __libc_realloc(puntero, tamanio);
+}
+#endif
+
+/*!
+ * @brief   Devuelve la cantidad de asignaciones y los bytes pedidos desde que inicio el programa.
+ *          Solo cuenta si la biblioteca de C permite interceptar malloc (glibc); si no, devuelve 0.
+ * @param asignaciones Cantidad de llamadas a malloc/calloc/realloc.
+ * @param bytes        Bytes pedidos en esas llamadas.
+*/
+void asignaciones_leer(unsigned long long* asignaciones, unsigned long long* bytes)
+{
+    *asignaciones = __atomic_load_n(&total_asignaciones, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&total_bytes, __ATOMIC_RELAXED);
+}
+
+/*!
+ * @brief   Devuelve el instante actual del reloj monotono.
+ * @return Segundos desde un origen arbitrario.
+*/
+static double ahora(void)
+{
+    struct timespec instante;
+
+    clock_gettime(CLOCK_MONOTONIC, &instante);
+    return instante.tv_sec + instante.tv_nsec / 1e9;
+}
+
+/*!
+ * @brief   Ejecuta una operacion varias veces seguidas.
+ * @param operacion    Operacion a ejecutar.
+ * @param contexto     Datos de la operacion.
+ * @param iteraciones  Cantidad de veces.
+ * @param segundos     Duracion total.
+ * @param asignaciones Asignaciones hechas durante la ejecucion.
+ * @param bytes        Bytes pedidos durante la ejecucion.
+ * @return OK(0) si todas las ejecuciones son exitosas, ERROR(-1) si alguna falla.
+*/
+static int ejecutar(Operacion operacion, void* contexto, long iteraciones, double* segundos,
+                    unsigned long long* asignaciones, unsigned long long* bytes)
+{
+    long i;
+    double inicio;
+    unsigned long long asignaciones_inicio, bytes_inicio;
+
+    asignaciones_leer(&asignaciones_inicio, &bytes_inicio);
+    inicio = ahora();
+    for (i = 0; i < iteraciones; i++)
+    {
+        if (operacion(contexto, i) != OK)
+        {
+            return ERROR;
+        }
+    }
+    *segundos = ahora() - inicio;
+    asignaciones_leer(asignaciones, bytes);
+    *asignaciones -= asignaciones_inicio;
+    *bytes -= bytes_inicio;
+    return OK;
+}
+
+/*!
+ * @brief   Compara dos duraciones para qsort.
+ * @param a Primera duracion.
+ * @param b Segunda duracion.
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+/*!
+ * @brief   Mide una operacion.
+ * @param resultado   Resultado a completar.
+ * @param nombre      Nombre de la medicion.
+ * @param operacion   Operacion a medir.
+ * @param contexto    Datos pasados a la operacion.
+ * @param unidades    Unidades que procesa cada operacion (0 si no aplica).
+ * @param tiempo_min  Duracion minima de cada repeticion, en segundos.
+ * @return OK(0) si se mide, ERROR(-1) si la operacion falla.
+*/
+int medir(Resultado* resultado, const char* nombre, Operacion operacion, void* contexto, double unidades, double tiempo_min)
+{
+    int i;
+    long iteraciones = 1, siguiente;
+    double segundos, duraciones[REPETICIONES];
+    unsigned long long asignaciones, bytes, asignaciones_total = 0, bytes_total = 0;
+
+    memset(resultado, 0, sizeof(Resultado));
+    snprintf(resultado->nombre, sizeof(resultado->nombre), "%s", nombre);
+    // calibramos: agrandamos las iteraciones hasta que una corrida dure lo pedido.
+    while (1)
+    {
+        if (ejecutar(operacion, contexto, iteraciones, &segundos, &asignaciones, &bytes) != OK)
+        {
+            return ERROR;
+        }
+        if (segundos >= tiempo_min || iteraciones >= 1000000000L)
+        {
+            break;
+        }
+        siguiente = (segundos > 0) ? (long)(iteraciones * 1.2 * tiempo_min / segundos) : iteraciones * 100;
+        if (siguiente > iteraciones * 100)
+        {
+            siguiente = iteraciones * 100;
+        }
+        iteraciones = (siguiente > iteraciones) ? siguiente : iteraciones + 1;
+    }
+    // repetimos la medicion y nos quedamos con la mediana, menos sensible a interrupciones.
+    for (i = 0; i < REPETICIONES; i++)
+    {
+        if (ejecutar(operacion, contexto, iteraciones, &duraciones[i], &asignaciones, &bytes) != OK)
+        {
+            return ERROR;
+        }
+        asignaciones_total += asignaciones;
+        bytes_total += bytes;
+    }
+    qsort(duraciones, REPETICIONES, sizeof(double), comparar);
+    resultado->iteraciones = iteraciones;
+    resultado->ns_op = duraciones[REPETICIONES / 2] * 1e9 / iteraciones;
+    resultado->ns_op_min = duraciones[0] * 1e9 / iteraciones;
+    resultado->unidades_op = unidades;
+    resultado->asignaciones_op = (double)asignaciones_total / (REPETICIONES * (double)iteraciones);
+    resultado->bytes_op = (double)bytes_total / (REPETICIONES * (double)iteraciones);
+    return OK;
+}
+
+/*!
+ * @brief   Carga los tiempos de una corrida de referencia desde la tabla que imprimio otra corrida.
+ * @param base Base a completar.
+ * @param ruta Archivo con la salida de la corrida de referencia.
+ * @return OK(0) si se carga, ERROR(-1) si no se pudo abrir el archivo.
+*/
+int base_cargar(Base* base, const char* ruta)
+{
+    long iteraciones;
+    char linea[LINEA_MAX];
+    FILE* archivo = fopen(ruta, "r");
+
+    if (archivo == NULL)
+    {
+        perror("No se pudo abrir la corrida de referencia.\n");
+        return ERROR;
+    }
+    base->cantidad = 0;
+    // cada fila empieza con nombre, iteraciones y ns/op; se saltean comentarios y cabecera.
+    while (fgets(linea, LINEA_MAX, archivo) != NULL && base->cantidad < BASE_MAX)
+    {
+        if (linea[0] != '#' && strncmp(linea, "medicion", 8) != 0
+            && sscanf(linea, "%63s %ld %lf", base->nombres[base->cantidad], &iteraciones, &base->ns_op[base->cantidad]) == 3)
+        {
+            base->cantidad++;
+        }
+    }
+    fclose(archivo);
+    return OK;
+}
+
+/*!
+ * @brief   Busca el tiempo de una medicion en la corrida de referencia.
+ * @param base   Corrida de referencia.
+ * @param nombre Nombre de la medicion.
+ * @return Nanosegundos por operacion, o 0 si la medicion no esta.
+*/
+static double base_buscar(const Base* base, const char* nombre)
+{
+    int i;
+
+    for (i = 0; i < base->cantidad; i++)
+    {
+        if (strcmp(base->nombres[i], nombre) == 0)
+        {
+            return base->ns_op[i];
+        }
+    }
+    return 0;
+}
+
+/*!
+ * @brief   Imprime la cabecera de la tabla de resultados.
+ * @param base Corrida de referencia, o NULL si no se compara.
+*/
+void imprimir_cabecera(const Base* base)
+{
+    printf("%-32s %12s %14s %14s %14s %10s %12s%s\n",
+           "medicion", "iteraciones", "ns/op", "ns/op(min)", "unidades/s", "asig/op", "B/op",
+           (base != NULL) ? "  aceleracion" : "");
+}
+
+/*!
+ * @brief   Imprime un resultado como fila de la tabla.
+ *          Si hay corrida de referencia agrega la aceleracion: ns/op de la referencia sobre ns/op actual.
+ * @param resultado Resultado a imprimir.
+ * @param base      Corrida de referencia, o NULL si no se compara.
+*/
+void imprimir_resultado(const Resultado* resultado, const Base* base)
+{
+    double referencia = (base != NULL) ? base_buscar(base, resultado->nombre) : 0;
+    double por_segundo = (resultado->unidades_op > 0) ? resultado->unidades_op * 1e9 / resultado->ns_op : 0;
+
+    printf("%-32s %12ld %14.1f %14.1f %14.0f %10.2f %12.1f",
+           resultado->nombre, resultado->iteraciones, resultado->ns_op, resultado->ns_op_min,
+           por_segundo, resultado->asignaciones_op, resultado->bytes_op);
+    if (referencia > 0)
+    {
+        printf("  %10.2fx", referencia / resultado->ns_op);
+    } else if (base != NULL)
+    {
+        printf("  %11s", "-");
+    }
+    printf("\n");
+    fflush(stdout);
+}
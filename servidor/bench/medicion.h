@@ -0,0 +1,106 @@
+/*!
+ * @file    medicion.h
+ * @brief   Definiciones y declaraciones para medir tiempos y asignaciones de memoria de una operacion.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - El tipo de las operaciones a medir y la estructura Resultado con sus cifras.
+ *          - Declaraciones de funciones para medir una operacion e imprimir los resultados.
+ *          La cantidad de iteraciones se ajusta sola hasta que cada medicion dura al menos el tiempo pedido,
+ *          y se informa la mediana de varias repeticiones para que las cifras sean comparables entre corridas.
+ *          Los resultados pueden compararse con los de otra corrida (ver Base), por ejemplo entre variantes de compilacion.
+*/
+
+#ifndef MEDICION_H
+#define MEDICION_H
+
+/*!
+ * @def REPETICIONES
+ * @brief Mediciones que se repiten con la cantidad de iteraciones ya calibrada.
+*/
+#define REPETICIONES 5
+
+/*!
+ * @brief Operacion a medir.
+ * @param contexto   Datos de la operacion.
+ * @param iteracion  Numero de iteracion, para variar los datos de entrada.
+ * @return OK(0) si la operacion es exitosa, otro valor si falla (se interrumpe la medicion).
+*/
+typedef int (*Operacion)(void* contexto, long iteracion);
+
+/*!
+ * @struct Resultado
+ * @brief Cifras de la medicion de una operacion.
+*/
+typedef struct Resultado
+{
+    char nombre[64];          /**< Nombre de la medicion, por ejemplo "listar/1000". */
+    long iteraciones;         /**< Iteraciones de cada repeticion. */
+    double ns_op;             /**< Nanosegundos por operacion (mediana de las repeticiones). */
+    double ns_op_min;         /**< Nanosegundos por operacion de la repeticion mas rapida. */
+    double unidades_op;       /**< Unidades procesadas por operacion (filas, registros), 0 si no aplica. */
+    double asignaciones_op;   /**< Llamadas a malloc/calloc/realloc por operacion. */
+    double bytes_op;          /**< Bytes pedidos al asignador por operacion. */
+} Resultado;
+
+/*!
+ * @def BASE_MAX
+ * @brief Cantidad maxima de mediciones de una corrida de referencia.
+*/
+#define BASE_MAX 256
+
+/*!
+ * @struct Base
+ * @brief Tiempos de una corrida de referencia (por ejemplo, la compilacion sin optimizar),
+ *        con los que se calcula la aceleracion de cada medicion.
+*/
+typedef struct Base
+{
+    int cantidad;                  /**< Cantidad de mediciones cargadas. */
+    char nombres[BASE_MAX][64];    /**< Nombre de cada medicion. */
+    double ns_op[BASE_MAX];        /**< Nanosegundos por operacion de cada medicion. */
+} Base;
+
+/*!
+ * @brief   Devuelve la cantidad de asignaciones y los bytes pedidos desde que inicio el programa.
+ *          Solo cuenta si la biblioteca de C permite interceptar malloc (glibc); si no, devuelve 0.
+ * @param asignaciones Cantidad de llamadas a malloc/calloc/realloc.
+ * @param bytes        Bytes pedidos en esas llamadas.
+*/
+void asignaciones_leer(unsigned long long* asignaciones, unsigned long long* bytes);
+
+/*!
+ * @brief   Mide una operacion.
+ * @param resultado   Resultado a completar.
+ * @param nombre      Nombre de la medicion.
+ * @param operacion   Operacion a medir.
+ * @param contexto    Datos pasados a la operacion.
+ * @param unidades    Unidades que procesa cada operacion (0 si no aplica).
+ * @param tiempo_min  Duracion minima de cada repeticion, en segundos.
+ * @return OK(0) si se mide, ERROR(-1) si la operacion falla.
+*/
+int medir(Resultado* resultado, const char* nombre, Operacion operacion, void* contexto, double unidades, double tiempo_min);
+
+/*!
+ * @brief   Carga los tiempos de una corrida de referencia desde la tabla que imprimio otra corrida.
+ * @param base Base a completar.
+ * @param ruta Archivo con la salida de la corrida de referencia.
+ * @return OK(0) si se carga, ERROR(-1) si no se pudo abrir el archivo.
+*/
+int base_cargar(Base* base, const char* ruta);
+
+/*!
+ * @brief   Imprime la cabecera de la tabla de resultados.
+ * @param base Corrida de referencia, o NULL si no se compara.
+*/
+void imprimir_cabecera(const Base* base);
+
+/*!
+ * @brief   Imprime un resultado como fila de la tabla.
+ *          Si hay corrida de referencia agrega la aceleracion: ns/op de la referencia sobre ns/op actual.
+ * @param resultado Resultado a imprimir.
+ * @param base      Corrida de referencia, o NULL si no se compara.
+*/
+void imprimir_resultado(const Resultado* resultado, const Base* base);
+
+#endif
@@ -0,0 +1,63 @@
+/*!
+ * @file    escanear.c
+ * @brief   Programa que arma el catalogo del servidor escaneando el directorio de canciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Contiene la funcion main del escaner sin servidor: lee las etiquetas ID3 de los .mp3 del directorio
+ *          y escribe media.csv y media.idx en el directorio actual (ver escaner.h). Puede correr con el servidor
+ *          en marcha: el servidor toma el catalogo y el indice nuevos al notar que cambiaron.
+ *          Con -m arma tambien el indice de marcos de cada cancion que no lo tenga (ver marcos.h), asi el primer
+ *          pedido de una cancion desde un instante no tiene que recorrerla.
+ *          Uso: escanear [-h hilos] [-m] <directorio>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "catalogo.h"
+#include "escaner.h"
+
+/*!
+ * @brief   Funcion principal del escaner.
+ * @param cant_arg Cantidad de argumentos pasados al programa.
+ * @param arg      Arreglo de cadenas con los argumentos: [-h hilos], [-m] y el directorio de canciones.
+ * @return OK(0) si se escribe el catalogo, ERROR(-1) si los argumentos son invalidos o falla el escaneo.
+*/
+int main(int cant_arg, char* arg[])
+{
+    int opcion, hilos = 0, marcos = 0, estado;
+    Resumen resumen;
+
+    while ((opcion = getopt(cant_arg, arg, "h:m")) != -1)
+    {
+        if (opcion == 'm')
+        {
+            marcos = 1;
+        } else if (opcion != 'h' || (hilos = atoi(optarg)) < 0)
+        {
+            fprintf(stderr, "Uso: %s [-h hilos] [-m] <directorio>\n", arg[0]);
+            return ERROR;
+        }
+    }
+    if (optind != cant_arg - 1)
+    {
+        fprintf(stderr, "Uso: %s [-h hilos] [-m] <directorio>\n", arg[0]);
+        return ERROR;
+    }
+    if ((estado = escaner_actualizar(arg[optind], CATALOGO_RUTA, CATALOGO_INDICE, hilos, marcos, &resumen)) != OK)
+    {
+        fprintf(stderr, (estado == ERROR_DE_MEMORIA) ? "No hay memoria para escanear %s.\n"
+                                                     : "No se pudo escanear %s o escribir el catalogo.\n", arg[optind]);
+        return ERROR;
+    }
+    printf("%d archivos en %.3f s con %d hilos (%d robos): %d leidos, %d sin cambios, %d nuevos, %d quitados, %d errores.\n",
+           resumen.archivos, resumen.segundos, resumen.hilos, resumen.robos, resumen.leidos, resumen.reutilizados,
+           resumen.nuevos, resumen.quitados, resumen.errores);
+    if (marcos)
+    {
+        printf("%d indices de marcos armados.\n", resumen.marcos);
+    }
+    return OK;
+}
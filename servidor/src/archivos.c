@@ -0,0 +1,609 @@
+/*!
+ * @file    archivos.c
+ * @brief   Tabla de archivos de canciones del servidor, indexada por numero de cancion.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Abrir los archivos de canciones con openat relativo al directorio de las canciones.
+ *          - Mantener abiertos los descriptores usados recientemente y cerrar los mas viejos (LRU).
+ *          - Recordar por un tiempo las canciones que no tienen archivo.
+ *          - Leer media.idx, con la ruta del archivo de cada cancion, y volver a leerlo cuando cambia.
+ *          - Retirar los descriptores de las canciones cuyo archivo cambio, y cerrarlos cuando se dejan de usar.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "archivos.h"
+#include "transporte.h"
+#include "canciones.h"
+#include "catalogo.h"
+#include "bitacora.h"
+
+/*!
+ * @def INEXISTENTE
+ * @brief Marca de una entrada cuya cancion no tiene archivo (ver Entrada.descriptor).
+*/
+#define INEXISTENTE -1
+
+/*!
+ * @struct Entrada
+ * @brief Estado del archivo de una cancion. La entrada 0 no es una cancion: es la cabeza de la lista LRU.
+*/
+typedef struct Entrada
+{
+    int descriptor;      /**< Descriptor abierto mas uno; 0 si no esta abierto, INEXISTENTE si no tiene archivo. */
+    uint32_t usos;       /**< Descargas que estan leyendo el archivo (mientras haya alguna no se cierra). */
+    uint32_t anterior;   /**< Entrada usada mas recientemente en la lista LRU de descriptores sin usar. */
+    uint32_t siguiente;  /**< Entrada usada menos recientemente en la lista LRU. */
+    uint32_t vence;      /**< Segundo en que vence la marca INEXISTENTE. */
+    dev_t dispositivo;   /**< Dispositivo del archivo abierto. */
+    ino_t inodo;         /**< Inodo del archivo abierto. */
+} Entrada;
+
+/*!
+ * @struct Retirado
+ * @brief Descriptor de una cancion cuyo archivo cambio mientras habia descargas leyendolo. Ya no se entrega
+ *        a pedidos nuevos y se cierra cuando lo sueltan las descargas que lo tienen.
+*/
+typedef struct Retirado
+{
+    int fd;                 /**< Descriptor retirado. */
+    uint32_t usos;          /**< Descargas que todavia lo estan leyendo. */
+    struct Retirado* sig;   /**< Siguiente descriptor retirado. */
+} Retirado;
+
+static Entrada* tabla = NULL;           // una entrada por numero de cancion.
+static int directorio = -1;             // directorio de las canciones.
+static int descriptores_abiertos = 0;   // descriptores abiertos, en uso o no.
+static int sin_usar = 0;                // descriptores abiertos en la lista LRU.
+static uint64_t total_aciertos = 0, total_aperturas = 0, total_negativos = 0, total_inexistentes = 0;
+static char* indice_texto = NULL;       // contenido de media.idx.
+static char** indice_rutas = NULL;      // ruta del archivo de cada numero (NULL si el numero esta libre).
+static uint32_t indice_cantidad = 0;    // numeros de media.idx; 0 si no existe (la cancion N es N.mp3).
+static struct stat indice_datos;        // datos de media.idx al leerlo (st_ino 0 si no existe).
+static uint32_t indice_revisado = 0;    // segundo en que se reviso por ultima vez si media.idx cambio.
+static uint32_t indice_version = 0;     // cambia cada vez que se lee un media.idx distinto.
+static uint32_t maximo = 0;             // mayor numero con una entrada abierta o INEXISTENTE.
+static Retirado* retirados = NULL;      // descriptores retirados que todavia se estan usando.
+static pthread_mutex_t archivos_mutex = PTHREAD_MUTEX_INITIALIZER; // protege la tabla, el indice y los contadores.
+static pthread_mutex_t revision_mutex = PTHREAD_MUTEX_INITIALIZER; // una sola revision de media.idx a la vez.
+
+/*!
+ * @brief   Devuelve el segundo actual de un reloj monotono.
+ * @return Segundos desde un instante fijo.
+*/
+static uint32_t segundo_actual(void)
+{
+    struct timespec ahora;
+
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return (uint32_t)ahora.tv_sec;
+}
+
+/*!
+ * @brief   Quita una entrada de la lista LRU. Debe llamarse con archivos_mutex tomado.
+ * @param numero Numero de la entrada.
+*/
+static void quitar_lru(uint32_t numero)
+{
+    tabla[tabla[numero].anterior].siguiente = tabla[numero].siguiente;
+    tabla[tabla[numero].siguiente].anterior = tabla[numero].anterior;
+    sin_usar--;
+}
+
+/*!
+ * @brief   Agrega una entrada al principio de la lista LRU (la mas reciente) y cierra los descriptores
+ *          del final mientras sobren. Debe llamarse con archivos_mutex tomado.
+ * @param numero Numero de la entrada.
+*/
+static void agregar_lru(uint32_t numero)
+{
+    uint32_t viejo;
+
+    tabla[numero].anterior = 0;
+    tabla[numero].siguiente = tabla[0].siguiente;
+    tabla[tabla[0].siguiente].anterior = numero;
+    tabla[0].siguiente = numero;
+    sin_usar++;
+    while (sin_usar > ARCHIVOS_ABIERTOS_MAX)
+    {
+        viejo = tabla[0].anterior;
+        quitar_lru(viejo);
+        close(tabla[viejo].descriptor - 1);
+        tabla[viejo].descriptor = 0;
+        descriptores_abiertos--;
+    }
+}
+
+/*!
+ * @brief   Retira el descriptor de una entrada abierta: los pedidos nuevos vuelven a abrir el archivo.
+ *          Si nadie lo usa se cierra enseguida; si no, pasa a la lista de retirados y lo cierra el ultimo
+ *          archivos_soltar(). Debe llamarse con archivos_mutex tomado.
+ * @param numero Numero de la entrada.
+*/
+static void retirar(uint32_t numero)
+{
+    Entrada* entrada = &tabla[numero];
+    Retirado* retirado = NULL;
+
+    if (entrada->usos == 0)
+    {
+        quitar_lru(numero);
+        close(entrada->descriptor - 1);
+        descriptores_abiertos--;
+    } else
+    {
+        if ((retirado = malloc(sizeof(Retirado))) == NULL)
+        {
+            bitacora_error("Error al reservar memoria para retirar el descriptor de la cancion %u.\n", numero);
+            return;
+        }
+        retirado->fd = entrada->descriptor - 1;
+        retirado->usos = entrada->usos;
+        retirado->sig = retirados;
+        retirados = retirado;
+        entrada->usos = 0;
+    }
+    entrada->descriptor = 0;
+}
+
+/*!
+ * @brief   Busca un descriptor en la lista de retirados. Debe llamarse con archivos_mutex tomado.
+ * @param fd Descriptor a buscar.
+ * @return Puntero al enlace que apunta al retirado, o NULL si no esta.
+*/
+static Retirado** buscar_retirado(int fd)
+{
+    Retirado** enlace;
+
+    for (enlace = &retirados; *enlace != NULL; enlace = &(*enlace)->sig)
+    {
+        if ((*enlace)->fd == fd)
+        {
+            return enlace;
+        }
+    }
+    return NULL;
+}
+
+/*!
+ * @brief   Compara las entradas abiertas con un media.idx recien leido. Debe llamarse con archivos_mutex
+ *          tomado y con el indice anterior todavia en indice_rutas.
+ *          Olvida las marcas INEXISTENTE (un numero sin archivo puede tenerlo ahora) y retira los descriptores
+ *          de los numeros cuya ruta cambio. Los que conservan la ruta se guardan en revisar, para comprobar
+ *          despues sin el mutex que la ruta siga siendo el mismo archivo.
+ * @param rutas    Rutas del indice nuevo.
+ * @param cantidad Numeros del indice nuevo.
+ * @param revisar  Numeros a completar (al menos abiertos elementos), o NULL si no hay memoria.
+ * @return Cantidad de numeros guardados en revisar.
+*/
+static uint32_t comparar_indice(char** rutas, uint32_t cantidad, uint32_t* revisar)
+{
+    uint32_t numero, pendientes = 0;
+    const char* anterior = NULL;
+    const char* nueva = NULL;
+
+    for (numero = 1; numero <= maximo; numero++)
+    {
+        if (tabla[numero].descriptor == INEXISTENTE)
+        {
+            tabla[numero].descriptor = 0;
+        }
+        if (tabla[numero].descriptor <= 0)
+        {
+            continue;
+        }
+        anterior = (indice_cantidad == 0) ? NULL : (numero <= indice_cantidad) ? indice_rutas[numero] : NULL;
+        nueva = (cantidad == 0) ? NULL : (numero <= cantidad) ? rutas[numero] : NULL;
+        // sin media.idx la ruta es N.mp3: solo se la compara con la del indice si uno de los dos existe.
+        if ((indice_cantidad == 0) != (cantidad == 0) || (cantidad > 0 && (anterior == NULL || nueva == NULL || strcmp(anterior, nueva) != 0)))
+        {
+            retirar(numero);
+        } else if (revisar != NULL)
+        {
+            revisar[pendientes++] = numero;
+        }
+    }
+    return pendientes;
+}
+
+/*!
+ * @brief   Vuelve a leer media.idx si cambio desde la ultima lectura (o si aparecio o desaparecio).
+ *          El escaner puede darle a un numero otro archivo (ej: se borro y se agrego otro con la misma ruta),
+ *          asi que se retiran los descriptores de los numeros cuya ruta cambio o ya no es el archivo abierto,
+ *          y se olvidan las canciones marcadas como inexistentes.
+*/
+static void revisar_indice(void)
+{
+    struct stat datos;
+    FILE* archivo = NULL;
+    char* texto = NULL;
+    char** rutas = NULL;
+    char** nuevas = NULL;
+    char* linea = NULL;
+    char* fin = NULL;
+    char* tabulador = NULL;
+    char nombre[PATH_MAX];
+    uint32_t* revisar = NULL;
+    uint32_t cantidad = 0, capacidad = 0, pendientes, i;
+    long largo;
+
+    pthread_mutex_lock(&revision_mutex);
+    if (stat(CATALOGO_INDICE, &datos) < 0)
+    {
+        memset(&datos, 0, sizeof(datos));
+    }
+    pthread_mutex_lock(&archivos_mutex);
+    if (datos.st_ino == indice_datos.st_ino && datos.st_dev == indice_datos.st_dev && datos.st_size == indice_datos.st_size
+        && datos.st_mtim.tv_sec == indice_datos.st_mtim.tv_sec && datos.st_mtim.tv_nsec == indice_datos.st_mtim.tv_nsec)
+    {
+        pthread_mutex_unlock(&archivos_mutex);
+        pthread_mutex_unlock(&revision_mutex);
+        return;
+    }
+    pthread_mutex_unlock(&archivos_mutex);
+    if (datos.st_ino != 0 && (archivo = fopen(CATALOGO_INDICE, "rb")) != NULL)
+    {
+        if (fseek(archivo, 0, SEEK_END) == 0 && (largo = ftell(archivo)) >= 0 && fseek(archivo, 0, SEEK_SET) == 0
+            && (texto = malloc(largo + 1)) != NULL)
+        {
+            texto[fread(texto, 1, largo, archivo)] = '\0';
+        }
+        fclose(archivo);
+    }
+    for (linea = texto; linea != NULL && *linea != '\0'; linea = fin)
+    {
+        if (cantidad + 1 >= capacidad)
+        {
+            capacidad = capacidad * 2 + 1024;
+            if ((nuevas = realloc(rutas, capacidad * sizeof(char*))) == NULL)
+            {
+                bitacora_error("Error al reservar memoria para el indice de archivos.\n");
+                free(rutas);
+                free(texto);
+                pthread_mutex_unlock(&revision_mutex);
+                return;
+            }
+            rutas = nuevas;
+        }
+        if ((fin = strchr(linea, '\n')) != NULL)
+        {
+            *fin++ = '\0';
+        }
+        // "ruta<TAB>modificacion<TAB>tamanio"; una linea vacia es un numero libre.
+        if ((tabulador = strchr(linea, '\t')) != NULL)
+        {
+            *tabulador = '\0';
+        }
+        rutas[++cantidad] = (tabulador != NULL) ? linea : NULL;
+    }
+    pthread_mutex_lock(&archivos_mutex);
+    if ((revisar = malloc((descriptores_abiertos + 1) * sizeof(uint32_t))) == NULL)
+    {
+        bitacora_error("Error al reservar memoria para revisar los archivos abiertos.\n");
+    }
+    pendientes = comparar_indice(rutas, cantidad, revisar);
+    free(indice_rutas);
+    free(indice_texto);
+    indice_rutas = rutas;
+    indice_texto = texto;
+    indice_cantidad = cantidad;
+    indice_datos = datos;
+    indice_version++;
+    pthread_mutex_unlock(&archivos_mutex);
+
+    // la misma ruta puede ser otro archivo: se compara el inodo sin el mutex (las rutas no cambian hasta la
+    // proxima revision, que espera a esta).
+    for (i = 0; i < pendientes; i++)
+    {
+        if (cantidad > 0)
+        {
+            snprintf(nombre, sizeof(nombre), "%s", rutas[revisar[i]]);
+        } else
+        {
+            snprintf(nombre, sizeof(nombre), ARCHIVOS_FORMATO, revisar[i]);
+        }
+        if (fstatat(directorio, nombre, &datos, 0) < 0)
+        {
+            memset(&datos, 0, sizeof(datos));
+        }
+        pthread_mutex_lock(&archivos_mutex);
+        if (tabla[revisar[i]].descriptor > 0
+            && (tabla[revisar[i]].inodo != datos.st_ino || tabla[revisar[i]].dispositivo != datos.st_dev))
+        {
+            retirar(revisar[i]);
+        }
+        pthread_mutex_unlock(&archivos_mutex);
+    }
+    free(revisar);
+    pthread_mutex_unlock(&revision_mutex);
+    if (cantidad > 0)
+    {
+        bitacora(NIVEL_INFO, "Indice de archivos leido: %u canciones.\n", cantidad);
+    }
+}
+
+/*!
+ * @brief   Arma la ruta del archivo de una cancion, relativa al directorio de las canciones.
+ *          Se llama con archivos_mutex tomado.
+ * @param numero  Numero de la cancion.
+ * @param nombre  Ruta a completar ("" si el numero no tiene archivo en media.idx).
+ * @param tamanio Tamanio de nombre.
+*/
+static void armar_nombre(uint32_t numero, char* nombre, size_t tamanio)
+{
+    if (indice_cantidad == 0)
+    {
+        snprintf(nombre, tamanio, ARCHIVOS_FORMATO, numero);
+    } else if (numero <= indice_cantidad && indice_rutas[numero] != NULL)
+    {
+        snprintf(nombre, tamanio, "%s", indice_rutas[numero]);
+    } else
+    {
+        nombre[0] = '\0';
+    }
+}
+
+/*!
+ * @brief   Abre el directorio de las canciones, reserva la tabla de archivos y lee media.idx si existe.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo abrir el directorio o no hay memoria.
+*/
+int archivos_iniciar(void)
+{
+    const char* ruta = getenv(ARCHIVOS_ENTORNO);
+
+    if (ruta == NULL || *ruta == '\0')
+    {
+        ruta = ".";
+    }
+    if ((directorio = open(ruta, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+    {
+        bitacora_error("No se pudo abrir el directorio de canciones %s.\n", ruta);
+        return ERROR;
+    }
+    // calloc de un bloque grande no toca la memoria: solo se asignan las paginas de los numeros pedidos.
+    if ((tabla = calloc(ARCHIVOS_IDS, sizeof(Entrada))) == NULL)
+    {
+        close(directorio);
+        directorio = -1;
+        return ERROR;
+    }
+    memset(&indice_datos, 0, sizeof(indice_datos));
+    indice_revisado = segundo_actual();
+    revisar_indice();
+    return OK;
+}
+
+/*!
+ * @brief   Interpreta el numero de una cancion pedida por un cliente: "12" o, como antes, "12.mp3".
+ * @param texto Texto recibido.
+ * @return Numero de la cancion, o 0 si el texto no es un numero de cancion valido.
+*/
+uint32_t archivos_leer_numero(const char* texto)
+{
+    uint32_t numero = 0;
+
+    for (; isdigit((unsigned char)*texto); texto++)
+    {
+        numero = numero * 10 + (*texto - '0');
+        if (numero >= ARCHIVOS_IDS)
+        {
+            return 0;
+        }
+    }
+    if (*texto != '\0' && strcmp(texto, ".mp3") != 0)
+    {
+        return 0;
+    }
+    return numero;
+}
+
+/*!
+ * @brief   Abre el archivo de una cancion, o reutiliza su descriptor si ya esta abierto.
+ *          La apertura se hace sin el mutex tomado; si dos pedidos abren la misma cancion a la vez,
+ *          el segundo cierra su descriptor y usa el del primero.
+ * @param numero  Numero de la cancion.
+ * @param archivo Archivo a completar.
+ * @return OK(0) si la cancion tiene archivo, ERROR(-1) si no existe o no se pudo abrir.
+*/
+int archivos_abrir(uint32_t numero, Archivo* archivo)
+{
+    int fd = -1, revisar;
+    uint32_t version;
+    char nombre[PATH_MAX];
+    struct stat datos;
+    Entrada* entrada = NULL;
+
+    if (numero == 0 || numero >= ARCHIVOS_IDS || tabla == NULL)
+    {
+        return ERROR;
+    }
+    entrada = &tabla[numero];
+    archivo->numero = numero;
+    // a lo sumo una revision de media.idx por segundo: tambien antes de usar un descriptor ya abierto o una
+    // marca INEXISTENTE, que pueden ser de un indice viejo.
+    pthread_mutex_lock(&archivos_mutex);
+    if ((revisar = (indice_revisado != segundo_actual())))
+    {
+        indice_revisado = segundo_actual();
+    }
+    pthread_mutex_unlock(&archivos_mutex);
+    if (revisar)
+    {
+        revisar_indice();
+    }
+
+    pthread_mutex_lock(&archivos_mutex);
+    if (entrada->descriptor > 0)
+    {
+        if (entrada->usos++ == 0)
+        {
+            quitar_lru(numero);
+        }
+        archivo->fd = entrada->descriptor - 1;
+        total_aciertos++;
+        pthread_mutex_unlock(&archivos_mutex);
+        return OK;
+    }
+    if (entrada->descriptor == INEXISTENTE && (int32_t)(entrada->vence - segundo_actual()) > 0)
+    {
+        total_negativos++;
+        pthread_mutex_unlock(&archivos_mutex);
+        return ERROR;
+    }
+    do
+    {
+        armar_nombre(numero, nombre, sizeof(nombre));
+        version = indice_version;
+        pthread_mutex_unlock(&archivos_mutex);
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+        if (nombre[0] != '\0' && (fd = openat(directorio, nombre, O_RDONLY | O_CLOEXEC)) >= 0
+            && (fstat(fd, &datos) < 0 || !S_ISREG(datos.st_mode)))
+        {
+            close(fd);
+            fd = -1;
+        }
+        pthread_mutex_lock(&archivos_mutex);
+    } while (version != indice_version); // el indice cambio mientras se abria: la ruta puede ser vieja.
+
+    if (numero > maximo)
+    {
+        maximo = numero;
+    }
+    if (entrada->descriptor > 0) // otro pedido lo abrio mientras tanto.
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (entrada->usos++ == 0)
+        {
+            quitar_lru(numero);
+        }
+        archivo->fd = entrada->descriptor - 1;
+        total_aciertos++;
+        pthread_mutex_unlock(&archivos_mutex);
+        return OK;
+    }
+    if (fd < 0)
+    {
+        entrada->descriptor = INEXISTENTE;
+        entrada->vence = segundo_actual() + ARCHIVOS_NEGATIVO;
+        total_inexistentes++;
+        pthread_mutex_unlock(&archivos_mutex);
+        return ERROR;
+    }
+    entrada->descriptor = fd + 1;
+    entrada->usos = 1;
+    entrada->dispositivo = datos.st_dev;
+    entrada->inodo = datos.st_ino;
+    descriptores_abiertos++;
+    total_aperturas++;
+    archivo->fd = fd;
+    pthread_mutex_unlock(&archivos_mutex);
+    return OK;
+}
+
+/*!
+ * @brief   Devuelve el directorio de las canciones y la ruta del archivo de una cancion abierta, para guardar
+ *          datos junto a ella (ver marcos.h).
+ * @param archivo Archivo abierto con archivos_abrir().
+ * @param nombre  Ruta a completar, relativa al directorio.
+ * @param tamanio Tamanio de nombre.
+ * @return Descriptor del directorio de las canciones, o -1 si la cancion ya no tiene archivo en media.idx o si
+ *         su descriptor se retiro porque la ruta es de otro archivo.
+*/
+int archivos_ruta(const Archivo* archivo, char* nombre, size_t tamanio)
+{
+    pthread_mutex_lock(&archivos_mutex);
+    if (tabla[archivo->numero].descriptor == archivo->fd + 1)
+    {
+        armar_nombre(archivo->numero, nombre, tamanio);
+    } else
+    {
+        nombre[0] = '\0';
+    }
+    pthread_mutex_unlock(&archivos_mutex);
+    return (nombre[0] != '\0') ? directorio : -1;
+}
+
+/*!
+ * @brief   Suelta un archivo abierto con archivos_abrir(). El descriptor queda abierto para los
+ *          proximos pedidos hasta que haga falta lugar; si se retiro, se cierra al soltarlo el ultimo.
+ * @param archivo Archivo a soltar.
+*/
+void archivos_soltar(const Archivo* archivo)
+{
+    Retirado** enlace = NULL;
+    Retirado* retirado = NULL;
+
+    pthread_mutex_lock(&archivos_mutex);
+    if (tabla[archivo->numero].descriptor == archivo->fd + 1)
+    {
+        if (--tabla[archivo->numero].usos == 0)
+        {
+            agregar_lru(archivo->numero);
+        }
+    } else if ((enlace = buscar_retirado(archivo->fd)) != NULL && --(*enlace)->usos == 0)
+    {
+        retirado = *enlace;
+        *enlace = retirado->sig;
+        close(retirado->fd);
+        free(retirado);
+        descriptores_abiertos--;
+    }
+    pthread_mutex_unlock(&archivos_mutex);
+}
+
+/*!
+ * @brief   Devuelve cuantas descargas estan usando el archivo de una cancion abierta, incluida la que pregunta.
+ * @param archivo Archivo abierto con archivos_abrir().
+ * @return Cantidad de usos del descriptor.
+*/
+int archivos_usos(const Archivo* archivo)
+{
+    Retirado** enlace = NULL;
+    int usos = 1;
+
+    pthread_mutex_lock(&archivos_mutex);
+    if (tabla[archivo->numero].descriptor == archivo->fd + 1)
+    {
+        usos = tabla[archivo->numero].usos;
+    } else if ((enlace = buscar_retirado(archivo->fd)) != NULL)
+    {
+        usos = (*enlace)->usos;
+    }
+    pthread_mutex_unlock(&archivos_mutex);
+    return usos;
+}
+
+/*!
+ * @brief   Devuelve los contadores de la tabla de archivos.
+ * @param aciertos     Pedidos resueltos con un descriptor ya abierto.
+ * @param aperturas    Pedidos que abrieron el archivo.
+ * @param negativos    Pedidos de canciones inexistentes resueltos sin ir al sistema de archivos.
+ * @param inexistentes Pedidos que buscaron el archivo y no lo encontraron.
+ * @param abiertos     Descriptores abiertos en este momento.
+*/
+void archivos_contadores(uint64_t* aciertos, uint64_t* aperturas, uint64_t* negativos, uint64_t* inexistentes, int* abiertos)
+{
+    pthread_mutex_lock(&archivos_mutex);
+    *aciertos = total_aciertos;
+    *aperturas = total_aperturas;
+    *negativos = total_negativos;
+    *inexistentes = total_inexistentes;
+    *abiertos = descriptores_abiertos;
+    pthread_mutex_unlock(&archivos_mutex);
+}
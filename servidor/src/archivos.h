@@ -0,0 +1,128 @@
+/*!
+ * @file    archivos.h
+ * @brief   Definiciones y declaraciones de la tabla de archivos de canciones del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los limites de la tabla y la estructura Archivo.
+ *          - Declaraciones de funciones para abrir y soltar archivos de canciones por su numero.
+ *          Las canciones se piden por su numero en el catalogo, no por nombre de archivo. El numero es la
+ *          posicion en una tabla de descriptores ya abiertos: encontrar el archivo de una cancion es leer
+ *          un elemento de un arreglo, sin recorrer rutas. La primera vez se abre con openat relativo al
+ *          directorio de las canciones (ARCHIVOS_ENTORNO, o el directorio actual), que se abre una sola vez;
+ *          un cliente no puede nombrar otros archivos. Los descriptores que nadie usa quedan abiertos hasta
+ *          ARCHIVOS_ABIERTOS_MAX y se cierran los usados hace mas tiempo (LRU). Los numeros sin archivo se
+ *          recuerdan ARCHIVOS_NEGATIVO segundos, asi los pedidos repetidos de canciones inexistentes no
+ *          llegan al sistema de archivos.
+ *          Como varias descargas pueden compartir un descriptor, los archivos se leen con pread.
+ *          Si existe media.idx (ver escaner.h), el archivo de cada numero es el que indica su linea; si no,
+ *          el de la cancion N es N.mp3. El indice se vuelve a leer cuando cambia (se revisa a lo sumo una vez por segundo, al pedir un archivo):
+ *          se olvidan los numeros sin archivo y se retiran los descriptores de los numeros cuya ruta cambio o
+ *          ya es otro archivo. Un descriptor retirado que alguna descarga esta leyendo se cierra al soltarlo.
+*/
+
+#ifndef ARCHIVOS_H
+#define ARCHIVOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*!
+ * @def ARCHIVOS_IDS
+ * @brief Cantidad de numeros de cancion de la tabla (validos de 1 a ARCHIVOS_IDS - 1).
+ *        La tabla se reserva entera, pero el sistema solo asigna memoria a las paginas que se usan.
+*/
+#define ARCHIVOS_IDS (1 << 22)
+
+/*!
+ * @def ARCHIVOS_ABIERTOS_MAX
+ * @brief Descriptores sin usar que se mantienen abiertos.
+*/
+#define ARCHIVOS_ABIERTOS_MAX 256
+
+/*!
+ * @def ARCHIVOS_NEGATIVO
+ * @brief Segundos que se recuerda que una cancion no tiene archivo.
+*/
+#define ARCHIVOS_NEGATIVO 5
+
+/*!
+ * @def ARCHIVOS_ENTORNO
+ * @brief Variable de entorno con el directorio de las canciones.
+*/
+#define ARCHIVOS_ENTORNO "CANCIONES_DIRECTORIO"
+
+/*!
+ * @def ARCHIVOS_FORMATO
+ * @brief Formato del nombre del archivo de una cancion a partir de su numero.
+*/
+#define ARCHIVOS_FORMATO "%u.mp3"
+
+/*!
+ * @struct Archivo
+ * @brief Archivo de una cancion abierto con archivos_abrir().
+*/
+typedef struct Archivo
+{
+    uint32_t numero;     /**< Numero de la cancion. */
+    int fd;              /**< Descriptor del archivo (compartido: leer con pread). */
+} Archivo;
+
+/*!
+ * @brief   Abre el directorio de las canciones, reserva la tabla de archivos y lee media.idx si existe.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo abrir el directorio o no hay memoria.
+*/
+int archivos_iniciar(void);
+
+/*!
+ * @brief   Interpreta el numero de una cancion pedida por un cliente: "12" o, como antes, "12.mp3".
+ * @param texto Texto recibido.
+ * @return Numero de la cancion, o 0 si el texto no es un numero de cancion valido.
+*/
+uint32_t archivos_leer_numero(const char* texto);
+
+/*!
+ * @brief   Abre el archivo de una cancion, o reutiliza su descriptor si ya esta abierto.
+ *          Debe devolverse con archivos_soltar() al terminar de leerlo.
+ * @param numero  Numero de la cancion.
+ * @param archivo Archivo a completar.
+ * @return OK(0) si la cancion tiene archivo, ERROR(-1) si no existe o no se pudo abrir.
+*/
+int archivos_abrir(uint32_t numero, Archivo* archivo);
+
+/*!
+ * @brief   Devuelve el directorio de las canciones y la ruta del archivo de una cancion abierta, para guardar
+ *          datos junto a ella (ver marcos.h).
+ * @param archivo Archivo abierto con archivos_abrir().
+ * @param nombre  Ruta a completar, relativa al directorio.
+ * @param tamanio Tamanio de nombre.
+ * @return Descriptor del directorio de las canciones, o -1 si la cancion ya no tiene archivo en media.idx o si
+ *         su descriptor se retiro porque la ruta es de otro archivo.
+*/
+int archivos_ruta(const Archivo* archivo, char* nombre, size_t tamanio);
+
+/*!
+ * @brief   Suelta un archivo abierto con archivos_abrir(). El descriptor queda abierto para los
+ *          proximos pedidos hasta que haga falta lugar; si se retiro, se cierra al soltarlo el ultimo.
+ * @param archivo Archivo a soltar.
+*/
+void archivos_soltar(const Archivo* archivo);
+
+/*!
+ * @brief   Devuelve cuantas descargas estan usando el archivo de una cancion abierta, incluida la que pregunta.
+ * @param archivo Archivo abierto con archivos_abrir().
+ * @return Cantidad de usos del descriptor.
+*/
+int archivos_usos(const Archivo* archivo);
+
+/*!
+ * @brief   Devuelve los contadores de la tabla de archivos.
+ * @param aciertos     Pedidos resueltos con un descriptor ya abierto.
+ * @param aperturas    Pedidos que abrieron el archivo.
+ * @param negativos    Pedidos de canciones inexistentes resueltos sin ir al sistema de archivos.
+ * @param inexistentes Pedidos que buscaron el archivo y no lo encontraron.
+ * @param abiertos     Descriptores abiertos en este momento.
+*/
+void archivos_contadores(uint64_t* aciertos, uint64_t* aperturas, uint64_t* negativos, uint64_t* inexistentes, int* abiertos);
+
+#endif
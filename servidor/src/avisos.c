@@ -0,0 +1,507 @@
+/*!
+ * @file    avisos.c
+ * @brief   Avisos de cambios del catalogo a los clientes suscriptos.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Revisar periodicamente si el catalogo cambio mientras haya suscripciones.
+ *          - Armar un solo evento por cambio, con sus filas ya partidas en tramas, y contar sus referencias.
+ *          - Encolar el evento en cada suscripcion y enviar todas las colas desde un solo hilo repartidor, sin
+ *            bloquearse en los clientes que no leen.
+ *          - Cerrar las suscripciones de una conexion que termina.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "avisos.h"
+#include "protocolo.h"
+#include "catalogo.h"
+#include "canciones.h"
+#include "bitacora.h"
+
+static pthread_mutex_t avisos_mutex = PTHREAD_MUTEX_INITIALIZER; // protege las suscripciones, sus colas y los eventos.
+static pthread_cond_t hay_avisos = PTHREAD_COND_INITIALIZER;   // despierta al repartidor: evento nuevo o cierre.
+static pthread_cond_t liberada = PTHREAD_COND_INITIALIZER;     // el repartidor solto el mutex de envio de una conexion.
+static Suscripcion* activas = NULL;        // suscripciones activas.
+static int cantidad_suscripciones = 0;     // cantidad de suscripciones activas.
+static uint64_t avisada = 0;               // version del catalogo ya avisada (0 si no hay suscripciones).
+static uint64_t eventos_armados = 0, eventos_entregados = 0, eventos_descartados = 0;
+
+/*!
+ * @brief   Suelta una referencia a un evento y lo libera si era la ultima. Debe llamarse con avisos_mutex tomado.
+ * @param evento Evento a soltar.
+*/
+static void soltar_evento(Evento* evento)
+{
+    if (--evento->referencias > 0)
+    {
+        return;
+    }
+    free(evento->filas);
+    free(evento->cortes);
+    free(evento);
+}
+
+/*!
+ * @brief   Agrega una fila al evento, cortando una trama nueva si la fila ya no entra en AVISOS_PARTE bytes.
+ *          Se usa como funcion de catalogo_cambios().
+ * @param contexto Evento en armado.
+ * @param fila     Fila a agregar.
+ * @return OK(0) si se agrega, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int agregar_fila_evento(void* contexto, const char* fila)
+{
+    Evento* evento = contexto;
+    size_t largo = strlen(fila);
+    size_t inicio = (evento->partes > 0) ? evento->cortes[evento->partes - 1] : 0;
+    size_t capacidad = (evento->capacidad > 0) ? evento->capacidad : AVISOS_PARTE;
+    char* filas = NULL;
+    size_t* cortes = NULL;
+
+    while (capacidad < evento->largo + largo + 1)
+    {
+        capacidad *= 2;
+    }
+    if (capacidad != evento->capacidad)
+    {
+        if ((filas = realloc(evento->filas, capacidad)) == NULL)
+        {
+            return ERROR_DE_MEMORIA;
+        }
+        evento->filas = filas;
+        evento->capacidad = capacidad;
+    }
+    if (evento->largo > inicio && evento->largo - inicio + largo > AVISOS_PARTE)
+    {
+        if ((cortes = realloc(evento->cortes, (evento->partes + 1) * sizeof(size_t))) == NULL)
+        {
+            return ERROR_DE_MEMORIA;
+        }
+        evento->cortes = cortes;
+        evento->cortes[evento->partes++] = evento->largo;
+    }
+    memcpy(evento->filas + evento->largo, fila, largo + 1);
+    evento->largo += largo;
+    return OK;
+}
+
+/*!
+ * @brief   Arma el evento del cambio del catalogo desde la version ya avisada a la vigente.
+ *          Si las huellas de la version avisada ya no se guardan, el evento no lleva filas (modo "completo").
+ * @param catalogo Catalogo vigente.
+ * @param anterior Version ya avisada.
+ * @return Evento sin referencias, o NULL si no hay memoria.
+*/
+static Evento* armar_evento(const Catalogo* catalogo, uint64_t anterior)
+{
+    int anteriores = 0, filas = 0;
+    uint64_t* huellas = catalogo_huellas_version(anterior, &anteriores);
+    const char* modo = (huellas != NULL) ? "cambios" : "completo";
+    size_t* cortes = NULL;
+    Evento* evento = calloc(1, sizeof(Evento));
+
+    if (evento != NULL && huellas != NULL)
+    {
+        filas = catalogo_cambios(catalogo, huellas, anteriores, agregar_fila_evento, evento);
+        // la ultima trama termina donde terminan las filas.
+        if (filas > 0 && (evento->partes == 0 || evento->cortes[evento->partes - 1] < evento->largo))
+        {
+            if ((cortes = realloc(evento->cortes, (evento->partes + 1) * sizeof(size_t))) == NULL)
+            {
+                filas = ERROR;
+            } else
+            {
+                evento->cortes = cortes;
+                evento->cortes[evento->partes++] = evento->largo;
+            }
+        }
+    }
+    free(huellas);
+    if (evento == NULL || filas < 0)
+    {
+        if (evento != NULL)
+        {
+            evento->referencias = 1;
+            soltar_evento(evento);
+        }
+        return NULL;
+    }
+    snprintf(evento->fin, sizeof(evento->fin), "%016llx %016llx %d %s", (unsigned long long)anterior,
+             (unsigned long long)catalogo->version, catalogo->cantidad, modo);
+    bitacora(NIVEL_INFO, "Catalogo cambiado (%s): %d filas en %d tramas.\n", modo, filas, evento->partes);
+    return evento;
+}
+
+/*!
+ * @brief   Deja un evento en la cola de cada suscripcion; las que tienen la cola llena lo descartan.
+ *          Todas comparten el mismo evento: solo se cuenta una referencia por suscripcion.
+ * @param evento Evento sin referencias.
+*/
+static void publicar(Evento* evento)
+{
+    Suscripcion* suscripcion = NULL;
+
+    pthread_mutex_lock(&avisos_mutex);
+    evento->referencias = 1; // la de esta funcion, hasta terminar de encolarlo.
+    for (suscripcion = activas; suscripcion != NULL; suscripcion = suscripcion->sig)
+    {
+        if (suscripcion->cerrar || suscripcion->pendientes == AVISOS_COLA)
+        {
+            eventos_descartados++;
+            continue;
+        }
+        suscripcion->cola[(suscripcion->primero + suscripcion->pendientes++) % AVISOS_COLA] = evento;
+        evento->referencias++;
+    }
+    eventos_armados++;
+    soltar_evento(evento);
+    pthread_cond_signal(&hay_avisos);
+    pthread_mutex_unlock(&avisos_mutex);
+}
+
+/*!
+ * @brief   Hilo vigia: cada AVISOS_PERIODO segundos, si hay suscripciones, obtiene el catalogo (que se recarga
+ *          si media.csv cambio) y publica un evento si la version cambio desde la ultima avisada.
+ * @param arg No se usa.
+ * @return NULL (no termina mientras el servidor este en marcha).
+*/
+static void* vigilar(void* arg)
+{
+    uint64_t anterior;
+    Catalogo* catalogo = NULL;
+    Evento* evento = NULL;
+
+    (void)arg;
+    while (1)
+    {
+        sleep(AVISOS_PERIODO);
+        pthread_mutex_lock(&avisos_mutex);
+        anterior = avisada;
+        pthread_mutex_unlock(&avisos_mutex);
+        if (anterior == 0 || (catalogo = catalogo_obtener()) == NULL)
+        {
+            continue;
+        }
+        if (catalogo->version != anterior)
+        {
+            if ((evento = armar_evento(catalogo, anterior)) != NULL)
+            {
+                publicar(evento);
+            } else
+            {
+                bitacora_error("Error al reservar memoria para el aviso de cambios del catalogo.\n");
+            }
+            pthread_mutex_lock(&avisos_mutex);
+            // si mientras tanto se fueron todas las suscripciones, no hay version avisada.
+            avisada = (activas != NULL) ? catalogo->version : 0;
+            pthread_mutex_unlock(&avisos_mutex);
+        }
+        catalogo_soltar(catalogo);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief   Envia sin esperar lo que entre en el socket de la trama actual de una suscripcion. Debe llamarse con
+ *          avisos_mutex y el mutex de envio de la conexion tomados.
+ * @param suscripcion Suscripcion con un evento en la cola.
+ * @return OK(0) si la trama termino de salir, ERROR_USUARIO(-2) si el socket esta lleno, ERROR(-1) si falla el envio.
+*/
+static int enviar_parte(Suscripcion* suscripcion)
+{
+    const Evento* evento = suscripcion->cola[suscripcion->primero];
+    size_t inicio = (suscripcion->parte > 0) ? evento->cortes[suscripcion->parte - 1] : 0;
+    struct iovec partes[2];
+    struct msghdr mensaje;
+    ssize_t enviados;
+
+    if (suscripcion->enviado == 0)
+    {
+        if (suscripcion->parte < evento->partes)
+        {
+            serializar_cabecera(suscripcion->cabecera, suscripcion->id, RESP_DATOS, evento->cortes[suscripcion->parte] - inicio);
+        } else
+        {
+            serializar_cabecera(suscripcion->cabecera, suscripcion->id, RESP_EVENTO, strlen(evento->fin));
+        }
+    }
+    partes[0].iov_base = suscripcion->cabecera;
+    partes[0].iov_len = CABECERA_TAMANIO;
+    if (suscripcion->parte < evento->partes)
+    {
+        partes[1].iov_base = evento->filas + inicio;
+        partes[1].iov_len = evento->cortes[suscripcion->parte] - inicio;
+    } else
+    {
+        partes[1].iov_base = (void*)evento->fin;
+        partes[1].iov_len = strlen(evento->fin);
+    }
+    // salteamos lo que ya salio en intentos anteriores.
+    if (suscripcion->enviado < CABECERA_TAMANIO)
+    {
+        partes[0].iov_base = suscripcion->cabecera + suscripcion->enviado;
+        partes[0].iov_len -= suscripcion->enviado;
+    } else
+    {
+        partes[0].iov_len = 0;
+        partes[1].iov_base = (char*)partes[1].iov_base + (suscripcion->enviado - CABECERA_TAMANIO);
+        partes[1].iov_len -= suscripcion->enviado - CABECERA_TAMANIO;
+    }
+    memset(&mensaje, 0, sizeof(mensaje));
+    mensaje.msg_iov = partes;
+    mensaje.msg_iovlen = 2;
+    while (partes[0].iov_len + partes[1].iov_len > 0)
+    {
+        if ((enviados = sendmsg(suscripcion->conexion->sock, &mensaje, MSG_NOSIGNAL | MSG_DONTWAIT)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? ERROR_USUARIO : ERROR;
+        }
+        suscripcion->enviado += enviados;
+        if ((size_t)enviados < partes[0].iov_len)
+        {
+            partes[0].iov_base = (char*)partes[0].iov_base + enviados;
+            partes[0].iov_len -= enviados;
+            continue;
+        }
+        enviados -= partes[0].iov_len;
+        partes[0].iov_len = 0;
+        partes[1].iov_base = (char*)partes[1].iov_base + enviados;
+        partes[1].iov_len -= enviados;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Avanza lo que se pueda, sin esperar, en la cola de una suscripcion. Debe llamarse con avisos_mutex
+ *          tomado. Entre trama y trama suelta el mutex de envio de la conexion; si una trama queda a medias lo
+ *          conserva, para que no se mezcle con las respuestas de la conexion.
+ * @param suscripcion Suscripcion a atender.
+ * @return 1 si quedan envios pendientes para reintentar, 0 si la cola quedo vacia o la suscripcion se cerro.
+*/
+static int repartir_suscripcion(Suscripcion* suscripcion)
+{
+    Evento* evento = NULL;
+    int estado;
+
+    while (suscripcion->pendientes > 0 && !suscripcion->cerrar)
+    {
+        if (!suscripcion->tomada)
+        {
+            // si otro hilo esta enviando por la conexion, lo reintentamos despues.
+            if (pthread_mutex_trylock(&suscripcion->conexion->envio) != 0)
+            {
+                return 1;
+            }
+            suscripcion->tomada = 1;
+        }
+        if ((estado = enviar_parte(suscripcion)) == ERROR)
+        {
+            bitacora_sesion(suscripcion->conexion->sesion);
+            bitacora_error("Error al enviar aviso de cambios del catalogo.\n");
+            suscripcion->cerrar = 1;
+            break;
+        } else if (estado == ERROR_USUARIO)
+        {
+            if (suscripcion->enviado == 0)
+            {
+                pthread_mutex_unlock(&suscripcion->conexion->envio);
+                suscripcion->tomada = 0;
+            }
+            return 1;
+        }
+        pthread_mutex_unlock(&suscripcion->conexion->envio);
+        suscripcion->tomada = 0;
+        suscripcion->enviado = 0;
+        evento = suscripcion->cola[suscripcion->primero];
+        if (suscripcion->parte++ < evento->partes)
+        {
+            continue;
+        }
+        suscripcion->parte = 0;
+        suscripcion->primero = (suscripcion->primero + 1) % AVISOS_COLA;
+        suscripcion->pendientes--;
+        soltar_evento(evento);
+        eventos_entregados++;
+    }
+    if (suscripcion->tomada)
+    {
+        pthread_mutex_unlock(&suscripcion->conexion->envio);
+        suscripcion->tomada = 0;
+        pthread_cond_broadcast(&liberada);
+    }
+    return 0;
+}
+
+/*!
+ * @brief   Hilo repartidor: envia los eventos encolados de todas las suscripciones sin bloquearse en ningun
+ *          cliente. Si alguno no pudo recibir todo, vuelve a intentar cada AVISOS_REINTENTO milisegundos.
+ * @param arg No se usa.
+ * @return NULL (no termina mientras el servidor este en marcha).
+*/
+static void* repartir(void* arg)
+{
+    Suscripcion* suscripcion = NULL;
+    struct timespec limite;
+    int reintentar;
+
+    (void)arg;
+    pthread_mutex_lock(&avisos_mutex);
+    while (1)
+    {
+        reintentar = 0;
+        for (suscripcion = activas; suscripcion != NULL; suscripcion = suscripcion->sig)
+        {
+            reintentar |= repartir_suscripcion(suscripcion);
+        }
+        if (!reintentar)
+        {
+            pthread_cond_wait(&hay_avisos, &avisos_mutex);
+            continue;
+        }
+        clock_gettime(CLOCK_REALTIME, &limite);
+        limite.tv_nsec += AVISOS_REINTENTO * 1000000L;
+        if (limite.tv_nsec >= 1000000000L)
+        {
+            limite.tv_sec += limite.tv_nsec / 1000000000L;
+            limite.tv_nsec %= 1000000000L;
+        }
+        pthread_cond_timedwait(&hay_avisos, &avisos_mutex, &limite);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief   Crea el hilo vigia del catalogo y el repartidor de los avisos.
+ * @return OK(0) si se inician, ERROR(-1) si no se pudo crear alguno de los hilos.
+*/
+int avisos_iniciar(void)
+{
+    pthread_t hilo;
+
+    if (pthread_create(&hilo, NULL, repartir, NULL) != 0)
+    {
+        return ERROR;
+    }
+    pthread_detach(hilo);
+    if (pthread_create(&hilo, NULL, vigilar, NULL) != 0)
+    {
+        return ERROR;
+    }
+    pthread_detach(hilo);
+    return OK;
+}
+
+/*!
+ * @brief   Suscribe una conexion a los cambios del catalogo (ver SOL_SUSCRIBIR).
+ * @param conexion Conexion del cliente.
+ * @param id       Identificador de la solicitud.
+ * @return OK(0) si la conexion puede seguir (aunque la suscripcion se rechace), ERROR(-1) si ocurre un problema de envio.
+*/
+int avisos_suscribir(Conexion* conexion, uint32_t id)
+{
+    Suscripcion* suscripcion = NULL;
+    Catalogo* catalogo = NULL;
+    uint64_t version;
+
+    pthread_mutex_lock(&avisos_mutex);
+    for (suscripcion = activas; suscripcion != NULL && suscripcion->conexion != conexion; suscripcion = suscripcion->sig);
+    pthread_mutex_unlock(&avisos_mutex);
+    if (suscripcion != NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "La conexion ya esta suscripta.");
+    }
+    // los eventos se arman desde la version vigente al suscribirse.
+    if ((catalogo = catalogo_obtener()) == NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
+    }
+    version = catalogo->version;
+    catalogo_soltar(catalogo);
+    if ((suscripcion = calloc(1, sizeof(Suscripcion))) == NULL)
+    {
+        bitacora_error("Error al reservar memoria para la suscripcion.\n");
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No hay memoria para la suscripcion.");
+    }
+    suscripcion->conexion = conexion;
+    suscripcion->id = id;
+    pthread_mutex_lock(&avisos_mutex);
+    suscripcion->sig = activas;
+    activas = suscripcion;
+    cantidad_suscripciones++;
+    if (avisada == 0)
+    {
+        avisada = version;
+    }
+    pthread_mutex_unlock(&avisos_mutex);
+    bitacora(NIVEL_DEPURACION, "Conexion suscripta a los cambios del catalogo.\n");
+    return OK;
+}
+
+/*!
+ * @brief   Cierra la suscripcion de una conexion, si tiene. Si el repartidor dejo una trama a medias, espera a
+ *          que suelte el mutex de envio de la conexion (no espera al cliente).
+ * @param conexion Conexion del cliente.
+*/
+void avisos_cerrar(Conexion* conexion)
+{
+    Suscripcion** anterior = NULL;
+    Suscripcion* suscripcion = NULL;
+
+    pthread_mutex_lock(&avisos_mutex);
+    for (anterior = &activas; *anterior != NULL && (*anterior)->conexion != conexion; anterior = &(*anterior)->sig);
+    if ((suscripcion = *anterior) == NULL)
+    {
+        pthread_mutex_unlock(&avisos_mutex);
+        return;
+    }
+    suscripcion->cerrar = 1;
+    while (suscripcion->tomada)
+    {
+        pthread_cond_signal(&hay_avisos);
+        pthread_cond_wait(&liberada, &avisos_mutex);
+    }
+    // el repartidor solo la recorre con avisos_mutex tomado: al sacarla de la lista ya no la vuelve a ver.
+    for (anterior = &activas; *anterior != suscripcion; anterior = &(*anterior)->sig);
+    *anterior = suscripcion->sig;
+    if (--cantidad_suscripciones == 0)
+    {
+        avisada = 0;
+    }
+    // los eventos que quedaron sin enviar sueltan su referencia.
+    while (suscripcion->pendientes > 0)
+    {
+        soltar_evento(suscripcion->cola[suscripcion->primero]);
+        suscripcion->primero = (suscripcion->primero + 1) % AVISOS_COLA;
+        suscripcion->pendientes--;
+    }
+    pthread_mutex_unlock(&avisos_mutex);
+    free(suscripcion);
+}
+
+/*!
+ * @brief   Devuelve los contadores de los avisos.
+ * @param suscripciones Suscripciones activas.
+ * @param eventos       Eventos armados (uno por cambio del catalogo visto mientras habia suscripciones).
+ * @param entregas      Eventos enviados a un cliente.
+ * @param descartados   Eventos descartados por tener la cola de la suscripcion llena.
+*/
+void avisos_contadores(uint64_t* suscripciones, uint64_t* eventos, uint64_t* entregas, uint64_t* descartados)
+{
+    pthread_mutex_lock(&avisos_mutex);
+    *suscripciones = cantidad_suscripciones;
+    *eventos = eventos_armados;
+    *entregas = eventos_entregados;
+    *descartados = eventos_descartados;
+    pthread_mutex_unlock(&avisos_mutex);
+}
@@ -0,0 +1,117 @@
+/*!
+ * @file    avisos.h
+ * @brief   Definiciones y declaraciones de los avisos de cambios del catalogo a los clientes suscriptos.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros de los avisos y las estructuras Evento y Suscripcion.
+ *          - Declaraciones de funciones para iniciar el vigia, suscribir una conexion, cerrar sus suscripciones
+ *            y leer los contadores.
+ *          Un hilo vigia revisa cada AVISOS_PERIODO segundos, mientras haya suscripciones, si el catalogo cambio
+ *          (ver catalogo.h). Cuando cambia arma un solo evento con las filas que cambiaron desde la version que
+ *          ya se aviso, partidas en tramas de hasta AVISOS_PARTE bytes, y lo deja en la cola de cada suscripcion:
+ *          todas comparten el mismo evento, que se libera cuando la ultima termina de enviarlo. Un solo hilo
+ *          repartidor envia las colas de todas las suscripciones, sin bloquearse: escribe en cada socket solo lo
+ *          que entra sin esperar y, si un cliente no lee, sigue con los demas y lo reintenta cada AVISOS_REINTENTO
+ *          milisegundos. Una suscripcion cuesta su cola y no un hilo; a cambio, sus tramas no pasan por el
+ *          planificador (son pocas y chicas). Si la cola se llena, los eventos nuevos se descartan para ese
+ *          cliente, que se pone al dia en su proxima sincronizacion (SOL_CATALOGO).
+*/
+
+#ifndef AVISOS_H
+#define AVISOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "transporte.h"
+#include "protocolo.h"
+
+/*!
+ * @def AVISOS_PERIODO
+ * @brief Segundos entre dos revisiones del catalogo.
+*/
+#define AVISOS_PERIODO 1
+
+/*!
+ * @def AVISOS_PARTE
+ * @brief Bytes de filas como maximo en cada trama de un evento.
+*/
+#define AVISOS_PARTE (16 * 1024)
+
+/*!
+ * @def AVISOS_REINTENTO
+ * @brief Milisegundos entre dos intentos de envio a un cliente que no lee.
+*/
+#define AVISOS_REINTENTO 50
+
+/*!
+ * @def AVISOS_COLA
+ * @brief Eventos pendientes de envio como maximo en cada suscripcion.
+*/
+#define AVISOS_COLA 8
+
+/*!
+ * @struct Evento
+ * @brief Cambio del catalogo, armado una sola vez y compartido por todas las suscripciones.
+*/
+typedef struct Evento
+{
+    int referencias;              /**< Suscripciones que todavia no lo terminaron de enviar. */
+    char* filas;                  /**< Filas que cambiaron, en el formato de SOL_CATALOGO. */
+    size_t largo;                 /**< Bytes de filas. */
+    size_t capacidad;             /**< Bytes reservados para filas. */
+    size_t* cortes;               /**< Fin de cada trama en filas (siempre despues de un salto de linea). */
+    int partes;                   /**< Cantidad de tramas de filas. */
+    char fin[96];                 /**< Carga de la trama RESP_EVENTO: "anterior nueva cantidad modo". */
+} Evento;
+
+/*!
+ * @struct Suscripcion
+ * @brief Suscripcion de una conexion a los cambios del catalogo.
+*/
+typedef struct Suscripcion
+{
+    Conexion* conexion;           /**< Conexion del cliente. */
+    uint32_t id;                  /**< Identificador de la solicitud SOL_SUSCRIBIR. */
+    Evento* cola[AVISOS_COLA];    /**< Eventos pendientes de envio, en orden. */
+    int primero;                  /**< Posicion del evento mas viejo de la cola. */
+    int pendientes;               /**< Cantidad de eventos en la cola. */
+    int parte;                    /**< Trama del evento mas viejo que se esta enviando (partes es la RESP_EVENTO). */
+    unsigned char cabecera[CABECERA_TAMANIO]; /**< Cabecera de la trama que se esta enviando. */
+    size_t enviado;               /**< Bytes ya enviados de esa trama (cabecera incluida). */
+    int tomada;                   /**< 1 si el repartidor tiene el mutex de envio de la conexion (trama a medias). */
+    int cerrar;                   /**< 1 si la conexion se cierra o fallo un envio. */
+    struct Suscripcion* sig;      /**< Siguiente suscripcion. */
+} Suscripcion;
+
+/*!
+ * @brief   Crea el hilo vigia del catalogo y el repartidor de los avisos.
+ * @return OK(0) si se inician, ERROR(-1) si no se pudo crear alguno de los hilos.
+*/
+int avisos_iniciar(void);
+
+/*!
+ * @brief   Suscribe una conexion a los cambios del catalogo (ver SOL_SUSCRIBIR).
+ * @param conexion Conexion del cliente.
+ * @param id       Identificador de la solicitud.
+ * @return OK(0) si la conexion puede seguir (aunque la suscripcion se rechace), ERROR(-1) si ocurre un problema de envio.
+*/
+int avisos_suscribir(Conexion* conexion, uint32_t id);
+
+/*!
+ * @brief   Cierra la suscripcion de una conexion, si tiene. Si el repartidor dejo una trama a medias, espera a
+ *          que suelte el mutex de envio de la conexion (no espera al cliente).
+ * @param conexion Conexion del cliente.
+*/
+void avisos_cerrar(Conexion* conexion);
+
+/*!
+ * @brief   Devuelve los contadores de los avisos.
+ * @param suscripciones Suscripciones activas.
+ * @param eventos       Eventos armados (uno por cambio del catalogo visto mientras habia suscripciones).
+ * @param entregas      Eventos enviados a un cliente.
+ * @param descartados   Eventos descartados por tener la cola de la suscripcion llena.
+*/
+void avisos_contadores(uint64_t* suscripciones, uint64_t* eventos, uint64_t* entregas, uint64_t* descartados);
+
+#endif
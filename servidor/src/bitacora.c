@@ -0,0 +1,426 @@
+/*!
+ * @file    bitacora.c
+ * @brief   Bitacora asincronica del servidor: anillos por hilo vaciados por un hilo aparte.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Dar a cada hilo su propio anillo de mensajes; los anillos de hilos terminados se reutilizan.
+ *          - Registrar mensajes sin bloqueos: el hilo escribe la entrada y publica su posicion con una
+ *            operacion atomica; si el anillo esta lleno descarta el mensaje y lo cuenta.
+ *          - Vaciar todos los anillos desde un hilo que escribe los mensajes por la salida estandar,
+ *            en bloques, con fecha, nivel y sesion.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bitacora.h"
+#include "transporte.h"
+#include "canciones.h"
+
+/*!
+ * @def SALIDA_MAX
+ * @brief Tamanio del bloque que el hilo de vaciado junta antes de escribir.
+*/
+#define SALIDA_MAX 65536
+
+/*!
+ * @def ESPERA_MIN_US
+ * @brief Espera del hilo de vaciado despues de encontrar mensajes, en microsegundos.
+*/
+#define ESPERA_MIN_US 1000
+
+/*!
+ * @def ESPERA_MAX_US
+ * @brief Espera maxima del hilo de vaciado cuando no hay mensajes, en microsegundos.
+*/
+#define ESPERA_MAX_US 50000
+
+/*!
+ * @struct Entrada
+ * @brief Mensaje guardado en un anillo.
+*/
+typedef struct Entrada
+{
+    struct timespec instante;    /**< Momento en que se registro el mensaje. */
+    uint32_t sesion;             /**< Sesion del hilo que lo registro (0 si no tiene). */
+    int nivel;                   /**< Nivel del mensaje. */
+    char texto[MENSAJE_MAX];     /**< Mensaje ya formateado. */
+} Entrada;
+
+/*!
+ * @struct Anillo
+ * @brief Cola circular de un productor (el hilo duenio) y un consumidor (el hilo de vaciado).
+ *        Las posiciones solo crecen; la entrada de la posicion p es entradas[p % ANILLO_ENTRADAS].
+*/
+typedef struct Anillo
+{
+    uint64_t cabeza __attribute__((aligned(64)));  /**< Proxima posicion a escribir (la modifica el productor). */
+    uint64_t cola __attribute__((aligned(64)));    /**< Proxima posicion a leer (la modifica el consumidor). */
+    int libre;                                     /**< 1 si el hilo duenio termino y otro puede tomarlo. */
+    struct Anillo* sig;                            /**< Siguiente anillo de la lista global. */
+    Entrada entradas[ANILLO_ENTRADAS];             /**< Mensajes. */
+} Anillo;
+
+static Anillo* anillos = NULL;              // lista de todos los anillos creados (nunca se liberan).
+static __thread Anillo* anillo_propio = NULL;
+static __thread uint32_t sesion_propia = 0;
+static pthread_key_t clave_anillo;          // su destructor libera el anillo cuando el hilo termina.
+static int iniciada = 0;
+static int nivel_minimo = NIVEL_INFO;
+static uint64_t descartados = 0;
+static uint32_t ultima_sesion = 0;
+static uint64_t vueltas = 0;                 // pasadas completas del hilo de vaciado.
+
+static const char* nombres_nivel[] = { "DEPURACION", "INFO", "AVISO", "ERROR" };
+
+/*!
+ * @brief   Marca como libre el anillo de un hilo que termina.
+ * @param arg Anillo del hilo.
+*/
+static void liberar_anillo(void* arg)
+{
+    Anillo* anillo = arg;
+
+    __atomic_store_n(&anillo->libre, 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * @brief   Devuelve el anillo del hilo actual, tomando uno libre o creando uno nuevo la primera vez.
+ * @return Anillo del hilo, o NULL si no hay memoria.
+*/
+static Anillo* obtener_anillo(void)
+{
+    int libre;
+    Anillo* anillo = NULL;
+
+    if (anillo_propio != NULL)
+    {
+        return anillo_propio;
+    }
+    // reutilizamos el anillo de un hilo terminado; lo que haya dejado se sigue vaciando en orden.
+    for (anillo = __atomic_load_n(&anillos, __ATOMIC_ACQUIRE); anillo != NULL; anillo = anillo->sig)
+    {
+        libre = 1;
+        if (__atomic_compare_exchange_n(&anillo->libre, &libre, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+    if (anillo == NULL)
+    {
+        if ((anillo = calloc(1, sizeof(Anillo))) == NULL)
+        {
+            return NULL;
+        }
+        anillo->sig = __atomic_load_n(&anillos, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&anillos, &anillo->sig, anillo, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+        }
+    }
+    anillo_propio = anillo;
+    pthread_setspecific(clave_anillo, anillo);
+    return anillo;
+}
+
+/*!
+ * @brief   Registra un mensaje ya formateado.
+ * @param nivel Nivel del mensaje.
+ * @param texto Mensaje.
+*/
+static void publicar(int nivel, const char* texto)
+{
+    uint64_t cabeza;
+    Anillo* anillo = NULL;
+    Entrada* entrada = NULL;
+
+    if (!__atomic_load_n(&iniciada, __ATOMIC_ACQUIRE))
+    {
+        fprintf(stderr, "%s %s\n", nombres_nivel[nivel], texto);
+        return;
+    }
+    if ((anillo = obtener_anillo()) == NULL)
+    {
+        __atomic_fetch_add(&descartados, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    cabeza = anillo->cabeza;
+    if (cabeza - __atomic_load_n(&anillo->cola, __ATOMIC_ACQUIRE) >= ANILLO_ENTRADAS)
+    {
+        __atomic_fetch_add(&descartados, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    entrada = &anillo->entradas[cabeza % ANILLO_ENTRADAS];
+    clock_gettime(CLOCK_REALTIME, &entrada->instante);
+    entrada->sesion = sesion_propia;
+    entrada->nivel = nivel;
+    snprintf(entrada->texto, MENSAJE_MAX, "%s", texto);
+    __atomic_store_n(&anillo->cabeza, cabeza + 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * @brief   Quita el salto de linea final de un mensaje, si lo tiene.
+ * @param texto Mensaje.
+*/
+static void quitar_salto(char* texto)
+{
+    size_t largo = strlen(texto);
+
+    if (largo > 0 && texto[largo - 1] == '\n')
+    {
+        texto[largo - 1] = '\0';
+    }
+}
+
+/*!
+ * @brief   Registra un mensaje con formato de printf.
+ *          No toma bloqueos ni escribe: deja el mensaje en el anillo del hilo.
+ * @param nivel   Nivel del mensaje.
+ * @param formato Formato del mensaje, como en printf.
+*/
+void bitacora(int nivel, const char* formato, ...)
+{
+    char texto[MENSAJE_MAX];
+    va_list argumentos;
+
+    if (nivel < nivel_minimo)
+    {
+        return;
+    }
+    va_start(argumentos, formato);
+    vsnprintf(texto, sizeof(texto), formato, argumentos);
+    va_end(argumentos);
+    quitar_salto(texto);
+    publicar(nivel, texto);
+}
+
+/*!
+ * @brief   Registra un mensaje de error seguido de la descripcion de errno, como perror.
+ * @param formato Formato del mensaje, como en printf.
+*/
+void bitacora_error(const char* formato, ...)
+{
+    int error = errno;
+    size_t largo;
+    char texto[MENSAJE_MAX];
+    char descripcion[64];
+    va_list argumentos;
+
+    va_start(argumentos, formato);
+    vsnprintf(texto, sizeof(texto), formato, argumentos);
+    va_end(argumentos);
+    quitar_salto(texto);
+    largo = strlen(texto);
+    if (error != 0 && largo < sizeof(texto))
+    {
+        if (strerror_r(error, descripcion, sizeof(descripcion)) != 0)
+        {
+            snprintf(descripcion, sizeof(descripcion), "errno %d", error);
+        }
+        snprintf(texto + largo, sizeof(texto) - largo, ": %s", descripcion);
+    }
+    publicar(NIVEL_ERROR, texto);
+}
+
+/*!
+ * @brief   Agrega una entrada, con fecha, nivel y sesion, al bloque de salida.
+ * @param salida  Bloque de salida.
+ * @param usados  Bytes ocupados del bloque.
+ * @param entrada Entrada a agregar.
+*/
+static void formatear(char* salida, size_t* usados, const Entrada* entrada)
+{
+    struct tm fecha;
+    char sesion[16] = "-";
+    int escritos;
+
+    localtime_r(&entrada->instante.tv_sec, &fecha);
+    if (entrada->sesion != 0)
+    {
+        snprintf(sesion, sizeof(sesion), "%u", entrada->sesion);
+    }
+    escritos = snprintf(salida + *usados, SALIDA_MAX - *usados, "%04d-%02d-%02d %02d:%02d:%02d.%06ld %-10s sesion=%s %s\n",
+                        fecha.tm_year + 1900, fecha.tm_mon + 1, fecha.tm_mday, fecha.tm_hour, fecha.tm_min, fecha.tm_sec,
+                        entrada->instante.tv_nsec / 1000, nombres_nivel[entrada->nivel], sesion, entrada->texto);
+    if (escritos > 0)
+    {
+        *usados += ((size_t)escritos < SALIDA_MAX - *usados) ? (size_t)escritos : SALIDA_MAX - *usados - 1;
+    }
+}
+
+/*!
+ * @brief   Escribe el bloque de salida completo por la salida estandar.
+ * @param salida Bloque de salida.
+ * @param usados Bytes ocupados del bloque (queda en 0).
+*/
+static void escribir(const char* salida, size_t* usados)
+{
+    size_t hechos = 0;
+    ssize_t escritos;
+
+    while (hechos < *usados)
+    {
+        if ((escritos = write(STDOUT_FILENO, salida + hechos, *usados - hechos)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break; // sin salida no hay a quien avisar.
+        }
+        hechos += escritos;
+    }
+    *usados = 0;
+}
+
+/*!
+ * @brief   Hilo de vaciado: recorre los anillos, escribe sus mensajes y avisa de los descartados.
+ *          Cuando no encuentra mensajes espera cada vez mas (hasta ESPERA_MAX_US), para no ocupar la CPU.
+ * @param arg No se usa.
+ * @return NULL (no termina mientras el servidor este en marcha).
+*/
+static void* vaciar(void* arg)
+{
+    uint64_t cabeza, cola, perdidos, avisados = 0;
+    useconds_t espera = ESPERA_MIN_US;
+    size_t usados = 0;
+    char* salida = malloc(SALIDA_MAX);
+    Anillo* anillo = NULL;
+    Entrada aviso;
+
+    if (salida == NULL)
+    {
+        return NULL;
+    }
+    (void)arg;
+    while (1)
+    {
+        for (anillo = __atomic_load_n(&anillos, __ATOMIC_ACQUIRE); anillo != NULL; anillo = anillo->sig)
+        {
+            cabeza = __atomic_load_n(&anillo->cabeza, __ATOMIC_ACQUIRE);
+            for (cola = anillo->cola; cola != cabeza; cola++)
+            {
+                if (SALIDA_MAX - usados < MENSAJE_MAX + 64)
+                {
+                    escribir(salida, &usados);
+                }
+                formatear(salida, &usados, &anillo->entradas[cola % ANILLO_ENTRADAS]);
+            }
+            __atomic_store_n(&anillo->cola, cola, __ATOMIC_RELEASE);
+        }
+        // avisamos de los mensajes que se perdieron desde el ultimo aviso.
+        if ((perdidos = __atomic_load_n(&descartados, __ATOMIC_RELAXED)) != avisados)
+        {
+            memset(&aviso, 0, sizeof(aviso));
+            clock_gettime(CLOCK_REALTIME, &aviso.instante);
+            aviso.nivel = NIVEL_AVISO;
+            snprintf(aviso.texto, MENSAJE_MAX, "Bitacora: %llu mensajes descartados por anillos llenos (%llu en total).",
+                     (unsigned long long)(perdidos - avisados), (unsigned long long)perdidos);
+            if (SALIDA_MAX - usados < MENSAJE_MAX + 64)
+            {
+                escribir(salida, &usados);
+            }
+            formatear(salida, &usados, &aviso);
+            avisados = perdidos;
+        }
+        if (usados > 0)
+        {
+            escribir(salida, &usados);
+            espera = ESPERA_MIN_US;
+        } else if (espera < ESPERA_MAX_US)
+        {
+            espera *= 2;
+        }
+        __atomic_add_fetch(&vueltas, 1, __ATOMIC_RELEASE);
+        usleep(espera);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief   Inicia la bitacora y el hilo que la vacia por la salida estandar.
+ *          El nivel minimo puede cambiarse con la variable de entorno BITACORA_NIVEL
+ *          (depuracion, info, aviso o error). Antes de iniciarla los mensajes se escriben directo en stderr.
+ * @param nivel Nivel minimo de los mensajes que se registran.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo crear el hilo.
+*/
+int bitacora_iniciar(int nivel)
+{
+    int i;
+    const char* variable = getenv("BITACORA_NIVEL");
+    pthread_t hilo;
+
+    nivel_minimo = nivel;
+    for (i = NIVEL_DEPURACION; variable != NULL && i <= NIVEL_ERROR; i++)
+    {
+        if (strcasecmp(variable, nombres_nivel[i]) == 0)
+        {
+            nivel_minimo = i;
+        }
+    }
+    if (pthread_key_create(&clave_anillo, liberar_anillo) != 0)
+    {
+        return ERROR;
+    }
+    if (pthread_create(&hilo, NULL, vaciar, NULL) != 0)
+    {
+        pthread_key_delete(clave_anillo);
+        return ERROR;
+    }
+    pthread_detach(hilo);
+    __atomic_store_n(&iniciada, 1, __ATOMIC_RELEASE);
+    return OK;
+}
+
+/*!
+ * @brief   Espera a que el hilo de vaciado escriba los mensajes registrados hasta ahora.
+ *          Se usa antes de terminar el programa para no perder los ultimos mensajes.
+*/
+void bitacora_terminar(void)
+{
+    uint64_t inicio;
+
+    if (!__atomic_load_n(&iniciada, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+    // dos pasadas completas aseguran que una empezo despues de esta llamada.
+    inicio = __atomic_load_n(&vueltas, __ATOMIC_ACQUIRE);
+    while (__atomic_load_n(&vueltas, __ATOMIC_ACQUIRE) - inicio < 2)
+    {
+        usleep(ESPERA_MIN_US);
+    }
+}
+
+/*!
+ * @brief   Asigna la sesion del hilo actual, que acompania a todos sus mensajes.
+ * @param sesion Identificador de sesion (0 para ninguna).
+*/
+void bitacora_sesion(uint32_t sesion)
+{
+    sesion_propia = sesion;
+}
+
+/*!
+ * @brief   Devuelve un identificador de sesion nuevo.
+ * @return Identificador mayor que 0.
+*/
+uint32_t bitacora_nueva_sesion(void)
+{
+    return __atomic_add_fetch(&ultima_sesion, 1, __ATOMIC_RELAXED);
+}
+
+/*!
+ * @brief   Devuelve la cantidad de mensajes descartados por anillos llenos.
+ * @return Mensajes descartados desde que inicio el servidor.
+*/
+uint64_t bitacora_descartados(void)
+{
+    return __atomic_load_n(&descartados, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,102 @@
+/*!
+ * @file    bitacora.h
+ * @brief   Definiciones y declaraciones de la bitacora asincronica del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los niveles de los mensajes de la bitacora.
+ *          - Declaraciones de funciones para iniciar la bitacora, identificar la sesion del hilo y registrar mensajes.
+ *          Cada hilo escribe sus mensajes en su propio anillo (un productor y un consumidor, sin bloqueos)
+ *          y un hilo aparte los vacia por la salida estandar con fecha, nivel y sesion. Registrar un mensaje
+ *          nunca espera: si el anillo del hilo esta lleno el mensaje se descarta y se cuenta.
+*/
+
+#ifndef BITACORA_H
+#define BITACORA_H
+
+#include <stdint.h>
+
+/*!
+ * @def NIVEL_DEPURACION
+ * @brief Mensajes de detalle, solo utiles al depurar.
+*/
+#define NIVEL_DEPURACION 0
+
+/*!
+ * @def NIVEL_INFO
+ * @brief Mensajes del funcionamiento normal (conexiones, solicitudes atendidas).
+*/
+#define NIVEL_INFO 1
+
+/*!
+ * @def NIVEL_AVISO
+ * @brief Situaciones anomalas de las que el servidor se recupera.
+*/
+#define NIVEL_AVISO 2
+
+/*!
+ * @def NIVEL_ERROR
+ * @brief Errores de una operacion o de una conexion.
+*/
+#define NIVEL_ERROR 3
+
+/*!
+ * @def ANILLO_ENTRADAS
+ * @brief Mensajes que caben en el anillo de cada hilo (potencia de dos).
+*/
+#define ANILLO_ENTRADAS 256
+
+/*!
+ * @def MENSAJE_MAX
+ * @brief Largo maximo de un mensaje de la bitacora (los mas largos se recortan).
+*/
+#define MENSAJE_MAX 224
+
+/*!
+ * @brief   Inicia la bitacora y el hilo que la vacia por la salida estandar.
+ *          El nivel minimo puede cambiarse con la variable de entorno BITACORA_NIVEL
+ *          (depuracion, info, aviso o error). Antes de iniciarla los mensajes se escriben directo en stderr.
+ * @param nivel Nivel minimo de los mensajes que se registran.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo crear el hilo.
+*/
+int bitacora_iniciar(int nivel);
+
+/*!
+ * @brief   Espera a que el hilo de vaciado escriba los mensajes registrados hasta ahora.
+ *          Se usa antes de terminar el programa para no perder los ultimos mensajes.
+*/
+void bitacora_terminar(void);
+
+/*!
+ * @brief   Asigna la sesion del hilo actual, que acompania a todos sus mensajes.
+ * @param sesion Identificador de sesion (0 para ninguna).
+*/
+void bitacora_sesion(uint32_t sesion);
+
+/*!
+ * @brief   Devuelve un identificador de sesion nuevo.
+ * @return Identificador mayor que 0.
+*/
+uint32_t bitacora_nueva_sesion(void);
+
+/*!
+ * @brief   Registra un mensaje con formato de printf.
+ *          No toma bloqueos ni escribe: deja el mensaje en el anillo del hilo.
+ * @param nivel   Nivel del mensaje.
+ * @param formato Formato del mensaje, como en printf.
+*/
+void bitacora(int nivel, const char* formato, ...) __attribute__((format(printf, 2, 3)));
+
+/*!
+ * @brief   Registra un mensaje de error seguido de la descripcion de errno, como perror.
+ * @param formato Formato del mensaje, como en printf.
+*/
+void bitacora_error(const char* formato, ...) __attribute__((format(printf, 1, 2)));
+
+/*!
+ * @brief   Devuelve la cantidad de mensajes descartados por anillos llenos.
+ * @return Mensajes descartados desde que inicio el servidor.
+*/
+uint64_t bitacora_descartados(void);
+
+#endif
@@ -0,0 +1,273 @@
+/*!
+ * @file    calentador.c
+ * @brief   Calentador de la cache de paginas: carga las canciones mas escuchadas y descarta las frias.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Recuperar y guardar las canciones mas escuchadas en CALENTADOR_ARCHIVO.
+ *          - Publicar el conjunto de canciones calientes sin mutex: los canales lo leen con cargas atomicas.
+ *          - Pedir al sistema que cargue las canciones calientes (readahead o POSIX_FADV_WILLNEED).
+ *          - Descartar las paginas de una cancion fria al terminar de enviarla (POSIX_FADV_DONTNEED).
+ *          - Medir cuanto de las canciones calientes sigue en la cache de una revision a la siguiente.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "popularidad.h"
+#include "calentador.h"
+#include "bitacora.h"
+
+static uint32_t calientes[POPULARIDAD_TOP];    // numeros de las canciones calientes (0 en los lugares libres).
+static uint64_t canciones_calentadas = 0, bytes_calentados = 0, canciones_descartadas = 0;
+static uint64_t paginas_residentes = 0, paginas_totales = 0;    // de la ultima revision, antes de calentar.
+
+/*!
+ * @brief   Indica si una cancion esta entre las calientes. No toma ningun mutex.
+ * @param numero Numero de la cancion.
+ * @return 1 si esta caliente, 0 si no.
+*/
+int calentador_caliente(uint32_t numero)
+{
+    int i;
+
+    for (i = 0; i < POPULARIDAD_TOP; i++)
+    {
+        if (__atomic_load_n(&calientes[i], __ATOMIC_RELAXED) == numero)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * @brief   Recupera la popularidad guardada en CALENTADOR_ARCHIVO antes de reiniciar el servidor.
+*/
+static void recuperar(void)
+{
+    FILE* archivo = fopen(CALENTADOR_ARCHIVO, "r");
+    unsigned int numero, cuenta;
+    int cantidad = 0;
+
+    if (archivo == NULL)
+    {
+        return;
+    }
+    while (cantidad < POPULARIDAD_TOP && fscanf(archivo, "%u %u", &numero, &cuenta) == 2)
+    {
+        popularidad_sembrar(numero, cuenta);
+        cantidad++;
+    }
+    fclose(archivo);
+    bitacora(NIVEL_INFO, "Popularidad recuperada de %s: %d canciones.\n", CALENTADOR_ARCHIVO, cantidad);
+}
+
+/*!
+ * @brief   Guarda las canciones mas escuchadas en CALENTADOR_ARCHIVO. Se escribe aparte y se reemplaza con
+ *          rename, asi una caida a mitad de la escritura no pierde lo guardado antes.
+ * @param populares Canciones mas escuchadas.
+ * @param cantidad  Cantidad de canciones.
+*/
+static void guardar(const Popular* populares, int cantidad)
+{
+    FILE* archivo = fopen(CALENTADOR_ARCHIVO ".nuevo", "w");
+    int i;
+
+    if (archivo == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < cantidad; i++)
+    {
+        fprintf(archivo, "%u %u\n", populares[i].numero, populares[i].cuenta);
+    }
+    if (fclose(archivo) != 0 || rename(CALENTADOR_ARCHIVO ".nuevo", CALENTADOR_ARCHIVO) != 0)
+    {
+        unlink(CALENTADOR_ARCHIVO ".nuevo");
+    }
+}
+
+/*!
+ * @brief   Cuenta las paginas de un archivo que estan en la cache de paginas (con mincore sobre un mapeo
+ *          que no se llega a leer).
+ * @param fd         Descriptor del archivo.
+ * @param tamanio    Tamanio del archivo.
+ * @param residentes Paginas en la cache; se suman las del archivo.
+ * @param totales    Paginas del archivo; se suman las del archivo.
+*/
+static void contar_residentes(int fd, off_t tamanio, long long* residentes, long long* totales)
+{
+    long pagina = sysconf(_SC_PAGESIZE);
+    size_t i, paginas = (tamanio + pagina - 1) / pagina;
+    unsigned char* vector;
+    void* mapa;
+
+    if (tamanio == 0 || (vector = malloc(paginas)) == NULL)
+    {
+        return;
+    }
+    if ((mapa = mmap(NULL, tamanio, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED)
+    {
+        if (mincore(mapa, tamanio, vector) == 0)
+        {
+            for (i = 0; i < paginas; i++)
+            {
+                *residentes += vector[i] & 1;
+            }
+            *totales += paginas;
+        }
+        munmap(mapa, tamanio);
+    }
+    free(vector);
+}
+
+/*!
+ * @brief   Pide al sistema que cargue una cancion en memoria.
+ *          readahead lee el archivo en la cache de paginas sin copiarlo (si ya esta, vuelve enseguida); se pide
+ *          de a CALENTADOR_PASO bytes porque cada llamada se corta en el maximo de lectura anticipada del disco.
+ *          Antes se cuenta cuanto de la cancion seguia en la cache desde la revision anterior.
+ * @param numero     Numero de la cancion.
+ * @param bytes      Bytes ya cargados en esta revision; se suma el tamanio de la cancion.
+ * @param residentes Paginas de las canciones calientes que seguian en la cache.
+ * @param totales    Paginas de las canciones calientes.
+ * @return 1 si se pidio cargarla, 0 si no tiene archivo o no entra en CALENTADOR_BYTES_MAX.
+*/
+static int calentar(uint32_t numero, long long* bytes, long long* residentes, long long* totales)
+{
+    Archivo archivo;
+    struct stat datos;
+    off_t posicion;
+    int estado = 0;
+
+    if (archivos_abrir(numero, &archivo) != OK)
+    {
+        return 0;
+    }
+    if (fstat(archivo.fd, &datos) == 0 && *bytes + datos.st_size <= CALENTADOR_BYTES_MAX)
+    {
+        contar_residentes(archivo.fd, datos.st_size, residentes, totales);
+        for (posicion = 0; posicion < datos.st_size; posicion += CALENTADOR_PASO)
+        {
+            if (readahead(archivo.fd, posicion, CALENTADOR_PASO) != 0)
+            {
+                posix_fadvise(archivo.fd, posicion, 0, POSIX_FADV_WILLNEED);
+                break;
+            }
+        }
+        *bytes += datos.st_size;
+        __atomic_fetch_add(&canciones_calentadas, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bytes_calentados, datos.st_size, __ATOMIC_RELAXED);
+        estado = 1;
+    }
+    archivos_soltar(&archivo);
+    return estado;
+}
+
+/*!
+ * @brief   Hilo del calentador: recupera la popularidad guardada y, cada CALENTADOR_PERIODO segundos,
+ *          publica las canciones calientes, las carga en memoria y guarda la lista.
+ * @param arg No se usa.
+ * @return NULL (no termina mientras el servidor este en marcha).
+*/
+static void* calentar_periodicamente(void* arg)
+{
+    Popular populares[POPULARIDAD_TOP];
+    int i, cantidad, cargadas;
+    long long bytes, residentes, totales;
+
+    (void)arg;
+    recuperar();
+    while (1)
+    {
+        cantidad = popularidad_top(populares);
+        bytes = residentes = totales = 0;
+        cargadas = 0;
+        for (i = 0; i < POPULARIDAD_TOP; i++)
+        {
+            // las mas escuchadas primero: si no entran todas, quedan afuera las de menos reproducciones.
+            if (i < cantidad && populares[i].cuenta >= CALENTADOR_MINIMO && calentar(populares[i].numero, &bytes, &residentes, &totales))
+            {
+                __atomic_store_n(&calientes[cargadas++], populares[i].numero, __ATOMIC_RELAXED);
+            }
+        }
+        for (i = cargadas; i < POPULARIDAD_TOP; i++)
+        {
+            __atomic_store_n(&calientes[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&paginas_residentes, residentes, __ATOMIC_RELAXED);
+        __atomic_store_n(&paginas_totales, totales, __ATOMIC_RELAXED);
+        if (cantidad > 0)
+        {
+            guardar(populares, cantidad);
+        }
+        bitacora(NIVEL_DEPURACION, "Calentador: %d canciones calientes, %lld bytes.\n", cargadas, bytes);
+        sleep(CALENTADOR_PERIODO);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief   Recupera la popularidad guardada y crea el hilo del calentador.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo crear el hilo.
+*/
+int calentador_iniciar(void)
+{
+    pthread_t hilo;
+
+    if (pthread_create(&hilo, NULL, calentar_periodicamente, NULL) != 0)
+    {
+        return ERROR;
+    }
+    pthread_detach(hilo);
+    return OK;
+}
+
+/*!
+ * @brief   Avisa que se termino de enviar un archivo. Si la cancion no esta caliente y nadie mas la esta
+ *          leyendo, descarta sus paginas de la cache. No toma mutex salvo el de la tabla de archivos.
+ *          Se llama antes de soltar el archivo.
+ * @param archivo Archivo enviado, abierto con archivos_abrir().
+*/
+void calentador_enviado(const Archivo* archivo)
+{
+    if (calentador_caliente(archivo->numero) || archivos_usos(archivo) > 1)
+    {
+        return;
+    }
+    posix_fadvise(archivo->fd, 0, 0, POSIX_FADV_DONTNEED);
+    __atomic_fetch_add(&canciones_descartadas, 1, __ATOMIC_RELAXED);
+}
+
+/*!
+ * @brief   Devuelve los contadores del calentador.
+ * @param calentadas Canciones que se pidieron cargar en memoria.
+ * @param bytes      Bytes que se pidieron cargar.
+ * @param descartadas Canciones frias cuyas paginas se descartaron despues de enviarlas.
+*/
+void calentador_contadores(uint64_t* calentadas, uint64_t* bytes, uint64_t* descartadas)
+{
+    *calentadas = __atomic_load_n(&canciones_calentadas, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&bytes_calentados, __ATOMIC_RELAXED);
+    *descartadas = __atomic_load_n(&canciones_descartadas, __ATOMIC_RELAXED);
+}
+
+/*!
+ * @brief   Devuelve cuantas paginas de las canciones calientes seguian en la cache de paginas en la ultima
+ *          revision, antes de volver a cargarlas: mide cuanto las desplazaron las demas descargas.
+ * @param residentes Paginas que seguian en la cache.
+ * @param totales    Paginas de las canciones calientes.
+*/
+void calentador_residencia(uint64_t* residentes, uint64_t* totales)
+{
+    *residentes = __atomic_load_n(&paginas_residentes, __ATOMIC_RELAXED);
+    *totales = __atomic_load_n(&paginas_totales, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,94 @@
+/*!
+ * @file    calentador.h
+ * @brief   Definiciones y declaraciones del calentador de la cache de paginas de las canciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros del calentador.
+ *          - Declaraciones de funciones para iniciarlo, consultarlo al terminar un envio y leer sus contadores.
+ *          Un hilo aparte revisa cada CALENTADOR_PERIODO segundos las canciones mas escuchadas (ver popularidad.h)
+ *          y le pide al sistema que las cargue en memoria (readahead, o posix_fadvise con POSIX_FADV_WILLNEED si
+ *          no se puede), hasta CALENTADOR_BYTES_MAX bytes: una vez calentada, las descargas de una cancion de moda
+ *          no esperan al disco. Al terminar de enviar una cancion que no esta entre las calientes, y si nadie mas la esta
+ *          leyendo, el canal avisa con POSIX_FADV_DONTNEED que sus paginas ya no hacen falta, asi la cache guarda
+ *          las canciones que se piden y no las ultimas que se descargaron.
+ *          Las mas escuchadas se guardan en CALENTADOR_ARCHIVO: al reiniciar el servidor el hilo del calentador
+ *          recupera su popularidad y las calienta en su primera revision, en segundo plano; las descargas que
+ *          llegan antes no lo esperan y pueden leer del disco.
+ *          Las canciones que no estan calientes y son grandes se leen sin pasar por la cache (ver directo.h).
+*/
+
+#ifndef CALENTADOR_H
+#define CALENTADOR_H
+
+#include <stdint.h>
+#include "archivos.h"
+
+/*!
+ * @def CALENTADOR_PERIODO
+ * @brief Segundos entre dos revisiones de las canciones mas escuchadas.
+*/
+#define CALENTADOR_PERIODO 10
+
+/*!
+ * @def CALENTADOR_MINIMO
+ * @brief Reproducciones estimadas desde las que una cancion se considera caliente.
+*/
+#define CALENTADOR_MINIMO 2
+
+/*!
+ * @def CALENTADOR_BYTES_MAX
+ * @brief Bytes de canciones calientes que se cargan como maximo, para no desplazar todo lo demas de la cache.
+*/
+#define CALENTADOR_BYTES_MAX (512LL * 1024 * 1024)
+
+/*!
+ * @def CALENTADOR_PASO
+ * @brief Bytes que se piden cargar en cada llamada a readahead.
+*/
+#define CALENTADOR_PASO (2 * 1024 * 1024)
+
+/*!
+ * @def CALENTADOR_ARCHIVO
+ * @brief Archivo donde se guardan las canciones mas escuchadas ("numero reproducciones" por linea).
+*/
+#define CALENTADOR_ARCHIVO "media.pop"
+
+/*!
+ * @brief   Recupera la popularidad guardada y crea el hilo del calentador.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo crear el hilo.
+*/
+int calentador_iniciar(void);
+
+/*!
+ * @brief   Indica si una cancion esta entre las calientes. No toma ningun mutex.
+ * @param numero Numero de la cancion.
+ * @return 1 si esta caliente, 0 si no.
+*/
+int calentador_caliente(uint32_t numero);
+
+/*!
+ * @brief   Avisa que se termino de enviar un archivo. Si la cancion no esta caliente y nadie mas la esta
+ *          leyendo, descarta sus paginas de la cache. No toma mutex salvo el de la tabla de archivos.
+ *          Se llama antes de soltar el archivo.
+ * @param archivo Archivo enviado, abierto con archivos_abrir().
+*/
+void calentador_enviado(const Archivo* archivo);
+
+/*!
+ * @brief   Devuelve los contadores del calentador.
+ * @param calentadas Canciones que se pidieron cargar en memoria.
+ * @param bytes      Bytes que se pidieron cargar.
+ * @param descartadas Canciones frias cuyas paginas se descartaron despues de enviarlas.
+*/
+void calentador_contadores(uint64_t* calentadas, uint64_t* bytes, uint64_t* descartadas);
+
+/*!
+ * @brief   Devuelve cuantas paginas de las canciones calientes seguian en la cache de paginas en la ultima
+ *          revision, antes de volver a cargarlas: mide cuanto las desplazaron las demas descargas.
+ * @param residentes Paginas que seguian en la cache.
+ * @param totales    Paginas de las canciones calientes.
+*/
+void calentador_residencia(uint64_t* residentes, uint64_t* totales);
+
+#endif
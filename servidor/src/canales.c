@@ -0,0 +1,327 @@
+/*!
+ * @file    canales.c
+ * @brief   Canales de descarga multiplexados sobre la conexion con un cliente.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Abrir un canal por cada cancion o lote pedido y enviarlo desde un hilo propio.
+ *          - Respetar la ventana de cada canal, que el cliente agranda a medida que consume datos.
+ *          - Cerrar los canales de una conexion que finaliza.
+ *          Mientras los canales envian, el hilo del cliente sigue atendiendo listados y filtros;
+ *          el planificador de salida reparte el ancho de banda entre todos ellos.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "canales.h"
+#include "protocolo.h"
+#include "canciones.h"
+#include "estadisticas.h"
+#include "calentador.h"
+#include "directo.h"
+#include "bitacora.h"
+#include "sondas.h"
+
+/*!
+ * @brief   Quita un canal de la lista de su conexion y libera sus recursos.
+ *          Debe llamarse con canales_mutex tomado.
+ * @param canal Canal a liberar.
+*/
+static void liberar_canal(Canal* canal)
+{
+    Conexion* conexion = canal->conexion;
+    Canal** actual = &conexion->canales;
+
+    while (*actual != NULL && *actual != canal)
+    {
+        actual = &(*actual)->sig;
+    }
+    if (*actual != NULL)
+    {
+        *actual = canal->sig;
+    }
+    conexion->cantidad_canales--;
+    pthread_cond_broadcast(&conexion->canales_cond);
+    for (; canal->actual < canal->cantidad; canal->actual++)
+    {
+        archivos_soltar(&canal->archivos[canal->actual]);
+    }
+    free(canal->archivos);
+    free(canal->bloque);
+    free(canal);
+}
+
+/*!
+ * @brief   Envia por el canal el archivo actual, en tramas de datos.
+ *          Cada trama se limita al bloque de la conexion y a la ventana disponible del canal.
+ *          Se lee con pread porque otras descargas de la misma cancion comparten el descriptor; las canciones
+ *          frias grandes se leen con O_DIRECT (ver directo.h), asi no desplazan de la cache a las calientes.
+ * @param canal Canal por el que se envia.
+ * @param flujo Flujo del planificador del canal.
+ * @return OK(0) si se envia el archivo completo, ERROR(-1) si se cierra la conexion, se cancela el canal o
+ *         falla el envio.
+*/
+static int enviar_archivo(Canal* canal, Flujo* flujo)
+{
+    Conexion* conexion = canal->conexion;
+    const Archivo* archivo = &canal->archivos[canal->actual];
+    const char* datos = canal->bloque;
+    Directo directo;
+    int directa, estado = OK;
+    size_t maximo;
+    ssize_t leidos;
+
+    directa = !calentador_caliente(archivo->numero) && directo_abrir(archivo, canal->posicion, &directo) == OK;
+    while (estado == OK)
+    {
+        // esperamos ventana disponible para el canal.
+        maximo = transporte_bloque(conexion);
+        pthread_mutex_lock(&conexion->canales_mutex);
+        while (canal->ventana <= 0 && !conexion->cerrada && !canal->cancelado)
+        {
+            pthread_cond_wait(&conexion->canales_cond, &conexion->canales_mutex);
+        }
+        if (conexion->cerrada || canal->cancelado)
+        {
+            pthread_mutex_unlock(&conexion->canales_mutex);
+            estado = ERROR;
+            break;
+        }
+        if ((size_t)canal->ventana < maximo)
+        {
+            maximo = canal->ventana;
+        }
+        pthread_mutex_unlock(&conexion->canales_mutex);
+        leidos = directa ? directo_leer(&directo, maximo, &datos) : pread(archivo->fd, canal->bloque, maximo, canal->posicion);
+        if (leidos <= 0)
+        {
+            if (leidos < 0)
+            {
+                bitacora_error("Error al leer archivo de cancion.\n");
+                estado = ERROR;
+            }
+            break;
+        }
+        canal->posicion += leidos;
+        planificador_esperar(flujo, leidos); // esperamos turno de envio.
+        if (transporte_enviar(conexion, canal->id, RESP_DATOS, datos, leidos) != OK)
+        {
+            bitacora_error("Error al enviar datos del archivo.\n");
+            estado = ERROR;
+            break;
+        }
+        canal->enviados += leidos;
+        SONDA3(descarga_bloque, conexion->sesion, canal->id, leidos);
+        pthread_mutex_lock(&conexion->canales_mutex);
+        canal->ventana -= leidos;
+        pthread_mutex_unlock(&conexion->canales_mutex);
+    }
+    if (directa)
+    {
+        directo_cerrar(&directo);
+    }
+    return estado;
+}
+
+/*!
+ * @brief   Hilo de un canal: envia sus archivos uno detras de otro y luego la trama de fin.
+ *          Si el cliente cancela el canal, termina sin trama de fin. En un lote cada archivo va precedido de una trama RESP_ARCHIVO con su nombre, y la
+ *          trama de fin informa cuantas canciones se enviaron.
+ * @param arg Canal a enviar.
+ * @return NULL al finalizar.
+*/
+static void* enviar_canal(void* arg)
+{
+    Canal* canal = arg;
+    Conexion* conexion = canal->conexion;
+    int estado = OK, enviadas = 0;
+    char nombre[32];
+    char resumen[BUFFER_SIZE] = "";
+    Flujo flujo;
+
+    bitacora_sesion(conexion->sesion);
+    flujo_iniciar(&flujo, &conexion->cubeta, canal->precarga ? PESO_PRECARGA : PESO_DESCARGA);
+    while (canal->actual < canal->cantidad && estado == OK)
+    {
+        snprintf(nombre, sizeof(nombre), ARCHIVOS_FORMATO, canal->archivos[canal->actual].numero);
+        if (canal->lote && transporte_enviar_texto(conexion, canal->id, RESP_ARCHIVO, nombre) != OK)
+        {
+            estado = ERROR;
+        } else
+        {
+            estado = enviar_archivo(canal, &flujo);
+        }
+        calentador_enviado(&canal->archivos[canal->actual]);
+        archivos_soltar(&canal->archivos[canal->actual++]);
+        canal->posicion = 0;
+        enviadas += (estado == OK);
+    }
+    // enviar indicador de fin de transmision.
+    if (canal->lote)
+    {
+        snprintf(resumen, sizeof(resumen), "Lote finalizado: %d de %d canciones enviadas.", enviadas, canal->solicitadas);
+    }
+    if (estado == OK && transporte_enviar_texto(conexion, canal->id, RESP_FIN, resumen) != OK)
+    {
+        bitacora_error("Error al enviar indicador de fin de transmision.\n");
+    }
+    flujo_finalizar(&flujo);
+    SONDA3(descarga_fin, conexion->sesion, canal->id, canal->enviados);
+    pthread_mutex_lock(&conexion->canales_mutex);
+    // una descarga que el cliente cancelo no cuenta como fallida.
+    estadisticas_registrar(canal->lote ? OP_LOTE : OP_DESCARGA, estadisticas_ahora() - canal->inicio, estado == OK || canal->cancelado, canal->enviados);
+    liberar_canal(canal);
+    pthread_mutex_unlock(&conexion->canales_mutex);
+    return NULL;
+}
+
+/*!
+ * @brief   Abre un canal de descarga y comienza a enviar los archivos en segundo plano.
+ *          Si ya hay CANALES_MAX canales abiertos responde con RESP_ERROR.
+ * @param conexion    Conexion del cliente.
+ * @param id          Identificador de la solicitud que abre el canal.
+ * @param archivos    Archivos abiertos con archivos_abrir(), en el orden de envio (se copian y el canal
+ *                    los suelta; si el canal no se abre, se sueltan antes de volver).
+ * @param cantidad    Cantidad de archivos (1 a LOTE_MAX).
+ * @param solicitadas Cantidad de canciones pedidas, para informar las que faltaron al terminar un lote.
+ * @param lote        1 si responde a SOL_LOTE, 0 si responde a SOL_CANCION, SOL_DESDE o SOL_PRECARGA.
+ * @param precarga    1 si responde a SOL_PRECARGA.
+ * @param desde       Byte del primer archivo desde el que se envia (0 salvo para SOL_DESDE).
+ * @return OK(0) si la conexion puede seguir, ERROR(-1) si ocurre un problema de comunicacion.
+*/
+int canal_abrir(Conexion* conexion, uint32_t id, const Archivo* archivos, int cantidad, int solicitadas, int lote, int precarga, off_t desde)
+{
+    int i;
+    Canal* canal = NULL;
+    pthread_t hilo;
+
+    pthread_mutex_lock(&conexion->canales_mutex);
+    if (conexion->cantidad_canales >= CANALES_MAX)
+    {
+        pthread_mutex_unlock(&conexion->canales_mutex);
+        for (i = 0; i < cantidad; i++)
+        {
+            archivos_soltar(&archivos[i]);
+        }
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_CANALES);
+    }
+    if ((canal = calloc(1, sizeof(Canal))) == NULL || (canal->bloque = malloc(BLOQUE_MAX)) == NULL
+        || (canal->archivos = malloc(cantidad * sizeof(Archivo))) == NULL)
+    {
+        pthread_mutex_unlock(&conexion->canales_mutex);
+        bitacora_error("Error al reservar memoria para el canal.\n");
+        if (canal != NULL)
+        {
+            free(canal->bloque);
+        }
+        free(canal);
+        for (i = 0; i < cantidad; i++)
+        {
+            archivos_soltar(&archivos[i]);
+        }
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_ABRIR_CANCION);
+    }
+    memcpy(canal->archivos, archivos, cantidad * sizeof(Archivo));
+    canal->id = id;
+    canal->cantidad = cantidad;
+    canal->solicitadas = solicitadas;
+    canal->lote = lote;
+    canal->precarga = precarga;
+    canal->actual = 0;
+    canal->posicion = desde;
+    canal->ventana = precarga ? PRECARGA_VENTANA : VENTANA_INICIAL;
+    canal->inicio = estadisticas_ahora();
+    canal->enviados = 0;
+    canal->conexion = conexion;
+    canal->sig = conexion->canales;
+    if (conexion->canales == NULL) // primer canal tras un periodo inactivo.
+    {
+        transporte_reiniciar_medicion(conexion);
+    }
+    conexion->canales = canal;
+    conexion->cantidad_canales++;
+    if (pthread_create(&hilo, NULL, enviar_canal, canal) != 0)
+    {
+        bitacora_error("Error al crear hilo del canal.\n");
+        liberar_canal(canal);
+        pthread_mutex_unlock(&conexion->canales_mutex);
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_ABRIR_CANCION);
+    }
+    pthread_detach(hilo);
+    pthread_mutex_unlock(&conexion->canales_mutex);
+    return OK;
+}
+
+/*!
+ * @brief   Agranda la ventana de un canal con los bytes que el cliente ya consumio.
+ *          Si el canal ya termino la actualizacion se ignora.
+ * @param conexion   Conexion del cliente.
+ * @param id         Identificador del canal.
+ * @param incremento Bytes que se devuelven a la ventana (la ventana no pasa de VENTANA_MAX).
+*/
+void canal_ventana(Conexion* conexion, uint32_t id, uint32_t incremento)
+{
+    Canal* canal = NULL;
+
+    pthread_mutex_lock(&conexion->canales_mutex);
+    for (canal = conexion->canales; canal != NULL; canal = canal->sig)
+    {
+        if (canal->id == id)
+        {
+            // un cliente que devuelve de mas no puede desbordar la ventana.
+            canal->ventana = ((long long)canal->ventana + incremento > VENTANA_MAX) ? VENTANA_MAX
+                                                                                    : canal->ventana + (long)incremento;
+            pthread_cond_broadcast(&conexion->canales_cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&conexion->canales_mutex);
+}
+
+/*!
+ * @brief   Cancela un canal: su hilo deja de enviar y termina sin trama de fin.
+ *          Si el canal ya termino la cancelacion se ignora.
+ * @param conexion Conexion del cliente.
+ * @param id       Identificador del canal.
+*/
+void canal_cancelar(Conexion* conexion, uint32_t id)
+{
+    Canal* canal = NULL;
+
+    pthread_mutex_lock(&conexion->canales_mutex);
+    for (canal = conexion->canales; canal != NULL; canal = canal->sig)
+    {
+        if (canal->id == id)
+        {
+            canal->cancelado = 1;
+            pthread_cond_broadcast(&conexion->canales_cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&conexion->canales_mutex);
+}
+
+/*!
+ * @brief   Cierra todos los canales de la conexion y espera a que sus hilos terminen.
+ *          Apaga el socket para que los envios bloqueados fallen en lugar de esperar al cliente.
+ * @param conexion Conexion del cliente.
+*/
+void canales_cerrar(Conexion* conexion)
+{
+    pthread_mutex_lock(&conexion->canales_mutex);
+    conexion->cerrada = 1;
+    if (conexion->canales != NULL)
+    {
+        shutdown(conexion->sock, SHUT_RDWR);
+    }
+    pthread_cond_broadcast(&conexion->canales_cond);
+    while (conexion->canales != NULL)
+    {
+        pthread_cond_wait(&conexion->canales_cond, &conexion->canales_mutex);
+    }
+    pthread_mutex_unlock(&conexion->canales_mutex);
+}
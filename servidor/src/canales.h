@@ -0,0 +1,110 @@
+/*!
+ * @file    canales.h
+ * @brief   Definiciones y declaraciones de los canales de descarga multiplexados sobre una conexion.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - La estructura Canal, con el estado de una descarga en curso.
+ *          - Declaraciones de funciones para abrir canales, actualizar su ventana y cerrarlos.
+ *          Un canal envia una cancion o un lote de canciones, una detras de otra.
+ *          Cada canal envia sus archivos desde un hilo propio, intercalando sus tramas con las de
+ *          otros canales y respuestas de la misma conexion, y nunca envia mas bytes que la ventana
+ *          concedida por el cliente (ver SOL_VENTANA en protocolo.h).
+*/
+
+#ifndef CANALES_H
+#define CANALES_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "transporte.h"
+#include "archivos.h"
+
+/*!
+ * @def CANALES_MAX
+ * @brief Cantidad maxima de descargas simultaneas por conexion.
+*/
+#define CANALES_MAX 8
+
+/*!
+ * @def LOTE_MAX
+ * @brief Cantidad maxima de canciones en un lote.
+*/
+#define LOTE_MAX 64
+
+/*!
+ * @def ERROR_CANALES
+ * @brief Mensaje de error al superar la cantidad de descargas simultaneas.
+*/
+#define ERROR_CANALES "Demasiadas descargas en curso."
+
+/*!
+ * @def VENTANA_MAX
+ * @brief Bytes que puede acumular la ventana de un canal; las actualizaciones que la superan se recortan.
+*/
+#define VENTANA_MAX INT32_MAX
+
+/*!
+ * @struct Canal
+ * @brief Estado de una descarga en curso dentro de una conexion.
+*/
+typedef struct Canal
+{
+    uint32_t id;          /**< Identificador del canal (id de la solicitud SOL_CANCION o SOL_LOTE). */
+    Archivo* archivos;    /**< Archivos a enviar, en el orden de envio (el canal los suelta al enviarlos). */
+    int cantidad;         /**< Cantidad de archivos a enviar. */
+    int solicitadas;      /**< Cantidad de canciones pedidas (incluye las inexistentes). */
+    int lote;             /**< 1 si responde a SOL_LOTE (cada archivo va precedido de RESP_ARCHIVO). */
+    int precarga;         /**< 1 si responde a SOL_PRECARGA (ventana inicial chica y peso PESO_PRECARGA). */
+    int cancelado;        /**< 1 si el cliente lo cancelo con SOL_CANCELAR. */
+    int actual;           /**< Archivo que se esta enviando; los anteriores ya se soltaron. */
+    off_t posicion;       /**< Proximo byte a leer del archivo actual. */
+    char* bloque;         /**< Buffer de lectura propio del canal (BLOQUE_MAX bytes). */
+    long ventana;         /**< Bytes que el cliente todavia acepta por este canal. */
+    double inicio;        /**< Instante en que se abrio el canal (ver estadisticas_ahora()). */
+    uint64_t enviados;    /**< Bytes de datos enviados por el canal. */
+    Conexion* conexion;   /**< Conexion a la que pertenece el canal. */
+    struct Canal* sig;    /**< Siguiente canal abierto de la conexion. */
+} Canal;
+
+/*!
+ * @brief   Abre un canal de descarga y comienza a enviar los archivos en segundo plano.
+ *          Si ya hay CANALES_MAX canales abiertos responde con RESP_ERROR.
+ * @param conexion    Conexion del cliente.
+ * @param id          Identificador de la solicitud que abre el canal.
+ * @param archivos    Archivos abiertos con archivos_abrir(), en el orden de envio (se copian y el canal
+ *                    los suelta; si el canal no se abre, se sueltan antes de volver).
+ * @param cantidad    Cantidad de archivos (1 a LOTE_MAX).
+ * @param solicitadas Cantidad de canciones pedidas, para informar las que faltaron al terminar un lote.
+ * @param lote        1 si responde a SOL_LOTE, 0 si responde a SOL_CANCION, SOL_DESDE o SOL_PRECARGA.
+ * @param precarga    1 si responde a SOL_PRECARGA.
+ * @param desde       Byte del primer archivo desde el que se envia (0 salvo para SOL_DESDE).
+ * @return OK(0) si la conexion puede seguir, ERROR(-1) si ocurre un problema de comunicacion.
+*/
+int canal_abrir(Conexion* conexion, uint32_t id, const Archivo* archivos, int cantidad, int solicitadas, int lote, int precarga, off_t desde);
+
+/*!
+ * @brief   Agranda la ventana de un canal con los bytes que el cliente ya consumio.
+ *          Si el canal ya termino la actualizacion se ignora.
+ * @param conexion   Conexion del cliente.
+ * @param id         Identificador del canal.
+ * @param incremento Bytes que se devuelven a la ventana (la ventana no pasa de VENTANA_MAX).
+*/
+void canal_ventana(Conexion* conexion, uint32_t id, uint32_t incremento);
+
+/*!
+ * @brief   Cancela un canal: su hilo deja de enviar y termina sin trama de fin.
+ *          Si el canal ya termino la cancelacion se ignora.
+ * @param conexion Conexion del cliente.
+ * @param id       Identificador del canal.
+*/
+void canal_cancelar(Conexion* conexion, uint32_t id);
+
+/*!
+ * @brief   Cierra todos los canales de la conexion y espera a que sus hilos terminen.
+ *          Apaga el socket para que los envios bloqueados fallen en lugar de esperar al cliente.
+ * @param conexion Conexion del cliente.
+*/
+void canales_cerrar(Conexion* conexion);
+
+#endif
@@ -4,332 +4,850 @@
  * @author  Grupo 3
  * @date    18/12/2024
  * @details Este archivo implementa las funciones necesarias para:
- *          - Mostrar un menu de opciones al cliente.
+ *          - Atender las solicitudes de canciones recibidas del cliente.
  *          - Listar las canciones disponibles.
  *          - Filtrar canciones por artista o genero.
- *          - Enviar canciones solicitadas por los clientes.
+ *          - Sincronizar la copia local del catalogo de los clientes, enviando solo lo que cambio.
+ *          - Enviar canciones solicitadas por los clientes, cada una por su propio canal, desde el principio o desde un instante.
+ *          - Enviar lotes de canciones en un solo canal, ordenadas por su ubicacion en disco.
+ *          Cada respuesta se envia en tramas con el id de la solicitud (ver protocolo.h).
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <sys/socket.h>
+#include <limits.h>
+#include <stdint.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#include "transporte.h"
+#include "protocolo.h"
+#include "canales.h"
+#include "avisos.h"
 #include "canciones.h"
+#include "estadisticas.h"
+#include "marcos.h"
+#include "popularidad.h"
+#include "catalogo.h"
+#include "consulta.h"
+#include "trigramas.h"
+#include "archivos.h"
+#include "bitacora.h"
+#include "sondas.h"
 
 /*!
- * @brief   Menu principal del servidor para gestionar opciones de canciones.
- *          Recibe las opciones seleccionadas por el cliente y llama a las funciones correspondientes
- *          para listar, filtrar o enviar canciones.
- * @param client_sock Descriptor del socket del cliente conectado.
- * @param buffer      Buffer utilizado para enviar y recibir datos.
+ * @brief   Envia como una trama de datos las filas acumuladas en el bloque de la conexion.
+ * @param conexion Estado de la conexion.
+ * @param flujo    Flujo del planificador con el que se envia.
+ * @param id       Identificador de la solicitud.
+ * @param usados   Bytes acumulados en el bloque; se pone en 0 al enviar.
+ * @return OK(0) si se envia, ERROR(-1) si ocurre un problema.
 */
-void menu_canciones_servidor(int client_sock, char* buffer)
+static int enviar_filas(Conexion* conexion, Flujo* flujo, uint32_t id, size_t* usados)
 {
-    int opcion, estado;
-    ssize_t bytes_received;
+    if (*usados == 0)
+    {
+        return OK;
+    }
+    planificador_esperar(flujo, *usados); // esperamos turno de envio.
+    if (transporte_enviar(conexion, id, RESP_DATOS, conexion->bloque, *usados) != OK)
+    {
+        bitacora_error("Error al enviar filas.\n");
+        return ERROR;
+    }
+    *usados = 0;
+    return OK;
+}
 
-    do
+/*!
+ * @brief   Agrega una fila al bloque de la conexion, enviando el bloque si ya no entra.
+ * @param conexion Estado de la conexion.
+ * @param flujo    Flujo del planificador con el que se envia.
+ * @param id       Identificador de la solicitud.
+ * @param usados   Bytes acumulados en el bloque.
+ * @param fila     Fila a agregar.
+ * @return OK(0) si se agrega, ERROR(-1) si ocurre un problema al enviar.
+*/
+static int agregar_fila(Conexion* conexion, Flujo* flujo, uint32_t id, size_t* usados, const char* fila)
+{
+    size_t largo = strlen(fila);
+
+    if (*usados + largo > transporte_bloque(conexion) && enviar_filas(conexion, flujo, id, usados) != OK)
     {
-        // recibir opcion del cliente.
-        if ((bytes_received = recv(client_sock, buffer, BUFFER_SIZE, 0)) < 0)
-        {
-            perror("Error al recibir opcion del cliente.\n");
-            break;
-        } else if (bytes_received == 0)
-        {
-            printf("Conexion finalizada por el cliente.\n");
-            break;
-        }
-        buffer[bytes_received] = '\0'; // otorgamos fin de linea al buffer.
-        opcion = atoi(buffer);
-        switch (opcion) // procesamos opcion elegida.
+        return ERROR;
+    }
+    memcpy(conexion->bloque + *usados, fila, largo);
+    *usados += largo;
+    return OK;
+}
+
+/*!
+ * @brief   Atiende una solicitud de canciones del cliente.
+ *          Segun el tipo de solicitud llama a la funcion correspondiente para listar, filtrar o enviar canciones.
+ * @param conexion Estado de la conexion con el cliente.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de solicitud (SOL_LISTAR, SOL_FILTRAR, SOL_CATALOGO, SOL_SUSCRIBIR, SOL_CANCION, SOL_DESDE,
+ *                 SOL_LOTE, SOL_PRECARGA, SOL_DESCRIPTOR, SOL_VENTANA o SOL_CANCELAR).
+ * @param carga    Carga util de la solicitud.
+ * @param longitud Bytes de la carga util (SOL_VENTANA lleva exactamente 4).
+ * @return OK(0) si la conexion puede seguir, ERROR(-1) si ocurre un problema de comunicacion.
+*/
+int atender_solicitud_canciones(Conexion* conexion, uint32_t id, uint8_t tipo, char* carga, uint32_t longitud)
+{
+    int estado;
+    double inicio;
+    uint32_t incremento;
+
+    switch (tipo) // procesamos solicitud recibida.
+    {
+        case SOL_LISTAR:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Listar canciones.\n");
+            inicio = estadisticas_ahora();
+            // sin carga (o con ORDEN_ARCHIVO) se lista en el orden del archivo.
+            if (atoi(carga) == ORDEN_POPULARES)
+            {
+                estado = listar_populares_servidor(conexion, id);
+            } else
+            {
+                estado = (atoi(carga) == ORDEN_ARCHIVO) ? listar_servidor(conexion, id) : listar_ordenado_servidor(conexion, id, atoi(carga));
+            }
+            estadisticas_registrar(OP_LISTAR, estadisticas_ahora() - inicio, estado == OK, 0);
+            return estado;
+        case SOL_FILTRAR:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Filtrar canciones.\n");
+            inicio = estadisticas_ahora();
+            estado = menu_filtrar_servidor(conexion, id, carga);
+            estadisticas_registrar(OP_FILTRAR, estadisticas_ahora() - inicio, estado == OK, 0);
+            return estado;
+        case SOL_CATALOGO:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Sincronizar catalogo.\n");
+            return sincronizar_catalogo_servidor(conexion, id, carga);
+        case SOL_SUSCRIBIR:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Suscribirse a los cambios del catalogo.\n");
+            return avisos_suscribir(conexion, id);
+        case SOL_CANCION:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Escuchar cancion.\n");
+            return escuchar_cancion_servidor(conexion, id, carga, 0);
+        case SOL_PRECARGA:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Precargar cancion.\n");
+            return escuchar_cancion_servidor(conexion, id, carga, 1);
+        case SOL_DESDE:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Escuchar cancion desde un instante.\n");
+            return escuchar_desde_servidor(conexion, id, carga);
+        case SOL_DESCRIPTOR:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Cancion por descriptor.\n");
+            return pasar_cancion_servidor(conexion, id, carga);
+        case SOL_LOTE:
+            bitacora(NIVEL_DEPURACION, "Opcion seleccionada: Descargar lote de canciones.\n");
+            return enviar_lote_servidor(conexion, id, carga);
+        case SOL_VENTANA:
+            if (longitud != sizeof(incremento))
+            {
+                bitacora(NIVEL_AVISO, "Actualizacion de ventana de %u bytes en el canal %u.\n", longitud, id);
+                return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_VENTANA);
+            }
+            memcpy(&incremento, carga, sizeof(incremento));
+            canal_ventana(conexion, id, ntohl(incremento));
+            return OK;
+        case SOL_CANCELAR:
+            bitacora(NIVEL_DEPURACION, "Canal %u cancelado por el cliente.\n", id);
+            canal_cancelar(conexion, id);
+            return OK;
+        default:
+            bitacora(NIVEL_AVISO, "Opcion incorrecta recibida.\n");
+            return transporte_enviar_texto(conexion, id, RESP_ERROR, "Solicitud desconocida.");
+    }
+}
+
+/*!
+ * @brief   Arma la fila del listado de una cancion. Las completas llevan sus cinco campos; las demas, los que
+ *          tienen, cada uno seguido de " - " salvo el quinto (como las mostraba el listado que leia media.csv).
+ * @param catalogo Catalogo de la cancion.
+ * @param cancion  Cancion.
+ * @param fila     Buffer destino (BUFFER_SIZE bytes).
+*/
+static void formatear_cancion(const Catalogo* catalogo, const Cancion* cancion, char* fila)
+{
+    int i;
+
+    if (cancion->completa)
+    {
+        snprintf(fila, BUFFER_SIZE, "%d - %s - %s - %s - %s - %s\n", cancion->numero,
+                 catalogo_texto(catalogo, cancion, TITULO), catalogo_texto(catalogo, cancion, ARTISTA),
+                 catalogo_texto(catalogo, cancion, ALBUM), catalogo_texto(catalogo, cancion, GENERO),
+                 catalogo_texto(catalogo, cancion, ANIO));
+        return;
+    }
+    snprintf(fila, BUFFER_SIZE, "%d - %s - ", cancion->numero, catalogo_texto(catalogo, cancion, TITULO));
+    for (i = 1; i < CAMPOS && catalogo_texto(catalogo, cancion, i)[0] != '\0'; i++)
+    {
+        strncat(fila, catalogo_texto(catalogo, cancion, i), BUFFER_SIZE - strlen(fila) - 1);
+        strncat(fila, (i < CAMPOS - 1) ? " - " : "", BUFFER_SIZE - strlen(fila) - 1);
+    }
+    strncat(fila, "\n", BUFFER_SIZE - strlen(fila) - 1);
+}
+
+/*!
+ * @brief   Envia canciones del catalogo en tramas de datos que agrupan varias filas, seguidas de la trama de fin.
+ *          Cada fila lleva el numero de linea de la cancion en media.csv, el mismo del listado sin orden.
+ *          Las lineas vacias (ver catalogo_vacia()) se saltean.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param catalogo Catalogo de las canciones.
+ * @param filas    Canciones a enviar, en el orden de envio.
+ * @param cantidad Cantidad de canciones.
+ * @return OK(0) si se envian, ERROR(-1) si ocurre un problema.
+*/
+static int enviar_canciones(Conexion* conexion, uint32_t id, const Catalogo* catalogo, Cancion* const* filas, int cantidad)
+{
+    int i, estado = OK;
+    size_t usados = 0;
+    char fila[BUFFER_SIZE];
+    Flujo flujo;
+
+    flujo_iniciar(&flujo, &conexion->cubeta, PESO_CONTROL);
+    for (i = 0; i < cantidad && estado == OK; i++)
+    {
+        if (catalogo_vacia(catalogo, filas[i]))
         {
-            case 1:
-                printf("Opcion seleccionada: Listar canciones.\n");
-                estado = listar_servidor(client_sock, buffer);
-                break;
-            case 2:
-                printf("Opcion seleccionada: Filtrar canciones.\n");
-                estado = menu_filtrar_servidor(client_sock, buffer);
-                break;
-            case 3:
-                printf("Opcion seleccionada: Escuchar cancion.\n");
-                estado = escuchar_cancion_servidor(client_sock, buffer);
-                break;
-            default:
-                printf("Opcion incorrecta recibida.\n");
-                estado = ERROR;
-                break;
+            continue;
         }
-    } while (estado == OK);
+        formatear_cancion(catalogo, filas[i], fila);
+        estado = agregar_fila(conexion, &flujo, id, &usados, fila);
+    }
+    // enviamos lo pendiente y la trama de fin.
+    if (estado == OK && (enviar_filas(conexion, &flujo, id, &usados) != OK || transporte_enviar(conexion, id, RESP_FIN, NULL, 0) != OK))
+    {
+        bitacora_error("Error al enviar senial de fin.\n");
+        estado = ERROR;
+    }
+    flujo_finalizar(&flujo);
+    return estado;
 }
 
 /*!
- * @brief   Lista las canciones disponibles en el servidor.
- *          Envia el listado de canciones al cliente conectado. Lee las canciones desde un archivo CSV
- *          y las envia linea por linea.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para enviar datos.
+ * @brief   Lista las canciones disponibles en el servidor, en el orden del archivo.
+ *          Recorre el catalogo en memoria (ver catalogo.h), sin volver a leer media.csv, y envia las canciones
+ *          en tramas de datos que agrupan varias filas. Las lineas vacias (numeros libres) no se listan.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
  * @return OK(0) si el listado es exitoso, ERROR(-1) si ocurre algun problema.
 */
-int listar_servidor(int client_sock, char* buffer)
+int listar_servidor(Conexion* conexion, uint32_t id)
 {
-    int i;
-    int cont = 1;
-    char* token = NULL;
-    char linea[LINEA_MAX];
-    FILE *canciones = fopen("media.csv", "r");
-    if (canciones == NULL)
+    int estado;
+    Catalogo* catalogo = NULL;
+
+    SONDA1(listar_inicio, conexion->sesion);
+    if ((catalogo = catalogo_obtener()) == NULL)
     {
-        perror("No se pudo abrir el archivo.\n");
-        return ERROR;
+        bitacora_error("No se pudo abrir el archivo.\n");
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
+    }
+    estado = enviar_canciones(conexion, id, catalogo, catalogo->orden[ORDEN_ARCHIVO], catalogo->cantidad);
+    SONDA2(listar_fin, conexion->sesion, catalogo->cantidad);
+    catalogo_soltar(catalogo);
+    return estado;
+}
+
+/*!
+ * @brief   Lista las canciones del catalogo ordenadas por anio, titulo, artista, genero o album.
+ *          Recorre la permutacion precalculada del orden pedido: no ordena nada al atender la solicitud.
+ *          Solo se listan las canciones con los cinco campos.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param orden    Orden del listado (ORDEN_ANIO a ORDEN_ALBUM).
+ * @return OK(0) si la conexion puede seguir (aunque el orden sea invalido), ERROR(-1) si ocurre un problema de envio.
+*/
+int listar_ordenado_servidor(Conexion* conexion, uint32_t id, int orden)
+{
+    int estado;
+    Catalogo* catalogo = NULL;
+
+    if (orden <= ORDEN_ARCHIVO || orden >= ORDENES)
+    {
+        bitacora(NIVEL_AVISO, "Orden de listado invalido.\n");
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "Orden de listado invalido.");
+    }
+    SONDA1(listar_inicio, conexion->sesion);
+    if ((catalogo = catalogo_obtener()) == NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
     }
+    estado = enviar_canciones(conexion, id, catalogo, catalogo->orden[orden], catalogo->completas);
+    SONDA2(listar_fin, conexion->sesion, catalogo->completas);
+    catalogo_soltar(catalogo);
+    return estado;
+}
+
+/*!
+ * @brief   Lista las canciones mas escuchadas, de mayor a menor, con sus reproducciones estimadas.
+ *          Las cuentas salen del registro de popularidad (ver popularidad.h): se consultan sin recorrer el catalogo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @return OK(0) si se envia el listado, ERROR(-1) si ocurre un problema de envio.
+*/
+int listar_populares_servidor(Conexion* conexion, uint32_t id)
+{
+    int i, cantidad;
+    size_t usados = 0;
+    char fila[BUFFER_SIZE];
+    Popular populares[POPULARIDAD_TOP];
+    const Cancion* cancion = NULL;
+    Catalogo* catalogo = NULL;
+    Flujo flujo;
 
-    while (fgets(linea, LINEA_MAX, canciones) != NULL)
+    SONDA1(listar_inicio, conexion->sesion);
+    if ((catalogo = catalogo_obtener()) == NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
+    }
+    cantidad = popularidad_top(populares);
+    flujo_iniciar(&flujo, &conexion->cubeta, PESO_CONTROL);
+    for (i = 0; i < cantidad; i++)
     {
-        linea[strcspn(linea, "\n")] = '\0'; // eliminamos salto de linea si existiese.
-        // tokenizamos la linea.
-        token = strtok(linea, ",");
-        snprintf(buffer, BUFFER_SIZE, "%d - %s - ", cont, token);
-        for (i = 0; i < 3; i++)
+        if (populares[i].numero == 0 || populares[i].numero > (uint32_t)catalogo->cantidad
+            || catalogo_vacia(catalogo, &catalogo->canciones[populares[i].numero - 1]))
         {
-            token = strtok(NULL, ",");
-            strcat(buffer, token);
-            strcat(buffer, " - ");
+            continue; // la cancion ya no esta en el catalogo.
         }
-        token = strtok(NULL, ",");
-        strcat(buffer, token);
-        strcat(buffer, "\n");        
-        if (send(client_sock, buffer, strlen(buffer), 0) < 0)
+        cancion = &catalogo->canciones[populares[i].numero - 1];
+        snprintf(fila, BUFFER_SIZE, "%d - %s - %s - %s - %s - %s - %u reproducciones\n", cancion->numero,
+                 catalogo_texto(catalogo, cancion, TITULO), catalogo_texto(catalogo, cancion, ARTISTA),
+                 catalogo_texto(catalogo, cancion, ALBUM), catalogo_texto(catalogo, cancion, GENERO),
+                 catalogo_texto(catalogo, cancion, ANIO), populares[i].cuenta);
+        if (agregar_fila(conexion, &flujo, id, &usados, fila) != OK)
         {
-            perror("Error al enviar linea.\n");
-            fclose(canciones);
+            flujo_finalizar(&flujo);
+            catalogo_soltar(catalogo);
             return ERROR;
         }
-        cont++;
-        usleep(50);
     }
-    // enviamos senial de fin.
-    if (send(client_sock, FIN, strlen(FIN), 0) < 0)
+    catalogo_soltar(catalogo);
+    if (enviar_filas(conexion, &flujo, id, &usados) != OK || transporte_enviar(conexion, id, RESP_FIN, NULL, 0) != OK)
     {
-        perror("Error al enviar senial de fin.\n");
-        fclose(canciones);
+        bitacora_error("Error al enviar senial de fin.\n");
+        flujo_finalizar(&flujo);
         return ERROR;
     }
-    
-    fclose(canciones);
+    flujo_finalizar(&flujo);
+    SONDA2(listar_fin, conexion->sesion, cantidad);
     return OK;
 }
 
+/*!
+ * @struct Envio
+ * @brief Filas de una respuesta que se van agrupando en el bloque de la conexion (ver agregar_fila()).
+*/
+typedef struct Envio
+{
+    Conexion* conexion;           /**< Conexion por la que se envia. */
+    Flujo* flujo;                 /**< Flujo del planificador con el que se envia. */
+    uint32_t id;                  /**< Identificador de la solicitud. */
+    size_t usados;                /**< Bytes acumulados en el bloque. */
+} Envio;
+
+/*!
+ * @brief   Agrega una fila de la sincronizacion del catalogo al bloque (ver catalogo_cambios()).
+ * @param contexto Envio en curso.
+ * @param fila     Fila a agregar.
+ * @return OK(0) si se agrega, ERROR(-1) si ocurre un problema al enviar.
+*/
+static int agregar_cambio(void* contexto, const char* fila)
+{
+    Envio* envio = contexto;
+
+    return agregar_fila(envio->conexion, envio->flujo, envio->id, &envio->usados, fila);
+}
+
+/*!
+ * @brief   Sincroniza la copia del catalogo de un cliente (ver SOL_CATALOGO).
+ *          Si la version del cliente es la vigente solo se envia la trama de fin. Si es una version anterior que
+ *          todavia esta en el historial, se envian las canciones cuya huella cambio y se quitan las que ya no
+ *          estan; si no, se envia el catalogo completo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Version de la copia del cliente en hexadecimal (vacia si no tiene copia).
+ * @return OK(0) si se envia la respuesta, ERROR(-1) si ocurre un problema de envio.
+*/
+int sincronizar_catalogo_servidor(Conexion* conexion, uint32_t id, char* carga)
+{
+    int anteriores = 0, enviadas = 0, estado;
+    uint64_t version = strtoull(carga, NULL, 16);
+    uint64_t* huellas = NULL;
+    char fin[BUFFER_SIZE];
+    const char* modo = "igual";
+    Catalogo* catalogo = NULL;
+    Flujo flujo;
+    Envio envio = { conexion, &flujo, id, 0 };
+
+    if ((catalogo = catalogo_obtener()) == NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
+    }
+    if (version != catalogo->version)
+    {
+        // sin las huellas de la version del cliente, cada cancion cuenta como cambiada.
+        huellas = catalogo_huellas_version(version, &anteriores);
+        modo = (huellas != NULL) ? "cambios" : "completo";
+        flujo_iniciar(&flujo, &conexion->cubeta, PESO_CONTROL);
+        enviadas = catalogo_cambios(catalogo, huellas, anteriores, agregar_cambio, &envio);
+        free(huellas);
+        estado = (enviadas == ERROR) ? ERROR : enviar_filas(conexion, &flujo, id, &envio.usados);
+        flujo_finalizar(&flujo);
+        if (estado != OK)
+        {
+            catalogo_soltar(catalogo);
+            return ERROR;
+        }
+    }
+    bitacora(NIVEL_DEPURACION, "Catalogo %016llx sincronizado (%s): %d filas.\n", (unsigned long long)catalogo->version, modo, enviadas);
+    snprintf(fin, BUFFER_SIZE, "%016llx %d %s", (unsigned long long)catalogo->version, catalogo->cantidad, modo);
+    catalogo_soltar(catalogo);
+    return transporte_enviar_texto(conexion, id, RESP_FIN, fin);
+}
+
+/*!
+ * @brief   Filtra las canciones por un rango de anios y las envia ordenadas por anio.
+ *          El rango se ubica con dos busquedas binarias en la permutacion por anio del catalogo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param rango    Rango ingresado por el cliente (ver catalogo_leer_rango()).
+ * @return OK(0) si la conexion puede seguir (aunque el rango sea invalido), ERROR(-1) si ocurre un problema de envio.
+*/
+int filtrar_anios_servidor(Conexion* conexion, uint32_t id, char* rango)
+{
+    int desde, hasta, inicio, cantidad, estado;
+    Catalogo* catalogo = NULL;
+
+    if (catalogo_leer_rango(rango, &desde, &hasta) != OK)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "Rango de anios invalido (ej: 1976-1986).");
+    }
+    SONDA3(filtrar_inicio, conexion->sesion, ANIO, rango);
+    if ((catalogo = catalogo_obtener()) == NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
+    }
+    cantidad = catalogo_rango_anios(catalogo, desde, hasta, &inicio);
+    estado = enviar_canciones(conexion, id, catalogo, catalogo->orden[ORDEN_ANIO] + inicio, cantidad);
+    SONDA3(filtrar_fin, conexion->sesion, catalogo->completas, cantidad);
+    catalogo_soltar(catalogo);
+    return estado;
+}
+
+/*!
+ * @brief   Filtra las canciones con una consulta combinada (ver consulta.h) y las envia en el orden del archivo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param texto    Consulta ingresada por el cliente, ej: "artista=Soda Stereo & anio=1985-1990".
+ * @return OK(0) si la conexion puede seguir (aunque la consulta sea invalida), ERROR(-1) si ocurre un problema de envio.
+*/
+int filtrar_consulta_servidor(Conexion* conexion, uint32_t id, char* texto)
+{
+    int cantidad, estado;
+    Catalogo* catalogo = NULL;
+    Cancion** resultado = NULL;
+    Consulta consulta;
+
+    if (consulta_leer(texto, &consulta) != OK)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "Consulta invalida (ej: artista=Soda Stereo & anio=1985-1990).");
+    }
+    SONDA3(filtrar_inicio, conexion->sesion, CAMPOS, texto);
+    if ((catalogo = catalogo_obtener()) == NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
+    }
+    if (consulta_resolver(catalogo, &consulta, &resultado, &cantidad) != OK)
+    {
+        bitacora_error("Error al reservar memoria para la consulta.\n");
+        catalogo_soltar(catalogo);
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No hay memoria para resolver la consulta.");
+    }
+    estado = enviar_canciones(conexion, id, catalogo, resultado, cantidad);
+    SONDA3(filtrar_fin, conexion->sesion, catalogo->completas, cantidad);
+    free(resultado);
+    catalogo_soltar(catalogo);
+    return estado;
+}
+
+/*!
+ * @brief   Busca canciones cuyo titulo, artista o album se parecen a un texto, tolerando errores de tipeo
+ *          (ver trigramas.h), y las envia de la mas parecida a la menos.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param texto    Texto ingresado por el cliente, ej: "pink floid".
+ * @return OK(0) si la conexion puede seguir (aunque el texto sea invalido), ERROR(-1) si ocurre un problema de envio.
+*/
+int filtrar_aproximado_servidor(Conexion* conexion, uint32_t id, char* texto)
+{
+    int cantidad, estado, resultado_busqueda;
+    Catalogo* catalogo = NULL;
+    Cancion** resultado = NULL;
+
+    SONDA3(filtrar_inicio, conexion->sesion, CAMPOS + 1, texto);
+    if ((catalogo = catalogo_obtener()) == NULL)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
+    }
+    if ((resultado_busqueda = trigramas_buscar(catalogo, texto, &resultado, &cantidad)) != OK)
+    {
+        catalogo_soltar(catalogo);
+        if (resultado_busqueda == ERROR)
+        {
+            return transporte_enviar_texto(conexion, id, RESP_ERROR, "La busqueda debe tener letras o numeros.");
+        }
+        bitacora_error("Error al reservar memoria para la busqueda.\n");
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No hay memoria para resolver la busqueda.");
+    }
+    estado = enviar_canciones(conexion, id, catalogo, resultado, cantidad);
+    SONDA3(filtrar_fin, conexion->sesion, catalogo->completas, cantidad);
+    free(resultado);
+    catalogo_soltar(catalogo);
+    return estado;
+}
+
 /*!
  * @brief   Menu de filtrado de canciones en el servidor.
- *          Recibe del cliente la opcion de filtrado (por artista o genero) y llama a la funcion de filtrado correspondiente.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para recibir datos.
+ *          Interpreta la opcion de filtrado (por artista, genero, rango de anios, consulta combinada o busqueda aproximada) recibida en la solicitud
+ *          y llama a la funcion de filtrado correspondiente.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Carga de la solicitud, con formato "opcion:filtro" (1 artista, 2 genero, 3 rango de anios,
+ *                 4 consulta combinada, 5 busqueda aproximada).
  * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un problema.
 */
-int menu_filtrar_servidor(int client_sock, char *buffer)
+int menu_filtrar_servidor(Conexion* conexion, uint32_t id, char *carga)
 {
     int opcion;
-    ssize_t bytes_received;
+    char* filtro = strchr(carga, ':');
 
-    // recibir opcion elegida por el cliente.
-    if ((bytes_received = recv(client_sock, buffer, BUFFER_SIZE, 0)) <= 0)
+    if (filtro == NULL)
     {
-        perror("Error al recibir opcion elegida.\n");
-        return ERROR;
+        bitacora(NIVEL_AVISO, "Opcion invalida.\n");
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "Solicitud de filtrado invalida.");
     }
-    buffer[bytes_received] = '\0';
-    opcion = atoi(buffer); // convertir opcion a entero.
+    *filtro++ = '\0';
+    opcion = atoi(carga); // convertir opcion a entero.
     if (opcion == 1)
     {
-        return filtrar_servidor(client_sock, buffer, ARTISTA);
+        return filtrar_servidor(conexion, id, filtro, ARTISTA);
     } else if (opcion == 2)
     {
-        return filtrar_servidor(client_sock, buffer, GENERO);
+        return filtrar_servidor(conexion, id, filtro, GENERO);
+    } else if (opcion == 3)
+    {
+        return filtrar_anios_servidor(conexion, id, filtro);
+    } else if (opcion == 4)
+    {
+        return filtrar_consulta_servidor(conexion, id, filtro);
+    } else if (opcion == 5)
+    {
+        return filtrar_aproximado_servidor(conexion, id, filtro);
     }
 
-    printf("Opcion invalida.\n");
-    return ERROR;
+    bitacora(NIVEL_AVISO, "Opcion invalida.\n");
+    return transporte_enviar_texto(conexion, id, RESP_ERROR, "Opcion de filtrado invalida.");
 }
 
 /*!
  * @brief   Filtra las canciones por un criterio especifico (artista o genero).
- *          Envia al cliente las canciones que cumplen con el criterio de filtrado ingresado.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para enviar datos.
- * @param sector      Indica el campo a filtrar (ARTISTA o GENERO).
+ *          Envia al cliente, en el orden del archivo, las canciones que cumplen con el criterio de filtrado ingresado.
+ *          Usa el diccionario del campo en el catalogo: compara claves enteras en lugar de textos.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param filtro   Filtro ingresado por el cliente.
+ * @param sector   Indica el campo a filtrar (ARTISTA o GENERO).
  * @return OK(0) si el filtrado es exitoso, ERROR(-1) si ocurre un problema.
 */
-int filtrar_servidor(int client_sock, char* buffer, int sector)
+int filtrar_servidor(Conexion* conexion, uint32_t id, char* filtro, int sector)
 {
-    ssize_t bytes_received;
-    int cont, i;
-    char linea[LINEA_MAX];
-    char filtro[FILTRO_MAX];
-    char* segmentos[5];
-    char* token = NULL;
-    FILE *canciones = fopen("media.csv", "r");
-    if (canciones == NULL)
+    int inicio, cantidad, estado;
+    Catalogo* catalogo = NULL;
+
+    SONDA3(filtrar_inicio, conexion->sesion, sector, filtro);
+    if ((catalogo = catalogo_obtener()) == NULL)
     {
-        perror("No se pudo abrir archivo de registro de canciones.\n");
-        return ERROR;
+        bitacora_error("No se pudo abrir archivo de registro de canciones.\n");
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "No se pudo abrir el registro de canciones.");
     }
-    // recibir filtro.
-    if ((bytes_received = recv(client_sock, buffer, BUFFER_SIZE, 0)) <= 0)
+    // el filtro se busca una vez en el diccionario del campo; las canciones con esa clase estan juntas.
+    cantidad = catalogo_buscar(catalogo, sector, filtro, &inicio);
+    estado = enviar_canciones(conexion, id, catalogo, catalogo->orden[catalogo_orden_campo(sector)] + inicio, cantidad);
+    SONDA3(filtrar_fin, conexion->sesion, catalogo->completas, cantidad);
+    catalogo_soltar(catalogo);
+    return estado;
+}
+
+/*!
+ * @brief   Envia una cancion solicitada por el cliente.
+ *          Busca el archivo de la cancion por su numero en la tabla de archivos, verifica su existencia,
+ *          y abre un canal que lo envia en segundo plano, en tramas de datos seguidas de una trama de fin.
+ *          Mientras tanto el cliente puede seguir enviando otras solicitudes.
+ *          Una precarga no cuenta como reproduccion y se envia como descarga de fondo (ver SOL_PRECARGA).
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param cancion  Numero de la cancion solicitada ("12"; tambien se acepta "12.mp3").
+ * @param precarga 1 si responde a SOL_PRECARGA, 0 si responde a SOL_CANCION.
+ * @return OK(0) si la conexion puede seguir (aunque la cancion no exista), ERROR(-1) si ocurre un problema de envio.
+*/
+int escuchar_cancion_servidor(Conexion* conexion, uint32_t id, char* cancion, int precarga)
+{
+    Archivo archivo;
+
+    if (archivos_abrir(archivos_leer_numero(cancion), &archivo) != OK)
     {
-        perror("Error al recibir filtro.\n");
-        fclose(canciones);
-        return ERROR;
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, CANCION_INEXISTENTE);
     }
-    buffer[bytes_received] = '\0';
-    strcpy(filtro, buffer);
-    cont = 1;
-    while (fgets(linea, LINEA_MAX, canciones) != NULL) // leemos el registro linea por linea.
+    bitacora(NIVEL_DEPURACION, "Enviando cancion: %u%s\n", archivo.numero, precarga ? " (precarga)" : "");
+    if (!precarga)
     {
-        i = 0; 
-        linea[strcspn(linea, "\n")] = '\0'; // eliminar salto de linea.
-        // tokenizamos.
-        token = strtok(linea, ",");
-        while (token != NULL && i < 5)
-        {
-            segmentos[i++] = token;
-            token = strtok(NULL, ",");
-        }
-        // validar que cumple el filtro.
-        if (verificar(segmentos[sector], filtro) == OK)
-        {
-            // damos formato y enviamos.
-            snprintf(buffer, BUFFER_SIZE, "%d - %s - %s - %s - %s - %s\n", 
-                     cont, segmentos[0], segmentos[1], segmentos[2], segmentos[3], segmentos[4]);
-            if (send(client_sock, buffer, strlen(buffer), 0) < 0)
-            {
-                perror("Error al enviar datos al cliente");
-                fclose(canciones);
-                return ERROR;
-            }
-        }
-        cont++;
-        usleep(50);
+        popularidad_registrar(archivo.numero);
     }
+    SONDA3(descarga_inicio, conexion->sesion, id, cancion);
+    return canal_abrir(conexion, id, &archivo, 1, 1, 0, precarga, 0);
+}
+
+/*!
+ * @brief   Envia una cancion a partir de un instante.
+ *          Ubica con el indice de marcos de la cancion (que se arma la primera vez) el byte del marco que
+ *          suena en ese instante y abre un canal que envia la cancion desde ahi, como SOL_CANCION.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Numero de la cancion y segundos desde el comienzo, ej: "12:95.5".
+ * @return OK(0) si la conexion puede seguir (aunque la cancion o el instante no existan), ERROR(-1) si ocurre un problema de envio.
+*/
+int escuchar_desde_servidor(Conexion* conexion, uint32_t id, char* carga)
+{
+    Archivo archivo;
+    Marcos marcos;
+    char ruta[PATH_MAX];
+    char* separador = strchr(carga, ':');
+    char* fin = NULL;
+    double segundos;
+    off_t desde;
+    int directorio, estado;
 
-    // enviamos senial de fin.
-    if (send(client_sock, FIN, strlen(FIN), 0) < 0)
+    if (separador == NULL)
     {
-        perror("Error al enviar senial de fin.\n");
-        fclose(canciones);
-        return ERROR;
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "Instante invalido (ej: 12:95).");
     }
-    fclose(canciones);
-    return OK;
+    *separador = '\0';
+    segundos = strtod(separador + 1, &fin);
+    if (fin == separador + 1 || *fin != '\0' || !(segundos >= 0 && segundos < UINT32_MAX / 1000))
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, "Instante invalido (ej: 12:95).");
+    }
+    if (archivos_abrir(archivos_leer_numero(carga), &archivo) != OK)
+    {
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, CANCION_INEXISTENTE);
+    }
+    if ((directorio = archivos_ruta(&archivo, ruta, sizeof(ruta))) < 0)
+    {
+        archivos_soltar(&archivo);
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, CANCION_INEXISTENTE);
+    }
+    if ((estado = marcos_obtener(directorio, ruta, archivo.fd, &marcos)) != OK)
+    {
+        archivos_soltar(&archivo);
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, (estado == ERROR) ? ERROR_MARCOS : ERROR_ABRIR_CANCION);
+    }
+    estado = marcos_ubicar(&marcos, (uint32_t)(segundos * 1000), &desde);
+    marcos_liberar(&marcos);
+    if (estado != OK)
+    {
+        archivos_soltar(&archivo);
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_INSTANTE);
+    }
+    bitacora(NIVEL_DEPURACION, "Enviando cancion %u desde %.3f s (byte %lld).\n", archivo.numero, segundos, (long long)desde);
+    popularidad_registrar(archivo.numero);
+    SONDA3(descarga_inicio, conexion->sesion, id, carga);
+    return canal_abrir(conexion, id, &archivo, 1, 1, 0, 0, desde);
 }
 
 /*!
- * @brief   Verifica si un dato cumple con el filtro ingresado.
- *          Compara el dato con el filtro ingresado por el cliente, ignorando diferencias en mayusculas/minusculas.
- * @param dato   Dato a comparar (por ejemplo, el nombre del artista o genero).
- * @param filtro Filtro ingresado por el cliente.
- * @return OK(0) si el dato cumple con el filtro, ERROR(-1) en caso contrario.
+ * @brief   Pasa a un cliente local el archivo de una cancion por descriptor (ver SOL_DESCRIPTOR).
+ *          Abre un descriptor propio de solo lectura (asi el cliente no comparte la posicion ni los modos del
+ *          que usan las descargas) y lo adjunta a la trama de fin, que lleva el tamanio del archivo. Cuenta como
+ *          una reproduccion y una descarga del tamanio del archivo.
+ * @param conexion Estado de la conexion (debe ser local).
+ * @param id       Identificador de la solicitud.
+ * @param cancion  Numero de la cancion solicitada ("12").
+ * @return OK(0) si la conexion puede seguir (aunque la cancion no exista), ERROR(-1) si ocurre un problema de envio.
 */
-int verificar(char *dato, char *filtro)
+int pasar_cancion_servidor(Conexion* conexion, uint32_t id, char* cancion)
 {
-    int posicion1 = 0, posicion2 = 0;
+    Archivo archivo;
+    struct stat datos, compartido;
+    char ruta[PATH_MAX];
+    char tamanio[32];
+    double inicio = estadisticas_ahora();
+    int directorio, fd, estado;
 
-    while (dato[posicion1] != '\0' && filtro[posicion2] != '\0')
+    if (!conexion->local)
     {
-        if (tolower(dato[posicion1]) != tolower(filtro[posicion2]))
-        {
-            return ERROR;
-        }
-        posicion1++;
-        posicion2++;
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_NO_LOCAL);
     }
-    // verificamos que finalicen al mismo tiempo.
-    if (dato[posicion1] != '\0' || filtro[posicion2] != '\0')
+    if (archivos_abrir(archivos_leer_numero(cancion), &archivo) != OK)
     {
-        return ERROR;
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, CANCION_INEXISTENTE);
+    }
+    fd = -1;
+    if ((directorio = archivos_ruta(&archivo, ruta, sizeof(ruta))) >= 0)
+    {
+        fd = openat(directorio, ruta, O_RDONLY | O_CLOEXEC);
     }
+    // si la ruta ya es de otro archivo que el abierto (se reemplazo), no se pasa.
+    if (fd >= 0 && (fstat(fd, &datos) < 0 || fstat(archivo.fd, &compartido) < 0
+        || datos.st_ino != compartido.st_ino || datos.st_dev != compartido.st_dev))
+    {
+        close(fd);
+        fd = -1;
+    }
+    archivos_soltar(&archivo);
+    if (fd < 0)
+    {
+        bitacora_error("Error al abrir la cancion %u para pasarla por descriptor.\n", archivo.numero);
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_ABRIR_CANCION);
+    }
+    bitacora(NIVEL_DEPURACION, "Pasando cancion %u por descriptor (%lld bytes).\n", archivo.numero, (long long)datos.st_size);
+    popularidad_registrar(archivo.numero);
+    SONDA3(descarga_inicio, conexion->sesion, id, cancion);
+    snprintf(tamanio, sizeof(tamanio), "%lld", (long long)datos.st_size);
+    estado = transporte_enviar_descriptor(conexion, id, RESP_FIN, tamanio, fd);
+    // el cliente ya tiene su copia del descriptor.
+    close(fd);
+    estadisticas_registrar(OP_DESCARGA, estadisticas_ahora() - inicio, estado == OK, (uint64_t)datos.st_size);
+    return estado;
+}
+
+/*!
+ * @brief   Obtiene la ubicacion fisica en disco del comienzo de un archivo.
+ *          Usa FIEMAP cuando el sistema de archivos lo soporta; si no, o si el archivo todavia no
+ *          tiene bloques asignados, el numero de inodo, que en la mayoria de los sistemas de archivos
+ *          crece con el orden de asignacion. Estos ultimos se ordenan despues de los de ubicacion conocida.
+ * @param lugar  Ubicacion a completar, con el archivo ya abierto.
+ * @return OK(0) si se obtiene la ubicacion, ERROR(-1) si no se pudo consultar.
+*/
+static int ubicar_en_disco(Ubicacion* lugar)
+{
+    int fd = lugar->archivo.fd;
+    struct stat datos;
+    struct
+    {
+        struct fiemap mapa;
+        struct fiemap_extent extension;
+    } consulta;
 
+    if (fstat(fd, &datos) < 0)
+    {
+        return ERROR;
+    }
+    lugar->dispositivo = datos.st_dev;
+    lugar->fisico = UBICACION_DESCONOCIDA | datos.st_ino;
+    memset(&consulta, 0, sizeof(consulta));
+    consulta.mapa.fm_length = FIEMAP_MAX_OFFSET;
+    consulta.mapa.fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, &consulta.mapa) == 0 && consulta.mapa.fm_mapped_extents > 0
+        && (consulta.extension.fe_flags & FIEMAP_EXTENT_UNKNOWN) == 0)
+    {
+        lugar->fisico = consulta.extension.fe_physical;
+    }
     return OK;
 }
 
 /*!
- * @brief   Envia una cancion solicitada por el cliente.
- *          Busca el archivo correspondiente a la cancion solicitada, verifica su existencia,
- *          y lo envia al cliente en bloques.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para enviar datos.
- * @return OK(0) si la cancion es enviada exitosamente, ERROR(-1) si ocurre algun problema.
+ * @brief   Compara dos canciones de un lote por su ubicacion en disco.
+ * @param a Primera ubicacion.
+ * @param b Segunda ubicacion.
+ * @return Negativo, cero o positivo segun el orden (como strcmp).
 */
-int escuchar_cancion_servidor(int client_sock, char* buffer)
+static int comparar_ubicacion(const void* a, const void* b)
 {
-    ssize_t bytes_received;
-    size_t bytes_read;
-    FILE* cancion = NULL;
+    const Ubicacion* x = a;
+    const Ubicacion* y = b;
 
-    // recibir nombre de la cancion.
-    if ((bytes_received = recv(client_sock, buffer, BUFFER_SIZE, 0)) <= 0)
+    if (x->dispositivo != y->dispositivo)
     {
-        perror("Error al recibir nombre de la cancion.\n");
-        return ERROR;
+        return (x->dispositivo < y->dispositivo) ? -1 : 1;
     }
-    buffer[bytes_received] = '\0';
-    if (strcmp(buffer, FIN) == 0) // validamos si usuario sigue conectado.
+    if (x->fisico != y->fisico)
     {
-        printf("\n");
-        return OK;
+        return (x->fisico < y->fisico) ? -1 : 1;
     }
-    // abrir el archivo.
-    if (access(buffer, F_OK) != 0) // verificar si el archivo existe.
+    return 0;
+}
+
+/*!
+ * @brief   Envia un lote de canciones solicitadas por el cliente en un solo canal.
+ *          Descarta numeros invalidos, repetidos e inexistentes, ordena las canciones por su ubicacion
+ *          en disco para leerlas con el menor movimiento posible y abre un canal que las envia una detras de otra.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Numeros de cancion separados por comas.
+ * @return OK(0) si la conexion puede seguir, ERROR(-1) si ocurre un problema de envio.
+*/
+int enviar_lote_servidor(Conexion* conexion, uint32_t id, char* carga)
+{
+    int i, repetida, cantidad = 0, solicitadas = 0;
+    uint32_t numero;
+    char* token = NULL;
+    char* resto = NULL;
+    uint32_t pedidas[LOTE_MAX];
+    Archivo archivos[LOTE_MAX];
+    Ubicacion lugares[LOTE_MAX];
+
+    for (token = strtok_r(carga, ",", &resto); token != NULL; token = strtok_r(NULL, ",", &resto))
     {
-        if (send(client_sock, FIN, strlen(FIN), 0) < 0)
+        if ((numero = archivos_leer_numero(token)) == 0)
         {
-            perror("Error al enviar aviso de inexistencia.\n");
-            return OK;
+            continue;
         }
-        return OK;
-    }
-    if ((cancion = fopen(buffer, "rb")) == NULL)
-    {
-        perror("Error al abrir archivo de cancion.\n");
-        if (send(client_sock, "ERROR", strlen("ERROR"), 0) < 0)
+        for (i = 0, repetida = 0; i < solicitadas && !repetida; i++)
         {
-            perror("Error al abrir archivo cancion.\n");
-            return ERROR;
+            repetida = (pedidas[i] == numero);
         }
-        return ERROR;
-    }
-    else 
-    {
-        if (send(client_sock, "OK", strlen("OK"), 0) < 0)
+        if (repetida)
         {
-            perror("Error al enviar confirmacion.\n");
-            return ERROR;
+            continue;
         }
-    }
-    printf("Enviando archivo: %s\n", buffer);
-    // enviar el archivo en bloques.
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, cancion)) > 0)
-    {
-        if (send(client_sock, buffer, bytes_read, 0) < 0)
+        if (solicitadas == LOTE_MAX)
         {
-            perror("Error al enviar datos del archivo.\n");
-            fclose(cancion);
-            return ERROR;
+            for (i = 0; i < cantidad; i++)
+            {
+                archivos_soltar(&lugares[i].archivo);
+            }
+            return transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_LOTE);
+        }
+        pedidas[solicitadas++] = numero;
+        if (archivos_abrir(numero, &lugares[cantidad].archivo) != OK)
+        {
+            continue;
+        }
+        if (ubicar_en_disco(&lugares[cantidad]) != OK)
+        {
+            archivos_soltar(&lugares[cantidad].archivo);
+            continue;
         }
-        usleep(50);
+        cantidad++;
     }
-    // enviar indicador de fin de transmision.
-    usleep(500000);
-    if (send(client_sock, FIN, strlen(FIN), 0) < 0)
+    if (cantidad == 0)
     {
-        perror("Error al enviar indicador de fin de transmision.\n");
-        fclose(cancion);
-        return ERROR;
+        return transporte_enviar_texto(conexion, id, RESP_ERROR, CANCION_INEXISTENTE);
     }
-
-    fclose(cancion);
-    return OK;
-}
\ No newline at end of file
+    // leemos en el orden en que estan en disco, no en el que se pidieron.
+    qsort(lugares, cantidad, sizeof(Ubicacion), comparar_ubicacion);
+    for (i = 0; i < cantidad; i++)
+    {
+        archivos[i] = lugares[i].archivo;
+    }
+    bitacora(NIVEL_DEPURACION, "Enviando lote de %d canciones.\n", cantidad);
+    SONDA3(lote_inicio, conexion->sesion, id, cantidad);
+    return canal_abrir(conexion, id, archivos, cantidad, solicitadas, 1, 0, 0);
+}
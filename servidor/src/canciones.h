@@ -8,6 +8,11 @@
  *          - Declaraciones de funciones para listar, filtrar y enviar canciones solicitadas por los clientes.
 */
 
+#include <stdint.h>
+#include <sys/types.h>
+#include "transporte.h"
+#include "canales.h"
+
 /*!
  * @def OK
  * @brief Codigo de retorno para indicar exito.
@@ -40,7 +45,7 @@
 
 /*!
  * @def BUFFER_SIZE
- * @brief Tamanio maximo del buffer para enviar y recibir datos.
+ * @brief Tamanio del buffer para mensajes de control. Los datos masivos usan el bloque de cada conexion (transporte.h).
 */
 #define BUFFER_SIZE 1024
 
@@ -69,64 +74,214 @@
 #define FILTRO_MAX 128
 
 /*!
- * @def FIN
- * @brief Senial utilizada para indicar el fin de la transmision de datos.
+ * @def CANCION_INEXISTENTE
+ * @brief Mensaje de error cuando la cancion solicitada no existe.
+*/
+#define CANCION_INEXISTENTE "Cancion inexistente."
+
+/*!
+ * @def ERROR_ABRIR_CANCION
+ * @brief Mensaje de error cuando no se puede abrir el archivo de la cancion.
+*/
+#define ERROR_ABRIR_CANCION "Error al abrir archivo en el servidor."
+
+/*!
+ * @def ERROR_MARCOS
+ * @brief Mensaje de error cuando el archivo de la cancion no tiene marcos MP3 para ubicar un instante.
+*/
+#define ERROR_MARCOS "La cancion no es un MP3 valido."
+
+/*!
+ * @def ERROR_INSTANTE
+ * @brief Mensaje de error cuando el instante pedido esta despues del final de la cancion.
+*/
+#define ERROR_INSTANTE "El instante pedido esta despues del final de la cancion."
+
+/*!
+ * @def ERROR_NO_LOCAL
+ * @brief Mensaje de error cuando se pide un descriptor por una conexion que no es local.
+*/
+#define ERROR_NO_LOCAL "Solo por el socket local del servidor."
+
+/*!
+ * @def ERROR_LOTE
+ * @brief Mensaje de error al pedir mas canciones de las permitidas en un lote.
+*/
+#define ERROR_LOTE "Demasiadas canciones en el lote."
+
+/*!
+ * @def ERROR_VENTANA
+ * @brief Mensaje de error cuando una actualizacion de ventana no trae un entero de 4 bytes.
+*/
+#define ERROR_VENTANA "Actualizacion de ventana invalida."
+
+/*!
+ * @def UBICACION_DESCONOCIDA
+ * @brief Bit que marca una ubicacion en disco estimada por el inodo, para ordenarla al final.
+*/
+#define UBICACION_DESCONOCIDA (1ULL << 63)
+
+/*!
+ * @struct Ubicacion
+ * @brief Cancion de un lote junto a su ubicacion en disco, usada para ordenar las lecturas.
 */
-#define FIN "FIN"
+typedef struct Ubicacion
+{
+    Archivo archivo;          /**< Archivo de la cancion, abierto con archivos_abrir(). */
+    dev_t dispositivo;        /**< Dispositivo que contiene el archivo. */
+    unsigned long long fisico; /**< Posicion fisica del primer bloque (o inodo si no se conoce). */
+} Ubicacion;
 
 /*!
  * @brief   Envia una cancion solicitada por el cliente.
- *          Busca el archivo correspondiente a la cancion solicitada, verifica su existencia,
- *          y lo envia al cliente en bloques.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para enviar datos.
- * @return OK(0) si la cancion es enviada exitosamente, ERROR(-1) si ocurre algun problema.
+ *          Busca el archivo de la cancion por su numero en la tabla de archivos, verifica su existencia,
+ *          y lo envia al cliente en tramas de datos seguidas de una trama de fin.
+ *          Una precarga no cuenta como reproduccion y se envia como descarga de fondo (ver SOL_PRECARGA).
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param cancion  Numero de la cancion solicitada ("12"; tambien se acepta "12.mp3").
+ * @param precarga 1 si responde a SOL_PRECARGA, 0 si responde a SOL_CANCION.
+ * @return OK(0) si la conexion puede seguir (aunque la cancion no exista), ERROR(-1) si ocurre un problema de envio.
 */
-int escuchar_cancion_servidor(int client_sock, char* buffer);
+int escuchar_cancion_servidor(Conexion* conexion, uint32_t id, char* cancion, int precarga);
 
 /*!
- * @brief   Verifica si un dato cumple con el filtro ingresado.
- *          Compara el dato con el filtro ingresado por el cliente, ignorando diferencias en mayusculas/minusculas.
- * @param dato   Dato a comparar (por ejemplo, el nombre del artista o genero).
- * @param filtro Filtro ingresado por el cliente.
- * @return OK(0) si el dato cumple con el filtro, ERROR(-1) en caso contrario.
+ * @brief   Envia una cancion a partir de un instante.
+ *          Ubica con el indice de marcos de la cancion (que se arma la primera vez) el byte del marco que
+ *          suena en ese instante y abre un canal que envia la cancion desde ahi, como SOL_CANCION.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Numero de la cancion y segundos desde el comienzo, ej: "12:95.5".
+ * @return OK(0) si la conexion puede seguir (aunque la cancion o el instante no existan), ERROR(-1) si ocurre un problema de envio.
 */
-int verificar(char *dato, char *filtro);
+int escuchar_desde_servidor(Conexion* conexion, uint32_t id, char* carga);
+
+/*!
+ * @brief   Pasa a un cliente local el archivo de una cancion por descriptor (ver SOL_DESCRIPTOR).
+ *          Abre un descriptor propio de solo lectura (asi el cliente no comparte la posicion ni los modos del
+ *          que usan las descargas) y lo adjunta a la trama de fin, que lleva el tamanio del archivo. Cuenta como
+ *          una reproduccion y una descarga del tamanio del archivo.
+ * @param conexion Estado de la conexion (debe ser local).
+ * @param id       Identificador de la solicitud.
+ * @param cancion  Numero de la cancion solicitada ("12").
+ * @return OK(0) si la conexion puede seguir (aunque la cancion no exista), ERROR(-1) si ocurre un problema de envio.
+*/
+int pasar_cancion_servidor(Conexion* conexion, uint32_t id, char* cancion);
+
+/*!
+ * @brief   Envia un lote de canciones solicitadas por el cliente en un solo canal.
+ *          Descarta numeros invalidos, repetidos e inexistentes, ordena las canciones por su ubicacion
+ *          en disco para leerlas con el menor movimiento posible y abre un canal que las envia una detras de otra.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Numeros de cancion separados por comas.
+ * @return OK(0) si la conexion puede seguir, ERROR(-1) si ocurre un problema de envio.
+*/
+int enviar_lote_servidor(Conexion* conexion, uint32_t id, char* carga);
 
 /*!
  * @brief   Filtra las canciones por un criterio especifico (artista o genero).
- *          Envia al cliente las canciones que cumplen con el criterio de filtrado ingresado.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para enviar datos.
- * @param sector      Indica el campo a filtrar (ARTISTA o GENERO).
+ *          Envia al cliente, en el orden del archivo, las canciones que cumplen con el criterio de filtrado ingresado.
+ *          Usa el diccionario del campo en el catalogo: compara claves enteras en lugar de textos.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param filtro   Filtro ingresado por el cliente.
+ * @param sector   Indica el campo a filtrar (ARTISTA o GENERO).
  * @return OK(0) si el filtrado es exitoso, ERROR(-1) si ocurre un problema.
 */
-int filtrar_servidor(int client_sock, char* buffer, int sector);
+int filtrar_servidor(Conexion* conexion, uint32_t id, char* filtro, int sector);
 
 /*!
  * @brief   Menu de filtrado de canciones en el servidor.
- *          Recibe del cliente la opcion de filtrado y llama a la funcion de filtrado correspondiente.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para recibir datos.
+ *          Interpreta la opcion de filtrado recibida en la solicitud y llama a la funcion de filtrado correspondiente.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Carga de la solicitud, con formato "opcion:filtro" (1 artista, 2 genero, 3 rango de anios,
+ *                 4 consulta combinada, 5 busqueda aproximada).
  * @return OK(0) si la operacion es exitosa, ERROR(-1) si ocurre un problema.
 */
-int menu_filtrar_servidor(int client_sock, char *buffer);
+int menu_filtrar_servidor(Conexion* conexion, uint32_t id, char *carga);
+
+/*!
+ * @brief   Filtra las canciones con una consulta combinada (ver consulta.h) y las envia en el orden del archivo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param texto    Consulta ingresada por el cliente, ej: "artista=Soda Stereo & anio=1985-1990".
+ * @return OK(0) si la conexion puede seguir (aunque la consulta sea invalida), ERROR(-1) si ocurre un problema de envio.
+*/
+int filtrar_consulta_servidor(Conexion* conexion, uint32_t id, char* texto);
+
+/*!
+ * @brief   Busca canciones cuyo titulo, artista o album se parecen a un texto, tolerando errores de tipeo
+ *          (ver trigramas.h), y las envia de la mas parecida a la menos.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param texto    Texto ingresado por el cliente, ej: "pink floid".
+ * @return OK(0) si la conexion puede seguir (aunque el texto sea invalido), ERROR(-1) si ocurre un problema de envio.
+*/
+int filtrar_aproximado_servidor(Conexion* conexion, uint32_t id, char* texto);
 
 /*!
- * @brief   Lista las canciones disponibles en el servidor.
- *          Envia el listado de canciones al cliente conectado. Lee las canciones desde un archivo CSV
- *          y las envia linea por linea.
- * @param client_sock Descriptor del socket del cliente.
- * @param buffer      Buffer utilizado para enviar datos.
+ * @brief   Filtra las canciones por un rango de anios y las envia ordenadas por anio.
+ *          El rango se ubica con dos busquedas binarias en la permutacion por anio del catalogo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param rango    Rango ingresado por el cliente (ver catalogo_leer_rango()).
+ * @return OK(0) si la conexion puede seguir (aunque el rango sea invalido), ERROR(-1) si ocurre un problema de envio.
+*/
+int filtrar_anios_servidor(Conexion* conexion, uint32_t id, char* rango);
+
+/*!
+ * @brief   Lista las canciones disponibles en el servidor, en el orden del archivo.
+ *          Recorre el catalogo en memoria (ver catalogo.h), sin volver a leer media.csv, y envia las canciones
+ *          en tramas de datos que agrupan varias filas. Las lineas vacias (numeros libres) no se listan.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
  * @return OK(0) si el listado es exitoso, ERROR(-1) si ocurre algun problema.
 */
-int listar_servidor(int client_sock, char* buffer);
+int listar_servidor(Conexion* conexion, uint32_t id);
+
+/*!
+ * @brief   Lista las canciones mas escuchadas, de mayor a menor, con sus reproducciones estimadas.
+ *          Las cuentas salen del registro de popularidad (ver popularidad.h): se consultan sin recorrer el catalogo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @return OK(0) si se envia el listado, ERROR(-1) si ocurre un problema de envio.
+*/
+int listar_populares_servidor(Conexion* conexion, uint32_t id);
+
+/*!
+ * @brief   Sincroniza la copia del catalogo de un cliente (ver SOL_CATALOGO).
+ *          Si la version del cliente es la vigente solo se envia la trama de fin. Si es una version anterior que
+ *          todavia esta en el historial, se envian las canciones cuya huella cambio y se quitan las que ya no
+ *          estan; si no, se envia el catalogo completo.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param carga    Version de la copia del cliente en hexadecimal (vacia si no tiene copia).
+ * @return OK(0) si se envia la respuesta, ERROR(-1) si ocurre un problema de envio.
+*/
+int sincronizar_catalogo_servidor(Conexion* conexion, uint32_t id, char* carga);
+
+/*!
+ * @brief   Lista las canciones del catalogo ordenadas por anio, titulo, artista, genero o album.
+ *          Recorre la permutacion precalculada del orden pedido: no ordena nada al atender la solicitud.
+ *          Solo se listan las canciones con los cinco campos.
+ * @param conexion Estado de la conexion (planificador de salida y transporte).
+ * @param id       Identificador de la solicitud.
+ * @param orden    Orden del listado (ORDEN_ANIO a ORDEN_ALBUM).
+ * @return OK(0) si la conexion puede seguir (aunque el orden sea invalido), ERROR(-1) si ocurre un problema de envio.
+*/
+int listar_ordenado_servidor(Conexion* conexion, uint32_t id, int orden);
 
 /*!
- * @brief   Menu principal del servidor para gestionar opciones de canciones.
- *          Recibe las opciones seleccionadas por el cliente y llama a las funciones correspondientes
- *          para listar, filtrar o enviar canciones.
- * @param client_sock Descriptor del socket del cliente conectado.
- * @param buffer      Buffer utilizado para enviar y recibir datos.
+ * @brief   Atiende una solicitud de canciones del cliente.
+ *          Segun el tipo de solicitud llama a la funcion correspondiente para listar, filtrar o enviar canciones.
+ * @param conexion Estado de la conexion con el cliente.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de solicitud (SOL_LISTAR, SOL_FILTRAR, SOL_CATALOGO, SOL_SUSCRIBIR, SOL_CANCION, SOL_DESDE,
+ *                 SOL_LOTE, SOL_PRECARGA, SOL_DESCRIPTOR, SOL_VENTANA o SOL_CANCELAR).
+ * @param carga    Carga util de la solicitud.
+ * @param longitud Bytes de la carga util (SOL_VENTANA lleva exactamente 4).
+ * @return OK(0) si la conexion puede seguir, ERROR(-1) si ocurre un problema de comunicacion.
 */
-void menu_canciones_servidor(int client_sock, char* buffer);
\ No newline at end of file
+int atender_solicitud_canciones(Conexion* conexion, uint32_t id, uint8_t tipo, char* carga, uint32_t longitud);
\ No newline at end of file
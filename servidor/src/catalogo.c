@@ -0,0 +1,957 @@
+/*!
+ * @file    catalogo.c
+ * @brief   Catalogo de canciones en memoria del servidor, con indices ordenados.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Cargar media.csv en memoria de una sola lectura, separando los campos de cada linea.
+ *          - Codificar cada campo con un diccionario de valores distintos e informar la memoria ahorrada.
+ *          - Precalcular las permutaciones de las canciones ordenadas por cada campo.
+ *          - Volver a cargar el catalogo cuando media.csv cambia, sin liberar el anterior mientras se use.
+ *          - Calcular la huella de cada cancion y la version del catalogo, y guardar las de las versiones anteriores.
+ *          - Resolver valores exactos y rangos de anios con busqueda binaria sobre los diccionarios y las permutaciones.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "catalogo.h"
+#include "trigramas.h"
+#include "transporte.h"
+#include "canciones.h"
+#include "bitacora.h"
+
+static Catalogo* vigente = NULL;
+static int cargando = 0;                 // 1 mientras una solicitud carga el catalogo nuevo.
+static struct stat fallido;              // datos de media.csv en la ultima carga que fallo.
+static pthread_mutex_t catalogo_mutex = PTHREAD_MUTEX_INITIALIZER; // protege vigente, la carga, las referencias y el historial.
+static pthread_cond_t catalogo_cargado = PTHREAD_COND_INITIALIZER; // avisa que termino una carga.
+
+/*!
+ * @struct Version
+ * @brief Huellas de una version anterior del catalogo.
+*/
+typedef struct Version
+{
+    uint64_t version;             /**< Version (0 si la entrada esta libre). */
+    uint64_t* huellas;            /**< Huella de cada cancion de esa version. */
+    int cantidad;                 /**< Cantidad de canciones de esa version. */
+} Version;
+
+static Version historial[CATALOGO_VERSIONES]; // versiones anteriores, la mas vieja se reemplaza primero.
+static int proxima_version = 0;                // entrada del historial que se reemplaza a continuacion.
+
+/*!
+ * @struct Distinto
+ * @brief Valor distinto de un campo mientras se arma su diccionario.
+*/
+typedef struct Distinto
+{
+    const char* valor;            /**< Valor, en el texto del archivo. */
+    uint32_t provisoria;          /**< Clave en el orden en que aparecio por primera vez. */
+} Distinto;
+
+/*!
+ * @brief   Compara dos canciones por anio y, a igual anio, por numero de linea.
+ * @param a Primera cancion (Cancion**).
+ * @param b Segunda cancion (Cancion**).
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_anio(const void* a, const void* b)
+{
+    const Cancion* x = *(Cancion* const*)a;
+    const Cancion* y = *(Cancion* const*)b;
+
+    if (x->anio != y->anio)
+    {
+        return (x->anio > y->anio) - (x->anio < y->anio);
+    }
+    return x->numero - y->numero;
+}
+
+/*!
+ * @brief   Compara dos valores distintos sin distinguir mayusculas y, si son iguales, distinguiendolas.
+ * @param a Primer valor (Distinto*).
+ * @param b Segundo valor (Distinto*).
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_distintos(const void* a, const void* b)
+{
+    const Distinto* x = a;
+    const Distinto* y = b;
+    int diferencia = strcasecmp(x->valor, y->valor);
+
+    return (diferencia != 0) ? diferencia : strcmp(x->valor, y->valor);
+}
+
+/*!
+ * @brief   Calcula el hash FNV-1a de un texto, para ubicarlo en la tabla de valores distintos.
+ * @param texto Texto.
+ * @return Hash del texto.
+*/
+static uint32_t dispersar(const char* texto)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *texto != '\0'; texto++)
+    {
+        hash = (hash ^ (unsigned char)*texto) * 16777619u;
+    }
+    return hash;
+}
+
+/*!
+ * @brief   Convierte el campo de anio a numero.
+ * @param texto Campo de anio.
+ * @return Anio, o 0 si el campo no es un numero.
+*/
+static int leer_anio(const char* texto)
+{
+    int anio = 0;
+
+    if (*texto == '\0')
+    {
+        return 0;
+    }
+    for (; *texto != '\0'; texto++)
+    {
+        if (!isdigit((unsigned char)*texto) || anio > 99999)
+        {
+            return 0;
+        }
+        anio = anio * 10 + (*texto - '0');
+    }
+    return anio;
+}
+
+/*!
+ * @brief   Separa una linea en campos, como strtok con ",": los campos vacios se saltean
+ *          y lo que sigue al quinto campo se ignora.
+ * @param linea   Linea terminada en '\0' (se modifica).
+ * @param campos  Campos de la linea (CAMPOS elementos); los que faltan quedan vacios.
+ * @param cancion Cancion a completar con el anio y si esta completa.
+*/
+static void separar_linea(char* linea, const char** campos, Cancion* cancion)
+{
+    int i = 0;
+    char* token = NULL;
+    char* resto = NULL;
+
+    for (token = strtok_r(linea, ",", &resto); token != NULL && i < CAMPOS; token = strtok_r(NULL, ",", &resto))
+    {
+        campos[i++] = token;
+    }
+    cancion->completa = (i == CAMPOS);
+    while (i < CAMPOS)
+    {
+        campos[i++] = "";
+    }
+    cancion->anio = leer_anio(campos[ANIO]);
+}
+
+/*!
+ * @brief   Libera un catalogo y sus indices.
+ * @param catalogo Catalogo a liberar (puede ser NULL).
+*/
+static void liberar_catalogo(Catalogo* catalogo)
+{
+    int i;
+
+    if (catalogo == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < ORDENES; i++)
+    {
+        free(catalogo->orden[i]);
+    }
+    for (i = 0; i < CAMPOS; i++)
+    {
+        free(catalogo->diccionarios[i].texto);
+        free(catalogo->diccionarios[i].valores);
+        free(catalogo->diccionarios[i].clases);
+    }
+    trigramas_liberar(catalogo->trigramas);
+    free(catalogo->huellas);
+    free(catalogo->canciones);
+    free(catalogo);
+}
+
+/*!
+ * @brief   Lee el archivo del catalogo completo en memoria.
+ * @param catalogo Catalogo donde dejar los datos del archivo.
+ * @param texto    Contenido del archivo (se libera con free()).
+ * @return OK(0) si se lee, ERROR(-1) si no se pudo leer, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int leer_archivo(Catalogo* catalogo, char** texto)
+{
+    int fd;
+    size_t leidos = 0;
+    ssize_t bytes;
+    struct stat datos;
+
+    if ((fd = open(CATALOGO_RUTA, O_RDONLY)) < 0)
+    {
+        return ERROR;
+    }
+    if (fstat(fd, &datos) < 0)
+    {
+        close(fd);
+        return ERROR;
+    }
+    if ((*texto = malloc(datos.st_size + 1)) == NULL)
+    {
+        close(fd);
+        return ERROR_DE_MEMORIA;
+    }
+    while (leidos < (size_t)datos.st_size && (bytes = read(fd, *texto + leidos, datos.st_size - leidos)) > 0)
+    {
+        leidos += bytes;
+    }
+    close(fd);
+    (*texto)[leidos] = '\0';
+    catalogo->dispositivo = datos.st_dev;
+    catalogo->inodo = datos.st_ino;
+    catalogo->tamanio = datos.st_size;
+    catalogo->modificado = datos.st_mtim;
+    return OK;
+}
+
+/*!
+ * @brief   Separa el texto del catalogo en canciones, una por linea.
+ * @param catalogo Catalogo donde dejar las canciones.
+ * @param texto    Contenido del archivo (se modifica).
+ * @param campos   Campos de cada cancion, CAMPOS por cancion y apuntando a texto (se libera con free()).
+ * @return OK(0) si se separa, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int separar_canciones(Catalogo* catalogo, char* texto, const char*** campos)
+{
+    int lineas = 0;
+    char* linea = texto;
+    char* fin = NULL;
+
+    for (fin = texto; (fin = strchr(fin, '\n')) != NULL; fin++)
+    {
+        lineas++;
+    }
+    lineas += (*texto != '\0' && texto[strlen(texto) - 1] != '\n');
+    if ((catalogo->canciones = calloc(lineas + 1, sizeof(Cancion))) == NULL
+        || (*campos = malloc((lineas + 1) * CAMPOS * sizeof(const char*))) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    while (*linea != '\0')
+    {
+        if ((fin = strchr(linea, '\n')) != NULL)
+        {
+            *fin = '\0';
+        }
+        catalogo->canciones[catalogo->cantidad].numero = catalogo->cantidad + 1;
+        separar_linea(linea, *campos + (size_t)catalogo->cantidad * CAMPOS, &catalogo->canciones[catalogo->cantidad]);
+        catalogo->cantidad++;
+        if (fin == NULL)
+        {
+            break;
+        }
+        linea = fin + 1;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Arma el diccionario de un campo y reemplaza cada valor por su clave.
+ *          Primero junta los valores distintos con una tabla hash, despues los ordena sin distinguir
+ *          mayusculas y copia cada uno una sola vez al texto del diccionario.
+ * @param catalogo Catalogo con las canciones ya separadas.
+ * @param campos   Campos de cada cancion (ver separar_canciones()).
+ * @param campo    Campo a codificar (TITULO a ANIO).
+ * @return OK(0) si se arma, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int codificar_campo(Catalogo* catalogo, const char** campos, int campo)
+{
+    int i, cantidad = 0;
+    size_t bytes = 0, tamanio = 2, posicion, largo;
+    const char* valor = NULL;
+    uint32_t* tabla = NULL;
+    uint32_t* claves = NULL;
+    Distinto* distintos = NULL;
+    Diccionario* diccionario = &catalogo->diccionarios[campo];
+
+    while (tamanio < 2 * (size_t)catalogo->cantidad)
+    {
+        tamanio *= 2;
+    }
+    // la tabla guarda la clave provisoria mas uno; cero indica un lugar libre.
+    if ((tabla = calloc(tamanio, sizeof(uint32_t))) == NULL
+        || (distintos = malloc((catalogo->cantidad + 1) * sizeof(Distinto))) == NULL)
+    {
+        free(tabla);
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < catalogo->cantidad; i++)
+    {
+        valor = campos[(size_t)i * CAMPOS + campo];
+        largo = strlen(valor) + 1;
+        diccionario->memoria_texto += largo + sizeof(const char*);
+        for (posicion = dispersar(valor) & (tamanio - 1);
+             tabla[posicion] != 0 && strcmp(distintos[tabla[posicion] - 1].valor, valor) != 0;
+             posicion = (posicion + 1) & (tamanio - 1))
+        {
+        }
+        if (tabla[posicion] == 0)
+        {
+            distintos[cantidad].valor = valor;
+            distintos[cantidad].provisoria = cantidad;
+            tabla[posicion] = ++cantidad;
+            bytes += largo;
+        }
+        catalogo->canciones[i].claves[campo] = tabla[posicion] - 1;
+    }
+    free(tabla);
+    qsort(distintos, cantidad, sizeof(Distinto), comparar_distintos);
+    if ((diccionario->texto = malloc(bytes + 1)) == NULL
+        || (diccionario->valores = malloc((cantidad + 1) * sizeof(const char*))) == NULL
+        || (diccionario->clases = malloc((cantidad + 1) * sizeof(uint32_t))) == NULL
+        || (claves = malloc((cantidad + 1) * sizeof(uint32_t))) == NULL)
+    {
+        free(distintos);
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0, bytes = 0; i < cantidad; i++)
+    {
+        largo = strlen(distintos[i].valor) + 1;
+        memcpy(diccionario->texto + bytes, distintos[i].valor, largo);
+        diccionario->valores[i] = diccionario->texto + bytes;
+        bytes += largo;
+        claves[distintos[i].provisoria] = i;
+        // los valores iguales sin distinguir mayusculas quedan juntos: comparten la clase del primero.
+        diccionario->clases[i] = (i > 0 && strcasecmp(diccionario->valores[i - 1], diccionario->valores[i]) == 0)
+                                 ? diccionario->clases[i - 1] : (uint32_t)i;
+    }
+    for (i = 0; i < catalogo->cantidad; i++)
+    {
+        catalogo->canciones[i].claves[campo] = claves[catalogo->canciones[i].claves[campo]];
+    }
+    free(claves);
+    free(distintos);
+    diccionario->cantidad = cantidad;
+    diccionario->memoria = bytes + cantidad * (sizeof(const char*) + sizeof(uint32_t))
+                           + catalogo->cantidad * sizeof(uint32_t);
+    return OK;
+}
+
+/*!
+ * @brief   Arma la permutacion de un campo de texto contando canciones por clase: como las clases siguen el
+ *          orden de los valores y las canciones se recorren en el orden del archivo, no hace falta comparar textos.
+ * @param catalogo Catalogo con los diccionarios ya armados.
+ * @param campo    Campo de texto (TITULO, ARTISTA, ALBUM o GENERO).
+ * @return OK(0) si se arma, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int ordenar_campo(Catalogo* catalogo, int campo)
+{
+    int i;
+    uint32_t clase;
+    Cancion** orden = catalogo->orden[catalogo_orden_campo(campo)];
+    int* inicios = calloc(catalogo->diccionarios[campo].cantidad + 1, sizeof(int));
+
+    if (inicios == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < catalogo->cantidad; i++)
+    {
+        if (catalogo->canciones[i].completa)
+        {
+            inicios[catalogo_clase(catalogo, &catalogo->canciones[i], campo) + 1]++;
+        }
+    }
+    for (i = 0; i < catalogo->diccionarios[campo].cantidad; i++)
+    {
+        inicios[i + 1] += inicios[i];
+    }
+    for (i = 0; i < catalogo->cantidad; i++)
+    {
+        if (catalogo->canciones[i].completa)
+        {
+            clase = catalogo_clase(catalogo, &catalogo->canciones[i], campo);
+            orden[inicios[clase]++] = &catalogo->canciones[i];
+        }
+    }
+    free(inicios);
+    return OK;
+}
+
+/*!
+ * @brief   Arma las permutaciones del catalogo: la del archivo con todas las canciones y las ordenadas
+ *          solo con las canciones completas.
+ * @param catalogo Catalogo con las canciones ya codificadas.
+ * @return OK(0) si se arman, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int ordenar(Catalogo* catalogo)
+{
+    int i;
+    static const int campos[] = { TITULO, ARTISTA, GENERO, ALBUM };
+
+    for (i = 0; i < ORDENES; i++)
+    {
+        if ((catalogo->orden[i] = malloc((catalogo->cantidad + 1) * sizeof(Cancion*))) == NULL)
+        {
+            return ERROR_DE_MEMORIA;
+        }
+    }
+    for (i = 0; i < catalogo->cantidad; i++)
+    {
+        catalogo->orden[ORDEN_ARCHIVO][i] = &catalogo->canciones[i];
+        if (catalogo->canciones[i].completa)
+        {
+            catalogo->orden[ORDEN_ANIO][catalogo->completas++] = &catalogo->canciones[i];
+        }
+    }
+    qsort(catalogo->orden[ORDEN_ANIO], catalogo->completas, sizeof(Cancion*), comparar_anio);
+    for (i = 0; i < (int)(sizeof(campos) / sizeof(campos[0])); i++)
+    {
+        if (ordenar_campo(catalogo, campos[i]) != OK)
+        {
+            return ERROR_DE_MEMORIA;
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Informa cuanta memoria ocupan los diccionarios frente a los mismos valores como textos sueltos.
+ * @param catalogo Catalogo cargado.
+*/
+static void informar_memoria(const Catalogo* catalogo)
+{
+    int i;
+    size_t memoria = 0, memoria_texto = 0;
+    static const char* nombres[CAMPOS] = { "titulo", "artista", "album", "genero", "anio" };
+
+    for (i = 0; i < CAMPOS; i++)
+    {
+        memoria += catalogo->diccionarios[i].memoria;
+        memoria_texto += catalogo->diccionarios[i].memoria_texto;
+        bitacora(NIVEL_INFO, "Diccionario de %s: %d valores, %zu KiB (%zu KiB como textos).\n", nombres[i],
+                 catalogo->diccionarios[i].cantidad, catalogo->diccionarios[i].memoria / 1024,
+                 catalogo->diccionarios[i].memoria_texto / 1024);
+    }
+    bitacora(NIVEL_INFO, "Diccionarios: %zu KiB en lugar de %zu KiB (%.1f%% menos).\n", memoria / 1024,
+             memoria_texto / 1024, memoria_texto > 0 ? 100.0 * (1.0 - (double)memoria / memoria_texto) : 0.0);
+}
+
+/*!
+ * @brief   Calcula la huella de cada cancion (hash FNV-1a de 64 bits de sus campos) y la version del catalogo
+ *          (hash de las huellas en el orden del archivo).
+ * @param catalogo Catalogo con los campos ya codificados.
+ * @return OK(0) si se calculan, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int calcular_huellas(Catalogo* catalogo)
+{
+    int i, campo, byte;
+    uint64_t huella, version = 14695981039346656037ull;
+    const char* texto = NULL;
+
+    if ((catalogo->huellas = malloc((catalogo->cantidad + 1) * sizeof(uint64_t))) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < catalogo->cantidad; i++)
+    {
+        huella = 14695981039346656037ull;
+        for (campo = 0; campo < CAMPOS; campo++)
+        {
+            for (texto = catalogo_texto(catalogo, &catalogo->canciones[i], campo); *texto != '\0'; texto++)
+            {
+                huella = (huella ^ (unsigned char)*texto) * 1099511628211ull;
+            }
+            huella = (huella ^ ',') * 1099511628211ull; // separa "ab","c" de "a","bc".
+        }
+        huella = (huella ^ (uint64_t)catalogo->canciones[i].completa) * 1099511628211ull;
+        catalogo->huellas[i] = huella;
+        for (byte = 0; byte < 8; byte++)
+        {
+            version = (version ^ ((huella >> (byte * 8)) & 0xff)) * 1099511628211ull;
+        }
+    }
+    // la version 0 la usa el cliente que todavia no tiene copia.
+    catalogo->version = (version != 0) ? version : 1;
+    return OK;
+}
+
+/*!
+ * @brief   Guarda en el historial las huellas de un catalogo que se reemplaza. Debe llamarse con catalogo_mutex tomado.
+ *          Si no hay memoria, la version simplemente no se guarda: sus clientes reciben el catalogo completo.
+ * @param catalogo Catalogo que deja de ser el vigente.
+*/
+static void guardar_version(const Catalogo* catalogo)
+{
+    Version* entrada = &historial[proxima_version];
+    uint64_t* huellas = malloc((catalogo->cantidad + 1) * sizeof(uint64_t));
+
+    if (huellas == NULL)
+    {
+        return;
+    }
+    memcpy(huellas, catalogo->huellas, catalogo->cantidad * sizeof(uint64_t));
+    free(entrada->huellas);
+    entrada->version = catalogo->version;
+    entrada->huellas = huellas;
+    entrada->cantidad = catalogo->cantidad;
+    proxima_version = (proxima_version + 1) % CATALOGO_VERSIONES;
+}
+
+/*!
+ * @brief   Carga media.csv, codifica sus campos y arma sus indices.
+ * @return Catalogo nuevo con una referencia, o NULL si ocurre un problema.
+*/
+static Catalogo* cargar(void)
+{
+    int i, estado = OK;
+    char* texto = NULL;
+    const char** campos = NULL;
+    Catalogo* catalogo = calloc(1, sizeof(Catalogo));
+
+    if (catalogo == NULL)
+    {
+        bitacora_error("Error al reservar memoria para el catalogo.\n");
+        return NULL;
+    }
+    if (leer_archivo(catalogo, &texto) != OK)
+    {
+        bitacora_error("No se pudo leer el catalogo de canciones.\n");
+        liberar_catalogo(catalogo);
+        return NULL;
+    }
+    estado = separar_canciones(catalogo, texto, &campos);
+    for (i = 0; i < CAMPOS && estado == OK; i++)
+    {
+        estado = codificar_campo(catalogo, campos, i);
+    }
+    // los diccionarios tienen su propia copia de los valores: el texto del archivo ya no hace falta.
+    free(campos);
+    free(texto);
+    if (estado != OK || ordenar(catalogo) != OK || trigramas_construir(catalogo) != OK || calcular_huellas(catalogo) != OK)
+    {
+        bitacora_error("Error al reservar memoria para el catalogo.\n");
+        liberar_catalogo(catalogo);
+        return NULL;
+    }
+    catalogo->referencias = 1;
+    bitacora(NIVEL_INFO, "Catalogo cargado: %d canciones.\n", catalogo->cantidad);
+    informar_memoria(catalogo);
+    return catalogo;
+}
+
+/*!
+ * @brief   Indica si media.csv cambio desde que se cargo el catalogo.
+ * @param catalogo Catalogo cargado.
+ * @param datos    Datos actuales de media.csv.
+ * @return 1 si cambio, 0 si no.
+*/
+static int cambio(const Catalogo* catalogo, const struct stat* datos)
+{
+    return catalogo->dispositivo != datos->st_dev || catalogo->inodo != datos->st_ino
+           || catalogo->tamanio != datos->st_size
+           || catalogo->modificado.tv_sec != datos->st_mtim.tv_sec
+           || catalogo->modificado.tv_nsec != datos->st_mtim.tv_nsec;
+}
+
+/*!
+ * @brief   Indica si media.csv es el mismo archivo cuya carga fallo la ultima vez.
+ * @param datos Datos actuales de media.csv.
+ * @return 1 si es el mismo (no se vuelve a intentar hasta que cambie), 0 si no.
+*/
+static int ya_fallo(const struct stat* datos)
+{
+    return fallido.st_ino != 0 && fallido.st_dev == datos->st_dev && fallido.st_ino == datos->st_ino
+           && fallido.st_size == datos->st_size && fallido.st_mtim.tv_sec == datos->st_mtim.tv_sec
+           && fallido.st_mtim.tv_nsec == datos->st_mtim.tv_nsec;
+}
+
+/*!
+ * @brief   Devuelve el catalogo vigente, cargandolo si todavia no se cargo o si media.csv cambio.
+ *          Una sola solicitud carga el catalogo nuevo, sin el mutex tomado; mientras tanto las demas siguen
+ *          usando el anterior (solo esperan si todavia no hay ninguno). Si la carga falla se sigue usando el
+ *          anterior y no se vuelve a intentar hasta que media.csv cambie otra vez.
+ *          Debe devolverse con catalogo_soltar() al terminar de usarlo.
+ * @return Catalogo, o NULL si no hay ninguno cargado y no se pudo leer media.csv o no hay memoria.
+*/
+Catalogo* catalogo_obtener(void)
+{
+    struct stat datos;
+    Catalogo* catalogo = NULL;
+    int existe = (stat(CATALOGO_RUTA, &datos) == 0);
+
+    pthread_mutex_lock(&catalogo_mutex);
+    while (existe && (vigente == NULL || cambio(vigente, &datos)) && !ya_fallo(&datos))
+    {
+        if (cargando)
+        {
+            if (vigente != NULL)
+            {
+                break; // mientras otra solicitud carga el nuevo, se usa el anterior.
+            }
+            pthread_cond_wait(&catalogo_cargado, &catalogo_mutex);
+            continue;
+        }
+        cargando = 1;
+        pthread_mutex_unlock(&catalogo_mutex);
+        catalogo = cargar();
+        pthread_mutex_lock(&catalogo_mutex);
+        cargando = 0;
+        pthread_cond_broadcast(&catalogo_cargado);
+        if (catalogo == NULL)
+        {
+            fallido = datos;
+            break;
+        }
+        memset(&fallido, 0, sizeof(fallido));
+        if (vigente != NULL && vigente->version != catalogo->version)
+        {
+            guardar_version(vigente);
+        }
+        if (vigente != NULL && --vigente->referencias == 0)
+        {
+            liberar_catalogo(vigente);
+        }
+        vigente = catalogo;
+        break;
+    }
+    if ((catalogo = vigente) != NULL)
+    {
+        catalogo->referencias++;
+    }
+    pthread_mutex_unlock(&catalogo_mutex);
+    return catalogo;
+}
+
+/*!
+ * @brief   Suelta una referencia obtenida con catalogo_obtener(). Si el catalogo ya fue reemplazado
+ *          y nadie mas lo usa, se libera.
+ * @param catalogo Catalogo a soltar.
+*/
+void catalogo_soltar(Catalogo* catalogo)
+{
+    int restantes;
+
+    pthread_mutex_lock(&catalogo_mutex);
+    restantes = --catalogo->referencias;
+    pthread_mutex_unlock(&catalogo_mutex);
+    if (restantes == 0)
+    {
+        liberar_catalogo(catalogo);
+    }
+}
+
+/*!
+ * @brief   Copia las huellas de una version anterior del catalogo, si todavia se guardan.
+ * @param version  Version buscada.
+ * @param cantidad Cantidad de canciones de esa version.
+ * @return Huellas (se liberan con free()), o NULL si la version no se guarda o no hay memoria.
+*/
+uint64_t* catalogo_huellas_version(uint64_t version, int* cantidad)
+{
+    int i;
+    uint64_t* huellas = NULL;
+
+    pthread_mutex_lock(&catalogo_mutex);
+    for (i = 0; i < CATALOGO_VERSIONES && version != 0; i++)
+    {
+        if (historial[i].version == version)
+        {
+            if ((huellas = malloc((historial[i].cantidad + 1) * sizeof(uint64_t))) != NULL)
+            {
+                memcpy(huellas, historial[i].huellas, historial[i].cantidad * sizeof(uint64_t));
+                *cantidad = historial[i].cantidad;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&catalogo_mutex);
+    return huellas;
+}
+
+/*!
+ * @brief   Recorre las canciones que cambiaron desde una version anterior y arma una fila por cada una, en el
+ *          formato de SOL_CATALOGO: "+N,C,titulo,artista,album,genero,anio" para las agregadas o cambiadas y
+ *          "-N" para las quitadas (o que quedaron como lineas vacias), cada una con su salto de linea.
+ * @param catalogo   Catalogo vigente.
+ * @param huellas    Huellas de la version anterior (ver catalogo_huellas_version()), o NULL para todas las canciones.
+ * @param anteriores Cantidad de canciones de la version anterior.
+ * @param agregar    Funcion que recibe cada fila; si no devuelve OK el recorrido se corta.
+ * @param contexto   Dato que se pasa a agregar.
+ * @return Cantidad de filas, o ERROR(-1) si agregar fallo.
+*/
+int catalogo_cambios(const Catalogo* catalogo, const uint64_t* huellas, int anteriores,
+                     int (*agregar)(void* contexto, const char* fila), void* contexto)
+{
+    int i, filas = 0;
+    char fila[BUFFER_SIZE];
+    const Cancion* cancion = NULL;
+
+    for (i = 0; i < catalogo->cantidad || i < anteriores; i++)
+    {
+        cancion = &catalogo->canciones[i];
+        if (i >= catalogo->cantidad || (catalogo_vacia(catalogo, cancion) && huellas != NULL && i < anteriores
+                                         && huellas[i] != catalogo->huellas[i]))
+        {
+            snprintf(fila, sizeof(fila), "-%d\n", i + 1);
+        } else if (catalogo_vacia(catalogo, cancion))
+        {
+            continue; // un numero libre: el cliente no lo tiene o ya se le quito.
+        } else if (huellas == NULL || i >= anteriores || huellas[i] != catalogo->huellas[i])
+        {
+            // una linea mas larga que la fila se corta, pero sigue terminando en salto de linea.
+            if (snprintf(fila, sizeof(fila), "+%d,%d,%s,%s,%s,%s,%s\n", cancion->numero, cancion->completa,
+                         catalogo_texto(catalogo, cancion, TITULO), catalogo_texto(catalogo, cancion, ARTISTA),
+                         catalogo_texto(catalogo, cancion, ALBUM), catalogo_texto(catalogo, cancion, GENERO),
+                         catalogo_texto(catalogo, cancion, ANIO)) >= (int)sizeof(fila))
+            {
+                fila[sizeof(fila) - 2] = '\n';
+            }
+        } else
+        {
+            continue;
+        }
+        if (agregar(contexto, fila) != OK)
+        {
+            return ERROR;
+        }
+        filas++;
+    }
+    return filas;
+}
+
+/*!
+ * @brief   Busca la primera posicion de la permutacion por anio cuyo anio es mayor o igual al dado.
+ * @param catalogo Catalogo donde buscar.
+ * @param anio     Anio buscado.
+ * @return Posicion en catalogo->orden[ORDEN_ANIO] (catalogo->completas si no hay ninguna).
+*/
+static int primera_posicion(const Catalogo* catalogo, int anio)
+{
+    int bajo = 0, alto = catalogo->completas, medio;
+
+    while (bajo < alto)
+    {
+        medio = bajo + (alto - bajo) / 2;
+        if (catalogo->orden[ORDEN_ANIO][medio]->anio < anio)
+        {
+            bajo = medio + 1;
+        } else
+        {
+            alto = medio;
+        }
+    }
+    return bajo;
+}
+
+/*!
+ * @brief   Devuelve la permutacion ordenada por un campo (ver ORDEN_ANIO a ORDEN_ALBUM).
+ * @param campo Campo (TITULO a ANIO).
+ * @return Orden correspondiente.
+*/
+int catalogo_orden_campo(int campo)
+{
+    static const int ordenes[CAMPOS] = { ORDEN_TITULO, ORDEN_ARTISTA, ORDEN_ALBUM, ORDEN_GENERO, ORDEN_ANIO };
+
+    return ordenes[campo];
+}
+
+/*!
+ * @brief   Devuelve el texto de un campo de una cancion.
+ * @param catalogo Catalogo de la cancion.
+ * @param cancion  Cancion.
+ * @param campo    Campo (TITULO a ANIO).
+ * @return Texto del campo (vacio si falta).
+*/
+const char* catalogo_texto(const Catalogo* catalogo, const Cancion* cancion, int campo)
+{
+    return catalogo->diccionarios[campo].valores[cancion->claves[campo]];
+}
+
+/*!
+ * @brief   Indica si una cancion es una linea vacia de media.csv: el numero de un archivo que se quito, que
+ *          el escaner deja libre para no renumerar las demas. No se lista ni se envia a los clientes.
+ * @param catalogo Catalogo de la cancion.
+ * @param cancion  Cancion.
+ * @return 1 si la linea no tiene campos, 0 si no.
+*/
+int catalogo_vacia(const Catalogo* catalogo, const Cancion* cancion)
+{
+    // los campos vacios se saltean al separar la linea: sin titulo no hay ningun campo.
+    return catalogo_texto(catalogo, cancion, TITULO)[0] == '\0';
+}
+
+/*!
+ * @brief   Devuelve la clase de un campo de una cancion: la misma para los valores iguales sin distinguir mayusculas.
+ * @param catalogo Catalogo de la cancion.
+ * @param cancion  Cancion.
+ * @param campo    Campo (TITULO a ANIO).
+ * @return Clase del valor.
+*/
+uint32_t catalogo_clase(const Catalogo* catalogo, const Cancion* cancion, int campo)
+{
+    return catalogo->diccionarios[campo].clases[cancion->claves[campo]];
+}
+
+/*!
+ * @brief   Busca la clase de un valor en el diccionario de un campo, sin distinguir mayusculas.
+ * @param catalogo Catalogo donde buscar.
+ * @param campo    Campo (TITULO a ANIO).
+ * @param valor    Valor buscado.
+ * @return Clase del valor, o CLAVE_NINGUNA si ninguna cancion lo tiene.
+*/
+uint32_t catalogo_clase_valor(const Catalogo* catalogo, int campo, const char* valor)
+{
+    int bajo = 0, medio;
+    const Diccionario* diccionario = &catalogo->diccionarios[campo];
+    int alto = diccionario->cantidad;
+
+    while (bajo < alto)
+    {
+        medio = bajo + (alto - bajo) / 2;
+        if (strcasecmp(diccionario->valores[medio], valor) < 0)
+        {
+            bajo = medio + 1;
+        } else
+        {
+            alto = medio;
+        }
+    }
+    // el primer valor igual sin distinguir mayusculas es el que da la clase.
+    if (bajo == diccionario->cantidad || strcasecmp(diccionario->valores[bajo], valor) != 0)
+    {
+        return CLAVE_NINGUNA;
+    }
+    return (uint32_t)bajo;
+}
+
+/*!
+ * @brief   Busca la primera posicion de la permutacion de un campo de texto cuya clase es mayor o igual a la dada.
+ * @param catalogo Catalogo donde buscar.
+ * @param campo    Campo de texto.
+ * @param clase    Clase buscada.
+ * @return Posicion en la permutacion del campo (catalogo->completas si no hay ninguna).
+*/
+static int primera_posicion_clase(const Catalogo* catalogo, int campo, uint32_t clase)
+{
+    int bajo = 0, alto = catalogo->completas, medio;
+    Cancion* const* orden = catalogo->orden[catalogo_orden_campo(campo)];
+
+    while (bajo < alto)
+    {
+        medio = bajo + (alto - bajo) / 2;
+        if (catalogo_clase(catalogo, orden[medio], campo) < clase)
+        {
+            bajo = medio + 1;
+        } else
+        {
+            alto = medio;
+        }
+    }
+    return bajo;
+}
+
+/*!
+ * @brief   Busca las canciones cuyo campo de texto es igual a un valor, sin distinguir mayusculas.
+ *          Las canciones encontradas quedan consecutivas en la permutacion del campo y en el orden del archivo.
+ *          El valor se busca una vez en el diccionario; en la permutacion solo se comparan clases.
+ * @param catalogo Catalogo donde buscar.
+ * @param campo    Campo de texto (TITULO, ARTISTA, ALBUM o GENERO).
+ * @param valor    Valor buscado.
+ * @param inicio   Posicion en la permutacion del campo de la primera cancion encontrada.
+ * @return Cantidad de canciones encontradas.
+*/
+int catalogo_buscar(const Catalogo* catalogo, int campo, const char* valor, int* inicio)
+{
+    uint32_t clase = catalogo_clase_valor(catalogo, campo, valor);
+
+    *inicio = 0;
+    if (clase == CLAVE_NINGUNA)
+    {
+        return 0;
+    }
+    *inicio = primera_posicion_clase(catalogo, campo, clase);
+    return primera_posicion_clase(catalogo, campo, clase + 1) - *inicio;
+}
+
+/*!
+ * @brief   Busca las canciones de un rango de anios en la permutacion por anio.
+ * @param catalogo Catalogo donde buscar.
+ * @param desde    Primer anio del rango.
+ * @param hasta    Ultimo anio del rango (incluido).
+ * @param inicio   Posicion en catalogo->orden[ORDEN_ANIO] de la primera cancion del rango.
+ * @return Cantidad de canciones del rango (desde inicio, consecutivas en la permutacion).
+*/
+int catalogo_rango_anios(const Catalogo* catalogo, int desde, int hasta, int* inicio)
+{
+    *inicio = primera_posicion(catalogo, desde);
+    if (hasta < desde)
+    {
+        return 0;
+    }
+    return primera_posicion(catalogo, hasta + 1) - *inicio;
+}
+
+/*!
+ * @brief   Lee un anio de un rango, salteando los espacios de alrededor.
+ * @param texto Texto desde donde leer (avanza hasta despues del anio).
+ * @param anio  Anio leido.
+ * @return 1 si se leyo un anio, 0 si no hay digitos.
+*/
+static int leer_extremo(const char** texto, int* anio)
+{
+    int digitos = 0;
+
+    while (**texto == ' ')
+    {
+        (*texto)++;
+    }
+    for (*anio = 0; isdigit((unsigned char)**texto) && digitos < 6; (*texto)++, digitos++)
+    {
+        *anio = *anio * 10 + (**texto - '0');
+    }
+    while (**texto == ' ')
+    {
+        (*texto)++;
+    }
+    return digitos > 0;
+}
+
+/*!
+ * @brief   Interpreta un rango de anios: "1976-1986", "1979" (un solo anio), "1976-" o "-1986".
+ *          Acepta espacios alrededor de los numeros.
+ * @param texto Rango a interpretar.
+ * @param desde Primer anio del rango.
+ * @param hasta Ultimo anio del rango.
+ * @return OK(0) si el rango es valido, ERROR(-1) si no.
+*/
+int catalogo_leer_rango(const char* texto, int* desde, int* hasta)
+{
+    int hay_desde = leer_extremo(&texto, desde);
+    int hay_hasta;
+
+    if (*texto != '-')
+    {
+        *hasta = *desde;
+        return (hay_desde && *texto == '\0') ? OK : ERROR;
+    }
+    texto++;
+    hay_hasta = leer_extremo(&texto, hasta);
+    if (*texto != '\0' || (!hay_desde && !hay_hasta))
+    {
+        return ERROR;
+    }
+    // los extremos abiertos llegan hasta el primer o el ultimo anio valido.
+    *desde = hay_desde ? *desde : 1;
+    *hasta = hay_hasta ? *hasta : 999999;
+    return (*desde <= *hasta) ? OK : ERROR;
+}
@@ -0,0 +1,290 @@
+/*!
+ * @file    catalogo.h
+ * @brief   Definiciones y declaraciones del catalogo de canciones en memoria del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los campos de cada cancion y los ordenes disponibles para listarlas.
+ *          - Las estructuras Diccionario, Cancion y Catalogo.
+ *          - Declaraciones de funciones para obtener el catalogo, recorrerlo en orden y buscar valores o rangos de anios.
+ *          El catalogo se carga de media.csv la primera vez que se pide y se vuelve a cargar cuando el archivo
+ *          cambia. Al cargarlo se precalculan permutaciones ordenadas por cada campo, de modo que los listados
+ *          ordenados no ordenan nada, y un valor exacto de un campo o un rango de anios se resuelven con dos
+ *          busquedas binarias. Como a igual valor se respeta el orden del archivo, las canciones con un mismo
+ *          valor forman una lista creciente de posiciones (lista de apariciones) lista para intersecar.
+ *          Los campos se guardan codificados con un diccionario por campo: cada valor distinto se guarda una sola
+ *          vez y cada cancion guarda la clave (un entero) de su valor. Las claves siguen el orden de los valores
+ *          sin distinguir mayusculas, asi las permutaciones se arman contando claves y los filtros comparan
+ *          enteros en lugar de textos. Al cargar se informa cuanta memoria ocupan los diccionarios frente a los
+ *          textos sin codificar.
+ *          Tambien se arma el indice de trigramas de la busqueda aproximada (ver trigramas.h).
+ *          Cada cancion tiene una huella (hash de su linea) y el catalogo una version (hash de todas las huellas),
+ *          que los clientes usan para sincronizar su copia local (ver SOL_CATALOGO). Las huellas de las ultimas
+ *          CATALOGO_VERSIONES versiones se guardan al recargar, asi a un cliente con una version reciente solo
+ *          se le envian las canciones que cambiaron.
+ *          Cada solicitud toma una referencia al catalogo vigente y la suelta al terminar: una recarga no
+ *          libera el catalogo anterior mientras alguien lo este usando.
+*/
+
+#ifndef CATALOGO_H
+#define CATALOGO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+/*!
+ * @def CATALOGO_RUTA
+ * @brief Archivo del catalogo, relativo al directorio del servidor.
+*/
+#define CATALOGO_RUTA "media.csv"
+
+/*!
+ * @def CATALOGO_INDICE
+ * @brief Archivo con el archivo de cada cancion del catalogo (ver escaner.h), relativo al directorio del servidor.
+ *        La linea N tiene la ruta del archivo de la cancion N; si no existe, la cancion N es N.mp3.
+*/
+#define CATALOGO_INDICE "media.idx"
+
+/*!
+ * @def CATALOGO_VERSIONES
+ * @brief Versiones anteriores del catalogo cuyas huellas se guardan para sincronizar clientes con cambios.
+*/
+#define CATALOGO_VERSIONES 8
+
+/*!
+ * @def TITULO
+ * @brief Campo del titulo de la cancion (primer campo de media.csv).
+*/
+#define TITULO 0
+
+/*!
+ * @def ALBUM
+ * @brief Campo del album de la cancion.
+*/
+#define ALBUM 2
+
+/*!
+ * @def ANIO
+ * @brief Campo del anio de la cancion.
+*/
+#define ANIO 4
+
+/*!
+ * @def CAMPOS
+ * @brief Cantidad de campos de cada cancion (titulo, artista, album, genero y anio).
+*/
+#define CAMPOS 5
+
+/*!
+ * @def ORDEN_ARCHIVO
+ * @brief Listado en el orden de media.csv.
+*/
+#define ORDEN_ARCHIVO 0
+
+/*!
+ * @def ORDEN_ANIO
+ * @brief Listado por anio; a igual anio, en el orden del archivo.
+*/
+#define ORDEN_ANIO 1
+
+/*!
+ * @def ORDEN_TITULO
+ * @brief Listado por titulo sin distinguir mayusculas; a igual titulo, en el orden del archivo.
+*/
+#define ORDEN_TITULO 2
+
+/*!
+ * @def ORDEN_ARTISTA
+ * @brief Listado por artista sin distinguir mayusculas; a igual artista, en el orden del archivo.
+*/
+#define ORDEN_ARTISTA 3
+
+/*!
+ * @def ORDEN_GENERO
+ * @brief Listado por genero sin distinguir mayusculas; a igual genero, en el orden del archivo.
+*/
+#define ORDEN_GENERO 4
+
+/*!
+ * @def ORDEN_ALBUM
+ * @brief Listado por album sin distinguir mayusculas; a igual album, en el orden del archivo.
+*/
+#define ORDEN_ALBUM 5
+
+/*!
+ * @def ORDENES
+ * @brief Cantidad de ordenes de listado.
+*/
+#define ORDENES 6
+
+/*!
+ * @def CLAVE_NINGUNA
+ * @brief Clase que no corresponde a ningun valor de un diccionario.
+*/
+#define CLAVE_NINGUNA UINT32_MAX
+
+/*!
+ * @struct Diccionario
+ * @brief Valores distintos de un campo. La clave de un valor es su posicion en valores.
+*/
+typedef struct Diccionario
+{
+    char* texto;                  /**< Valores, uno detras de otro, terminados en '\0'. */
+    const char** valores;         /**< Valores ordenados sin distinguir mayusculas y, a igualdad, distinguiendolas. */
+    uint32_t* clases;             /**< Para cada clave, la primera clave con el mismo valor sin distinguir mayusculas. */
+    int cantidad;                 /**< Cantidad de valores. */
+    size_t memoria;               /**< Bytes que ocupa el diccionario, con las claves de las canciones. */
+    size_t memoria_texto;         /**< Bytes que ocuparian los valores como textos sueltos, uno por cancion. */
+} Diccionario;
+
+/*!
+ * @struct Cancion
+ * @brief Fila de media.csv, con sus campos codificados. Los campos que faltan quedan vacios.
+*/
+typedef struct Cancion
+{
+    uint32_t claves[CAMPOS];      /**< Clave de titulo, artista, album, genero y anio en su diccionario (ver TITULO a ANIO). */
+    int anio;                     /**< Anio como numero (0 si falta o no es valido). */
+    int numero;                   /**< Numero de linea en media.csv, el que ven los clientes. */
+    int completa;                 /**< 1 si la linea tiene los cinco campos. */
+} Cancion;
+
+/*!
+ * @struct Catalogo
+ * @brief Contenido de media.csv en memoria con sus indices.
+*/
+typedef struct Catalogo
+{
+    Diccionario diccionarios[CAMPOS]; /**< Diccionario de cada campo. */
+    Cancion* canciones;           /**< Canciones en el orden del archivo. */
+    int cantidad;                 /**< Cantidad de canciones. */
+    int completas;                /**< Cantidad de canciones con los cinco campos. */
+    Cancion** orden[ORDENES];     /**< Permutaciones en cada orden: la del archivo tiene todas las canciones
+                                       (cantidad) y las ordenadas solo las completas (completas). */
+    struct Trigramas* trigramas;  /**< Indice de trigramas para la busqueda aproximada (ver trigramas.h). */
+    uint64_t* huellas;            /**< Huella de cada cancion, en el orden del archivo. */
+    uint64_t version;             /**< Version del catalogo: hash de las huellas (nunca 0). */
+    dev_t dispositivo;            /**< Dispositivo de media.csv al cargarlo. */
+    ino_t inodo;                  /**< Inodo de media.csv al cargarlo. */
+    off_t tamanio;                /**< Tamanio de media.csv al cargarlo. */
+    struct timespec modificado;   /**< Ultima modificacion de media.csv al cargarlo. */
+    int referencias;              /**< Solicitudes que lo estan usando, mas una si es el vigente. */
+} Catalogo;
+
+/*!
+ * @brief   Devuelve el catalogo vigente, cargandolo si todavia no se cargo o si media.csv cambio.
+ *          Una sola solicitud carga el catalogo nuevo, sin el mutex tomado; mientras tanto las demas siguen
+ *          usando el anterior (solo esperan si todavia no hay ninguno). Si la carga falla se sigue usando el
+ *          anterior y no se vuelve a intentar hasta que media.csv cambie otra vez.
+ *          Debe devolverse con catalogo_soltar() al terminar de usarlo.
+ * @return Catalogo, o NULL si no hay ninguno cargado y no se pudo leer media.csv o no hay memoria.
+*/
+Catalogo* catalogo_obtener(void);
+
+/*!
+ * @brief   Suelta una referencia obtenida con catalogo_obtener(). Si el catalogo ya fue reemplazado
+ *          y nadie mas lo usa, se libera.
+ * @param catalogo Catalogo a soltar.
+*/
+void catalogo_soltar(Catalogo* catalogo);
+
+/*!
+ * @brief   Copia las huellas de una version anterior del catalogo, si todavia se guardan.
+ * @param version  Version buscada.
+ * @param cantidad Cantidad de canciones de esa version.
+ * @return Huellas (se liberan con free()), o NULL si la version no se guarda o no hay memoria.
+*/
+uint64_t* catalogo_huellas_version(uint64_t version, int* cantidad);
+
+/*!
+ * @brief   Recorre las canciones que cambiaron desde una version anterior y arma una fila por cada una, en el
+ *          formato de SOL_CATALOGO: "+N,C,titulo,artista,album,genero,anio" para las agregadas o cambiadas y
+ *          "-N" para las quitadas, cada una con su salto de linea.
+ * @param catalogo   Catalogo vigente.
+ * @param huellas    Huellas de la version anterior (ver catalogo_huellas_version()), o NULL para todas las canciones.
+ * @param anteriores Cantidad de canciones de la version anterior.
+ * @param agregar    Funcion que recibe cada fila; si no devuelve OK el recorrido se corta.
+ * @param contexto   Dato que se pasa a agregar.
+ * @return Cantidad de filas, o ERROR(-1) si agregar fallo.
+*/
+int catalogo_cambios(const Catalogo* catalogo, const uint64_t* huellas, int anteriores,
+                     int (*agregar)(void* contexto, const char* fila), void* contexto);
+
+/*!
+ * @brief   Busca las canciones de un rango de anios en la permutacion por anio.
+ * @param catalogo Catalogo donde buscar.
+ * @param desde    Primer anio del rango.
+ * @param hasta    Ultimo anio del rango (incluido).
+ * @param inicio   Posicion en catalogo->orden[ORDEN_ANIO] de la primera cancion del rango.
+ * @return Cantidad de canciones del rango (desde inicio, consecutivas en la permutacion).
+*/
+int catalogo_rango_anios(const Catalogo* catalogo, int desde, int hasta, int* inicio);
+
+/*!
+ * @brief   Devuelve la permutacion ordenada por un campo (ver ORDEN_ANIO a ORDEN_ALBUM).
+ * @param campo Campo (TITULO a ANIO).
+ * @return Orden correspondiente.
+*/
+int catalogo_orden_campo(int campo);
+
+/*!
+ * @brief   Devuelve el texto de un campo de una cancion.
+ * @param catalogo Catalogo de la cancion.
+ * @param cancion  Cancion.
+ * @param campo    Campo (TITULO a ANIO).
+ * @return Texto del campo (vacio si falta).
+*/
+const char* catalogo_texto(const Catalogo* catalogo, const Cancion* cancion, int campo);
+
+/*!
+ * @brief   Indica si una cancion es una linea vacia de media.csv: el numero de un archivo que se quito, que
+ *          el escaner deja libre para no renumerar las demas. No se lista ni se envia a los clientes.
+ * @param catalogo Catalogo de la cancion.
+ * @param cancion  Cancion.
+ * @return 1 si la linea no tiene campos, 0 si no.
+*/
+int catalogo_vacia(const Catalogo* catalogo, const Cancion* cancion);
+
+/*!
+ * @brief   Devuelve la clase de un campo de una cancion: la misma para los valores iguales sin distinguir mayusculas.
+ * @param catalogo Catalogo de la cancion.
+ * @param cancion  Cancion.
+ * @param campo    Campo (TITULO a ANIO).
+ * @return Clase del valor.
+*/
+uint32_t catalogo_clase(const Catalogo* catalogo, const Cancion* cancion, int campo);
+
+/*!
+ * @brief   Busca la clase de un valor en el diccionario de un campo, sin distinguir mayusculas.
+ * @param catalogo Catalogo donde buscar.
+ * @param campo    Campo (TITULO a ANIO).
+ * @param valor    Valor buscado.
+ * @return Clase del valor, o CLAVE_NINGUNA si ninguna cancion lo tiene.
+*/
+uint32_t catalogo_clase_valor(const Catalogo* catalogo, int campo, const char* valor);
+
+/*!
+ * @brief   Busca las canciones cuyo campo de texto es igual a un valor, sin distinguir mayusculas.
+ *          Las canciones encontradas quedan consecutivas en la permutacion del campo y en el orden del archivo.
+ *          El valor se busca una vez en el diccionario; en la permutacion solo se comparan clases.
+ * @param catalogo Catalogo donde buscar.
+ * @param campo    Campo de texto (TITULO, ARTISTA, ALBUM o GENERO).
+ * @param valor    Valor buscado.
+ * @param inicio   Posicion en la permutacion del campo de la primera cancion encontrada.
+ * @return Cantidad de canciones encontradas.
+*/
+int catalogo_buscar(const Catalogo* catalogo, int campo, const char* valor, int* inicio);
+
+/*!
+ * @brief   Interpreta un rango de anios: "1976-1986", "1979" (un solo anio), "1976-" o "-1986".
+ *          Acepta espacios alrededor de los numeros.
+ * @param texto Rango a interpretar.
+ * @param desde Primer anio del rango.
+ * @param hasta Ultimo anio del rango.
+ * @return OK(0) si el rango es valido, ERROR(-1) si no.
+*/
+int catalogo_leer_rango(const char* texto, int* desde, int* hasta);
+
+#endif
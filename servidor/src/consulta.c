@@ -0,0 +1,513 @@
+/*!
+ * @file    consulta.c
+ * @brief   Consultas combinadas sobre el catalogo de canciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Interpretar consultas con condiciones sobre los campos unidas con "&" y "|".
+ *          - Planificar cada conjuncion: estimar con los indices del catalogo cuantas canciones cumple cada
+ *            condicion y partir de la mas selectiva.
+ *          - Intersecar listas de apariciones con busqueda galopante y verificar las condiciones sin indice
+ *            comparando claves de los diccionarios del catalogo.
+ *          - Unir los resultados de las conjunciones manteniendo el orden del archivo.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "consulta.h"
+#include "transporte.h"
+#include "canciones.h"
+
+/*!
+ * @struct Lista
+ * @brief Lista de apariciones de una condicion: canciones que la cumplen, segun los indices del catalogo.
+*/
+typedef struct Lista
+{
+    Cancion* const* elementos;   /**< Canciones (NULL si la condicion no tiene indice). */
+    int cantidad;                /**< Cantidad de canciones (o del catalogo, si no tiene indice). */
+    int ordenada;                /**< 1 si las canciones estan en el orden del archivo. */
+    const Termino* termino;      /**< Condicion de la lista. */
+    const Catalogo* catalogo;    /**< Catalogo de las canciones. */
+    uint32_t clase;              /**< Clase del valor buscado (condiciones campo=valor). */
+    uint8_t* coincidencias;      /**< Para cada clave del diccionario del campo, 1 si contiene el texto (condiciones campo~texto). */
+} Lista;
+
+/*!
+ * @brief   Quita los espacios del principio y del final de un texto.
+ * @param texto Texto (se modifica).
+ * @return Comienzo del texto sin espacios.
+*/
+static char* recortar(char* texto)
+{
+    char* fin = NULL;
+
+    while (*texto == ' ')
+    {
+        texto++;
+    }
+    fin = texto + strlen(texto);
+    while (fin > texto && fin[-1] == ' ')
+    {
+        *--fin = '\0';
+    }
+    return texto;
+}
+
+/*!
+ * @brief   Convierte el nombre de un campo en su numero.
+ * @param nombre Nombre del campo (titulo, artista, album, genero o anio).
+ * @return Campo (TITULO a ANIO), o ERROR(-1) si el nombre no existe.
+*/
+static int leer_campo(const char* nombre)
+{
+    int i;
+    static const char* nombres[CAMPOS] = { "titulo", "artista", "album", "genero", "anio" };
+
+    for (i = 0; i < CAMPOS; i++)
+    {
+        if (strcasecmp(nombre, nombres[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return ERROR;
+}
+
+/*!
+ * @brief   Interpreta una condicion: campo=valor, campo~texto o anio=rango.
+ * @param texto   Condicion (se modifica).
+ * @param termino Condicion a completar.
+ * @return OK(0) si la condicion es valida, ERROR(-1) si no.
+*/
+static int leer_termino(char* texto, Termino* termino)
+{
+    char* valor = texto + strcspn(texto, "=~");
+
+    if (*valor == '\0')
+    {
+        return ERROR;
+    }
+    termino->operador = (*valor == '~') ? OPERADOR_CONTIENE : OPERADOR_IGUAL;
+    *valor++ = '\0';
+    valor = recortar(valor);
+    if ((termino->campo = leer_campo(recortar(texto))) == ERROR || *valor == '\0'
+        || snprintf(termino->valor, VALOR_MAX, "%s", valor) >= VALOR_MAX)
+    {
+        return ERROR;
+    }
+    if (termino->campo == ANIO)
+    {
+        termino->operador = (termino->operador == OPERADOR_IGUAL) ? OPERADOR_RANGO : ERROR;
+        return (termino->operador == OPERADOR_RANGO) ? catalogo_leer_rango(valor, &termino->desde, &termino->hasta) : ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Interpreta el texto de una consulta.
+ * @param texto    Consulta ingresada por el cliente.
+ * @param consulta Consulta a completar.
+ * @return OK(0) si la consulta es valida, ERROR(-1) si no.
+*/
+int consulta_leer(const char* texto, Consulta* consulta)
+{
+    char copia[BUFFER_SIZE];
+    char* alternativa = NULL;
+    char* termino = NULL;
+    char* resto_alternativas = NULL;
+    char* resto_terminos = NULL;
+    Conjuncion* conjuncion = NULL;
+
+    if (snprintf(copia, sizeof(copia), "%s", texto) >= (int)sizeof(copia))
+    {
+        return ERROR;
+    }
+    consulta->cantidad = 0;
+    for (alternativa = strtok_r(copia, "|", &resto_alternativas); alternativa != NULL;
+         alternativa = strtok_r(NULL, "|", &resto_alternativas))
+    {
+        if (consulta->cantidad == ALTERNATIVAS_MAX)
+        {
+            return ERROR;
+        }
+        conjuncion = &consulta->alternativas[consulta->cantidad++];
+        conjuncion->cantidad = 0;
+        for (termino = strtok_r(alternativa, "&", &resto_terminos); termino != NULL;
+             termino = strtok_r(NULL, "&", &resto_terminos))
+        {
+            if (conjuncion->cantidad == TERMINOS_MAX || leer_termino(termino, &conjuncion->terminos[conjuncion->cantidad++]) != OK)
+            {
+                return ERROR;
+            }
+        }
+        if (conjuncion->cantidad == 0)
+        {
+            return ERROR;
+        }
+    }
+    return (consulta->cantidad > 0) ? OK : ERROR;
+}
+
+/*!
+ * @brief   Indica si un dato contiene un texto, sin distinguir mayusculas.
+ * @param dato  Dato donde buscar.
+ * @param texto Texto buscado.
+ * @return 1 si lo contiene, 0 si no.
+*/
+static int contiene(const char* dato, const char* texto)
+{
+    size_t i;
+
+    for (; *dato != '\0'; dato++)
+    {
+        for (i = 0; texto[i] != '\0' && tolower((unsigned char)dato[i]) == tolower((unsigned char)texto[i]); i++)
+        {
+        }
+        if (texto[i] == '\0')
+        {
+            return 1;
+        }
+    }
+    return *texto == '\0';
+}
+
+/*!
+ * @brief   Indica si una cancion cumple la condicion de una lista. Solo compara enteros: la clase del valor
+ *          buscado o las coincidencias ya calculadas sobre el diccionario del campo.
+ * @param cancion Cancion.
+ * @param lista   Lista de la condicion (ver estimar()).
+ * @return 1 si la cumple, 0 si no.
+*/
+static int cumple(const Cancion* cancion, const Lista* lista)
+{
+    const Termino* termino = lista->termino;
+
+    if (termino->operador == OPERADOR_RANGO)
+    {
+        return cancion->anio >= termino->desde && cancion->anio <= termino->hasta;
+    } else if (termino->operador == OPERADOR_CONTIENE)
+    {
+        return lista->coincidencias[cancion->claves[termino->campo]];
+    }
+    return catalogo_clase(lista->catalogo, cancion, termino->campo) == lista->clase;
+}
+
+/*!
+ * @brief   Arma la lista de apariciones de una condicion con los indices del catalogo. Para las condiciones
+ *          campo~texto busca el texto en cada valor distinto del diccionario, una sola vez por valor.
+ * @param catalogo Catalogo.
+ * @param termino  Condicion.
+ * @param lista    Lista a completar.
+ * @return OK(0) si se arma, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int estimar(const Catalogo* catalogo, const Termino* termino, Lista* lista)
+{
+    int i, inicio;
+    const Diccionario* diccionario = &catalogo->diccionarios[termino->campo];
+
+    lista->termino = termino;
+    lista->catalogo = catalogo;
+    lista->elementos = NULL;
+    lista->coincidencias = NULL;
+    lista->ordenada = 1;
+    if (termino->operador == OPERADOR_IGUAL)
+    {
+        lista->clase = catalogo_clase_valor(catalogo, termino->campo, termino->valor);
+        lista->cantidad = catalogo_buscar(catalogo, termino->campo, termino->valor, &inicio);
+        lista->elementos = catalogo->orden[catalogo_orden_campo(termino->campo)] + inicio;
+    } else if (termino->operador == OPERADOR_RANGO)
+    {
+        // un rango de un solo anio queda en el orden del archivo; uno de varios, agrupado por anio.
+        lista->cantidad = catalogo_rango_anios(catalogo, termino->desde, termino->hasta, &inicio);
+        lista->elementos = catalogo->orden[ORDEN_ANIO] + inicio;
+        lista->ordenada = (termino->desde == termino->hasta);
+    } else
+    {
+        lista->cantidad = catalogo->completas; // sin indice: hay que mirar todas.
+        if ((lista->coincidencias = malloc(diccionario->cantidad + 1)) == NULL)
+        {
+            return ERROR_DE_MEMORIA;
+        }
+        for (i = 0; i < diccionario->cantidad; i++)
+        {
+            lista->coincidencias[i] = contiene(diccionario->valores[i], termino->valor);
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Libera las coincidencias calculadas para las listas de una conjuncion.
+ * @param listas   Listas.
+ * @param cantidad Cantidad de listas.
+*/
+static void liberar_listas(Lista* listas, int cantidad)
+{
+    int i;
+
+    for (i = 0; i < cantidad; i++)
+    {
+        free(listas[i].coincidencias);
+    }
+}
+
+/*!
+ * @brief   Compara dos listas por cantidad de canciones, para ordenar las condiciones de la mas selectiva a la menos.
+ * @param a Primera lista.
+ * @param b Segunda lista.
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_listas(const void* a, const void* b)
+{
+    const Lista* x = a;
+    const Lista* y = b;
+
+    // a igual cantidad, primero las que tienen indice.
+    if (x->cantidad != y->cantidad)
+    {
+        return (x->cantidad > y->cantidad) - (x->cantidad < y->cantidad);
+    }
+    return (x->elementos == NULL) - (y->elementos == NULL);
+}
+
+/*!
+ * @brief   Compara dos canciones por su posicion en el catalogo (el orden del archivo).
+ * @param a Primera cancion (Cancion**).
+ * @param b Segunda cancion (Cancion**).
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_posicion(const void* a, const void* b)
+{
+    const Cancion* x = *(Cancion* const*)a;
+    const Cancion* y = *(Cancion* const*)b;
+
+    return (x > y) - (x < y);
+}
+
+/*!
+ * @brief   Busca en una lista ordenada la primera cancion que no esta antes de otra, galopando desde una posicion:
+ *          salta 1, 2, 4, ... posiciones hasta pasarla y luego busca binariamente en el ultimo salto.
+ *          Cuesta O(log d), con d la distancia recorrida, en lugar de O(log n).
+ * @param lista   Lista en el orden del archivo.
+ * @param largo   Cantidad de canciones de la lista.
+ * @param desde   Posicion desde donde buscar.
+ * @param cancion Cancion buscada.
+ * @return Posicion encontrada (largo si todas estan antes).
+*/
+static int galopar(Cancion* const* lista, int largo, int desde, const Cancion* cancion)
+{
+    int bajo = desde, alto, salto = 1, medio;
+
+    if (desde >= largo || lista[desde] >= cancion)
+    {
+        return desde;
+    }
+    // lista[bajo] siempre queda antes de la cancion.
+    while (bajo + salto < largo && lista[bajo + salto] < cancion)
+    {
+        bajo += salto;
+        salto *= 2;
+    }
+    alto = (bajo + salto < largo) ? bajo + salto : largo;
+    bajo++;
+    while (bajo < alto)
+    {
+        medio = bajo + (alto - bajo) / 2;
+        if (lista[medio] < cancion)
+        {
+            bajo = medio + 1;
+        } else
+        {
+            alto = medio;
+        }
+    }
+    return bajo;
+}
+
+/*!
+ * @brief   Deja en los candidatos solo los que tambien estan en una lista de apariciones.
+ * @param candidatos Candidatos en el orden del archivo (se compactan).
+ * @param cantidad   Cantidad de candidatos.
+ * @param lista      Lista de apariciones en el orden del archivo.
+ * @param largo      Cantidad de canciones de la lista.
+ * @return Cantidad de candidatos que quedan.
+*/
+static int intersecar(Cancion** candidatos, int cantidad, Cancion* const* lista, int largo)
+{
+    int i, posicion = 0, quedan = 0;
+
+    for (i = 0; i < cantidad && posicion < largo; i++)
+    {
+        posicion = galopar(lista, largo, posicion, candidatos[i]);
+        if (posicion < largo && lista[posicion] == candidatos[i])
+        {
+            candidatos[quedan++] = candidatos[i];
+        }
+    }
+    return quedan;
+}
+
+/*!
+ * @brief   Deja en los candidatos solo los que cumplen una condicion.
+ * @param candidatos Candidatos (se compactan).
+ * @param cantidad   Cantidad de candidatos.
+ * @param lista      Lista de la condicion.
+ * @return Cantidad de candidatos que quedan.
+*/
+static int verificar_termino(Cancion** candidatos, int cantidad, const Lista* lista)
+{
+    int i, quedan = 0;
+
+    for (i = 0; i < cantidad; i++)
+    {
+        if (cumple(candidatos[i], lista))
+        {
+            candidatos[quedan++] = candidatos[i];
+        }
+    }
+    return quedan;
+}
+
+/*!
+ * @brief   Resuelve una conjuncion: parte de la lista de apariciones mas chica, la interseca con las demas
+ *          listas de valores exactos y verifica el resto de las condiciones cancion por cancion.
+ * @param catalogo   Catalogo.
+ * @param conjuncion Conjuncion a resolver.
+ * @param resultado  Canciones que la cumplen, en el orden del archivo (se libera con free()).
+ * @param cantidad   Cantidad de canciones del resultado.
+ * @return OK(0) si se resuelve, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int resolver_conjuncion(const Catalogo* catalogo, const Conjuncion* conjuncion, Cancion*** resultado, int* cantidad)
+{
+    int i, total;
+    Lista listas[TERMINOS_MAX];
+    Cancion** candidatos = NULL;
+
+    for (i = 0; i < conjuncion->cantidad; i++)
+    {
+        if (estimar(catalogo, &conjuncion->terminos[i], &listas[i]) != OK)
+        {
+            liberar_listas(listas, i);
+            return ERROR_DE_MEMORIA;
+        }
+    }
+    qsort(listas, conjuncion->cantidad, sizeof(Lista), comparar_listas);
+    // la primera lista es la mas selectiva; si no tiene indice, se recorre todo el catalogo.
+    total = (listas[0].elementos != NULL) ? listas[0].cantidad : catalogo->cantidad;
+    if ((candidatos = malloc((total + 1) * sizeof(Cancion*))) == NULL)
+    {
+        liberar_listas(listas, conjuncion->cantidad);
+        return ERROR_DE_MEMORIA;
+    }
+    if (listas[0].elementos != NULL)
+    {
+        memcpy(candidatos, listas[0].elementos, total * sizeof(Cancion*));
+        if (!listas[0].ordenada)
+        {
+            qsort(candidatos, total, sizeof(Cancion*), comparar_posicion);
+        }
+    } else
+    {
+        for (i = 0, total = 0; i < catalogo->cantidad; i++)
+        {
+            if (catalogo->canciones[i].completa && cumple(&catalogo->canciones[i], &listas[0]))
+            {
+                candidatos[total++] = &catalogo->canciones[i];
+            }
+        }
+    }
+    for (i = 1; i < conjuncion->cantidad && total > 0; i++)
+    {
+        if (listas[i].elementos != NULL && listas[i].ordenada)
+        {
+            total = intersecar(candidatos, total, listas[i].elementos, listas[i].cantidad);
+        } else
+        {
+            total = verificar_termino(candidatos, total, &listas[i]);
+        }
+    }
+    liberar_listas(listas, conjuncion->cantidad);
+    *resultado = candidatos;
+    *cantidad = total;
+    return OK;
+}
+
+/*!
+ * @brief   Une dos listas en el orden del archivo sin repetir canciones.
+ * @param a      Primera lista.
+ * @param largo_a Cantidad de canciones de la primera lista.
+ * @param b      Segunda lista.
+ * @param largo_b Cantidad de canciones de la segunda lista.
+ * @param unida  Lista unida (se reserva; se libera con free()).
+ * @return Cantidad de canciones de la union, o ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int unir(Cancion* const* a, int largo_a, Cancion* const* b, int largo_b, Cancion*** unida)
+{
+    int i = 0, j = 0, total = 0;
+    Cancion** lista = malloc((largo_a + largo_b + 1) * sizeof(Cancion*));
+
+    if (lista == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    while (i < largo_a || j < largo_b)
+    {
+        if (j == largo_b || (i < largo_a && a[i] < b[j]))
+        {
+            lista[total++] = a[i++];
+        } else if (i == largo_a || b[j] < a[i])
+        {
+            lista[total++] = b[j++];
+        } else
+        {
+            lista[total++] = a[i++];
+            j++;
+        }
+    }
+    *unida = lista;
+    return total;
+}
+
+/*!
+ * @brief   Resuelve una consulta sobre el catalogo.
+ * @param catalogo  Catalogo donde buscar.
+ * @param consulta  Consulta a resolver.
+ * @param resultado Canciones que cumplen la consulta, en el orden del archivo (se libera con free()).
+ * @param cantidad  Cantidad de canciones del resultado.
+ * @return OK(0) si se resuelve, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int consulta_resolver(const Catalogo* catalogo, const Consulta* consulta, Cancion*** resultado, int* cantidad)
+{
+    int i, parcial, total;
+    Cancion** acumulado = NULL;
+    Cancion** alternativa = NULL;
+    Cancion** unidas = NULL;
+
+    if (resolver_conjuncion(catalogo, &consulta->alternativas[0], &acumulado, &total) != OK)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 1; i < consulta->cantidad; i++)
+    {
+        if (resolver_conjuncion(catalogo, &consulta->alternativas[i], &alternativa, &parcial) != OK)
+        {
+            free(acumulado);
+            return ERROR_DE_MEMORIA;
+        }
+        total = unir(acumulado, total, alternativa, parcial, &unidas);
+        free(acumulado);
+        free(alternativa);
+        if (total == ERROR_DE_MEMORIA)
+        {
+            return ERROR_DE_MEMORIA;
+        }
+        acumulado = unidas;
+    }
+    *resultado = acumulado;
+    *cantidad = total;
+    return OK;
+}
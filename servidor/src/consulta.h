@@ -0,0 +1,113 @@
+/*!
+ * @file    consulta.h
+ * @brief   Definiciones y declaraciones de las consultas combinadas sobre el catalogo de canciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Las estructuras Termino, Conjuncion y Consulta.
+ *          - Declaraciones de funciones para interpretar y resolver una consulta.
+ *          Una consulta combina condiciones sobre los campos con "&" (y) y "|" (o); "&" se aplica primero:
+ *              artista=Soda Stereo & genero=new wave & anio=1985-1990 | titulo~amor
+ *          Condiciones: campo=valor (igual, sin distinguir mayusculas) en titulo, artista, album y genero;
+ *          campo~texto (contiene el texto) en esos mismos campos; anio=rango (ver catalogo_leer_rango()).
+ *          Para cada conjuncion el planificador estima cuantas canciones cumple cada condicion con los
+ *          indices del catalogo, parte de la lista de apariciones mas chica y la interseca con las demas
+ *          por busqueda galopante; las condiciones sin indice (contiene) y los rangos de varios anios que no
+ *          son la lista mas chica se verifican cancion por cancion, comparando claves enteras: el texto de un
+ *          campo~texto se busca una sola vez en cada valor distinto del diccionario del campo. El resultado
+ *          sale en el orden del archivo.
+*/
+
+#ifndef CONSULTA_H
+#define CONSULTA_H
+
+#include "catalogo.h"
+
+/*!
+ * @def VALOR_MAX
+ * @brief Largo maximo del valor de una condicion.
+*/
+#define VALOR_MAX 128
+
+/*!
+ * @def TERMINOS_MAX
+ * @brief Cantidad maxima de condiciones de una conjuncion.
+*/
+#define TERMINOS_MAX 8
+
+/*!
+ * @def ALTERNATIVAS_MAX
+ * @brief Cantidad maxima de conjunciones unidas con "|".
+*/
+#define ALTERNATIVAS_MAX 8
+
+/*!
+ * @def OPERADOR_IGUAL
+ * @brief Condicion campo=valor.
+*/
+#define OPERADOR_IGUAL 0
+
+/*!
+ * @def OPERADOR_CONTIENE
+ * @brief Condicion campo~texto.
+*/
+#define OPERADOR_CONTIENE 1
+
+/*!
+ * @def OPERADOR_RANGO
+ * @brief Condicion anio=desde-hasta.
+*/
+#define OPERADOR_RANGO 2
+
+/*!
+ * @struct Termino
+ * @brief Condicion sobre un campo.
+*/
+typedef struct Termino
+{
+    int campo;                   /**< Campo (TITULO a ANIO). */
+    int operador;                /**< OPERADOR_IGUAL, OPERADOR_CONTIENE u OPERADOR_RANGO. */
+    char valor[VALOR_MAX];       /**< Valor o texto buscado. */
+    int desde;                   /**< Primer anio del rango. */
+    int hasta;                   /**< Ultimo anio del rango. */
+} Termino;
+
+/*!
+ * @struct Conjuncion
+ * @brief Condiciones unidas con "&".
+*/
+typedef struct Conjuncion
+{
+    Termino terminos[TERMINOS_MAX]; /**< Condiciones. */
+    int cantidad;                   /**< Cantidad de condiciones. */
+} Conjuncion;
+
+/*!
+ * @struct Consulta
+ * @brief Conjunciones unidas con "|".
+*/
+typedef struct Consulta
+{
+    Conjuncion alternativas[ALTERNATIVAS_MAX]; /**< Conjunciones. */
+    int cantidad;                              /**< Cantidad de conjunciones. */
+} Consulta;
+
+/*!
+ * @brief   Interpreta el texto de una consulta.
+ * @param texto    Consulta ingresada por el cliente.
+ * @param consulta Consulta a completar.
+ * @return OK(0) si la consulta es valida, ERROR(-1) si no.
+*/
+int consulta_leer(const char* texto, Consulta* consulta);
+
+/*!
+ * @brief   Resuelve una consulta sobre el catalogo.
+ * @param catalogo  Catalogo donde buscar.
+ * @param consulta  Consulta a resolver.
+ * @param resultado Canciones que cumplen la consulta, en el orden del archivo (se libera con free()).
+ * @param cantidad  Cantidad de canciones del resultado.
+ * @return OK(0) si se resuelve, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int consulta_resolver(const Catalogo* catalogo, const Consulta* consulta, Cancion*** resultado, int* cantidad);
+
+#endif
@@ -0,0 +1,270 @@
+/*!
+ * @file    directo.c
+ * @brief   Lectura directa (O_DIRECT) de canciones frias, con doble buffer.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Mantener un fondo de buffers alineados, que se reservan la primera vez que hacen falta y se reutilizan.
+ *          - Abrir una cancion con O_DIRECT y leerla desde un hilo propio en dos buffers que se alternan.
+ *          - Entregar al canal los datos leidos sin copiarlos.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "directo.h"
+#include "bitacora.h"
+
+static pthread_mutex_t fondo_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char* libres[DIRECTO_BUFFERES];     // buffers devueltos al fondo.
+static int cantidad_libres = 0, reservados = 0;
+static uint64_t lecturas_directas = 0, bytes_directos = 0, lecturas_sin_soporte = 0, lecturas_sin_buffer = 0;
+
+/*!
+ * @brief   Toma dos buffers del fondo, reservandolos si todavia no se llego a DIRECTO_BUFFERES.
+ * @param buffers Buffers a completar.
+ * @return OK(0) si se toman los dos, ERROR(-1) si no hay (no se toma ninguno).
+*/
+static int tomar_buffers(char** buffers)
+{
+    int i;
+    void* nuevo;
+
+    pthread_mutex_lock(&fondo_mutex);
+    for (i = 0; i < 2; i++)
+    {
+        if (cantidad_libres > 0)
+        {
+            buffers[i] = libres[--cantidad_libres];
+        } else if (reservados < DIRECTO_BUFFERES && posix_memalign(&nuevo, DIRECTO_ALINEACION, DIRECTO_BUFFER) == 0)
+        {
+            buffers[i] = nuevo;
+            reservados++;
+        } else
+        {
+            // devolvemos el que ya se tomo: con un solo buffer no hay doble buffer.
+            if (i == 1)
+            {
+                libres[cantidad_libres++] = buffers[0];
+            }
+            pthread_mutex_unlock(&fondo_mutex);
+            return ERROR;
+        }
+    }
+    pthread_mutex_unlock(&fondo_mutex);
+    return OK;
+}
+
+/*!
+ * @brief   Devuelve dos buffers al fondo.
+ * @param buffers Buffers tomados con tomar_buffers().
+*/
+static void devolver_buffers(char** buffers)
+{
+    pthread_mutex_lock(&fondo_mutex);
+    libres[cantidad_libres++] = buffers[0];
+    libres[cantidad_libres++] = buffers[1];
+    pthread_mutex_unlock(&fondo_mutex);
+}
+
+/*!
+ * @brief   Hilo lector: llena los buffers libres, alternandolos, hasta el final del archivo.
+ *          El pread se hace sin el mutex, asi el canal sigue enviando el otro buffer mientras tanto.
+ * @param arg Lectura directa.
+ * @return NULL al llegar al final, fallar una lectura o pedirse el cierre.
+*/
+static void* leer_adelantado(void* arg)
+{
+    Directo* directo = arg;
+    int i = 0;
+    off_t desplazamiento;
+    ssize_t leidos;
+
+    pthread_mutex_lock(&directo->mutex);
+    while (1)
+    {
+        while (directo->listos[i] && !directo->cerrar)
+        {
+            pthread_cond_wait(&directo->cond, &directo->mutex);
+        }
+        if (directo->cerrar)
+        {
+            break;
+        }
+        desplazamiento = directo->lectura;
+        pthread_mutex_unlock(&directo->mutex);
+        leidos = pread(directo->fd, directo->buffers[i], DIRECTO_BUFFER, desplazamiento);
+        if (leidos > 0)
+        {
+            __atomic_fetch_add(&bytes_directos, leidos, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_lock(&directo->mutex);
+        directo->llenos[i] = leidos;
+        directo->listos[i] = 1;
+        pthread_cond_broadcast(&directo->cond);
+        // una lectura incompleta es el final del archivo (o un error): no hay nada mas que leer.
+        if (leidos < DIRECTO_BUFFER)
+        {
+            break;
+        }
+        directo->lectura += leidos;
+        i ^= 1;
+    }
+    directo->fin = 1;
+    pthread_cond_broadcast(&directo->cond);
+    pthread_mutex_unlock(&directo->mutex);
+    return NULL;
+}
+
+/*!
+ * @brief   Abre una lectura directa de una cancion y empieza a leerla en segundo plano.
+ * @param archivo Archivo abierto con archivos_abrir().
+ * @param desde   Byte desde el que se envia.
+ * @param directo Lectura a completar.
+ * @return OK(0) si se abre, ERROR(-1) si la cancion es chica, el sistema de archivos no admite O_DIRECT o no
+ *         quedan buffers libres (se debe leer por la cache).
+*/
+int directo_abrir(const Archivo* archivo, off_t desde, Directo* directo)
+{
+    char ruta[PATH_MAX];
+    struct stat datos, propios;
+    int directorio;
+
+    if (fstat(archivo->fd, &datos) != 0 || datos.st_size < DIRECTO_MINIMO || desde >= datos.st_size)
+    {
+        return ERROR;
+    }
+    memset(directo, 0, sizeof(Directo));
+    // O_DIRECT es del descriptor abierto: no se puede activar en el compartido sin afectar a las otras descargas.
+    if ((directorio = archivos_ruta(archivo, ruta, sizeof(ruta))) < 0
+        || (directo->fd = openat(directorio, ruta, O_RDONLY | O_DIRECT | O_CLOEXEC)) < 0)
+    {
+        __atomic_fetch_add(&lecturas_sin_soporte, 1, __ATOMIC_RELAXED);
+        return ERROR;
+    }
+    // si el archivo se reemplazo desde que se abrio el compartido, se envia el que ya esta abierto.
+    if (fstat(directo->fd, &propios) != 0 || propios.st_ino != datos.st_ino || propios.st_dev != datos.st_dev)
+    {
+        close(directo->fd);
+        return ERROR;
+    }
+    if (tomar_buffers(directo->buffers) != OK)
+    {
+        close(directo->fd);
+        __atomic_fetch_add(&lecturas_sin_buffer, 1, __ATOMIC_RELAXED);
+        return ERROR;
+    }
+    directo->lectura = desde & ~(off_t)(DIRECTO_ALINEACION - 1);
+    directo->salto = desde - directo->lectura;
+    pthread_mutex_init(&directo->mutex, NULL);
+    pthread_cond_init(&directo->cond, NULL);
+    if (pthread_create(&directo->hilo, NULL, leer_adelantado, directo) != 0)
+    {
+        bitacora_error("Error al crear hilo de lectura directa.\n");
+        pthread_mutex_destroy(&directo->mutex);
+        pthread_cond_destroy(&directo->cond);
+        devolver_buffers(directo->buffers);
+        close(directo->fd);
+        return ERROR;
+    }
+    __atomic_fetch_add(&lecturas_directas, 1, __ATOMIC_RELAXED);
+    return OK;
+}
+
+/*!
+ * @brief   Devuelve los proximos bytes de la cancion, sin copiarlos. Los datos siguen siendo validos hasta
+ *          la proxima llamada.
+ * @param directo Lectura abierta con directo_abrir().
+ * @param maximo  Bytes como maximo.
+ * @param datos   Puntero a completar con el comienzo de los datos.
+ * @return Bytes disponibles, 0 al final del archivo o -1 si fallo la lectura.
+*/
+ssize_t directo_leer(Directo* directo, size_t maximo, const char** datos)
+{
+    int i;
+    size_t pendientes;
+
+    pthread_mutex_lock(&directo->mutex);
+    i = directo->actual;
+    if (directo->en_uso && directo->desplazamiento >= (size_t)directo->llenos[i])
+    {
+        // el buffer actual ya se envio entero: se lo devolvemos al lector y pasamos al otro.
+        directo->listos[i] = 0;
+        directo->en_uso = 0;
+        directo->actual = i ^= 1;
+        pthread_cond_broadcast(&directo->cond);
+    }
+    if (!directo->en_uso)
+    {
+        while (!directo->listos[i] && !directo->fin)
+        {
+            pthread_cond_wait(&directo->cond, &directo->mutex);
+        }
+        if (!directo->listos[i])
+        {
+            pthread_mutex_unlock(&directo->mutex);
+            return 0;
+        }
+        if (directo->llenos[i] < 0)
+        {
+            pthread_mutex_unlock(&directo->mutex);
+            return -1;
+        }
+        directo->desplazamiento = directo->salto;
+        directo->salto = 0;
+        directo->en_uso = 1;
+    }
+    pthread_mutex_unlock(&directo->mutex);
+    if (directo->desplazamiento >= (size_t)directo->llenos[i])
+    {
+        return 0;
+    }
+    pendientes = directo->llenos[i] - directo->desplazamiento;
+    if (pendientes > maximo)
+    {
+        pendientes = maximo;
+    }
+    *datos = directo->buffers[i] + directo->desplazamiento;
+    directo->desplazamiento += pendientes;
+    return pendientes;
+}
+
+/*!
+ * @brief   Termina el hilo lector, cierra el descriptor y devuelve los buffers al fondo.
+ * @param directo Lectura abierta con directo_abrir().
+*/
+void directo_cerrar(Directo* directo)
+{
+    pthread_mutex_lock(&directo->mutex);
+    directo->cerrar = 1;
+    pthread_cond_broadcast(&directo->cond);
+    pthread_mutex_unlock(&directo->mutex);
+    pthread_join(directo->hilo, NULL);
+    pthread_mutex_destroy(&directo->mutex);
+    pthread_cond_destroy(&directo->cond);
+    devolver_buffers(directo->buffers);
+    close(directo->fd);
+}
+
+/*!
+ * @brief   Devuelve los contadores de la lectura directa.
+ * @param directas     Envios que se leyeron con O_DIRECT.
+ * @param bytes        Bytes leidos con O_DIRECT.
+ * @param sin_soporte  Envios de canciones frias que no pudieron abrirse con O_DIRECT.
+ * @param sin_buffer   Envios de canciones frias que encontraron el fondo de buffers vacio.
+*/
+void directo_contadores(uint64_t* directas, uint64_t* bytes, uint64_t* sin_soporte, uint64_t* sin_buffer)
+{
+    *directas = __atomic_load_n(&lecturas_directas, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&bytes_directos, __ATOMIC_RELAXED);
+    *sin_soporte = __atomic_load_n(&lecturas_sin_soporte, __ATOMIC_RELAXED);
+    *sin_buffer = __atomic_load_n(&lecturas_sin_buffer, __ATOMIC_RELAXED);
+}
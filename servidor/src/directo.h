@@ -0,0 +1,106 @@
+/*!
+ * @file    directo.h
+ * @brief   Definiciones y declaraciones de la lectura directa (O_DIRECT) de canciones frias.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros de la lectura directa y la estructura Directo.
+ *          - Declaraciones de funciones para abrir, leer y cerrar una lectura directa, y leer sus contadores.
+ *          Enviar una cancion grande que casi nadie pide por la cache de paginas desplaza de ella a las mas
+ *          escuchadas. Las canciones frias de DIRECTO_MINIMO bytes o mas se leen con su propio descriptor abierto
+ *          con O_DIRECT, que no pasa por la cache, en dos buffers alineados a DIRECTO_ALINEACION tomados de un
+ *          fondo comun: un hilo lector llena uno mientras el canal envia el otro, asi la lectura del disco se
+ *          superpone con el envio. Si no se puede (el sistema de archivos no admite O_DIRECT o no quedan buffers
+ *          libres en el fondo), el canal lee por la cache como siempre.
+*/
+
+#ifndef DIRECTO_H
+#define DIRECTO_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "archivos.h"
+
+/*!
+ * @def DIRECTO_MINIMO
+ * @brief Tamanio desde el que una cancion fria se lee sin pasar por la cache de paginas.
+*/
+#define DIRECTO_MINIMO (4 * 1024 * 1024)
+
+/*!
+ * @def DIRECTO_ALINEACION
+ * @brief Alineacion de los buffers, de los desplazamientos y de los tamanios leidos con O_DIRECT.
+*/
+#define DIRECTO_ALINEACION 4096
+
+/*!
+ * @def DIRECTO_BUFFER
+ * @brief Bytes de cada buffer de lectura (multiplo de DIRECTO_ALINEACION).
+*/
+#define DIRECTO_BUFFER (512 * 1024)
+
+/*!
+ * @def DIRECTO_BUFFERES
+ * @brief Buffers del fondo comun; cada lectura directa usa dos.
+*/
+#define DIRECTO_BUFFERES 32
+
+/*!
+ * @struct Directo
+ * @brief Lectura directa de una cancion en curso.
+*/
+typedef struct Directo
+{
+    int fd;                    /**< Descriptor propio abierto con O_DIRECT. */
+    char* buffers[2];          /**< Buffers alineados tomados del fondo. */
+    ssize_t llenos[2];         /**< Bytes leidos en cada buffer (-1 si fallo la lectura). */
+    int listos[2];             /**< 1 si el buffer tiene datos que el canal todavia no termino de enviar. */
+    int actual;                /**< Buffer que envia el canal. */
+    int en_uso;                /**< 1 si el canal ya tomo datos del buffer actual. */
+    size_t desplazamiento;     /**< Proximo byte a enviar del buffer actual. */
+    size_t salto;              /**< Bytes a saltear al comienzo del primer buffer (lectura desde un byte no alineado). */
+    off_t lectura;             /**< Proximo desplazamiento (alineado) a leer. */
+    int fin;                   /**< 1 si el hilo lector termino. */
+    int cerrar;                /**< 1 si el canal pide que el hilo lector termine. */
+    pthread_mutex_t mutex;     /**< Protege el estado de los buffers. */
+    pthread_cond_t cond;       /**< Avisa que un buffer se lleno o se libero. */
+    pthread_t hilo;            /**< Hilo lector. */
+} Directo;
+
+/*!
+ * @brief   Abre una lectura directa de una cancion y empieza a leerla en segundo plano.
+ * @param archivo Archivo abierto con archivos_abrir().
+ * @param desde   Byte desde el que se envia.
+ * @param directo Lectura a completar.
+ * @return OK(0) si se abre, ERROR(-1) si la cancion es chica, el sistema de archivos no admite O_DIRECT o no
+ *         quedan buffers libres (se debe leer por la cache).
+*/
+int directo_abrir(const Archivo* archivo, off_t desde, Directo* directo);
+
+/*!
+ * @brief   Devuelve los proximos bytes de la cancion, sin copiarlos. Los datos siguen siendo validos hasta
+ *          la proxima llamada.
+ * @param directo Lectura abierta con directo_abrir().
+ * @param maximo  Bytes como maximo.
+ * @param datos   Puntero a completar con el comienzo de los datos.
+ * @return Bytes disponibles, 0 al final del archivo o -1 si fallo la lectura.
+*/
+ssize_t directo_leer(Directo* directo, size_t maximo, const char** datos);
+
+/*!
+ * @brief   Termina el hilo lector, cierra el descriptor y devuelve los buffers al fondo.
+ * @param directo Lectura abierta con directo_abrir().
+*/
+void directo_cerrar(Directo* directo);
+
+/*!
+ * @brief   Devuelve los contadores de la lectura directa.
+ * @param directas     Envios que se leyeron con O_DIRECT.
+ * @param bytes        Bytes leidos con O_DIRECT.
+ * @param sin_soporte  Envios de canciones frias que no pudieron abrirse con O_DIRECT.
+ * @param sin_buffer   Envios de canciones frias que encontraron el fondo de buffers vacio.
+*/
+void directo_contadores(uint64_t* directas, uint64_t* bytes, uint64_t* sin_soporte, uint64_t* sin_buffer);
+
+#endif
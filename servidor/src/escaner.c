@@ -0,0 +1,1370 @@
+/*!
+ * @file    escaner.c
+ * @brief   Escaner del directorio de canciones: arma media.csv y media.idx a partir de las etiquetas ID3.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Recorrer el directorio de canciones con varios hilos que se roban tareas entre si.
+ *          - Leer las etiquetas ID3v2 (versiones 2.2, 2.3 y 2.4) e ID3v1 de cada archivo .mp3.
+ *          - Reutilizar las filas de los archivos que no cambiaron desde el escaneo anterior.
+ *          - Asignar numeros de cancion estables y escribir el catalogo y su indice.
+ *          No usa la bitacora: lo usa tanto el servidor como la herramienta escanear, y los errores de
+ *          cada archivo se cuentan en el resumen.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "catalogo.h"
+#include "archivos.h"
+#include "escaner.h"
+#include "marcos.h"
+
+/*!
+ * @def ROBO_MAX
+ * @brief Cantidad maxima de tareas que un hilo toma de otro en un robo.
+*/
+#define ROBO_MAX 64
+
+/*!
+ * @def GENEROS_ID3
+ * @brief Cantidad de generos de la tabla de ID3v1.
+*/
+#define GENEROS_ID3 80
+
+static const char* generos_id3[GENEROS_ID3] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop", "Jazz", "Metal",
+    "New Age", "Oldies", "Other", "Pop", "R&B", "Rap", "Reggae", "Rock", "Techno", "Industrial",
+    "Alternative", "Ska", "Death Metal", "Pranks", "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk",
+    "Fusion", "Trance", "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "AlternRock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock", "Ethnic", "Gothic",
+    "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream", "Southern Rock", "Comedy", "Cult", "Gangsta",
+    "Top 40", "Christian Rap", "Pop/Funk", "Jungle", "Native American", "Cabaret", "New Wave", "Psychadelic", "Rave", "Showtunes",
+    "Trailer", "Lo-Fi", "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock"
+};
+
+/*!
+ * @struct Tarea
+ * @brief Directorio o archivo por procesar.
+*/
+typedef struct Tarea
+{
+    char* ruta;          /**< Ruta relativa al directorio de canciones ("" es el directorio mismo). */
+    int directorio;      /**< 1 si es un directorio, 0 si es un archivo .mp3. */
+} Tarea;
+
+/*!
+ * @struct Cola
+ * @brief Cola de tareas de un hilo. El hilo agrega y toma al final; los demas roban del principio.
+*/
+typedef struct Cola
+{
+    Tarea* tareas;           /**< Tareas, de tareas[inicio] a tareas[fin - 1]. */
+    int inicio;              /**< Primera tarea pendiente (la mas vieja). */
+    int fin;                 /**< Una despues de la ultima tarea pendiente. */
+    int capacidad;           /**< Tamanio de tareas. */
+    pthread_mutex_t mutex;   /**< Protege la cola. */
+} Cola;
+
+/*!
+ * @struct Previo
+ * @brief Archivo del escaneo anterior (una linea de media.idx).
+*/
+typedef struct Previo
+{
+    const char* ruta;        /**< Ruta relativa al directorio de canciones. */
+    const char* fila;        /**< Linea de media.csv de la cancion (NULL si falta). */
+    uint32_t numero;         /**< Numero de la cancion. */
+    long long segundos;      /**< Fecha de modificacion (segundos). */
+    long nanos;              /**< Fecha de modificacion (nanosegundos). */
+    long long tamanio;       /**< Tamanio del archivo. */
+    int encontrado;          /**< 1 si el archivo sigue estando. */
+} Previo;
+
+/*!
+ * @struct Registro
+ * @brief Archivo encontrado en este escaneo.
+*/
+typedef struct Registro
+{
+    char* ruta;              /**< Ruta relativa al directorio de canciones. */
+    char* fila;              /**< Linea de media.csv, sin el salto de linea. */
+    uint32_t numero;         /**< Numero de la cancion (0 si el archivo es nuevo). */
+    long long segundos;      /**< Fecha de modificacion (segundos). */
+    long nanos;              /**< Fecha de modificacion (nanosegundos). */
+    long long tamanio;       /**< Tamanio del archivo. */
+} Registro;
+
+struct Escaneo;
+
+/*!
+ * @struct Trabajador
+ * @brief Estado de un hilo del escaner.
+*/
+typedef struct Trabajador
+{
+    Cola cola;               /**< Tareas del hilo. */
+    Registro* registros;     /**< Archivos procesados por el hilo. */
+    int cantidad;            /**< Cantidad de registros. */
+    int capacidad;           /**< Tamanio de registros. */
+    int leidos;              /**< Archivos cuyas etiquetas leyo. */
+    int reutilizados;        /**< Archivos tomados del escaneo anterior. */
+    int errores;             /**< Archivos o directorios que no pudo leer. */
+    int robos;               /**< Robos exitosos. */
+    int marcos;              /**< Indices de marcos que armo. */
+    unsigned int semilla;    /**< Semilla para elegir a quien robar. */
+    struct Escaneo* escaneo; /**< Escaneo al que pertenece. */
+    pthread_t hilo;          /**< Hilo. */
+} Trabajador;
+
+/*!
+ * @struct Escaneo
+ * @brief Estado compartido de un escaneo.
+*/
+typedef struct Escaneo
+{
+    int base;                /**< Descriptor del directorio de canciones. */
+    Trabajador* trabajadores;/**< Hilos del escaneo. */
+    int hilos;               /**< Cantidad de hilos. */
+    int pendientes;          /**< Tareas agregadas y todavia no terminadas (atomico). */
+    int sin_memoria;         /**< 1 si falto memoria en algun hilo. */
+    Previo* previos;         /**< Archivos del escaneo anterior, ordenados por ruta. */
+    int cantidad_previos;    /**< Cantidad de previos. */
+    int marcos;              /**< 1 si hay que armar los indices de marcos que falten. */
+} Escaneo;
+
+/*!
+ * @brief   Agrega una tarea al final de una cola.
+ * @param cola  Cola.
+ * @param tarea Tarea a agregar.
+ * @return OK(0) si se agrega, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int agregar_tarea(Cola* cola, Tarea tarea)
+{
+    Tarea* nuevas = NULL;
+    int capacidad;
+
+    pthread_mutex_lock(&cola->mutex);
+    if (cola->fin == cola->capacidad)
+    {
+        if (cola->inicio > 0) // lugar liberado por robos: corremos las pendientes al principio.
+        {
+            memmove(cola->tareas, cola->tareas + cola->inicio, (cola->fin - cola->inicio) * sizeof(Tarea));
+            cola->fin -= cola->inicio;
+            cola->inicio = 0;
+        } else
+        {
+            capacidad = (cola->capacidad == 0) ? 64 : cola->capacidad * 2;
+            if ((nuevas = realloc(cola->tareas, capacidad * sizeof(Tarea))) == NULL)
+            {
+                pthread_mutex_unlock(&cola->mutex);
+                return ERROR_DE_MEMORIA;
+            }
+            cola->tareas = nuevas;
+            cola->capacidad = capacidad;
+        }
+    }
+    cola->tareas[cola->fin++] = tarea;
+    pthread_mutex_unlock(&cola->mutex);
+    return OK;
+}
+
+/*!
+ * @brief   Toma la ultima tarea de la cola propia (la mas reciente, que suele tener sus datos en cache).
+ * @param cola  Cola propia.
+ * @param tarea Tarea tomada.
+ * @return 1 si habia una tarea, 0 si la cola estaba vacia.
+*/
+static int tomar_tarea(Cola* cola, Tarea* tarea)
+{
+    int hay;
+
+    pthread_mutex_lock(&cola->mutex);
+    if ((hay = (cola->fin > cola->inicio)))
+    {
+        *tarea = cola->tareas[--cola->fin];
+    }
+    pthread_mutex_unlock(&cola->mutex);
+    return hay;
+}
+
+/*!
+ * @brief   Roba tareas a otro hilo: la mitad de las pendientes de la primera cola con tareas, empezando por
+ *          una al azar. Nunca se toman dos colas a la vez, asi dos hilos que se roban entre si no se traban.
+ * @param trabajador Hilo que roba.
+ * @param tarea      Primera tarea robada, para procesarla enseguida; las demas quedan en la cola propia.
+ * @return 1 si robo alguna tarea, 0 si todas las colas estaban vacias.
+*/
+static int robar_tareas(Trabajador* trabajador, Tarea* tarea)
+{
+    Escaneo* escaneo = trabajador->escaneo;
+    Tarea botin[ROBO_MAX];
+    Cola* victima = NULL;
+    int i, j, cantidad = 0, primero = rand_r(&trabajador->semilla) % escaneo->hilos;
+
+    for (i = 0; i < escaneo->hilos && cantidad == 0; i++)
+    {
+        victima = &escaneo->trabajadores[(primero + i) % escaneo->hilos].cola;
+        if (victima == &trabajador->cola)
+        {
+            continue;
+        }
+        pthread_mutex_lock(&victima->mutex);
+        cantidad = (victima->fin - victima->inicio + 1) / 2;
+        if (cantidad > ROBO_MAX)
+        {
+            cantidad = ROBO_MAX;
+        }
+        memcpy(botin, victima->tareas + victima->inicio, cantidad * sizeof(Tarea));
+        victima->inicio += cantidad;
+        pthread_mutex_unlock(&victima->mutex);
+    }
+    if (cantidad == 0)
+    {
+        return 0;
+    }
+    trabajador->robos++;
+    for (j = 1; j < cantidad; j++)
+    {
+        if (agregar_tarea(&trabajador->cola, botin[j]) != OK)
+        {
+            // sin memoria para la cola propia: la tarea se pierde, pero no debe quedar pendiente.
+            escaneo->sin_memoria = 1;
+            free(botin[j].ruta);
+            __atomic_sub_fetch(&escaneo->pendientes, 1, __ATOMIC_RELEASE);
+        }
+    }
+    *tarea = botin[0];
+    return 1;
+}
+
+/*!
+ * @brief   Crea una tarea y la agrega a la cola de un hilo.
+ * @param trabajador Hilo que encontro la tarea.
+ * @param padre      Ruta del directorio que la contiene.
+ * @param nombre     Nombre de la entrada.
+ * @param directorio 1 si es un directorio.
+*/
+static void nueva_tarea(Trabajador* trabajador, const char* padre, const char* nombre, int directorio)
+{
+    Escaneo* escaneo = trabajador->escaneo;
+    Tarea tarea;
+    size_t largo = strlen(padre) + strlen(nombre) + 2;
+
+    tarea.directorio = directorio;
+    if ((tarea.ruta = malloc(largo)) == NULL)
+    {
+        escaneo->sin_memoria = 1;
+        return;
+    }
+    snprintf(tarea.ruta, largo, (*padre == '\0') ? "%s%s" : "%s/%s", padre, nombre);
+    __atomic_add_fetch(&escaneo->pendientes, 1, __ATOMIC_RELAXED);
+    if (agregar_tarea(&trabajador->cola, tarea) != OK)
+    {
+        escaneo->sin_memoria = 1;
+        free(tarea.ruta);
+        __atomic_sub_fetch(&escaneo->pendientes, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/*!
+ * @brief   Indica si un nombre de archivo termina en .mp3 (sin distinguir mayusculas).
+ * @param nombre Nombre del archivo.
+ * @return 1 si es un .mp3, 0 si no.
+*/
+static int es_mp3(const char* nombre)
+{
+    size_t largo = strlen(nombre);
+
+    return largo > 4 && strcasecmp(nombre + largo - 4, ".mp3") == 0;
+}
+
+/*!
+ * @brief   Lee un directorio y agrega a la cola propia sus subdirectorios y archivos .mp3.
+ *          Se ignoran las entradas ocultas, los enlaces a directorios (pueden formar ciclos) y los nombres
+ *          con tabuladores o saltos de linea, que no entran en media.idx.
+ * @param trabajador Hilo que procesa el directorio.
+ * @param ruta       Ruta del directorio.
+*/
+static void procesar_directorio(Trabajador* trabajador, const char* ruta)
+{
+    int fd;
+    DIR* dir = NULL;
+    struct dirent* entrada = NULL;
+    struct stat datos;
+    char* hijo = NULL;
+    size_t largo;
+
+    if ((fd = openat(trabajador->escaneo->base, (*ruta == '\0') ? "." : ruta, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0
+        || (dir = fdopendir(fd)) == NULL)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        trabajador->errores++;
+        return;
+    }
+    while ((entrada = readdir(dir)) != NULL)
+    {
+        if (entrada->d_name[0] == '.' || strpbrk(entrada->d_name, "\t\n\r") != NULL)
+        {
+            continue;
+        }
+        if (entrada->d_type == DT_DIR)
+        {
+            nueva_tarea(trabajador, ruta, entrada->d_name, 1);
+            continue;
+        }
+        if (!es_mp3(entrada->d_name))
+        {
+            continue;
+        }
+        if (entrada->d_type == DT_REG)
+        {
+            nueva_tarea(trabajador, ruta, entrada->d_name, 0);
+            continue;
+        }
+        if (entrada->d_type == DT_LNK || entrada->d_type == DT_UNKNOWN)
+        {
+            largo = strlen(ruta) + strlen(entrada->d_name) + 2;
+            if ((hijo = malloc(largo)) == NULL)
+            {
+                trabajador->escaneo->sin_memoria = 1;
+                continue;
+            }
+            snprintf(hijo, largo, (*ruta == '\0') ? "%s%s" : "%s/%s", ruta, entrada->d_name);
+            if (fstatat(trabajador->escaneo->base, hijo, &datos, 0) == 0)
+            {
+                if (S_ISREG(datos.st_mode))
+                {
+                    nueva_tarea(trabajador, ruta, entrada->d_name, 0);
+                } else if (S_ISDIR(datos.st_mode) && entrada->d_type == DT_UNKNOWN)
+                {
+                    nueva_tarea(trabajador, ruta, entrada->d_name, 1);
+                }
+            }
+            free(hijo);
+        }
+    }
+    closedir(dir);
+}
+
+/*!
+ * @brief   Agrega un punto de codigo a un texto en UTF-8, si entra completo.
+ * @param valor Texto (VALOR_MAX bytes).
+ * @param largo Largo actual del texto; se actualiza.
+ * @param punto Punto de codigo.
+ * @return 1 si se agrego, 0 si no entra (el texto se termina ahi).
+*/
+static int agregar_punto(char* valor, size_t* largo, uint32_t punto)
+{
+    unsigned char bytes[4];
+    size_t cantidad;
+
+    if (punto < 0x80)
+    {
+        bytes[0] = punto;
+        cantidad = 1;
+    } else if (punto < 0x800)
+    {
+        bytes[0] = 0xC0 | (punto >> 6);
+        bytes[1] = 0x80 | (punto & 0x3F);
+        cantidad = 2;
+    } else if (punto < 0x10000)
+    {
+        bytes[0] = 0xE0 | (punto >> 12);
+        bytes[1] = 0x80 | ((punto >> 6) & 0x3F);
+        bytes[2] = 0x80 | (punto & 0x3F);
+        cantidad = 3;
+    } else
+    {
+        bytes[0] = 0xF0 | (punto >> 18);
+        bytes[1] = 0x80 | ((punto >> 12) & 0x3F);
+        bytes[2] = 0x80 | ((punto >> 6) & 0x3F);
+        bytes[3] = 0x80 | (punto & 0x3F);
+        cantidad = 4;
+    }
+    if (*largo + cantidad >= VALOR_MAX)
+    {
+        return 0;
+    }
+    memcpy(valor + *largo, bytes, cantidad);
+    *largo += cantidad;
+    valor[*largo] = '\0';
+    return 1;
+}
+
+/*!
+ * @brief   Decodifica un texto de una etiqueta a UTF-8. Si el texto tiene varios valores separados por
+ *          caracteres nulos (ID3v2.4), se toma el primero.
+ * @param datos       Texto codificado.
+ * @param largo       Bytes del texto.
+ * @param codificacion 0 ISO-8859-1, 1 UTF-16 con marca de orden, 2 UTF-16BE, 3 UTF-8.
+ * @param valor       Texto decodificado (VALOR_MAX bytes).
+*/
+static void decodificar(const unsigned char* datos, size_t largo, int codificacion, char* valor)
+{
+    size_t i, escritos = 0;
+    int grande = (codificacion == 2);
+    uint32_t unidad, baja;
+
+    valor[0] = '\0';
+    if (codificacion == 0)
+    {
+        for (i = 0; i < largo && datos[i] != 0 && agregar_punto(valor, &escritos, datos[i]); i++)
+        {
+        }
+        return;
+    }
+    if (codificacion == 3)
+    {
+        for (i = 0; i < largo && datos[i] != 0 && escritos + 1 < VALOR_MAX; i++)
+        {
+            valor[escritos++] = datos[i];
+        }
+        if (i < largo && datos[i] != 0 && (datos[i] & 0xC0) == 0x80) // no dejamos un caracter cortado.
+        {
+            while (escritos > 0 && (valor[escritos - 1] & 0xC0) == 0x80)
+            {
+                escritos--;
+            }
+            escritos -= (escritos > 0);
+        }
+        valor[escritos] = '\0';
+        return;
+    }
+    if (codificacion != 1 && codificacion != 2)
+    {
+        return;
+    }
+    if (codificacion == 1 && largo >= 2)
+    {
+        if (datos[0] == 0xFE && datos[1] == 0xFF)
+        {
+            grande = 1;
+            datos += 2;
+            largo -= 2;
+        } else if (datos[0] == 0xFF && datos[1] == 0xFE)
+        {
+            datos += 2;
+            largo -= 2;
+        }
+    }
+    for (i = 0; i + 1 < largo; i += 2)
+    {
+        unidad = grande ? (datos[i] << 8 | datos[i + 1]) : (datos[i + 1] << 8 | datos[i]);
+        if (unidad == 0)
+        {
+            break;
+        }
+        if (unidad >= 0xD800 && unidad < 0xDC00 && i + 3 < largo) // par sustituto.
+        {
+            baja = grande ? (datos[i + 2] << 8 | datos[i + 3]) : (datos[i + 3] << 8 | datos[i + 2]);
+            if (baja >= 0xDC00 && baja < 0xE000)
+            {
+                unidad = 0x10000 + ((unidad - 0xD800) << 10) + (baja - 0xDC00);
+                i += 2;
+            }
+        }
+        if (unidad >= 0xD800 && unidad < 0xE000)
+        {
+            unidad = 0xFFFD;
+        }
+        if (!agregar_punto(valor, &escritos, unidad))
+        {
+            break;
+        }
+    }
+}
+
+/*!
+ * @brief   Deshace la desincronizacion de ID3v2: quita el 0x00 que sigue a cada 0xFF.
+ * @param datos Datos a corregir (se corrigen en el lugar).
+ * @param largo Bytes de los datos.
+ * @return Bytes de los datos corregidos.
+*/
+static size_t resincronizar(unsigned char* datos, size_t largo)
+{
+    size_t i, j = 0;
+
+    for (i = 0; i < largo; i++)
+    {
+        datos[j++] = datos[i];
+        if (datos[i] == 0xFF && i + 1 < largo && datos[i + 1] == 0x00)
+        {
+            i++;
+        }
+    }
+    return j;
+}
+
+/*!
+ * @brief   Lee un entero de 28 bits guardado en 4 bytes de 7 bits (syncsafe).
+ * @param datos Bytes del entero.
+ * @return Valor del entero.
+*/
+static uint32_t leer_syncsafe(const unsigned char* datos)
+{
+    return (uint32_t)(datos[0] & 0x7F) << 21 | (datos[1] & 0x7F) << 14 | (datos[2] & 0x7F) << 7 | (datos[3] & 0x7F);
+}
+
+/*!
+ * @brief   Indica que campo del catalogo guarda un marco de ID3v2.
+ * @param id Identificador del marco (3 caracteres en ID3v2.2, 4 en las demas).
+ * @return Campo (TITULO a ANIO), o -1 si el marco no interesa.
+*/
+static int campo_de_marco(const char* id)
+{
+    static const struct { const char* id; int campo; } marcos[] = {
+        { "TIT2", TITULO }, { "TT2", TITULO }, { "TPE1", ARTISTA }, { "TP1", ARTISTA },
+        { "TALB", ALBUM }, { "TAL", ALBUM }, { "TCON", GENERO }, { "TCO", GENERO },
+        { "TYER", ANIO }, { "TYE", ANIO }, { "TDRC", ANIO }
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(marcos) / sizeof(marcos[0]); i++)
+    {
+        if (strcmp(id, marcos[i].id) == 0)
+        {
+            return marcos[i].campo;
+        }
+    }
+    return -1;
+}
+
+/*!
+ * @brief   Lee los campos de la etiqueta ID3v2 del principio de un archivo.
+ *          Se saltean los marcos comprimidos o cifrados y los que no entran en ETIQUETA_MAX.
+ * @param fd      Descriptor del archivo.
+ * @param valores Campos a completar (solo los que estan vacios).
+*/
+static void leer_id3v2(int fd, char valores[CAMPOS][VALOR_MAX])
+{
+    unsigned char cabecera[10];
+    unsigned char* datos = NULL;
+    unsigned char* marco = NULL;
+    char id[5] = "";
+    int version, banderas, campo, formato;
+    size_t tamanio, largo, posicion = 0, largo_marco, encabezado;
+    ssize_t leidos;
+
+    if (pread(fd, cabecera, sizeof(cabecera), 0) != sizeof(cabecera) || memcmp(cabecera, "ID3", 3) != 0
+        || cabecera[3] < 2 || cabecera[3] > 4)
+    {
+        return;
+    }
+    version = cabecera[3];
+    banderas = cabecera[5];
+    tamanio = leer_syncsafe(cabecera + 6);
+    if (tamanio > ETIQUETA_MAX)
+    {
+        tamanio = ETIQUETA_MAX;
+    }
+    if ((datos = malloc(tamanio)) == NULL || (leidos = pread(fd, datos, tamanio, sizeof(cabecera))) <= 0)
+    {
+        free(datos);
+        return;
+    }
+    largo = leidos;
+    if ((banderas & 0x80) && version < 4) // en 2.2 y 2.3 la desincronizacion abarca toda la etiqueta.
+    {
+        largo = resincronizar(datos, largo);
+    }
+    if ((banderas & 0x40) && version >= 3 && largo >= 4) // encabezado extendido.
+    {
+        posicion = (version == 3) ? ((uint32_t)datos[0] << 24 | datos[1] << 16 | datos[2] << 8 | datos[3]) + 4 : leer_syncsafe(datos);
+    }
+    encabezado = (version == 2) ? 6 : 10;
+    while (posicion + encabezado <= largo && datos[posicion] != 0) // un byte nulo empieza el relleno.
+    {
+        formato = 0;
+        if (version == 2)
+        {
+            memcpy(id, datos + posicion, 3);
+            id[3] = '\0';
+            largo_marco = datos[posicion + 3] << 16 | datos[posicion + 4] << 8 | datos[posicion + 5];
+        } else
+        {
+            memcpy(id, datos + posicion, 4);
+            id[4] = '\0';
+            largo_marco = (version == 4) ? leer_syncsafe(datos + posicion + 4)
+                : ((uint32_t)datos[posicion + 4] << 24 | datos[posicion + 5] << 16 | datos[posicion + 6] << 8 | datos[posicion + 7]);
+            formato = datos[posicion + 9];
+        }
+        posicion += encabezado;
+        if (largo_marco > largo - posicion)
+        {
+            break;
+        }
+        marco = datos + posicion;
+        posicion += largo_marco;
+        if ((campo = campo_de_marco(id)) < 0 || valores[campo][0] != '\0')
+        {
+            continue;
+        }
+        if (version == 3)
+        {
+            if (formato & 0xC0) // comprimido o cifrado.
+            {
+                continue;
+            }
+            if ((formato & 0x20) && largo_marco > 0) // byte de grupo.
+            {
+                marco++;
+                largo_marco--;
+            }
+        } else if (version == 4)
+        {
+            if (formato & 0x0C)
+            {
+                continue;
+            }
+            if ((formato & 0x40) && largo_marco > 0)
+            {
+                marco++;
+                largo_marco--;
+            }
+            if ((formato & 0x01) && largo_marco >= 4) // largo de los datos antes de desincronizar.
+            {
+                marco += 4;
+                largo_marco -= 4;
+            }
+            if ((formato & 0x02) || (banderas & 0x80))
+            {
+                largo_marco = resincronizar(marco, largo_marco);
+            }
+        }
+        if (largo_marco > 0)
+        {
+            decodificar(marco + 1, largo_marco - 1, marco[0], valores[campo]);
+        }
+    }
+    free(datos);
+}
+
+/*!
+ * @brief   Copia un campo de ID3v1 (ISO-8859-1 de largo fijo, relleno con espacios o nulos).
+ * @param datos Campo.
+ * @param largo Largo del campo.
+ * @param valor Texto a completar, si esta vacio (VALOR_MAX bytes).
+*/
+static void copiar_id3v1(const unsigned char* datos, size_t largo, char* valor)
+{
+    if (valor[0] == '\0')
+    {
+        decodificar(datos, largo, 0, valor);
+    }
+}
+
+/*!
+ * @brief   Lee los campos de la etiqueta ID3v1 del final de un archivo.
+ * @param fd      Descriptor del archivo.
+ * @param tamanio Tamanio del archivo.
+ * @param valores Campos a completar (solo los que estan vacios).
+*/
+static void leer_id3v1(int fd, long long tamanio, char valores[CAMPOS][VALOR_MAX])
+{
+    unsigned char etiqueta[128];
+
+    if (tamanio < (long long)sizeof(etiqueta) || pread(fd, etiqueta, sizeof(etiqueta), tamanio - sizeof(etiqueta)) != sizeof(etiqueta)
+        || memcmp(etiqueta, "TAG", 3) != 0)
+    {
+        return;
+    }
+    copiar_id3v1(etiqueta + 3, 30, valores[TITULO]);
+    copiar_id3v1(etiqueta + 33, 30, valores[ARTISTA]);
+    copiar_id3v1(etiqueta + 63, 30, valores[ALBUM]);
+    copiar_id3v1(etiqueta + 93, 4, valores[ANIO]);
+    if (valores[GENERO][0] == '\0' && etiqueta[127] < GENEROS_ID3)
+    {
+        snprintf(valores[GENERO], VALOR_MAX, "%s", generos_id3[etiqueta[127]]);
+    }
+}
+
+/*!
+ * @brief   Reemplaza un genero numerico de ID3 ("17", "(17)" o "(17)Rock") por su nombre.
+ * @param valor Genero (se corrige en el lugar).
+*/
+static void traducir_genero(char* valor)
+{
+    char* fin = NULL;
+    long numero;
+
+    if (valor[0] == '(' && isdigit((unsigned char)valor[1]))
+    {
+        numero = strtol(valor + 1, &fin, 10);
+        if (*fin != ')')
+        {
+            return;
+        }
+        if (fin[1] != '\0') // refinamiento en texto: es mas preciso que el numero.
+        {
+            memmove(valor, fin + 1, strlen(fin + 1) + 1);
+            return;
+        }
+    } else if (isdigit((unsigned char)valor[0]))
+    {
+        numero = strtol(valor, &fin, 10);
+        if (*fin != '\0')
+        {
+            return;
+        }
+    } else
+    {
+        if (strcmp(valor, "(RX)") == 0 || strcmp(valor, "RX") == 0)
+        {
+            strcpy(valor, "Remix");
+        } else if (strcmp(valor, "(CR)") == 0 || strcmp(valor, "CR") == 0)
+        {
+            strcpy(valor, "Cover");
+        }
+        return;
+    }
+    if (numero >= 0 && numero < GENEROS_ID3)
+    {
+        snprintf(valor, VALOR_MAX, "%s", generos_id3[numero]);
+    } else
+    {
+        valor[0] = '\0';
+    }
+}
+
+/*!
+ * @brief   Deja un campo listo para media.csv: las comas y los caracteres de control pasan a ser espacios,
+ *          y se quitan los espacios repetidos y los de los extremos.
+ * @param valor Campo (se corrige en el lugar).
+*/
+static void limpiar(char* valor)
+{
+    size_t i, j = 0;
+    unsigned char c;
+
+    for (i = 0; valor[i] != '\0'; i++)
+    {
+        c = valor[i];
+        if (c == ',' || c < 0x20 || c == 0x7F)
+        {
+            c = ' ';
+        }
+        if (c == ' ' && (j == 0 || valor[j - 1] == ' '))
+        {
+            continue;
+        }
+        valor[j++] = c;
+    }
+    while (j > 0 && valor[j - 1] == ' ')
+    {
+        j--;
+    }
+    valor[j] = '\0';
+}
+
+/*!
+ * @brief   Arma la fila de media.csv de un archivo a partir de sus etiquetas.
+ *          Sin titulo se usa el nombre del archivo; los demas campos que faltan quedan como DESCONOCIDO.
+ * @param fd      Descriptor del archivo.
+ * @param ruta    Ruta del archivo.
+ * @param tamanio Tamanio del archivo.
+ * @return Fila (se libera con free()), o NULL si no hay memoria.
+*/
+static char* armar_fila(int fd, const char* ruta, long long tamanio)
+{
+    char valores[CAMPOS][VALOR_MAX];
+    const char* nombre = strrchr(ruta, '/');
+    char* fila = NULL;
+    int i;
+
+    memset(valores, 0, sizeof(valores));
+    leer_id3v2(fd, valores);
+    leer_id3v1(fd, tamanio, valores);
+    traducir_genero(valores[GENERO]);
+    // del anio solo interesan los cuatro primeros digitos (ID3v2.4 guarda fechas completas).
+    if (strlen(valores[ANIO]) >= 4 && isdigit((unsigned char)valores[ANIO][0]) && isdigit((unsigned char)valores[ANIO][1])
+        && isdigit((unsigned char)valores[ANIO][2]) && isdigit((unsigned char)valores[ANIO][3]))
+    {
+        valores[ANIO][4] = '\0';
+    } else
+    {
+        valores[ANIO][0] = '\0';
+    }
+    for (i = 0; i < CAMPOS; i++)
+    {
+        limpiar(valores[i]);
+    }
+    if (valores[TITULO][0] == '\0')
+    {
+        snprintf(valores[TITULO], VALOR_MAX, "%.*s", (int)(strlen(nombre ? nombre + 1 : ruta) - 4), nombre ? nombre + 1 : ruta);
+        limpiar(valores[TITULO]);
+    }
+    for (i = 0; i < CAMPOS; i++)
+    {
+        if (valores[i][0] == '\0')
+        {
+            strcpy(valores[i], DESCONOCIDO);
+        }
+    }
+    if ((fila = malloc(CAMPOS * VALOR_MAX)) != NULL)
+    {
+        snprintf(fila, CAMPOS * VALOR_MAX, "%s,%s,%s,%s,%s", valores[TITULO], valores[ARTISTA], valores[ALBUM], valores[GENERO], valores[ANIO]);
+    }
+    return fila;
+}
+
+/*!
+ * @brief   Compara dos archivos del escaneo anterior por ruta.
+ * @param a Primer archivo.
+ * @param b Segundo archivo.
+ * @return Negativo, cero o positivo segun el orden (como strcmp).
+*/
+static int comparar_previos(const void* a, const void* b)
+{
+    return strcmp(((const Previo*)a)->ruta, ((const Previo*)b)->ruta);
+}
+
+/*!
+ * @brief   Arma y guarda el indice de marcos de un archivo si se pidio y falta o esta viejo (ver marcos.h).
+ *          Los archivos sin marcos MP3 se saltean sin contarlos como errores.
+ * @param trabajador Hilo que procesa el archivo.
+ * @param ruta       Ruta del archivo.
+ * @param fd         Descriptor del archivo, o -1 si no esta abierto.
+ * @param datos      Datos del archivo.
+*/
+static void armar_marcos(Trabajador* trabajador, const char* ruta, int fd, const struct stat* datos)
+{
+    Escaneo* escaneo = trabajador->escaneo;
+    Marcos marcos;
+    int propio = -1;
+
+    if (!escaneo->marcos || marcos_al_dia(escaneo->base, ruta, datos))
+    {
+        return;
+    }
+    if (fd < 0 && (fd = propio = openat(escaneo->base, ruta, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        trabajador->errores++;
+        return;
+    }
+    if (marcos_obtener(escaneo->base, ruta, fd, &marcos) == OK)
+    {
+        trabajador->marcos++;
+        marcos_liberar(&marcos);
+    }
+    if (propio >= 0)
+    {
+        close(propio);
+    }
+}
+
+/*!
+ * @brief   Procesa un archivo .mp3: si no cambio desde el escaneo anterior reutiliza su fila, si no lee sus etiquetas.
+ * @param trabajador Hilo que procesa el archivo.
+ * @param ruta       Ruta del archivo (pasa a ser del registro).
+*/
+static void procesar_archivo(Trabajador* trabajador, char* ruta)
+{
+    Escaneo* escaneo = trabajador->escaneo;
+    Registro* registro = NULL;
+    Registro* nuevos = NULL;
+    Previo clave;
+    Previo* previo = NULL;
+    struct stat datos;
+    int fd;
+
+    if (fstatat(escaneo->base, ruta, &datos, 0) < 0 || !S_ISREG(datos.st_mode))
+    {
+        trabajador->errores++;
+        free(ruta);
+        return;
+    }
+    if (trabajador->cantidad == trabajador->capacidad)
+    {
+        if ((nuevos = realloc(trabajador->registros, (trabajador->capacidad * 2 + 64) * sizeof(Registro))) == NULL)
+        {
+            escaneo->sin_memoria = 1;
+            free(ruta);
+            return;
+        }
+        trabajador->registros = nuevos;
+        trabajador->capacidad = trabajador->capacidad * 2 + 64;
+    }
+    registro = &trabajador->registros[trabajador->cantidad];
+    registro->ruta = ruta;
+    registro->numero = 0;
+    registro->segundos = datos.st_mtim.tv_sec;
+    registro->nanos = datos.st_mtim.tv_nsec;
+    registro->tamanio = datos.st_size;
+    registro->fila = NULL;
+    clave.ruta = ruta;
+    if (escaneo->cantidad_previos > 0
+        && (previo = bsearch(&clave, escaneo->previos, escaneo->cantidad_previos, sizeof(Previo), comparar_previos)) != NULL)
+    {
+        previo->encontrado = 1;
+        registro->numero = previo->numero;
+        if (previo->fila != NULL && previo->segundos == registro->segundos && previo->nanos == registro->nanos
+            && previo->tamanio == registro->tamanio)
+        {
+            if ((registro->fila = strdup(previo->fila)) != NULL)
+            {
+                trabajador->reutilizados++;
+                trabajador->cantidad++;
+                armar_marcos(trabajador, ruta, -1, &datos);
+                return;
+            }
+        }
+    }
+    if ((fd = openat(escaneo->base, ruta, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        trabajador->errores++;
+        free(ruta);
+        return;
+    }
+    registro->fila = armar_fila(fd, ruta, registro->tamanio);
+    if (registro->fila != NULL)
+    {
+        armar_marcos(trabajador, ruta, fd, &datos);
+    }
+    close(fd);
+    if (registro->fila == NULL)
+    {
+        escaneo->sin_memoria = 1;
+        free(ruta);
+        return;
+    }
+    trabajador->leidos++;
+    trabajador->cantidad++;
+}
+
+/*!
+ * @brief   Hilo del escaner: procesa tareas propias y, cuando no le quedan, roba a los demas hasta que
+ *          no quede ninguna pendiente.
+ * @param arg Trabajador del hilo.
+ * @return NULL al finalizar.
+*/
+static void* trabajar(void* arg)
+{
+    Trabajador* trabajador = arg;
+    Escaneo* escaneo = trabajador->escaneo;
+    Tarea tarea;
+
+    while (1)
+    {
+        if (tomar_tarea(&trabajador->cola, &tarea) || robar_tareas(trabajador, &tarea))
+        {
+            if (tarea.directorio)
+            {
+                procesar_directorio(trabajador, tarea.ruta);
+                free(tarea.ruta);
+            } else
+            {
+                procesar_archivo(trabajador, tarea.ruta);
+            }
+            // las tareas que encontro ya se contaron: recien ahora puede llegar a cero.
+            __atomic_sub_fetch(&escaneo->pendientes, 1, __ATOMIC_RELEASE);
+            continue;
+        }
+        if (__atomic_load_n(&escaneo->pendientes, __ATOMIC_ACQUIRE) == 0)
+        {
+            return NULL;
+        }
+        sched_yield();
+    }
+}
+
+/*!
+ * @brief   Lee un archivo de texto completo.
+ * @param ruta Archivo a leer.
+ * @return Contenido terminado en nulo (se libera con free()), o NULL si no existe o no hay memoria.
+*/
+static char* leer_texto(const char* ruta)
+{
+    FILE* archivo = fopen(ruta, "rb");
+    char* texto = NULL;
+    long largo;
+
+    if (archivo == NULL)
+    {
+        return NULL;
+    }
+    if (fseek(archivo, 0, SEEK_END) == 0 && (largo = ftell(archivo)) >= 0 && fseek(archivo, 0, SEEK_SET) == 0
+        && (texto = malloc(largo + 1)) != NULL)
+    {
+        texto[fread(texto, 1, largo, archivo)] = '\0';
+    }
+    fclose(archivo);
+    return texto;
+}
+
+/*!
+ * @brief   Parte un texto en lineas, reemplazando cada salto de linea por un nulo.
+ * @param texto  Texto a partir.
+ * @param lineas Lineas (se libera con free()).
+ * @return Cantidad de lineas, o -1 si no hay memoria.
+*/
+static int partir_lineas(char* texto, char*** lineas)
+{
+    int cantidad = 0, capacidad = 0;
+    char* linea = texto;
+    char* fin = NULL;
+    char** nuevas = NULL;
+
+    *lineas = NULL;
+    while (linea != NULL && *linea != '\0')
+    {
+        if (cantidad == capacidad)
+        {
+            capacidad = capacidad * 2 + 64;
+            if ((nuevas = realloc(*lineas, capacidad * sizeof(char*))) == NULL)
+            {
+                free(*lineas);
+                *lineas = NULL;
+                return -1;
+            }
+            *lineas = nuevas;
+        }
+        if ((fin = strchr(linea, '\n')) != NULL)
+        {
+            *fin++ = '\0';
+        }
+        (*lineas)[cantidad++] = linea;
+        linea = fin;
+    }
+    return cantidad;
+}
+
+/*!
+ * @brief   Carga el escaneo anterior: las lineas de media.idx junto a las filas de media.csv.
+ * @param escaneo   Escaneo a completar con los previos.
+ * @param texto_idx Contenido de media.idx (se parte en el lugar).
+ * @param texto_csv Contenido de media.csv (se parte en el lugar; puede ser NULL).
+ * @return Cantidad de lineas de media.idx (el ultimo numero usado), o -1 si no hay memoria.
+*/
+static int cargar_previos(Escaneo* escaneo, char* texto_idx, char* texto_csv)
+{
+    char** lineas = NULL;
+    char** filas = NULL;
+    char* campo = NULL;
+    int i, cantidad, cantidad_filas = 0;
+    Previo* previo = NULL;
+
+    if ((cantidad = partir_lineas(texto_idx, &lineas)) < 0
+        || (texto_csv != NULL && (cantidad_filas = partir_lineas(texto_csv, &filas)) < 0)
+        || (escaneo->previos = calloc(cantidad + 1, sizeof(Previo))) == NULL)
+    {
+        free(lineas);
+        free(filas);
+        return -1;
+    }
+    for (i = 0; i < cantidad; i++)
+    {
+        if ((campo = strchr(lineas[i], '\t')) == NULL)
+        {
+            continue; // cancion quitada.
+        }
+        previo = &escaneo->previos[escaneo->cantidad_previos++];
+        *campo++ = '\0';
+        previo->ruta = lineas[i];
+        previo->numero = i + 1;
+        previo->segundos = strtoll(campo, &campo, 10);
+        previo->nanos = (*campo == '.') ? strtol(campo + 1, &campo, 10) : 0;
+        previo->tamanio = (*campo == '\t') ? strtoll(campo + 1, NULL, 10) : -1;
+        previo->fila = (i < cantidad_filas && *filas[i] != '\0') ? filas[i] : NULL;
+    }
+    qsort(escaneo->previos, escaneo->cantidad_previos, sizeof(Previo), comparar_previos);
+    free(lineas);
+    free(filas);
+    return cantidad;
+}
+
+/*!
+ * @brief   Compara dos registros por ruta.
+ * @param a Primer registro.
+ * @param b Segundo registro.
+ * @return Negativo, cero o positivo segun el orden (como strcmp).
+*/
+static int comparar_registros(const void* a, const void* b)
+{
+    return strcmp((*(Registro* const*)a)->ruta, (*(Registro* const*)b)->ruta);
+}
+
+/*!
+ * @brief   Obtiene el numero de cancion del nombre de un archivo N.mp3.
+ * @param ruta Ruta del archivo.
+ * @return Numero, o 0 si el nombre no es un numero.
+*/
+static uint32_t numero_de_nombre(const char* ruta)
+{
+    const char* nombre = strrchr(ruta, '/');
+    uint32_t numero = 0;
+
+    for (nombre = nombre ? nombre + 1 : ruta; isdigit((unsigned char)*nombre); nombre++)
+    {
+        if ((numero = numero * 10 + (*nombre - '0')) >= ARCHIVOS_IDS)
+        {
+            return 0;
+        }
+    }
+    return (strcasecmp(nombre, ".mp3") == 0) ? numero : 0;
+}
+
+/*!
+ * @brief   Escribe un archivo nuevo y lo pone en lugar de otro con rename.
+ * @param ruta      Archivo a reemplazar.
+ * @param lineas    Registro de cada numero de cancion (NULL si el numero esta libre).
+ * @param cantidad  Cantidad de numeros.
+ * @param indice    1 para escribir media.idx, 0 para media.csv.
+ * @return OK(0) si se escribe, ERROR(-1) si falla la escritura.
+*/
+static int escribir(const char* ruta, Registro** lineas, int cantidad, int indice)
+{
+    char temporal[PATH_MAX];
+    FILE* archivo = NULL;
+    int i, estado = OK;
+
+    snprintf(temporal, sizeof(temporal), "%s.nuevo", ruta);
+    if ((archivo = fopen(temporal, "w")) == NULL)
+    {
+        return ERROR;
+    }
+    for (i = 1; i <= cantidad; i++)
+    {
+        if (lineas[i] == NULL)
+        {
+            fputc('\n', archivo);
+        } else if (indice)
+        {
+            fprintf(archivo, "%s\t%lld.%09ld\t%lld\n", lineas[i]->ruta, lineas[i]->segundos, lineas[i]->nanos, lineas[i]->tamanio);
+        } else
+        {
+            fprintf(archivo, "%s\n", lineas[i]->fila);
+        }
+    }
+    if (ferror(archivo))
+    {
+        estado = ERROR;
+    }
+    if (fclose(archivo) != 0 || estado != OK || rename(temporal, ruta) != 0)
+    {
+        unlink(temporal);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Asigna numeros de cancion a los registros y escribe el indice y el catalogo.
+ *          Los archivos que ya estaban conservan su numero; los nuevos toman el de su nombre (N.mp3)
+ *          si esta libre y es mayor que los del indice anterior y, si no, el siguiente al ultimo usado, en el
+ *          orden de sus rutas. Los numeros de los archivos que se quitaron quedan como lineas vacias en los dos
+ *          archivos: un cliente que guardo un numero nunca recibe otra cancion con el.
+ * @param escaneo   Escaneo terminado.
+ * @param anteriores Lineas del indice anterior (los numeros hasta ahi no se reutilizan para archivos nuevos).
+ * @param catalogo  Catalogo a escribir.
+ * @param indice    Indice a escribir.
+ * @param resumen   Resumen a completar con los nuevos.
+ * @return OK(0) si se escriben, ERROR(-1) si falla la escritura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int asignar_y_escribir(Escaneo* escaneo, int anteriores, const char* catalogo, const char* indice, Resumen* resumen)
+{
+    Registro** registros = NULL;
+    Registro** lineas = NULL;
+    int i, j, cantidad = 0, ultimo = anteriores, estado;
+    uint32_t numero, tope;
+
+    for (i = 0; i < escaneo->hilos; i++)
+    {
+        cantidad += escaneo->trabajadores[i].cantidad;
+    }
+    if ((registros = malloc((cantidad + 1) * sizeof(Registro*))) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    cantidad = 0;
+    tope = anteriores;
+    for (i = 0; i < escaneo->hilos; i++)
+    {
+        for (j = 0; j < escaneo->trabajadores[i].cantidad; j++)
+        {
+            registros[cantidad++] = &escaneo->trabajadores[i].registros[j];
+            numero = registros[cantidad - 1]->numero ? registros[cantidad - 1]->numero : numero_de_nombre(registros[cantidad - 1]->ruta);
+            tope = (numero > tope) ? numero : tope;
+        }
+    }
+    tope += cantidad + 1;
+    // el orden de las rutas hace que dos escaneos del mismo directorio numeren igual los archivos nuevos.
+    qsort(registros, cantidad, sizeof(Registro*), comparar_registros);
+    if ((lineas = calloc(tope, sizeof(Registro*))) == NULL)
+    {
+        free(registros);
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < cantidad; i++)
+    {
+        if (registros[i]->numero != 0)
+        {
+            lineas[registros[i]->numero] = registros[i];
+        }
+    }
+    for (i = 0; i < cantidad; i++)
+    {
+        if (registros[i]->numero == 0 && (numero = numero_de_nombre(registros[i]->ruta)) > (uint32_t)anteriores
+            && lineas[numero] == NULL)
+        {
+            registros[i]->numero = numero;
+            lineas[numero] = registros[i];
+            resumen->nuevos++;
+        }
+    }
+    for (i = 1; i < (int)tope; i++)
+    {
+        ultimo = (lineas[i] != NULL && i > ultimo) ? i : ultimo;
+    }
+    for (i = 0; i < cantidad; i++)
+    {
+        if (registros[i]->numero == 0)
+        {
+            registros[i]->numero = ++ultimo;
+            lineas[ultimo] = registros[i];
+            resumen->nuevos++;
+        }
+    }
+    // primero el indice: cuando el servidor vea el catalogo nuevo, los archivos de sus canciones ya estan.
+    estado = escribir(indice, lineas, ultimo, 1);
+    if (estado == OK)
+    {
+        estado = escribir(catalogo, lineas, ultimo, 0);
+    }
+    free(lineas);
+    free(registros);
+    return estado;
+}
+
+/*!
+ * @brief   Escanea el directorio de canciones y reescribe el catalogo y su indice.
+ *          Ambos archivos se escriben aparte y se reemplazan con rename, asi un servidor en marcha nunca
+ *          lee un catalogo a medio escribir.
+ * @param directorio Directorio de las canciones.
+ * @param catalogo   Catalogo a escribir (ej: media.csv).
+ * @param indice     Indice a escribir (ej: media.idx); el anterior, si existe, se usa para no releer archivos.
+ * @param hilos      Cantidad de hilos (0 para elegirla segun los procesadores).
+ * @param marcos     1 para armar tambien los indices de marcos que falten (ver marcos.h), 0 para dejarlos
+ *                   para el primer pedido de un instante.
+ * @param resumen    Resumen del escaneo a completar.
+ * @return OK(0) si se escribe el catalogo, ERROR(-1) si no se pudo leer el directorio o escribir los archivos,
+ *         ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int escaner_actualizar(const char* directorio, const char* catalogo, const char* indice, int hilos, int marcos, Resumen* resumen)
+{
+    Escaneo escaneo;
+    Tarea raiz = { NULL, 1 };
+    char* texto_idx = NULL;
+    char* texto_csv = NULL;
+    struct timespec inicio, fin;
+    int i, j, creados = 0, anteriores = 0, estado = OK;
+
+    memset(resumen, 0, sizeof(Resumen));
+    memset(&escaneo, 0, sizeof(escaneo));
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    if (hilos <= 0)
+    {
+        // la mayor parte del tiempo se espera al disco: conviene tener mas hilos que procesadores.
+        hilos = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    hilos = (hilos < 1) ? 1 : (hilos > ESCANER_HILOS_MAX) ? ESCANER_HILOS_MAX : hilos;
+    if ((escaneo.base = open(directorio, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+    {
+        return ERROR;
+    }
+    if ((texto_idx = leer_texto(indice)) != NULL)
+    {
+        texto_csv = leer_texto(catalogo);
+        if ((anteriores = cargar_previos(&escaneo, texto_idx, texto_csv)) < 0)
+        {
+            estado = ERROR_DE_MEMORIA;
+        }
+    }
+    if (estado == OK && ((escaneo.trabajadores = calloc(hilos, sizeof(Trabajador))) == NULL || (raiz.ruta = strdup("")) == NULL))
+    {
+        estado = ERROR_DE_MEMORIA;
+    }
+    if (estado == OK)
+    {
+        escaneo.hilos = hilos;
+        escaneo.marcos = marcos;
+        for (i = 0; i < hilos; i++)
+        {
+            pthread_mutex_init(&escaneo.trabajadores[i].cola.mutex, NULL);
+            escaneo.trabajadores[i].escaneo = &escaneo;
+            escaneo.trabajadores[i].semilla = i * 2654435761u + 1;
+        }
+        escaneo.pendientes = 1;
+        if (agregar_tarea(&escaneo.trabajadores[0].cola, raiz) != OK)
+        {
+            free(raiz.ruta);
+            estado = ERROR_DE_MEMORIA;
+        }
+    }
+    if (estado == OK)
+    {
+        for (creados = 1; creados < hilos; creados++)
+        {
+            if (pthread_create(&escaneo.trabajadores[creados].hilo, NULL, trabajar, &escaneo.trabajadores[creados]) != 0)
+            {
+                break;
+            }
+        }
+        trabajar(&escaneo.trabajadores[0]); // el hilo que llama tambien trabaja.
+        for (i = 1; i < creados; i++)
+        {
+            pthread_join(escaneo.trabajadores[i].hilo, NULL);
+        }
+        resumen->hilos = creados;
+        for (i = 0; i < hilos; i++)
+        {
+            resumen->archivos += escaneo.trabajadores[i].cantidad;
+            resumen->leidos += escaneo.trabajadores[i].leidos;
+            resumen->reutilizados += escaneo.trabajadores[i].reutilizados;
+            resumen->errores += escaneo.trabajadores[i].errores;
+            resumen->robos += escaneo.trabajadores[i].robos;
+            resumen->marcos += escaneo.trabajadores[i].marcos;
+        }
+        for (i = 0; i < escaneo.cantidad_previos; i++)
+        {
+            resumen->quitados += !escaneo.previos[i].encontrado;
+        }
+        estado = escaneo.sin_memoria ? ERROR_DE_MEMORIA : asignar_y_escribir(&escaneo, anteriores, catalogo, indice, resumen);
+    }
+
+    for (i = 0; escaneo.trabajadores != NULL && i < hilos; i++)
+    {
+        for (j = 0; j < escaneo.trabajadores[i].cantidad; j++)
+        {
+            free(escaneo.trabajadores[i].registros[j].ruta);
+            free(escaneo.trabajadores[i].registros[j].fila);
+        }
+        free(escaneo.trabajadores[i].registros);
+        free(escaneo.trabajadores[i].cola.tareas);
+        pthread_mutex_destroy(&escaneo.trabajadores[i].cola.mutex);
+    }
+    free(escaneo.trabajadores);
+    free(escaneo.previos);
+    free(texto_idx);
+    free(texto_csv);
+    close(escaneo.base);
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+    resumen->segundos = (fin.tv_sec - inicio.tv_sec) + (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+    return estado;
+}
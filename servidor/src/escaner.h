@@ -0,0 +1,88 @@
+/*!
+ * @file    escaner.h
+ * @brief   Definiciones y declaraciones del escaner del directorio de canciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros del escaner y la estructura Resumen.
+ *          - La declaracion de la funcion que arma el catalogo a partir de los archivos .mp3.
+ *          El escaner recorre el directorio de canciones (y sus subdirectorios), lee las etiquetas ID3v2 e ID3v1
+ *          de cada .mp3 y escribe media.csv y media.idx: la linea N de media.idx tiene la ruta, la fecha de
+ *          modificacion y el tamanio del archivo de la cancion N de media.csv.
+ *          Los numeros de cancion no cambian entre escaneos: un archivo que ya estaba conserva su numero, uno que
+ *          desaparece deja su linea vacia y uno nuevo toma el numero de su nombre (N.mp3) si esta libre, o uno al
+ *          final. Solo se vuelven a leer las etiquetas de los archivos cuya fecha de modificacion o tamanio cambio.
+ *          El trabajo se reparte entre varios hilos con robo de tareas: cada hilo tiene su propia cola de
+ *          directorios y archivos por procesar, agrega al final lo que encuentra y toma de ahi; un hilo sin
+ *          tareas le roba la mitad de las mas viejas a otro, asi un directorio con muchos archivos se reparte solo.
+*/
+
+#ifndef ESCANER_H
+#define ESCANER_H
+
+/*!
+ * @def ESCANER_ENTORNO
+ * @brief Variable de entorno que pide escanear el directorio de canciones al iniciar el servidor.
+ *        Su valor es la cantidad de hilos (0 para elegirla segun los procesadores).
+*/
+#define ESCANER_ENTORNO "CATALOGO_ESCANEAR"
+
+/*!
+ * @def ESCANER_HILOS_MAX
+ * @brief Cantidad maxima de hilos del escaner.
+*/
+#define ESCANER_HILOS_MAX 64
+
+/*!
+ * @def ETIQUETA_MAX
+ * @brief Bytes que se leen como maximo de una etiqueta ID3v2 (las imagenes suelen ir al final y se ignoran).
+*/
+#define ETIQUETA_MAX (256 * 1024)
+
+/*!
+ * @def VALOR_MAX
+ * @brief Tamanio maximo de un campo leido de las etiquetas, en bytes de UTF-8.
+*/
+#define VALOR_MAX 256
+
+/*!
+ * @def DESCONOCIDO
+ * @brief Valor de los campos que no tienen etiqueta (media.csv no admite campos vacios).
+*/
+#define DESCONOCIDO "Desconocido"
+
+/*!
+ * @struct Resumen
+ * @brief Resultado de un escaneo.
+*/
+typedef struct Resumen
+{
+    int archivos;        /**< Archivos .mp3 encontrados. */
+    int leidos;          /**< Archivos cuyas etiquetas se leyeron (nuevos o modificados). */
+    int reutilizados;    /**< Archivos sin cambios, tomados del escaneo anterior. */
+    int nuevos;          /**< Archivos que no estaban en el escaneo anterior. */
+    int quitados;        /**< Archivos del escaneo anterior que ya no estan. */
+    int errores;         /**< Archivos o directorios que no se pudieron leer. */
+    int robos;           /**< Veces que un hilo tomo tareas de otro. */
+    int marcos;          /**< Indices de marcos armados. */
+    int hilos;           /**< Hilos usados. */
+    double segundos;     /**< Duracion del escaneo. */
+} Resumen;
+
+/*!
+ * @brief   Escanea el directorio de canciones y reescribe el catalogo y su indice.
+ *          Ambos archivos se escriben aparte y se reemplazan con rename, asi un servidor en marcha nunca
+ *          lee un catalogo a medio escribir.
+ * @param directorio Directorio de las canciones.
+ * @param catalogo   Catalogo a escribir (ej: media.csv).
+ * @param indice     Indice a escribir (ej: media.idx); el anterior, si existe, se usa para no releer archivos.
+ * @param hilos      Cantidad de hilos (0 para elegirla segun los procesadores).
+ * @param marcos     1 para armar tambien los indices de marcos que falten (ver marcos.h), 0 para dejarlos
+ *                   para el primer pedido de un instante.
+ * @param resumen    Resumen del escaneo a completar.
+ * @return OK(0) si se escribe el catalogo, ERROR(-1) si no se pudo leer el directorio o escribir los archivos,
+ *         ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int escaner_actualizar(const char* directorio, const char* catalogo, const char* indice, int hilos, int marcos, Resumen* resumen);
+
+#endif
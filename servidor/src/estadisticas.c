@@ -0,0 +1,420 @@
+/*!
+ * @file    estadisticas.c
+ * @brief   Estadisticas de operaciones del servidor: contadores, histogramas de latencia y socket de administracion.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Registrar la duracion, el resultado y los bytes de cada operacion sin tomar bloqueos:
+ *            cada hilo escribe con operaciones atomicas en su propio fragmento.
+ *          - Sumar los fragmentos y calcular cuantiles de latencia.
+ *          - Publicar las estadisticas por un socket local en formato de texto de Prometheus.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "estadisticas.h"
+#include "transporte.h"
+#include "canciones.h"
+#include "archivos.h"
+#include "popularidad.h"
+#include "calentador.h"
+#include "directo.h"
+#include "avisos.h"
+#include "bitacora.h"
+
+/*!
+ * @struct Fragmento
+ * @brief Histogramas de todas las operaciones que registran los hilos asignados a un fragmento.
+ *        Se alinea a la linea de cache para que fragmentos vecinos no se interfieran.
+*/
+typedef struct Fragmento
+{
+    Histograma operaciones[OPERACIONES]; /**< Histograma de cada operacion. */
+} __attribute__((aligned(64))) Fragmento;
+
+static Fragmento fragmentos[FRAGMENTOS];
+static int fragmentos_asignados = 0;        // hilos que ya eligieron fragmento.
+static __thread int fragmento_propio = -1;  // fragmento del hilo actual.
+static int64_t conexiones_activas = 0;
+static uint64_t conexiones_totales = 0;
+
+static const char* nombres[OPERACIONES] = { "inicio", "registro", "listar", "filtrar", "descarga", "lote" };
+
+/*!
+ * @brief   Devuelve el instante actual del reloj monotono.
+ * @return Segundos desde un origen arbitrario.
+*/
+double estadisticas_ahora(void)
+{
+    struct timespec instante;
+
+    clock_gettime(CLOCK_MONOTONIC, &instante);
+    return instante.tv_sec + instante.tv_nsec / 1e9;
+}
+
+/*!
+ * @brief   Calcula la cubeta de una latencia.
+ *          Por debajo de 64 us cada microsegundo tiene su cubeta; por encima, cada potencia de dos
+ *          se divide en 32 cubetas iguales.
+ * @param valor Latencia en microsegundos.
+ * @return Indice de cubeta entre 0 y CUBETAS - 1.
+*/
+static int cubeta(uint64_t valor)
+{
+    int magnitud;
+
+    if (valor < (2 << SUBCUBETAS_BITS))
+    {
+        return (int)valor;
+    }
+    magnitud = 63 - __builtin_clzll(valor) - SUBCUBETAS_BITS;
+    if (magnitud > MAGNITUDES)
+    {
+        return CUBETAS - 1;
+    }
+    return (2 << SUBCUBETAS_BITS) + (magnitud - 1) * (1 << SUBCUBETAS_BITS) + (int)((valor >> magnitud) - (1 << SUBCUBETAS_BITS));
+}
+
+/*!
+ * @brief   Devuelve el valor representativo (punto medio) de una cubeta.
+ * @param indice Indice de cubeta.
+ * @return Latencia en microsegundos.
+*/
+static uint64_t valor_cubeta(int indice)
+{
+    int magnitud;
+    uint64_t base;
+
+    if (indice < (2 << SUBCUBETAS_BITS))
+    {
+        return indice;
+    }
+    magnitud = (indice - (2 << SUBCUBETAS_BITS)) / (1 << SUBCUBETAS_BITS) + 1;
+    base = (uint64_t)((indice - (2 << SUBCUBETAS_BITS)) % (1 << SUBCUBETAS_BITS) + (1 << SUBCUBETAS_BITS)) << magnitud;
+    return base + ((1ULL << magnitud) >> 1);
+}
+
+/*!
+ * @brief   Devuelve el fragmento del hilo actual, asignandolo en su primer registro.
+ * @return Fragmento del hilo.
+*/
+static Fragmento* fragmento(void)
+{
+    if (fragmento_propio < 0)
+    {
+        fragmento_propio = __atomic_fetch_add(&fragmentos_asignados, 1, __ATOMIC_RELAXED) % FRAGMENTOS;
+    }
+    return &fragmentos[fragmento_propio];
+}
+
+/*!
+ * @brief   Registra una operacion terminada.
+ *          Puede llamarse desde cualquier hilo; no toma bloqueos.
+ * @param operacion Operacion (OP_INICIO a OP_LOTE).
+ * @param segundos  Duracion de la operacion.
+ * @param exito     1 si la operacion termino bien, 0 si termino con error.
+ * @param bytes     Bytes de datos enviados por la operacion.
+*/
+void estadisticas_registrar(int operacion, double segundos, int exito, uint64_t bytes)
+{
+    Histograma* histograma = &fragmento()->operaciones[operacion];
+    uint64_t valor = (segundos > 0) ? (uint64_t)(segundos * 1e6) : 0;
+    uint64_t maximo = __atomic_load_n(&histograma->maximo, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&histograma->cubetas[cubeta(valor)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histograma->cantidad, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histograma->suma, valor, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histograma->bytes, bytes, __ATOMIC_RELAXED);
+    if (!exito)
+    {
+        __atomic_fetch_add(&histograma->errores, 1, __ATOMIC_RELAXED);
+    }
+    while (valor > maximo && !__atomic_compare_exchange_n(&histograma->maximo, &maximo, valor, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+/*!
+ * @brief   Registra la apertura (+1) o el cierre (-1) de una conexion de cliente.
+ * @param cambio +1 al aceptar una conexion, -1 al cerrarla.
+*/
+void estadisticas_conexion(int cambio)
+{
+    __atomic_fetch_add(&conexiones_activas, cambio, __ATOMIC_RELAXED);
+    if (cambio > 0)
+    {
+        __atomic_fetch_add(&conexiones_totales, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*!
+ * @brief   Suma los fragmentos de una operacion.
+ * @param operacion Operacion (OP_INICIO a OP_LOTE).
+ * @param total     Histograma donde se deja la suma.
+*/
+void estadisticas_leer(int operacion, Histograma* total)
+{
+    int i, j;
+    uint64_t maximo;
+    const Histograma* parcial = NULL;
+
+    memset(total, 0, sizeof(Histograma));
+    for (i = 0; i < FRAGMENTOS; i++)
+    {
+        parcial = &fragmentos[i].operaciones[operacion];
+        for (j = 0; j < CUBETAS; j++)
+        {
+            total->cubetas[j] += __atomic_load_n(&parcial->cubetas[j], __ATOMIC_RELAXED);
+        }
+        total->cantidad += __atomic_load_n(&parcial->cantidad, __ATOMIC_RELAXED);
+        total->suma += __atomic_load_n(&parcial->suma, __ATOMIC_RELAXED);
+        total->errores += __atomic_load_n(&parcial->errores, __ATOMIC_RELAXED);
+        total->bytes += __atomic_load_n(&parcial->bytes, __ATOMIC_RELAXED);
+        if ((maximo = __atomic_load_n(&parcial->maximo, __ATOMIC_RELAXED)) > total->maximo)
+        {
+            total->maximo = maximo;
+        }
+    }
+}
+
+/*!
+ * @brief   Calcula un cuantil de un histograma.
+ * @param histograma Histograma sumado (ver estadisticas_leer()).
+ * @param cuantil    Cuantil entre 0 y 1.
+ * @return Latencia en microsegundos (punto medio de la cubeta), o 0 si no hay muestras.
+*/
+uint64_t histograma_cuantil(const Histograma* histograma, double cuantil)
+{
+    int i;
+    uint64_t acumulado = 0, total = 0, rango, valor;
+
+    // los contadores se leen sin detener a los hilos: usamos la suma de cubetas, no el total aparte.
+    for (i = 0; i < CUBETAS; i++)
+    {
+        total += histograma->cubetas[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    rango = (uint64_t)ceil(cuantil * total); // rango mas cercano.
+    rango = (rango < 1) ? 1 : (rango > total) ? total : rango;
+    for (i = 0; i < CUBETAS; i++)
+    {
+        if ((acumulado += histograma->cubetas[i]) >= rango)
+        {
+            break;
+        }
+    }
+    valor = valor_cubeta(i);
+    return (histograma->maximo > 0 && valor > histograma->maximo) ? histograma->maximo : valor;
+}
+
+/*!
+ * @brief   Escribe un buffer completo en un socket.
+ * @param sock   Socket donde escribir.
+ * @param datos  Datos a escribir.
+ * @param largo  Bytes a escribir.
+ * @return OK(0) si se escriben, ERROR(-1) si falla la escritura.
+*/
+static int escribir_todo(int sock, const char* datos, size_t largo)
+{
+    ssize_t escritos;
+
+    while (largo > 0)
+    {
+        if ((escritos = send(sock, datos, largo, MSG_NOSIGNAL)) < 0)
+        {
+            return ERROR;
+        }
+        datos += escritos;
+        largo -= escritos;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Escribe todas las estadisticas en formato de texto de Prometheus.
+ * @param sock Socket donde escribir.
+ * @return OK(0) si se escriben, ERROR(-1) si falla la escritura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int estadisticas_volcar(int sock)
+{
+    int i, j, estado, abiertos, populares;
+    uint64_t aciertos, aperturas, negativos, inexistentes, calentadas, bytes, descartadas;
+    uint64_t residentes, paginas, directas, sin_soporte, sin_buffer, suscripciones, eventos, entregas, descartados;
+    Popular top[POPULARIDAD_TOP];
+    char* texto = NULL;
+    size_t largo = 0;
+    const double cuantiles[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+    Histograma* totales = malloc(OPERACIONES * sizeof(Histograma));
+    FILE* salida = NULL;
+
+    if (totales == NULL || (salida = open_memstream(&texto, &largo)) == NULL)
+    {
+        bitacora_error("Error al reservar memoria para las estadisticas.\n");
+        free(totales);
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < OPERACIONES; i++)
+    {
+        estadisticas_leer(i, &totales[i]);
+    }
+    fprintf(salida, "# HELP infotify_operaciones_total Operaciones atendidas.\n# TYPE infotify_operaciones_total counter\n");
+    for (i = 0; i < OPERACIONES; i++)
+    {
+        fprintf(salida, "infotify_operaciones_total{operacion=\"%s\"} %llu\n", nombres[i], (unsigned long long)totales[i].cantidad);
+    }
+    fprintf(salida, "# HELP infotify_errores_total Operaciones que terminaron con error.\n# TYPE infotify_errores_total counter\n");
+    for (i = 0; i < OPERACIONES; i++)
+    {
+        fprintf(salida, "infotify_errores_total{operacion=\"%s\"} %llu\n", nombres[i], (unsigned long long)totales[i].errores);
+    }
+    fprintf(salida, "# HELP infotify_bytes_enviados_total Bytes de datos enviados.\n# TYPE infotify_bytes_enviados_total counter\n");
+    for (i = OP_DESCARGA; i <= OP_LOTE; i++)
+    {
+        fprintf(salida, "infotify_bytes_enviados_total{operacion=\"%s\"} %llu\n", nombres[i], (unsigned long long)totales[i].bytes);
+    }
+    fprintf(salida, "# HELP infotify_latencia_segundos Duracion de las operaciones.\n# TYPE infotify_latencia_segundos summary\n");
+    for (i = 0; i < OPERACIONES; i++)
+    {
+        for (j = 0; j < (int)(sizeof(cuantiles) / sizeof(cuantiles[0])); j++)
+        {
+            fprintf(salida, "infotify_latencia_segundos{operacion=\"%s\",quantile=\"%g\"} %.6f\n",
+                    nombres[i], cuantiles[j], histograma_cuantil(&totales[i], cuantiles[j]) / 1e6);
+        }
+        fprintf(salida, "infotify_latencia_segundos_sum{operacion=\"%s\"} %.6f\n", nombres[i], totales[i].suma / 1e6);
+        fprintf(salida, "infotify_latencia_segundos_count{operacion=\"%s\"} %llu\n", nombres[i], (unsigned long long)totales[i].cantidad);
+    }
+    fprintf(salida, "# HELP infotify_conexiones_activas Clientes conectados.\n# TYPE infotify_conexiones_activas gauge\n");
+    fprintf(salida, "infotify_conexiones_activas %lld\n", (long long)__atomic_load_n(&conexiones_activas, __ATOMIC_RELAXED));
+    fprintf(salida, "# HELP infotify_conexiones_total Clientes aceptados.\n# TYPE infotify_conexiones_total counter\n");
+    fprintf(salida, "infotify_conexiones_total %llu\n", (unsigned long long)__atomic_load_n(&conexiones_totales, __ATOMIC_RELAXED));
+    fprintf(salida, "# HELP infotify_bitacora_descartados_total Mensajes de la bitacora descartados por anillos llenos.\n# TYPE infotify_bitacora_descartados_total counter\n");
+    fprintf(salida, "infotify_bitacora_descartados_total %llu\n", (unsigned long long)bitacora_descartados());
+    archivos_contadores(&aciertos, &aperturas, &negativos, &inexistentes, &abiertos);
+    fprintf(salida, "# HELP infotify_archivos_total Pedidos de archivos de canciones, por resultado.\n# TYPE infotify_archivos_total counter\n");
+    fprintf(salida, "infotify_archivos_total{resultado=\"abierto\"} %llu\n", (unsigned long long)aciertos);
+    fprintf(salida, "infotify_archivos_total{resultado=\"apertura\"} %llu\n", (unsigned long long)aperturas);
+    fprintf(salida, "infotify_archivos_total{resultado=\"negativo\"} %llu\n", (unsigned long long)negativos);
+    fprintf(salida, "infotify_archivos_total{resultado=\"inexistente\"} %llu\n", (unsigned long long)inexistentes);
+    fprintf(salida, "# HELP infotify_archivos_abiertos Descriptores de canciones abiertos.\n# TYPE infotify_archivos_abiertos gauge\n");
+    fprintf(salida, "infotify_archivos_abiertos %d\n", abiertos);
+    fprintf(salida, "# HELP infotify_reproducciones_total Canciones pedidas para escuchar (SOL_CANCION y SOL_DESDE).\n# TYPE infotify_reproducciones_total counter\n");
+    fprintf(salida, "infotify_reproducciones_total %llu\n", (unsigned long long)popularidad_total());
+    fprintf(salida, "# HELP infotify_popularidad Reproducciones estimadas de las canciones mas escuchadas (la mitad por cada hora que pasa).\n# TYPE infotify_popularidad gauge\n");
+    for (i = 0, populares = popularidad_top(top); i < populares; i++)
+    {
+        fprintf(salida, "infotify_popularidad{cancion=\"%u\"} %u\n", top[i].numero, top[i].cuenta);
+    }
+    calentador_contadores(&calentadas, &bytes, &descartadas);
+    fprintf(salida, "# HELP infotify_calentador_total Canciones cargadas en memoria por populares o descartadas por frias.\n# TYPE infotify_calentador_total counter\n");
+    fprintf(salida, "infotify_calentador_total{accion=\"calentar\"} %llu\n", (unsigned long long)calentadas);
+    fprintf(salida, "infotify_calentador_total{accion=\"descartar\"} %llu\n", (unsigned long long)descartadas);
+    fprintf(salida, "# HELP infotify_calentador_bytes_total Bytes de canciones populares que se pidieron cargar en memoria.\n# TYPE infotify_calentador_bytes_total counter\n");
+    fprintf(salida, "infotify_calentador_bytes_total %llu\n", (unsigned long long)bytes);
+    calentador_residencia(&residentes, &paginas);
+    fprintf(salida, "# HELP infotify_calentador_residencia Fraccion de las paginas de las canciones calientes que seguia en la cache en la ultima revision.\n# TYPE infotify_calentador_residencia gauge\n");
+    fprintf(salida, "infotify_calentador_residencia %.4f\n", paginas > 0 ? (double)residentes / paginas : 0.0);
+    directo_contadores(&directas, &bytes, &sin_soporte, &sin_buffer);
+    fprintf(salida, "# HELP infotify_directo_total Envios de canciones frias grandes segun como se leyeron.\n# TYPE infotify_directo_total counter\n");
+    fprintf(salida, "infotify_directo_total{lectura=\"directa\"} %llu\n", (unsigned long long)directas);
+    fprintf(salida, "infotify_directo_total{lectura=\"sin_soporte\"} %llu\n", (unsigned long long)sin_soporte);
+    fprintf(salida, "infotify_directo_total{lectura=\"sin_buffer\"} %llu\n", (unsigned long long)sin_buffer);
+    fprintf(salida, "# HELP infotify_directo_bytes_total Bytes leidos con O_DIRECT, sin pasar por la cache de paginas.\n# TYPE infotify_directo_bytes_total counter\n");
+    fprintf(salida, "infotify_directo_bytes_total %llu\n", (unsigned long long)bytes);
+    avisos_contadores(&suscripciones, &eventos, &entregas, &descartados);
+    fprintf(salida, "# HELP infotify_avisos_suscripciones Conexiones suscriptas a los cambios del catalogo.\n# TYPE infotify_avisos_suscripciones gauge\n");
+    fprintf(salida, "infotify_avisos_suscripciones %llu\n", (unsigned long long)suscripciones);
+    fprintf(salida, "# HELP infotify_avisos_total Cambios del catalogo armados como evento, enviados a un cliente o descartados por cola llena.\n# TYPE infotify_avisos_total counter\n");
+    fprintf(salida, "infotify_avisos_total{estado=\"armado\"} %llu\n", (unsigned long long)eventos);
+    fprintf(salida, "infotify_avisos_total{estado=\"entregado\"} %llu\n", (unsigned long long)entregas);
+    fprintf(salida, "infotify_avisos_total{estado=\"descartado\"} %llu\n", (unsigned long long)descartados);
+    fclose(salida);
+    free(totales);
+
+    estado = escribir_todo(sock, texto, largo);
+    free(texto);
+    return estado;
+}
+
+/*!
+ * @brief   Hilo que atiende el socket de administracion.
+ * @param arg Puntero (reservado con malloc) al descriptor del socket de escucha. Se libera aqui.
+ * @return NULL (no termina mientras el servidor este en marcha).
+*/
+static void* atender_admin(void* arg)
+{
+    int escucha = *(int*)arg;
+    int cliente;
+
+    free(arg);
+    while (1)
+    {
+        if ((cliente = accept(escucha, NULL, NULL)) < 0)
+        {
+            bitacora_error("Error al aceptar conexion de administracion.\n");
+            continue;
+        }
+        if (estadisticas_volcar(cliente) != OK)
+        {
+            bitacora_error("Error al enviar estadisticas.\n");
+        }
+        close(cliente);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief   Inicia el socket local de administracion y un hilo que lo atiende.
+ *          Cada conexion al socket recibe las estadisticas actuales (ver estadisticas_volcar()) y se cierra.
+ * @param ruta Ruta del socket (se reemplaza si ya existe).
+ * @return OK(0) si se inicia, ERROR(-1) si ocurre un problema.
+*/
+int estadisticas_iniciar_admin(const char* ruta)
+{
+    int* escucha = malloc(sizeof(int));
+    struct sockaddr_un direccion;
+    pthread_t hilo;
+
+    if (escucha == NULL || strlen(ruta) >= sizeof(direccion.sun_path))
+    {
+        free(escucha);
+        return ERROR;
+    }
+    memset(&direccion, 0, sizeof(direccion));
+    direccion.sun_family = AF_UNIX;
+    strcpy(direccion.sun_path, ruta);
+    unlink(ruta); // un socket que quedo de una ejecucion anterior.
+    if ((*escucha = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+        bitacora_error("Error al crear el socket de administracion.\n");
+        free(escucha);
+        return ERROR;
+    }
+    if (bind(*escucha, (struct sockaddr*)&direccion, sizeof(direccion)) < 0 || chmod(ruta, 0600) < 0
+        || listen(*escucha, SOMAXCONN) < 0)
+    {
+        bitacora_error("Error al enlazar el socket de administracion.\n");
+        close(*escucha);
+        free(escucha);
+        return ERROR;
+    }
+    if (pthread_create(&hilo, NULL, atender_admin, escucha) != 0)
+    {
+        bitacora_error("Error al crear hilo de administracion.\n");
+        close(*escucha);
+        free(escucha);
+        return ERROR;
+    }
+    pthread_detach(hilo);
+    return OK;
+}
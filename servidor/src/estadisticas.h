@@ -0,0 +1,160 @@
+/*!
+ * @file    estadisticas.h
+ * @brief   Definiciones y declaraciones de las estadisticas de operaciones del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Las operaciones medidas y la estructura Histograma de latencias.
+ *          - Declaraciones de funciones para registrar operaciones y publicar las estadisticas.
+ *          Cada operacion tiene un contador de errores, uno de bytes enviados y un histograma de
+ *          latencias con cubetas log-lineales (estilo HDR): 32 cubetas por potencia de dos, con un
+ *          error relativo menor al 3%. Los registros se reparten en fragmentos, uno por hilo segun
+ *          su orden de llegada, para no disputar las mismas lineas de cache; al leer se suman.
+ *          Las estadisticas se publican por un socket local de administracion (ver ADMIN_RUTA):
+ *          cada conexion recibe una foto en formato de texto de Prometheus y se cierra.
+*/
+
+#ifndef ESTADISTICAS_H
+#define ESTADISTICAS_H
+
+#include <stdint.h>
+
+/*!
+ * @def OP_INICIO
+ * @brief Operacion de inicio de sesion.
+*/
+#define OP_INICIO 0
+
+/*!
+ * @def OP_REGISTRO
+ * @brief Operacion de registro de usuario.
+*/
+#define OP_REGISTRO 1
+
+/*!
+ * @def OP_LISTAR
+ * @brief Operacion de listado de canciones.
+*/
+#define OP_LISTAR 2
+
+/*!
+ * @def OP_FILTRAR
+ * @brief Operacion de filtrado de canciones.
+*/
+#define OP_FILTRAR 3
+
+/*!
+ * @def OP_DESCARGA
+ * @brief Descarga de una cancion, desde que se abre el canal hasta su trama de fin.
+*/
+#define OP_DESCARGA 4
+
+/*!
+ * @def OP_LOTE
+ * @brief Descarga de un lote de canciones, desde que se abre el canal hasta su trama de fin.
+*/
+#define OP_LOTE 5
+
+/*!
+ * @def OPERACIONES
+ * @brief Cantidad de operaciones medidas.
+*/
+#define OPERACIONES 6
+
+/*!
+ * @def SUBCUBETAS_BITS
+ * @brief Bits de precision de cada potencia de dos del histograma (2^5 = 32 cubetas).
+*/
+#define SUBCUBETAS_BITS 5
+
+/*!
+ * @def MAGNITUDES
+ * @brief Potencias de dos que cubre el histograma por encima de la zona lineal (hasta 2^40 us, unos 12 dias).
+*/
+#define MAGNITUDES 35
+
+/*!
+ * @def CUBETAS
+ * @brief Cantidad de cubetas del histograma: 64 lineales y 32 por cada potencia de dos siguiente.
+*/
+#define CUBETAS ((2 << SUBCUBETAS_BITS) + MAGNITUDES * (1 << SUBCUBETAS_BITS))
+
+/*!
+ * @def FRAGMENTOS
+ * @brief Cantidad de fragmentos en que se reparten los registros de los hilos.
+*/
+#define FRAGMENTOS 8
+
+/*!
+ * @def ADMIN_RUTA
+ * @brief Ruta del socket local de administracion, relativa al directorio del servidor.
+*/
+#define ADMIN_RUTA "admin.sock"
+
+/*!
+ * @struct Histograma
+ * @brief Latencias de una operacion, en microsegundos.
+*/
+typedef struct Histograma
+{
+    uint64_t cubetas[CUBETAS];   /**< Cantidad de muestras de cada cubeta. */
+    uint64_t cantidad;           /**< Cantidad total de muestras. */
+    uint64_t suma;               /**< Suma de las latencias. */
+    uint64_t maximo;             /**< Mayor latencia registrada. */
+    uint64_t errores;            /**< Operaciones que terminaron con error. */
+    uint64_t bytes;              /**< Bytes de datos enviados por la operacion. */
+} Histograma;
+
+/*!
+ * @brief   Devuelve el instante actual del reloj monotono.
+ * @return Segundos desde un origen arbitrario.
+*/
+double estadisticas_ahora(void);
+
+/*!
+ * @brief   Registra una operacion terminada.
+ *          Puede llamarse desde cualquier hilo; no toma bloqueos.
+ * @param operacion Operacion (OP_INICIO a OP_LOTE).
+ * @param segundos  Duracion de la operacion.
+ * @param exito     1 si la operacion termino bien, 0 si termino con error.
+ * @param bytes     Bytes de datos enviados por la operacion.
+*/
+void estadisticas_registrar(int operacion, double segundos, int exito, uint64_t bytes);
+
+/*!
+ * @brief   Registra la apertura (+1) o el cierre (-1) de una conexion de cliente.
+ * @param cambio +1 al aceptar una conexion, -1 al cerrarla.
+*/
+void estadisticas_conexion(int cambio);
+
+/*!
+ * @brief   Suma los fragmentos de una operacion.
+ * @param operacion Operacion (OP_INICIO a OP_LOTE).
+ * @param total     Histograma donde se deja la suma.
+*/
+void estadisticas_leer(int operacion, Histograma* total);
+
+/*!
+ * @brief   Calcula un cuantil de un histograma.
+ * @param histograma Histograma sumado (ver estadisticas_leer()).
+ * @param cuantil    Cuantil entre 0 y 1.
+ * @return Latencia en microsegundos (punto medio de la cubeta), o 0 si no hay muestras.
+*/
+uint64_t histograma_cuantil(const Histograma* histograma, double cuantil);
+
+/*!
+ * @brief   Escribe todas las estadisticas en formato de texto de Prometheus.
+ * @param sock Socket donde escribir.
+ * @return OK(0) si se escriben, ERROR(-1) si falla la escritura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int estadisticas_volcar(int sock);
+
+/*!
+ * @brief   Inicia el socket local de administracion y un hilo que lo atiende.
+ *          Cada conexion al socket recibe las estadisticas actuales (ver estadisticas_volcar()) y se cierra.
+ * @param ruta Ruta del socket (se reemplaza si ya existe).
+ * @return OK(0) si se inicia, ERROR(-1) si ocurre un problema.
+*/
+int estadisticas_iniciar_admin(const char* ruta);
+
+#endif
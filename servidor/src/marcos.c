@@ -0,0 +1,539 @@
+/*!
+ * @file    marcos.c
+ * @brief   Indice de marcos MP3: relaciona instantes de una cancion con el byte de su marco.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Recorrer los marcos MPEG (capas I, II y III; MPEG-1, 2 y 2.5) de un archivo, salteando etiquetas ID3v2.
+ *          - Armar el indice de instantes a bytes y guardarlo junto a la cancion.
+ *          - Leer un indice guardado y comprobar que corresponde a la cancion actual.
+ *          No usa la bitacora: lo usa tanto el servidor como el escaner.
+ *          El archivo del indice tiene una cabecera fija y las posiciones como enteros de 64 bits, en el orden de
+ *          bytes de la maquina que lo escribio (se arma en el mismo servidor que lo lee).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "marcos.h"
+
+/*!
+ * @def BLOQUE_MARCOS
+ * @brief Bytes que se leen de una vez al recorrer los marcos.
+*/
+#define BLOQUE_MARCOS (64 * 1024)
+
+/*!
+ * @def CONFIRMAR_MARCOS
+ * @brief Marcos seguidos que tiene que haber para aceptar una cabecera despues de perder la sincronizacion.
+ *        Una sola cabecera valida puede ser casualidad dentro de datos que no son audio.
+*/
+#define CONFIRMAR_MARCOS 3
+
+/*!
+ * @struct Cabecera
+ * @brief Datos de la cabecera de un marco MPEG.
+*/
+typedef struct Cabecera
+{
+    uint32_t largo;          /**< Bytes del marco, con la cabecera. */
+    uint32_t muestras;       /**< Muestras por canal del marco. */
+    uint32_t frecuencia;     /**< Muestras por segundo. */
+    uint32_t tipo;           /**< Version, capa y frecuencia: no cambian entre marcos de un mismo archivo. */
+} Cabecera;
+
+/*!
+ * @struct Lector
+ * @brief Ventana de lectura sobre el archivo.
+*/
+typedef struct Lector
+{
+    int fd;                  /**< Descriptor del archivo. */
+    off_t tamanio;           /**< Tamanio del archivo. */
+    off_t inicio;            /**< Byte del archivo del primer byte de datos. */
+    size_t largo;            /**< Bytes validos en datos. */
+    unsigned char* datos;    /**< Bytes leidos (BLOQUE_MARCOS). */
+} Lector;
+
+/*!
+ * @struct Guardado
+ * @brief Cabecera del archivo del indice.
+*/
+typedef struct Guardado
+{
+    char magia[4];           /**< MARCOS_MAGIA. */
+    uint32_t intervalo;      /**< MARCOS_INTERVALO al guardarlo. */
+    uint64_t tamanio;        /**< Tamanio del MP3. */
+    int64_t segundos;        /**< Fecha de modificacion del MP3 (segundos). */
+    int64_t nanos;           /**< Fecha de modificacion del MP3 (nanosegundos). */
+    uint32_t duracion;       /**< Duracion en milisegundos. */
+    uint32_t cantidad;       /**< Cantidad de posiciones que siguen. */
+} Guardado;
+
+static const uint16_t tasas[2][3][15] = {
+    { // MPEG-1: capas I, II y III.
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+    },
+    { // MPEG-2 y 2.5.
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+    }
+};
+
+static const uint32_t frecuencias[3] = { 44100, 48000, 32000 };
+
+static uint32_t sucesor = 0;
+
+/*!
+ * @brief   Interpreta la cabecera de un marco MPEG.
+ * @param bytes    Los 4 bytes de la cabecera.
+ * @param cabecera Datos a completar.
+ * @return 1 si es una cabecera valida, 0 si no (incluye velocidad libre, que no permite calcular el largo).
+*/
+static int leer_cabecera(const unsigned char* bytes, Cabecera* cabecera)
+{
+    int version, capa, indice_tasa, indice_frecuencia, relleno, mpeg1;
+    uint32_t tasa;
+
+    if (bytes[0] != 0xFF || (bytes[1] & 0xE0) != 0xE0)
+    {
+        return 0;
+    }
+    version = (bytes[1] >> 3) & 0x03; // 0: 2.5, 1: reservado, 2: 2, 3: 1.
+    capa = 4 - ((bytes[1] >> 1) & 0x03); // 4 es reservado.
+    indice_tasa = bytes[2] >> 4;
+    indice_frecuencia = (bytes[2] >> 2) & 0x03;
+    relleno = (bytes[2] >> 1) & 0x01;
+    if (version == 1 || capa == 4 || indice_tasa == 0 || indice_tasa == 15 || indice_frecuencia == 3)
+    {
+        return 0;
+    }
+    mpeg1 = (version == 3);
+    tasa = tasas[mpeg1 ? 0 : 1][capa - 1][indice_tasa] * 1000;
+    cabecera->frecuencia = frecuencias[indice_frecuencia] >> (mpeg1 ? 0 : (version == 2) ? 1 : 2);
+    if (capa == 1)
+    {
+        cabecera->muestras = 384;
+        cabecera->largo = (12 * tasa / cabecera->frecuencia + relleno) * 4;
+    } else
+    {
+        cabecera->muestras = (capa == 3 && !mpeg1) ? 576 : 1152;
+        cabecera->largo = cabecera->muestras / 8 * tasa / cabecera->frecuencia + relleno;
+    }
+    cabecera->tipo = (uint32_t)(bytes[1] & 0xFE) << 8 | (bytes[2] & 0x0C); // sin el bit de CRC.
+    return 1;
+}
+
+/*!
+ * @brief   Devuelve bytes del archivo, leyendo un bloque nuevo si no estan en la ventana.
+ * @param lector   Ventana de lectura.
+ * @param posicion Byte del archivo.
+ * @param largo    Bytes necesarios (a lo sumo BLOQUE_MARCOS).
+ * @return Puntero a los bytes, o NULL si el archivo termina antes.
+*/
+static const unsigned char* leer_bytes(Lector* lector, off_t posicion, size_t largo)
+{
+    ssize_t leidos;
+
+    if (posicion < 0 || posicion + (off_t)largo > lector->tamanio)
+    {
+        return NULL;
+    }
+    if (posicion < lector->inicio || posicion + (off_t)largo > lector->inicio + (off_t)lector->largo)
+    {
+        if ((leidos = pread(lector->fd, lector->datos, BLOQUE_MARCOS, posicion)) < (ssize_t)largo)
+        {
+            return NULL;
+        }
+        lector->inicio = posicion;
+        lector->largo = leidos;
+    }
+    return lector->datos + (posicion - lector->inicio);
+}
+
+/*!
+ * @brief   Indica si en una posicion empiezan varios marcos seguidos del mismo tipo.
+ * @param lector   Ventana de lectura.
+ * @param posicion Byte del archivo.
+ * @param cabecera Datos del primer marco a completar.
+ * @return 1 si se confirman CONFIRMAR_MARCOS marcos (o los que haya hasta el final del archivo), 0 si no.
+*/
+static int confirmar(Lector* lector, off_t posicion, Cabecera* cabecera)
+{
+    const unsigned char* bytes = NULL;
+    Cabecera siguiente;
+    off_t actual;
+    int i;
+
+    if ((bytes = leer_bytes(lector, posicion, 4)) == NULL || !leer_cabecera(bytes, cabecera))
+    {
+        return 0;
+    }
+    actual = posicion + cabecera->largo;
+    for (i = 1; i < CONFIRMAR_MARCOS && actual + 4 <= lector->tamanio; i++)
+    {
+        if ((bytes = leer_bytes(lector, actual, 4)) == NULL || !leer_cabecera(bytes, &siguiente)
+            || siguiente.tipo != cabecera->tipo)
+        {
+            return 0;
+        }
+        actual += siguiente.largo;
+    }
+    return actual <= lector->tamanio;
+}
+
+/*!
+ * @brief   Busca el proximo marco confirmado a partir de una posicion.
+ * @param lector   Ventana de lectura.
+ * @param posicion Byte desde el que se busca; se actualiza al del marco encontrado.
+ * @param cabecera Datos del marco a completar.
+ * @return 1 si se encuentra un marco, 0 si no quedan.
+*/
+static int sincronizar(Lector* lector, off_t* posicion, Cabecera* cabecera)
+{
+    const unsigned char* bytes = NULL;
+
+    for (; *posicion + 4 <= lector->tamanio; (*posicion)++)
+    {
+        if ((bytes = leer_bytes(lector, *posicion, 2)) != NULL && bytes[0] == 0xFF && (bytes[1] & 0xE0) == 0xE0
+            && confirmar(lector, *posicion, cabecera))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * @brief   Saltea las etiquetas ID3v2 del principio del archivo.
+ * @param lector Ventana de lectura.
+ * @return Byte donde terminan las etiquetas.
+*/
+static off_t saltear_id3v2(Lector* lector)
+{
+    const unsigned char* bytes = NULL;
+    off_t posicion = 0;
+
+    while ((bytes = leer_bytes(lector, posicion, 10)) != NULL && memcmp(bytes, "ID3", 3) == 0)
+    {
+        posicion += 10 + ((off_t)(bytes[6] & 0x7F) << 21 | (bytes[7] & 0x7F) << 14 | (bytes[8] & 0x7F) << 7 | (bytes[9] & 0x7F));
+        if (bytes[5] & 0x10) // pie de etiqueta.
+        {
+            posicion += 10;
+        }
+    }
+    return posicion;
+}
+
+/*!
+ * @brief   Agrega al indice las entradas de los instantes que caen dentro de un marco.
+ *          El final del marco se cuenta en muestras y no en milisegundos, asi un instante que coincide con el
+ *          comienzo de un marco no queda en el anterior por errores de redondeo.
+ * @param marcos     Indice.
+ * @param base       Milisegundos anteriores al ultimo cambio de frecuencia (0 si no cambio).
+ * @param muestras   Muestras desde ese cambio hasta el final del marco.
+ * @param frecuencia Muestras por segundo.
+ * @param posicion   Byte del marco.
+ * @param capacidad  Entradas reservadas (se actualiza si se agranda).
+ * @return OK(0) si se agregan, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int agregar_entradas(Marcos* marcos, double base, uint64_t muestras, uint32_t frecuencia, off_t posicion, uint32_t* capacidad)
+{
+    uint64_t* nuevas = NULL;
+
+    while (((double)marcos->cantidad * MARCOS_INTERVALO - base) * frecuencia < (double)muestras * 1000)
+    {
+        if (marcos->cantidad == *capacidad)
+        {
+            if ((nuevas = realloc(marcos->posiciones, (*capacidad * 2 + 256) * sizeof(uint64_t))) == NULL)
+            {
+                return ERROR_DE_MEMORIA;
+            }
+            marcos->posiciones = nuevas;
+            *capacidad = *capacidad * 2 + 256;
+        }
+        marcos->posiciones[marcos->cantidad++] = posicion;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Arma el indice de una cancion recorriendo todos sus marcos.
+ * @param fd     Descriptor de la cancion.
+ * @param datos  Datos de la cancion.
+ * @param marcos Indice a completar.
+ * @return OK(0) si se arma, ERROR(-1) si no hay marcos o falla la lectura, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int construir(int fd, const struct stat* datos, Marcos* marcos)
+{
+    Lector lector = { fd, datos->st_size, 0, 0, NULL };
+    const unsigned char* bytes = NULL;
+    Cabecera cabecera, siguiente;
+    uint32_t capacidad = 0, frecuencia;
+    uint64_t muestras = 0;
+    double base = 0;
+    off_t posicion;
+    int estado = OK;
+
+    memset(marcos, 0, sizeof(Marcos));
+    marcos->tamanio = datos->st_size;
+    marcos->segundos = datos->st_mtim.tv_sec;
+    marcos->nanos = datos->st_mtim.tv_nsec;
+    if ((lector.datos = malloc(BLOQUE_MARCOS)) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    posicion = saltear_id3v2(&lector);
+    if (!sincronizar(&lector, &posicion, &cabecera))
+    {
+        free(lector.datos);
+        return ERROR;
+    }
+    frecuencia = cabecera.frecuencia;
+    while (1)
+    {
+        if (cabecera.frecuencia != frecuencia)
+        {
+            base += (double)muestras * 1000 / frecuencia;
+            muestras = 0;
+            frecuencia = cabecera.frecuencia;
+        }
+        muestras += cabecera.muestras;
+        if ((estado = agregar_entradas(marcos, base, muestras, frecuencia, posicion, &capacidad)) != OK)
+        {
+            break;
+        }
+        posicion += cabecera.largo;
+        if ((bytes = leer_bytes(&lector, posicion, 4)) != NULL && leer_cabecera(bytes, &siguiente)
+            && siguiente.tipo == cabecera.tipo)
+        {
+            cabecera = siguiente;
+        } else if (!sincronizar(&lector, &posicion, &cabecera))
+        {
+            break;
+        }
+    }
+    free(lector.datos);
+    if (estado != OK)
+    {
+        marcos_liberar(marcos);
+        return estado;
+    }
+    marcos->duracion = (uint32_t)(base + (double)muestras * 1000 / frecuencia);
+    return OK;
+}
+
+/*!
+ * @brief   Arma el nombre del archivo del indice de una cancion.
+ * @param ruta   Ruta de la cancion.
+ * @param nombre Nombre a completar (PATH_MAX bytes).
+ * @return OK(0) si entra, ERROR(-1) si la ruta es demasiado larga.
+*/
+static int nombre_indice(const char* ruta, char* nombre)
+{
+    int largo = snprintf(nombre, PATH_MAX, "%s%s", ruta, MARCOS_EXTENSION);
+
+    return (largo < 0 || largo >= PATH_MAX) ? ERROR : OK;
+}
+
+/*!
+ * @brief   Lee la cabecera del indice guardado de una cancion y comprueba que esta al dia.
+ * @param directorio Descriptor del directorio de canciones.
+ * @param ruta       Ruta de la cancion.
+ * @param datos      Datos actuales de la cancion.
+ * @param guardado   Cabecera a completar.
+ * @return Descriptor del indice, posicionado en la primera posicion, o -1 si falta o esta viejo.
+*/
+static int abrir_guardado(int directorio, const char* ruta, const struct stat* datos, Guardado* guardado)
+{
+    char nombre[PATH_MAX];
+    struct stat datos_indice;
+    int fd;
+
+    if (nombre_indice(ruta, nombre) != OK || (fd = openat(directorio, nombre, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        return -1;
+    }
+    if (read(fd, guardado, sizeof(Guardado)) != sizeof(Guardado) || memcmp(guardado->magia, MARCOS_MAGIA, 4) != 0
+        || guardado->intervalo != MARCOS_INTERVALO || guardado->tamanio != (uint64_t)datos->st_size
+        || guardado->segundos != datos->st_mtim.tv_sec || guardado->nanos != datos->st_mtim.tv_nsec
+        || fstat(fd, &datos_indice) < 0
+        || datos_indice.st_size != (off_t)(sizeof(Guardado) + (uint64_t)guardado->cantidad * sizeof(uint64_t)))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*!
+ * @brief   Lee el indice guardado de una cancion.
+ * @param directorio Descriptor del directorio de canciones.
+ * @param ruta       Ruta de la cancion.
+ * @param datos      Datos actuales de la cancion.
+ * @param marcos     Indice a completar.
+ * @return OK(0) si se lee, ERROR(-1) si falta, esta viejo o no hay memoria (se vuelve a armar).
+*/
+static int leer(int directorio, const char* ruta, const struct stat* datos, Marcos* marcos)
+{
+    Guardado guardado;
+    size_t bytes;
+    int fd;
+
+    if ((fd = abrir_guardado(directorio, ruta, datos, &guardado)) < 0)
+    {
+        return ERROR;
+    }
+    bytes = (size_t)guardado.cantidad * sizeof(uint64_t);
+    if (guardado.cantidad == 0 || (marcos->posiciones = malloc(bytes)) == NULL
+        || read(fd, marcos->posiciones, bytes) != (ssize_t)bytes)
+    {
+        free(marcos->posiciones);
+        marcos->posiciones = NULL;
+        close(fd);
+        return ERROR;
+    }
+    close(fd);
+    marcos->tamanio = guardado.tamanio;
+    marcos->segundos = guardado.segundos;
+    marcos->nanos = guardado.nanos;
+    marcos->duracion = guardado.duracion;
+    marcos->cantidad = guardado.cantidad;
+    return OK;
+}
+
+/*!
+ * @brief   Guarda el indice de una cancion. Se escribe aparte y se reemplaza con rename, asi quien lo lee
+ *          al mismo tiempo nunca ve un indice a medio escribir.
+ * @param directorio Descriptor del directorio de canciones.
+ * @param ruta       Ruta de la cancion.
+ * @param marcos     Indice a guardar.
+ * @return OK(0) si se guarda, ERROR(-1) si no.
+*/
+static int guardar(int directorio, const char* ruta, const Marcos* marcos)
+{
+    char nombre[PATH_MAX];
+    char temporal[PATH_MAX];
+    Guardado guardado;
+    size_t bytes = (size_t)marcos->cantidad * sizeof(uint64_t);
+    int fd, largo;
+
+    largo = snprintf(temporal, sizeof(temporal), "%s%s.%ld.%u", ruta, MARCOS_EXTENSION, (long)getpid(),
+                     __atomic_add_fetch(&sucesor, 1, __ATOMIC_RELAXED));
+    if (nombre_indice(ruta, nombre) != OK || largo < 0 || largo >= (int)sizeof(temporal)
+        || (fd = openat(directorio, temporal, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)) < 0)
+    {
+        return ERROR;
+    }
+    memset(&guardado, 0, sizeof(guardado));
+    memcpy(guardado.magia, MARCOS_MAGIA, 4);
+    guardado.intervalo = MARCOS_INTERVALO;
+    guardado.tamanio = marcos->tamanio;
+    guardado.segundos = marcos->segundos;
+    guardado.nanos = marcos->nanos;
+    guardado.duracion = marcos->duracion;
+    guardado.cantidad = marcos->cantidad;
+    if (write(fd, &guardado, sizeof(guardado)) != sizeof(guardado)
+        || write(fd, marcos->posiciones, bytes) != (ssize_t)bytes)
+    {
+        close(fd);
+        unlinkat(directorio, temporal, 0);
+        return ERROR;
+    }
+    if (close(fd) < 0 || renameat(directorio, temporal, directorio, nombre) < 0)
+    {
+        unlinkat(directorio, temporal, 0);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Obtiene el indice de marcos de una cancion: lo lee si esta al dia y, si no, lo arma y lo guarda.
+ *          Si no se puede guardar (ej: directorio de solo lectura) el indice igual se devuelve.
+ * @param directorio Descriptor del directorio de canciones.
+ * @param ruta       Ruta de la cancion relativa al directorio.
+ * @param fd         Descriptor de la cancion.
+ * @param marcos     Indice a completar (se libera con marcos_liberar()).
+ * @return OK(0) si se obtiene, ERROR(-1) si el archivo no tiene marcos MP3, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int marcos_obtener(int directorio, const char* ruta, int fd, Marcos* marcos)
+{
+    struct stat datos;
+    int estado;
+
+    memset(marcos, 0, sizeof(Marcos));
+    if (fstat(fd, &datos) < 0)
+    {
+        return ERROR;
+    }
+    if (leer(directorio, ruta, &datos, marcos) == OK)
+    {
+        return OK;
+    }
+    if ((estado = construir(fd, &datos, marcos)) == OK)
+    {
+        guardar(directorio, ruta, marcos);
+    }
+    return estado;
+}
+
+/*!
+ * @brief   Indica si el indice guardado de una cancion esta al dia, sin leer sus entradas.
+ * @param directorio Descriptor del directorio de canciones.
+ * @param ruta       Ruta de la cancion relativa al directorio.
+ * @param datos      Datos actuales de la cancion.
+ * @return 1 si esta al dia, 0 si falta o esta viejo.
+*/
+int marcos_al_dia(int directorio, const char* ruta, const struct stat* datos)
+{
+    Guardado guardado;
+    int fd;
+
+    if ((fd = abrir_guardado(directorio, ruta, datos, &guardado)) < 0)
+    {
+        return 0;
+    }
+    close(fd);
+    return 1;
+}
+
+/*!
+ * @brief   Busca el byte desde el que hay que enviar una cancion para empezar en un instante.
+ * @param marcos       Indice de la cancion.
+ * @param milisegundos Instante pedido.
+ * @param posicion     Byte del marco que suena en ese instante.
+ * @return OK(0) si el instante esta dentro de la cancion, ERROR(-1) si no.
+*/
+int marcos_ubicar(const Marcos* marcos, uint32_t milisegundos, off_t* posicion)
+{
+    uint32_t entrada = milisegundos / MARCOS_INTERVALO;
+
+    if (milisegundos >= marcos->duracion || entrada >= marcos->cantidad)
+    {
+        return ERROR;
+    }
+    *posicion = marcos->posiciones[entrada];
+    return OK;
+}
+
+/*!
+ * @brief   Libera las entradas de un indice.
+ * @param marcos Indice a liberar.
+*/
+void marcos_liberar(Marcos* marcos)
+{
+    free(marcos->posiciones);
+    marcos->posiciones = NULL;
+    marcos->cantidad = 0;
+}
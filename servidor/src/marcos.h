@@ -0,0 +1,92 @@
+/*!
+ * @file    marcos.h
+ * @brief   Definiciones y declaraciones del indice de marcos MP3, para empezar una cancion desde un instante.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros del indice y la estructura Marcos.
+ *          - Declaraciones de funciones para armar, guardar, leer y consultar el indice de una cancion.
+ *          Un MP3 es una sucesion de marcos, cada uno con su cabecera y una duracion fija (1152 muestras en
+ *          MPEG-1 capa III); con velocidad variable, el byte de un instante solo se conoce recorriendo los
+ *          marcos. El indice guarda, cada MARCOS_INTERVALO milisegundos, el byte donde empieza el marco que
+ *          suena en ese instante: empezar a enviar desde ahi es empezar en un marco completo.
+ *          Se guarda junto a la cancion (cancion.mp3.marcos) con el tamanio y la fecha de modificacion del
+ *          MP3; si no coinciden, el indice esta viejo y se vuelve a armar. Se arma la primera vez que se pide
+ *          un instante de la cancion o, con la opcion -m, al escanear el directorio (ver escaner.h).
+*/
+
+#ifndef MARCOS_H
+#define MARCOS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/*!
+ * @def MARCOS_INTERVALO
+ * @brief Milisegundos entre dos entradas del indice.
+*/
+#define MARCOS_INTERVALO 250
+
+/*!
+ * @def MARCOS_EXTENSION
+ * @brief Extension que se agrega al nombre de la cancion para guardar su indice.
+*/
+#define MARCOS_EXTENSION ".marcos"
+
+/*!
+ * @def MARCOS_MAGIA
+ * @brief Comienzo de un archivo de indice; cambia si cambia el formato.
+*/
+#define MARCOS_MAGIA "MRC1"
+
+/*!
+ * @struct Marcos
+ * @brief Indice de marcos de una cancion.
+*/
+typedef struct Marcos
+{
+    uint64_t tamanio;        /**< Tamanio del MP3 al armar el indice. */
+    int64_t segundos;        /**< Fecha de modificacion del MP3 (segundos). */
+    int64_t nanos;           /**< Fecha de modificacion del MP3 (nanosegundos). */
+    uint32_t duracion;       /**< Duracion de la cancion en milisegundos. */
+    uint32_t cantidad;       /**< Cantidad de entradas. */
+    uint64_t* posiciones;    /**< Byte del marco que suena en el instante i * MARCOS_INTERVALO. */
+} Marcos;
+
+/*!
+ * @brief   Obtiene el indice de marcos de una cancion: lo lee si esta al dia y, si no, lo arma y lo guarda.
+ *          Si no se puede guardar (ej: directorio de solo lectura) el indice igual se devuelve.
+ * @param directorio Descriptor del directorio de canciones.
+ * @param ruta       Ruta de la cancion relativa al directorio.
+ * @param fd         Descriptor de la cancion.
+ * @param marcos     Indice a completar (se libera con marcos_liberar()).
+ * @return OK(0) si se obtiene, ERROR(-1) si el archivo no tiene marcos MP3, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int marcos_obtener(int directorio, const char* ruta, int fd, Marcos* marcos);
+
+/*!
+ * @brief   Indica si el indice guardado de una cancion esta al dia, sin leer sus entradas.
+ * @param directorio Descriptor del directorio de canciones.
+ * @param ruta       Ruta de la cancion relativa al directorio.
+ * @param datos      Datos actuales de la cancion.
+ * @return 1 si esta al dia, 0 si falta o esta viejo.
+*/
+int marcos_al_dia(int directorio, const char* ruta, const struct stat* datos);
+
+/*!
+ * @brief   Busca el byte desde el que hay que enviar una cancion para empezar en un instante.
+ * @param marcos       Indice de la cancion.
+ * @param milisegundos Instante pedido.
+ * @param posicion     Byte del marco que suena en ese instante.
+ * @return OK(0) si el instante esta dentro de la cancion, ERROR(-1) si no.
+*/
+int marcos_ubicar(const Marcos* marcos, uint32_t milisegundos, off_t* posicion);
+
+/*!
+ * @brief   Libera las entradas de un indice.
+ * @param marcos Indice a liberar.
+*/
+void marcos_liberar(Marcos* marcos);
+
+#endif
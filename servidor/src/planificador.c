@@ -0,0 +1,283 @@
+/*!
+ * @file    planificador.c
+ * @brief   Planificador de ancho de banda de salida: cubetas de fichas global y por conexion con encolado justo ponderado.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Limitar la tasa de envio global y de cada conexion con cubetas de fichas.
+ *          - Repartir el enlace entre los flujos activos segun su peso (encolado justo con reloj virtual propio).
+ *          Sin limites configurados (global y de la conexion) se envia sin tomar el mutex ni esperar turno:
+ *          el reparto justo solo rige cuando hay tasas configuradas.
+*/
+
+#include <pthread.h>
+#include <time.h>
+#include "planificador.h"
+
+/*!
+ * @def ESPERA_MIN
+ * @brief Espera minima en segundos antes de volver a evaluar el turno.
+*/
+#define ESPERA_MIN 0.0001
+
+/*!
+ * @def ESPERA_MAX
+ * @brief Espera maxima en segundos antes de volver a evaluar el turno.
+*/
+#define ESPERA_MAX 0.01
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static Cubeta global;              // cubeta compartida por todo el servidor.
+static double tasa_por_conexion;   // tasa con la que se inician las cubetas de conexion.
+static double tiempo_virtual = 0;  // reloj virtual del encolado justo.
+static Flujo* en_espera = NULL;    // flujos esperando turno.
+
+/*!
+ * @brief   Inicia una cubeta con la tasa indicada y la llena.
+ * @param cubeta Cubeta a iniciar.
+ * @param tasa   Bytes por segundo (SIN_LIMITE para no limitar).
+*/
+static void cubeta_iniciar(Cubeta* cubeta, double tasa)
+{
+    cubeta->tasa = tasa;
+    cubeta->capacidad = tasa * RAFAGA_SEGUNDOS;
+    if (cubeta->capacidad < 1)
+    {
+        cubeta->capacidad = 1;
+    }
+    cubeta->fichas = cubeta->capacidad;
+    clock_gettime(CLOCK_MONOTONIC, &cubeta->ultima);
+}
+
+/*!
+ * @brief   Repone las fichas de una cubeta segun el tiempo transcurrido.
+ * @param cubeta Cubeta a reponer.
+*/
+static void cubeta_reponer(Cubeta* cubeta)
+{
+    struct timespec ahora;
+
+    if (cubeta->tasa == SIN_LIMITE)
+    {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    cubeta->fichas += cubeta->tasa * ((ahora.tv_sec - cubeta->ultima.tv_sec) + (ahora.tv_nsec - cubeta->ultima.tv_nsec) / 1e9);
+    if (cubeta->fichas > cubeta->capacidad)
+    {
+        cubeta->fichas = cubeta->capacidad;
+    }
+    cubeta->ultima = ahora;
+}
+
+/*!
+ * @brief   Indica cuantos segundos faltan para que la cubeta permita enviar los bytes pedidos.
+ *          Un envio mayor que la capacidad solo exige la cubeta llena y la deja en negativo.
+ * @param cubeta Cubeta a consultar.
+ * @param bytes  Cantidad de bytes a enviar.
+ * @return 0 si puede enviar ya, o los segundos de espera necesarios.
+*/
+static double cubeta_faltante(const Cubeta* cubeta, size_t bytes)
+{
+    double necesarias = (bytes < cubeta->capacidad) ? bytes : cubeta->capacidad;
+
+    if (cubeta->tasa == SIN_LIMITE || cubeta->fichas >= necesarias)
+    {
+        return 0;
+    }
+    return (necesarias - cubeta->fichas) / cubeta->tasa;
+}
+
+/*!
+ * @brief   Verifica si el flujo es el de menor marca entre los flujos en espera habilitados por su conexion.
+ * @param flujo Flujo a verificar.
+ * @return 1 si le corresponde el turno, 0 en caso contrario.
+*/
+static int es_su_turno(const Flujo* flujo)
+{
+    Flujo* otro;
+
+    for (otro = en_espera; otro != NULL; otro = otro->sig)
+    {
+        if (otro != flujo && otro->marca < flujo->marca)
+        {
+            cubeta_reponer(otro->conexion);
+            if (cubeta_faltante(otro->conexion, otro->pendiente) == 0)
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*!
+ * @brief   Despierta al flujo en espera que sigue: el de menor marca cuya conexion tiene fichas. Los demas
+ *          siguen esperando hasta su plazo (a lo sumo ESPERA_MAX), cuando vuelven a mirar las cubetas.
+*/
+static void avisar_siguiente(void)
+{
+    Flujo* otro;
+    Flujo* siguiente = NULL;
+
+    for (otro = en_espera; otro != NULL; otro = otro->sig)
+    {
+        if (siguiente == NULL || otro->marca < siguiente->marca)
+        {
+            cubeta_reponer(otro->conexion);
+            if (cubeta_faltante(otro->conexion, otro->pendiente) == 0)
+            {
+                siguiente = otro;
+            }
+        }
+    }
+    if (siguiente != NULL)
+    {
+        pthread_cond_signal(&siguiente->turno);
+    }
+}
+
+/*!
+ * @brief   Quita un flujo de la lista de espera.
+ * @param flujo Flujo a quitar.
+*/
+static void quitar_de_espera(Flujo* flujo)
+{
+    Flujo** actual = &en_espera;
+
+    while (*actual != NULL && *actual != flujo)
+    {
+        actual = &(*actual)->sig;
+    }
+    if (*actual != NULL)
+    {
+        *actual = flujo->sig;
+    }
+    flujo->sig = NULL;
+    flujo->pendiente = 0;
+}
+
+/*!
+ * @brief   Inicia el planificador de salida.
+ *          Configura la tasa global y la tasa por conexion. SIN_LIMITE desactiva la cubeta correspondiente.
+ * @param tasa_global   Bytes por segundo para todo el servidor.
+ * @param tasa_conexion Bytes por segundo para cada conexion.
+*/
+void planificador_iniciar(double tasa_global, double tasa_conexion)
+{
+    pthread_mutex_lock(&mutex);
+    cubeta_iniciar(&global, tasa_global);
+    tasa_por_conexion = tasa_conexion;
+    pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * @brief   Inicia la cubeta de una nueva conexion con la tasa por conexion configurada.
+ * @param cubeta Cubeta a iniciar.
+*/
+void cubeta_conexion_iniciar(Cubeta* cubeta)
+{
+    pthread_mutex_lock(&mutex);
+    cubeta_iniciar(cubeta, tasa_por_conexion);
+    pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * @brief   Inicia un flujo de salida de una conexion.
+ * @param flujo    Flujo a iniciar.
+ * @param conexion Cubeta de la conexion duenia del flujo.
+ * @param peso     Peso del flujo en el encolado justo.
+*/
+void flujo_iniciar(Flujo* flujo, Cubeta* conexion, double peso)
+{
+    flujo->conexion = conexion;
+    flujo->peso = peso;
+    flujo->fin_virtual = 0;
+    flujo->marca = 0;
+    flujo->pendiente = 0;
+    flujo->sig = NULL;
+    pthread_cond_init(&flujo->turno, NULL);
+}
+
+/*!
+ * @brief   Libera los recursos de un flujo que ya no envia (no puede estar esperando turno).
+ * @param flujo Flujo a finalizar.
+*/
+void flujo_finalizar(Flujo* flujo)
+{
+    pthread_cond_destroy(&flujo->turno);
+}
+
+/*!
+ * @brief   Espera el turno del flujo para enviar una cantidad de bytes.
+ *          Entre los flujos en espera cuya conexion tiene fichas, atiende al de menor marca de fin virtual,
+ *          siempre que la cubeta global tenga fichas. Si un solo flujo esta activo, no espera a nadie.
+ *          Sin limites configurados vuelve enseguida, sin tomar el mutex.
+ * @param flujo Flujo que desea enviar.
+ * @param bytes Cantidad de bytes a enviar.
+*/
+void planificador_esperar(Flujo* flujo, size_t bytes)
+{
+    double espera, faltante;
+    struct timespec limite;
+
+    // las tasas se fijan antes de aceptar conexiones y no cambian: se pueden leer sin el mutex.
+    if (global.tasa == SIN_LIMITE && flujo->conexion->tasa == SIN_LIMITE)
+    {
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    // asignamos marca de fin virtual al envio.
+    flujo->marca = ((flujo->fin_virtual > tiempo_virtual) ? flujo->fin_virtual : tiempo_virtual) + bytes / flujo->peso;
+    flujo->fin_virtual = flujo->marca;
+    flujo->pendiente = bytes;
+    flujo->sig = en_espera;
+    en_espera = flujo;
+    while (1)
+    {
+        cubeta_reponer(&global);
+        cubeta_reponer(flujo->conexion);
+        espera = cubeta_faltante(flujo->conexion, bytes);
+        faltante = cubeta_faltante(&global, bytes);
+        if (espera == 0 && faltante == 0 && es_su_turno(flujo))
+        {
+            break;
+        }
+        // esperamos fichas o que otro flujo libere su turno.
+        if (faltante > espera)
+        {
+            espera = faltante;
+        }
+        if (espera < ESPERA_MIN)
+        {
+            espera = ESPERA_MIN;
+        } else if (espera > ESPERA_MAX)
+        {
+            espera = ESPERA_MAX;
+        }
+        clock_gettime(CLOCK_REALTIME, &limite);
+        limite.tv_nsec += (long)(espera * 1e9);
+        if (limite.tv_nsec >= 1000000000L)
+        {
+            limite.tv_sec += limite.tv_nsec / 1000000000L;
+            limite.tv_nsec %= 1000000000L;
+        }
+        pthread_cond_timedwait(&flujo->turno, &mutex, &limite);
+    }
+    // consumimos fichas y avanzamos el reloj virtual.
+    if (global.tasa != SIN_LIMITE)
+    {
+        global.fichas -= bytes;
+    }
+    if (flujo->conexion->tasa != SIN_LIMITE)
+    {
+        flujo->conexion->fichas -= bytes;
+    }
+    if (flujo->marca > tiempo_virtual)
+    {
+        tiempo_virtual = flujo->marca;
+    }
+    quitar_de_espera(flujo);
+    avisar_siguiente();
+    pthread_mutex_unlock(&mutex);
+}
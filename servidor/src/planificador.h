@@ -0,0 +1,118 @@
+/*!
+ * @file    planificador.h
+ * @brief   Definiciones y declaraciones del planificador de ancho de banda de salida del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Estructuras de cubeta de fichas (token bucket) global y por conexion.
+ *          - Estructura de flujo para el encolado justo ponderado (WFQ) entre flujos activos.
+ *          - Declaraciones de funciones para iniciar el planificador y pedir turno de envio.
+ *          El reparto justo entre flujos solo rige cuando hay una tasa configurada (global o de la conexion):
+ *          sin limites, cada flujo envia apenas lo pide, sin pasar por el mutex del planificador, y el orden
+ *          entre flujos lo decide el sistema (los hilos y el socket).
+*/
+
+#ifndef PLANIFICADOR_H
+#define PLANIFICADOR_H
+
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+
+/*!
+ * @def SIN_LIMITE
+ * @brief Tasa que indica que una cubeta no limita el envio.
+*/
+#define SIN_LIMITE 0
+
+/*!
+ * @def PESO_CONTROL
+ * @brief Peso de los flujos de control (listado y filtrado) en el encolado justo.
+*/
+#define PESO_CONTROL 8.0
+
+/*!
+ * @def PESO_DESCARGA
+ * @brief Peso de los flujos de descarga de canciones en el encolado justo.
+*/
+#define PESO_DESCARGA 1.0
+
+/*!
+ * @def PESO_PRECARGA
+ * @brief Peso de los flujos de precarga (SOL_PRECARGA): ceden el ancho de banda a las descargas que se escuchan.
+*/
+#define PESO_PRECARGA 0.25
+
+/*!
+ * @def RAFAGA_SEGUNDOS
+ * @brief Fraccion de segundo de envio que puede acumular una cubeta como rafaga.
+*/
+#define RAFAGA_SEGUNDOS 0.05
+
+/*!
+ * @struct Cubeta
+ * @brief Cubeta de fichas que limita la tasa de envio en bytes por segundo.
+*/
+typedef struct Cubeta
+{
+    double tasa;            /**< Bytes por segundo que se reponen (SIN_LIMITE para no limitar). */
+    double capacidad;       /**< Maxima cantidad de fichas acumulables. */
+    double fichas;          /**< Fichas disponibles (puede ser negativo tras un envio grande). */
+    struct timespec ultima; /**< Instante de la ultima reposicion. */
+} Cubeta;
+
+/*!
+ * @struct Flujo
+ * @brief Flujo de salida que compite por el enlace en el encolado justo ponderado.
+ *        Cada flujo pertenece a una conexion, cuya cubeta comparte con sus demas flujos.
+*/
+typedef struct Flujo
+{
+    Cubeta* conexion;     /**< Cubeta de la conexion a la que pertenece el flujo. */
+    double peso;          /**< Peso del flujo (PESO_CONTROL, PESO_DESCARGA o PESO_PRECARGA). */
+    double fin_virtual;   /**< Ultima marca de fin virtual asignada al flujo. */
+    double marca;         /**< Marca de fin virtual del envio en espera. */
+    size_t pendiente;     /**< Bytes del envio en espera (0 si no espera). */
+    pthread_cond_t turno; /**< Se avisa cuando le toca el turno. */
+    struct Flujo* sig;    /**< Siguiente flujo en la lista de espera. */
+} Flujo;
+
+/*!
+ * @brief   Inicia el planificador de salida.
+ *          Configura la tasa global y la tasa por conexion. SIN_LIMITE desactiva la cubeta correspondiente.
+ * @param tasa_global   Bytes por segundo para todo el servidor.
+ * @param tasa_conexion Bytes por segundo para cada conexion.
+*/
+void planificador_iniciar(double tasa_global, double tasa_conexion);
+
+/*!
+ * @brief   Inicia la cubeta de una nueva conexion con la tasa por conexion configurada.
+ * @param cubeta Cubeta a iniciar.
+*/
+void cubeta_conexion_iniciar(Cubeta* cubeta);
+
+/*!
+ * @brief   Inicia un flujo de salida de una conexion.
+ * @param flujo    Flujo a iniciar.
+ * @param conexion Cubeta de la conexion duenia del flujo.
+ * @param peso     Peso del flujo en el encolado justo.
+*/
+void flujo_iniciar(Flujo* flujo, Cubeta* conexion, double peso);
+
+/*!
+ * @brief   Libera los recursos de un flujo que ya no envia (no puede estar esperando turno).
+ * @param flujo Flujo a finalizar.
+*/
+void flujo_finalizar(Flujo* flujo);
+
+/*!
+ * @brief   Espera el turno del flujo para enviar una cantidad de bytes.
+ *          Entre los flujos en espera cuya conexion tiene fichas, atiende al de menor marca de fin virtual,
+ *          siempre que la cubeta global tenga fichas. Si un solo flujo esta activo, no espera a nadie.
+ *          Sin limites configurados vuelve enseguida, sin tomar el mutex.
+ * @param flujo Flujo que desea enviar.
+ * @param bytes Cantidad de bytes a enviar.
+*/
+void planificador_esperar(Flujo* flujo, size_t bytes);
+
+#endif
@@ -0,0 +1,399 @@
+/*!
+ * @file    popularidad.c
+ * @brief   Registro de popularidad: anillos por hilo volcados en un count-min sketch con las mas escuchadas.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Dar a cada hilo su propio anillo de reproducciones; los anillos de hilos terminados se reutilizan.
+ *          - Anotar una reproduccion sin bloqueos: el hilo escribe el numero y publica su posicion con una
+ *            operacion atomica. Solo si el anillo esta lleno toma el mutex y vuelca las anotaciones.
+ *          - Volcar los anillos en el count-min sketch (con actualizacion conservadora: solo se incrementan
+ *            los contadores que estan en el minimo) y mantener el monticulo de las mas escuchadas.
+ *          - Dividir las cuentas por dos cada POPULARIDAD_VENTANA segundos.
+ *          El que tiene el mutex es el unico que vacia los anillos, asi cada anillo tiene un solo productor
+ *          (su hilo) y un solo consumidor a la vez.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "transporte.h"
+#include "canciones.h"
+#include "popularidad.h"
+
+/*!
+ * @struct Anillo
+ * @brief Reproducciones anotadas por un hilo. Las posiciones solo crecen; la de la posicion p es
+ *        numeros[p % POPULARIDAD_ANILLO].
+*/
+typedef struct Anillo
+{
+    uint64_t cabeza __attribute__((aligned(64)));  /**< Proxima posicion a escribir (la modifica el hilo duenio). */
+    uint64_t cola __attribute__((aligned(64)));    /**< Proxima posicion a volcar (la modifica quien tiene el mutex). */
+    int libre;                                     /**< 1 si el hilo duenio termino y otro puede tomarlo. */
+    struct Anillo* sig;                            /**< Siguiente anillo de la lista global. */
+    uint32_t numeros[POPULARIDAD_ANILLO];          /**< Numeros de las canciones reproducidas. */
+} Anillo;
+
+// multiplicadores impares de las funciones de hash (multiplicar y quedarse con los bits altos).
+static const uint64_t semillas[POPULARIDAD_FILAS] = {
+    0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL
+};
+
+static Anillo* anillos = NULL;              // lista de todos los anillos creados (nunca se liberan).
+static __thread Anillo* anillo_propio = NULL;
+static pthread_key_t clave_anillo;          // su destructor libera el anillo cuando el hilo termina.
+static int iniciada = 0;
+static pthread_mutex_t popularidad_mutex = PTHREAD_MUTEX_INITIALIZER; // protege el sketch, el monticulo y el vaciado.
+static uint32_t contadores[POPULARIDAD_FILAS][POPULARIDAD_COLUMNAS];
+static Popular monticulo[POPULARIDAD_TOP];  // minimo en la raiz: la primera candidata a salir.
+static int cantidad_top = 0;
+static uint64_t total = 0;                  // reproducciones volcadas.
+static time_t ventana = 0;                  // comienzo de la ventana actual (segundos monotonicos).
+
+/*!
+ * @brief   Devuelve los segundos del reloj monotonico.
+ * @return Segundos desde un instante fijo.
+*/
+static time_t segundos_monotonicos(void)
+{
+    struct timespec ahora;
+
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return ahora.tv_sec;
+}
+
+/*!
+ * @brief   Marca como libre el anillo de un hilo que termina. Lo que haya anotado se vuelca en el proximo vaciado.
+ * @param arg Anillo del hilo.
+*/
+static void liberar_anillo(void* arg)
+{
+    Anillo* anillo = arg;
+
+    __atomic_store_n(&anillo->libre, 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * @brief   Devuelve el anillo del hilo actual, tomando uno libre o creando uno nuevo la primera vez.
+ * @return Anillo del hilo, o NULL si no hay memoria.
+*/
+static Anillo* obtener_anillo(void)
+{
+    int libre;
+    Anillo* anillo = NULL;
+
+    if (anillo_propio != NULL)
+    {
+        return anillo_propio;
+    }
+    for (anillo = __atomic_load_n(&anillos, __ATOMIC_ACQUIRE); anillo != NULL; anillo = anillo->sig)
+    {
+        libre = 1;
+        if (__atomic_compare_exchange_n(&anillo->libre, &libre, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+    if (anillo == NULL)
+    {
+        if ((anillo = calloc(1, sizeof(Anillo))) == NULL)
+        {
+            return NULL;
+        }
+        anillo->sig = __atomic_load_n(&anillos, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&anillos, &anillo->sig, anillo, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+        }
+    }
+    anillo_propio = anillo;
+    pthread_setspecific(clave_anillo, anillo);
+    return anillo;
+}
+
+/*!
+ * @brief   Devuelve la columna de una cancion en una fila del sketch.
+ * @param fila   Fila.
+ * @param numero Numero de la cancion.
+ * @return Columna.
+*/
+static uint32_t columna(int fila, uint32_t numero)
+{
+    return (uint32_t)(((uint64_t)numero * semillas[fila]) >> (64 - POPULARIDAD_BITS));
+}
+
+/*!
+ * @brief   Estima las reproducciones de una cancion con el sketch. Se llama con popularidad_mutex tomado.
+ * @param numero Numero de la cancion.
+ * @return El menor de sus contadores.
+*/
+static uint32_t estimar(uint32_t numero)
+{
+    uint32_t minimo = UINT32_MAX;
+    int i;
+
+    for (i = 0; i < POPULARIDAD_FILAS; i++)
+    {
+        if (contadores[i][columna(i, numero)] < minimo)
+        {
+            minimo = contadores[i][columna(i, numero)];
+        }
+    }
+    return minimo;
+}
+
+/*!
+ * @brief   Hunde un elemento del monticulo hasta su lugar.
+ * @param i Posicion del elemento.
+*/
+static void hundir(int i)
+{
+    int menor, hijo;
+    Popular auxiliar;
+
+    while (1)
+    {
+        menor = i;
+        for (hijo = 2 * i + 1; hijo <= 2 * i + 2 && hijo < cantidad_top; hijo++)
+        {
+            if (monticulo[hijo].cuenta < monticulo[menor].cuenta)
+            {
+                menor = hijo;
+            }
+        }
+        if (menor == i)
+        {
+            return;
+        }
+        auxiliar = monticulo[i];
+        monticulo[i] = monticulo[menor];
+        monticulo[menor] = auxiliar;
+        i = menor;
+    }
+}
+
+/*!
+ * @brief   Sube un elemento del monticulo hasta su lugar.
+ * @param i Posicion del elemento.
+*/
+static void subir(int i)
+{
+    Popular auxiliar;
+
+    while (i > 0 && monticulo[(i - 1) / 2].cuenta > monticulo[i].cuenta)
+    {
+        auxiliar = monticulo[i];
+        monticulo[i] = monticulo[(i - 1) / 2];
+        monticulo[(i - 1) / 2] = auxiliar;
+        i = (i - 1) / 2;
+    }
+}
+
+/*!
+ * @brief   Cuenta reproducciones en el sketch y actualiza el monticulo. Se llama con popularidad_mutex tomado.
+ * @param numero   Numero de la cancion.
+ * @param cantidad Reproducciones a sumar.
+*/
+static void contar(uint32_t numero, uint32_t cantidad)
+{
+    uint64_t suma = (uint64_t)estimar(numero) + cantidad;
+    uint32_t cuenta = (suma > UINT32_MAX) ? UINT32_MAX : (uint32_t)suma;
+    uint32_t* contador = NULL;
+    int i;
+
+    for (i = 0; i < POPULARIDAD_FILAS; i++)
+    {
+        contador = &contadores[i][columna(i, numero)];
+        if (*contador < cuenta) // actualizacion conservadora.
+        {
+            *contador = cuenta;
+        }
+    }
+    for (i = 0; i < cantidad_top; i++)
+    {
+        if (monticulo[i].numero == numero)
+        {
+            monticulo[i].cuenta = cuenta;
+            hundir(i); // la cuenta solo crece: se aleja de la raiz.
+            return;
+        }
+    }
+    if (cantidad_top < POPULARIDAD_TOP)
+    {
+        monticulo[cantidad_top].numero = numero;
+        monticulo[cantidad_top].cuenta = cuenta;
+        subir(cantidad_top++);
+    } else if (cuenta > monticulo[0].cuenta)
+    {
+        monticulo[0].numero = numero;
+        monticulo[0].cuenta = cuenta;
+        hundir(0);
+    }
+}
+
+/*!
+ * @brief   Divide las cuentas por dos por cada ventana completa desde la ultima division.
+ *          Dividir todo por igual no cambia el orden del monticulo. Se llama con popularidad_mutex tomado.
+*/
+static void decaer(void)
+{
+    time_t ahora = segundos_monotonicos();
+    time_t ventanas = (ahora - ventana) / POPULARIDAD_VENTANA;
+    int i, j, desplazamiento;
+
+    if (ventanas <= 0)
+    {
+        return;
+    }
+    ventana += ventanas * POPULARIDAD_VENTANA;
+    desplazamiento = (ventanas > 31) ? 31 : (int)ventanas;
+    for (i = 0; i < POPULARIDAD_FILAS; i++)
+    {
+        for (j = 0; j < POPULARIDAD_COLUMNAS; j++)
+        {
+            contadores[i][j] >>= desplazamiento;
+        }
+    }
+    for (i = 0, j = 0; i < cantidad_top; i++)
+    {
+        if ((monticulo[i].cuenta >>= desplazamiento) > 0)
+        {
+            monticulo[j++] = monticulo[i];
+        }
+    }
+    cantidad_top = j;
+    for (i = cantidad_top / 2 - 1; i >= 0; i--) // rearmamos el monticulo sin las que quedaron en cero.
+    {
+        hundir(i);
+    }
+}
+
+/*!
+ * @brief   Vuelca las reproducciones anotadas en todos los anillos. Se llama con popularidad_mutex tomado.
+*/
+static void vaciar(void)
+{
+    Anillo* anillo = NULL;
+    uint64_t cola, cabeza;
+
+    decaer();
+    for (anillo = __atomic_load_n(&anillos, __ATOMIC_ACQUIRE); anillo != NULL; anillo = anillo->sig)
+    {
+        cabeza = __atomic_load_n(&anillo->cabeza, __ATOMIC_ACQUIRE);
+        for (cola = anillo->cola; cola < cabeza; cola++)
+        {
+            contar(anillo->numeros[cola % POPULARIDAD_ANILLO], 1);
+            total++;
+        }
+        __atomic_store_n(&anillo->cola, cola, __ATOMIC_RELEASE);
+    }
+}
+
+/*!
+ * @brief   Inicia el registro de popularidad.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo crear la clave de los anillos por hilo.
+*/
+int popularidad_iniciar(void)
+{
+    if (pthread_key_create(&clave_anillo, liberar_anillo) != 0)
+    {
+        return ERROR;
+    }
+    ventana = segundos_monotonicos();
+    __atomic_store_n(&iniciada, 1, __ATOMIC_RELEASE);
+    return OK;
+}
+
+/*!
+ * @brief   Registra una reproduccion de una cancion. Sin mutex, salvo cuando el anillo del hilo se llena.
+ * @param numero Numero de la cancion.
+*/
+void popularidad_registrar(uint32_t numero)
+{
+    Anillo* anillo = NULL;
+    uint64_t cabeza;
+
+    if (!__atomic_load_n(&iniciada, __ATOMIC_ACQUIRE) || (anillo = obtener_anillo()) == NULL)
+    {
+        return;
+    }
+    cabeza = anillo->cabeza;
+    if (cabeza - __atomic_load_n(&anillo->cola, __ATOMIC_ACQUIRE) >= POPULARIDAD_ANILLO)
+    {
+        pthread_mutex_lock(&popularidad_mutex);
+        vaciar();
+        pthread_mutex_unlock(&popularidad_mutex);
+    }
+    anillo->numeros[cabeza % POPULARIDAD_ANILLO] = numero;
+    __atomic_store_n(&anillo->cabeza, cabeza + 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * @brief   Suma reproducciones a una cancion sin contarlas en el total, para recuperar la popularidad
+ *          guardada antes de reiniciar el servidor.
+ * @param numero   Numero de la cancion.
+ * @param cantidad Reproducciones estimadas guardadas.
+*/
+void popularidad_sembrar(uint32_t numero, uint32_t cantidad)
+{
+    if (cantidad == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&popularidad_mutex);
+    contar(numero, cantidad);
+    pthread_mutex_unlock(&popularidad_mutex);
+}
+
+/*!
+ * @brief   Compara dos canciones populares de mayor a menor cuenta y, a igual cuenta, por numero.
+ * @param a Primera cancion.
+ * @param b Segunda cancion.
+ * @return Negativo, cero o positivo segun el orden (como strcmp).
+*/
+static int comparar_populares(const void* a, const void* b)
+{
+    const Popular* x = a;
+    const Popular* y = b;
+
+    if (x->cuenta != y->cuenta)
+    {
+        return (x->cuenta > y->cuenta) ? -1 : 1;
+    }
+    return (x->numero < y->numero) ? -1 : (x->numero > y->numero);
+}
+
+/*!
+ * @brief   Devuelve las canciones mas escuchadas, de mayor a menor.
+ * @param populares Canciones a completar (POPULARIDAD_TOP elementos).
+ * @return Cantidad de canciones (0 si todavia no se escucho ninguna).
+*/
+int popularidad_top(Popular* populares)
+{
+    int cantidad;
+
+    pthread_mutex_lock(&popularidad_mutex);
+    vaciar();
+    cantidad = cantidad_top;
+    memcpy(populares, monticulo, cantidad * sizeof(Popular));
+    pthread_mutex_unlock(&popularidad_mutex);
+    qsort(populares, cantidad, sizeof(Popular), comparar_populares);
+    return cantidad;
+}
+
+/*!
+ * @brief   Devuelve la cantidad de reproducciones volcadas desde el inicio (sin decaimiento).
+ * @return Reproducciones registradas.
+*/
+uint64_t popularidad_total(void)
+{
+    uint64_t cantidad;
+
+    pthread_mutex_lock(&popularidad_mutex);
+    vaciar();
+    cantidad = total;
+    pthread_mutex_unlock(&popularidad_mutex);
+    return cantidad;
+}
@@ -0,0 +1,110 @@
+/*!
+ * @file    popularidad.h
+ * @brief   Definiciones y declaraciones del registro de popularidad de las canciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros del registro de popularidad y la estructura Popular.
+ *          - Declaraciones de funciones para registrar reproducciones y consultar las canciones mas escuchadas.
+ *          Registrar una reproduccion no toma ningun mutex: cada hilo anota el numero de la cancion en su propio
+ *          anillo (como la bitacora) y las anotaciones se vuelcan en conjunto al consultar, o cuando un anillo se llena.
+ *          Los volcados cuentan las reproducciones en un count-min sketch (POPULARIDAD_FILAS filas de
+ *          POPULARIDAD_COLUMNAS contadores, cada fila con su propia funcion de hash: la estimacion de una cancion es
+ *          el menor de sus contadores, que nunca es menor que la cuenta real) y mantienen en un monticulo las
+ *          POPULARIDAD_TOP canciones de mayor estimacion. La memoria es la misma con 10 o con millones de canciones.
+ *          Cada POPULARIDAD_VENTANA segundos todos los contadores se dividen por dos, asi pesan mas las
+ *          reproducciones recientes.
+*/
+
+#ifndef POPULARIDAD_H
+#define POPULARIDAD_H
+
+#include <stdint.h>
+#include "catalogo.h"
+
+/*!
+ * @def POPULARIDAD_FILAS
+ * @brief Filas (funciones de hash) del count-min sketch.
+*/
+#define POPULARIDAD_FILAS 4
+
+/*!
+ * @def POPULARIDAD_BITS
+ * @brief Logaritmo en base 2 de la cantidad de contadores de cada fila.
+*/
+#define POPULARIDAD_BITS 12
+
+/*!
+ * @def POPULARIDAD_COLUMNAS
+ * @brief Contadores de cada fila del count-min sketch.
+*/
+#define POPULARIDAD_COLUMNAS (1 << POPULARIDAD_BITS)
+
+/*!
+ * @def POPULARIDAD_TOP
+ * @brief Cantidad de canciones mas escuchadas que se mantienen.
+*/
+#define POPULARIDAD_TOP 20
+
+/*!
+ * @def POPULARIDAD_VENTANA
+ * @brief Segundos despues de los cuales las cuentas se dividen por dos.
+*/
+#define POPULARIDAD_VENTANA 3600
+
+/*!
+ * @def POPULARIDAD_ANILLO
+ * @brief Reproducciones que un hilo anota antes de volcarlas (potencia de dos).
+*/
+#define POPULARIDAD_ANILLO 256
+
+/*!
+ * @def ORDEN_POPULARES
+ * @brief Orden de listado de las canciones mas escuchadas (SOL_LISTAR). No es una permutacion del catalogo.
+*/
+#define ORDEN_POPULARES ORDENES
+
+/*!
+ * @struct Popular
+ * @brief Cancion entre las mas escuchadas.
+*/
+typedef struct Popular
+{
+    uint32_t numero;     /**< Numero de la cancion. */
+    uint32_t cuenta;     /**< Reproducciones estimadas (con el decaimiento aplicado). */
+} Popular;
+
+/*!
+ * @brief   Inicia el registro de popularidad.
+ * @return OK(0) si se inicia, ERROR(-1) si no se pudo crear la clave de los anillos por hilo.
+*/
+int popularidad_iniciar(void);
+
+/*!
+ * @brief   Registra una reproduccion de una cancion. Sin mutex, salvo cuando el anillo del hilo se llena.
+ * @param numero Numero de la cancion.
+*/
+void popularidad_registrar(uint32_t numero);
+
+/*!
+ * @brief   Suma reproducciones a una cancion sin contarlas en el total, para recuperar la popularidad
+ *          guardada antes de reiniciar el servidor.
+ * @param numero   Numero de la cancion.
+ * @param cantidad Reproducciones estimadas guardadas.
+*/
+void popularidad_sembrar(uint32_t numero, uint32_t cantidad);
+
+/*!
+ * @brief   Devuelve las canciones mas escuchadas, de mayor a menor.
+ * @param populares Canciones a completar (POPULARIDAD_TOP elementos).
+ * @return Cantidad de canciones (0 si todavia no se escucho ninguna).
+*/
+int popularidad_top(Popular* populares);
+
+/*!
+ * @brief   Devuelve la cantidad de reproducciones volcadas desde el inicio (sin decaimiento).
+ * @return Reproducciones registradas.
+*/
+uint64_t popularidad_total(void);
+
+#endif
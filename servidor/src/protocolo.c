@@ -0,0 +1,206 @@
+/*!
+ * @file    protocolo.c
+ * @brief   Envio y recepcion de tramas del protocolo entre cliente y servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Serializar la cabecera de una trama y enviarla junto a su carga en una sola llamada, con un
+ *            descriptor adjunto si se pide (socket Unix).
+ *          - Recibir tramas completas, aunque lleguen partidas en varias recepciones.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include "protocolo.h"
+#include "canciones.h"
+#include "bitacora.h"
+
+/*!
+ * @brief   Recibe exactamente la cantidad de bytes pedida.
+ * @param sock  Descriptor del socket.
+ * @param datos Buffer destino.
+ * @param largo Cantidad de bytes a recibir.
+ * @return OK(0) si se reciben todos, SALIR(-4) si el otro extremo cerro, ERROR(-1) ante un error.
+*/
+static int recibir_todo(int sock, void* datos, size_t largo)
+{
+    ssize_t recibidos;
+    size_t total = 0;
+
+    while (total < largo)
+    {
+        if ((recibidos = recv(sock, (char*)datos + total, largo - total, 0)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return ERROR;
+        } else if (recibidos == 0)
+        {
+            return SALIR;
+        }
+        total += recibidos;
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Serializa la cabecera de una trama en orden de red.
+ * @param cabecera Destino (CABECERA_TAMANIO bytes).
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param longitud Bytes de carga util.
+*/
+void serializar_cabecera(unsigned char* cabecera, uint32_t id, uint8_t tipo, size_t longitud)
+{
+    uint32_t red;
+
+    red = htonl(id);
+    memcpy(cabecera, &red, 4);
+    cabecera[4] = tipo;
+    red = htonl((uint32_t)longitud);
+    memcpy(cabecera + 5, &red, 4);
+}
+
+/*!
+ * @brief   Envia una trama completa con un descriptor adjunto (SCM_RIGHTS), que llega con su primer byte.
+ *          Solo por sockets Unix.
+ * @param sock       Descriptor del socket.
+ * @param id         Identificador de la solicitud.
+ * @param tipo       Tipo de trama.
+ * @param carga      Carga util (puede ser NULL si longitud es 0).
+ * @param longitud   Bytes de carga util.
+ * @param descriptor Descriptor a pasar (el del servidor sigue abierto).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int enviar_trama_descriptor(int sock, uint32_t id, uint8_t tipo, const void* carga, size_t longitud, int descriptor)
+{
+    unsigned char cabecera[CABECERA_TAMANIO];
+    struct iovec partes[2];
+    struct msghdr mensaje;
+    struct cmsghdr* control = NULL;
+    union
+    {
+        struct cmsghdr alineado;
+        char espacio[CMSG_SPACE(sizeof(int))];
+    } adjunto;
+    ssize_t enviados;
+
+    serializar_cabecera(cabecera, id, tipo, longitud);
+    partes[0].iov_base = cabecera;
+    partes[0].iov_len = CABECERA_TAMANIO;
+    partes[1].iov_base = (void*)carga;
+    partes[1].iov_len = longitud;
+    memset(&mensaje, 0, sizeof(mensaje));
+    mensaje.msg_iov = partes;
+    mensaje.msg_iovlen = (longitud > 0) ? 2 : 1;
+    if (descriptor >= 0)
+    {
+        memset(&adjunto, 0, sizeof(adjunto));
+        mensaje.msg_control = adjunto.espacio;
+        mensaje.msg_controllen = sizeof(adjunto.espacio);
+        control = CMSG_FIRSTHDR(&mensaje);
+        control->cmsg_level = SOL_SOCKET;
+        control->cmsg_type = SCM_RIGHTS;
+        control->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(control), &descriptor, sizeof(int));
+    }
+    while (mensaje.msg_iovlen > 0)
+    {
+        if ((enviados = sendmsg(sock, &mensaje, MSG_NOSIGNAL)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return ERROR;
+        }
+        // el descriptor viaja con el primer envio; si fue parcial, el resto va sin el.
+        mensaje.msg_control = NULL;
+        mensaje.msg_controllen = 0;
+        // avanzamos sobre lo ya enviado por si el envio fue parcial.
+        while (mensaje.msg_iovlen > 0 && (size_t)enviados >= mensaje.msg_iov[0].iov_len)
+        {
+            enviados -= mensaje.msg_iov[0].iov_len;
+            mensaje.msg_iov++;
+            mensaje.msg_iovlen--;
+        }
+        if (mensaje.msg_iovlen > 0)
+        {
+            mensaje.msg_iov[0].iov_base = (char*)mensaje.msg_iov[0].iov_base + enviados;
+            mensaje.msg_iov[0].iov_len -= enviados;
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Envia una trama completa (cabecera y carga) en una sola llamada al sistema.
+ *          Reintenta hasta enviar todos los bytes.
+ * @param sock     Descriptor del socket.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param carga    Carga util (puede ser NULL si longitud es 0).
+ * @param longitud Bytes de carga util.
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int enviar_trama(int sock, uint32_t id, uint8_t tipo, const void* carga, size_t longitud)
+{
+    return enviar_trama_descriptor(sock, id, tipo, carga, longitud, -1);
+}
+
+/*!
+ * @brief   Envia una trama cuya carga es una cadena de texto.
+ * @param sock  Descriptor del socket.
+ * @param id    Identificador de la solicitud.
+ * @param tipo  Tipo de trama.
+ * @param texto Cadena a enviar (sin el terminador).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int enviar_texto(int sock, uint32_t id, uint8_t tipo, const char* texto)
+{
+    return enviar_trama(sock, id, tipo, texto, strlen(texto));
+}
+
+/*!
+ * @brief   Recibe una trama completa.
+ *          La carga se termina con '\0' para poder tratarla como texto.
+ * @param sock     Descriptor del socket.
+ * @param cabecera Cabecera recibida.
+ * @param carga    Buffer donde se copia la carga util.
+ * @param maximo   Tamanio del buffer de carga (incluye lugar para el terminador).
+ * @return OK(0) si se recibe la trama, SALIR(-4) si el otro extremo cerro la conexion,
+ *         ERROR(-1) si ocurre un problema o la carga no entra en el buffer.
+*/
+int recibir_trama(int sock, Cabecera* cabecera, char* carga, size_t maximo)
+{
+    int estado;
+    uint32_t red;
+    unsigned char datos[CABECERA_TAMANIO];
+
+    if ((estado = recibir_todo(sock, datos, CABECERA_TAMANIO)) != OK)
+    {
+        return estado;
+    }
+    memcpy(&red, datos, 4);
+    cabecera->id = ntohl(red);
+    cabecera->tipo = datos[4];
+    memcpy(&red, datos + 5, 4);
+    cabecera->longitud = ntohl(red);
+    if (cabecera->longitud >= maximo)
+    {
+        bitacora(NIVEL_AVISO, "Trama demasiado grande (%u bytes).\n", cabecera->longitud);
+        return ERROR;
+    }
+    if ((estado = recibir_todo(sock, carga, cabecera->longitud)) != OK)
+    {
+        return estado;
+    }
+    carga[cabecera->longitud] = '\0';
+    return OK;
+}
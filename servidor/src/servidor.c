@@ -5,17 +5,56 @@
  * @date    18/12/2024
  * @details Contiene la funcion main del servidor servidor, que:
  *          - Verifica argumentos pasados al programa.
- *          - Establece conexion con los clientes mediante un socket.
+ *          - Configura el planificador de ancho de banda de salida.
+ *          - Si se pide (CATALOGO_ESCANEAR), arma el catalogo escaneando el directorio de canciones.
+ *          - Establece conexion con los clientes mediante un socket TCP y otro Unix para los de la misma maquina.
+ *          - Publica las estadisticas de operaciones por el socket local de administracion.
  *          - Gestiona el bucle principal del servidor para procesar solicitudes de los clientes.
  *          Dependencias:
  *          - usuarios.h: Funciones relacionadas con la gestion de usuarios.
  *          - canciones.h: Funciones relacionadas con la gestion de canciones.
+ *          - transporte.h: Estado de cada conexion y planificador de ancho de banda de salida.
+ *          - estadisticas.h: Contadores e histogramas de latencia de las operaciones.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "transporte.h"
+#include "protocolo.h"
 #include "usuarios.h"
 #include "canciones.h"
+#include "estadisticas.h"
+#include "archivos.h"
+#include "popularidad.h"
+#include "calentador.h"
+#include "avisos.h"
+#include "catalogo.h"
+#include "escaner.h"
+#include "bitacora.h"
+
+/*!
+ * @brief   Escanea el directorio de canciones y reescribe media.csv y media.idx antes de atender clientes.
+ *          Si el escaneo falla el servidor sigue con el catalogo que ya habia.
+ * @param hilos Cantidad de hilos del escaner (0 para elegirla segun los procesadores).
+*/
+static void escanear_canciones(int hilos)
+{
+    const char* directorio = getenv(ARCHIVOS_ENTORNO);
+    Resumen resumen;
+
+    if (directorio == NULL || *directorio == '\0')
+    {
+        directorio = ".";
+    }
+    if (escaner_actualizar(directorio, CATALOGO_RUTA, CATALOGO_INDICE, hilos, 0, &resumen) != OK)
+    {
+        bitacora(NIVEL_AVISO, "No se pudo escanear el directorio de canciones %s.\n", directorio);
+        return;
+    }
+    bitacora(NIVEL_INFO, "Directorio de canciones %s escaneado en %.3f s con %d hilos: %d archivos, %d leidos, %d sin cambios, "
+             "%d nuevos, %d quitados, %d errores.\n", directorio, resumen.segundos, resumen.hilos, resumen.archivos, resumen.leidos,
+             resumen.reutilizados, resumen.nuevos, resumen.quitados, resumen.errores);
+}
 
 /*!
  * @brief   Funcion principal del servidor.
@@ -25,6 +64,8 @@
  * @param arg      Arreglo de cadenas con los argumentos. Se espera:
  *                 - arg[1]: Direccion IP del servidor.
  *                 - arg[2]: Puerto del servidor.
+ *                 - arg[3]: (opcional) Tasa de salida global en KB/s, 0 para no limitar.
+ *                 - arg[4]: (opcional) Tasa de salida por conexion en KB/s, 0 para no limitar.
  * @return OK(0) si el servidor se ejecuta correctamente, ERROR(-1) si ocurre algun problema.
 */
 
@@ -32,17 +73,69 @@
 int main(int cant_arg, char* arg[])
 {
     int server_sock;
-    if (cant_arg != 3)
+    double tasa_global = SIN_LIMITE, tasa_conexion = SIN_LIMITE;
+    if (cant_arg < 3 || cant_arg > 5)
     {
         printf("Cantidad de argumentos ingresados erronea.\n");
         return ERROR;
     }
-    
+    // configuramos el planificador de salida (tasas en KB/s).
+    if (cant_arg > 3)
+    {
+        tasa_global = atof(arg[3]) * 1024;
+    }
+    if (cant_arg > 4)
+    {
+        tasa_conexion = atof(arg[4]) * 1024;
+    }
+    planificador_iniciar(tasa_global, tasa_conexion);
+    // los mensajes del servidor pasan por la bitacora; sin ella se escriben directo en stderr.
+    if (bitacora_iniciar(NIVEL_INFO) != OK)
+    {
+        fprintf(stderr, "No se pudo iniciar la bitacora.\n");
+    }
+    if (getenv(ESCANER_ENTORNO) != NULL)
+    {
+        escanear_canciones(atoi(getenv(ESCANER_ENTORNO)));
+    }
+    // sin el directorio de canciones no hay nada que descargar.
+    if (archivos_iniciar() != OK)
+    {
+        bitacora_terminar();
+        return ERROR;
+    }
+
+    // sin registro de popularidad las canciones se envian igual: solo falta el listado de las mas escuchadas.
+    if (popularidad_iniciar() != OK)
+    {
+        bitacora(NIVEL_AVISO, "No se pudo iniciar el registro de popularidad.\n");
+    } else if (calentador_iniciar() != OK)
+    {
+        bitacora(NIVEL_AVISO, "No se pudo iniciar el calentador de canciones.\n");
+    }
+
+    // sin vigia del catalogo los clientes se enteran de los cambios al sincronizar su copia.
+    if (avisos_iniciar() != OK)
+    {
+        bitacora(NIVEL_AVISO, "No se pudo iniciar el vigia del catalogo.\n");
+    }
+
     // abro socket y conecto con el cliente.
     if (conexion(&server_sock, arg[1], atoi(arg[2])) == ERROR)
     {
+        bitacora_terminar();
         return ERROR;
     }
+    // sin socket local los clientes de la misma maquina se conectan por TCP.
+    if (conexion_local(LOCAL_RUTA) != OK)
+    {
+        bitacora(NIVEL_AVISO, "No se pudo iniciar el socket local %s.\n", LOCAL_RUTA);
+    }
+    // las estadisticas son opcionales: sin socket de administracion el servidor sigue atendiendo.
+    if (estadisticas_iniciar_admin(ADMIN_RUTA) != OK)
+    {
+        bitacora(NIVEL_AVISO, "No se pudo iniciar el socket de administracion %s.\n", ADMIN_RUTA);
+    }
     // ingresamos a bucle.
     menu_bucle_servidor(server_sock);
 
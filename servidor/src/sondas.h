@@ -0,0 +1,112 @@
+/*!
+ * @file    sondas.h
+ * @brief   Sondas estaticas (USDT) del servidor, para seguirlo con bpftrace o perf sin recompilar.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Las macros SONDA0 a SONDA3, que marcan un punto del codigo con un nombre y hasta tres argumentos.
+ *          Cada sonda es una sola instruccion nop mas una nota en la seccion .note.stapsdt del ejecutable,
+ *          con la direccion de la nop y donde encontrar cada argumento (registro, memoria o constante).
+ *          Mientras nadie la activa no cuesta nada: los argumentos no se copian ni se calculan aparte.
+ *          Al activarla, bpftrace o perf reemplazan la nop por un punto de interrupcion y leen los argumentos.
+ *          Si el sistema tiene <sys/sdt.h> (systemtap-sdt-dev) se usa ese; si no, se generan las mismas
+ *          notas con ensamblador propio (x86-64 y aarch64). En otras arquitecturas las sondas no hacen nada.
+ *          Todos los argumentos se pasan como enteros de 64 bits; los textos, como su direccion (str(argN)).
+ *          Sondas y argumentos:
+ *          - sesion_aceptada(socket, IPv4 del cliente o 0) y sesion_resultado(sesion, opcion, exito).
+ *          - listar_inicio(sesion) y listar_fin(sesion, filas del listado).
+ *          - filtrar_inicio(sesion, campo, texto): campo es ARTISTA, GENERO o ANIO, CAMPOS para la consulta
+ *            combinada y CAMPOS + 1 para la busqueda aproximada.
+ *          - filtrar_fin(sesion, candidatas, encontradas): candidatas son siempre las canciones completas del
+ *            catalogo, entre las que busca todo filtro; encontradas / candidatas es la selectividad.
+ *          - descarga_inicio(sesion, canal, cancion), lote_inicio(sesion, canal, cantidad),
+ *            descarga_bloque(sesion, canal, bytes) y descarga_fin(sesion, canal, bytes enviados).
+ *          Ver servidor/sondas/ para ejemplos de bpftrace.
+*/
+
+#ifndef SONDAS_H
+#define SONDAS_H
+
+#include <stdint.h>
+
+/*!
+ * @def PROVEEDOR
+ * @brief Proveedor de las sondas (usdt:<ejecutable>:infotify:<nombre>).
+*/
+#define PROVEEDOR infotify
+
+/*!
+ * @def SONDA_ARG
+ * @brief Convierte un argumento de sonda a entero de 64 bits.
+*/
+#define SONDA_ARG(x) ((uint64_t)(uintptr_t)(x))
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define SONDAS_SDT
+#endif
+#endif
+
+#if defined(SONDAS_SDT)
+
+#include <sys/sdt.h>
+
+#define SONDA0(nombre) DTRACE_PROBE(infotify, nombre)
+#define SONDA1(nombre, a) DTRACE_PROBE1(infotify, nombre, SONDA_ARG(a))
+#define SONDA2(nombre, a, b) DTRACE_PROBE2(infotify, nombre, SONDA_ARG(a), SONDA_ARG(b))
+#define SONDA3(nombre, a, b, c) DTRACE_PROBE3(infotify, nombre, SONDA_ARG(a), SONDA_ARG(b), SONDA_ARG(c))
+
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+
+#define SONDA_TEXTO_(x) #x
+#define SONDA_TEXTO(x) SONDA_TEXTO_(x)
+
+/*!
+ * @def SONDA_NOTA
+ * @brief Emite la nop de la sonda y su nota con el formato de SystemTap (version 3):
+ *        direccion de la sonda, direccion de la base (para ejecutables con reubicacion), semaforo (sin uso),
+ *        proveedor, nombre y descripcion de los argumentos ("8@<operando>" por argumento).
+*/
+#define SONDA_NOTA(nombre, argumentos)                                          \
+    "990: nop\n"                                                                \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                               \
+    ".balign 4\n"                                                               \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                          \
+    "991: .asciz \"stapsdt\"\n"                                                 \
+    "992: .balign 4\n"                                                          \
+    "993: .8byte 990b\n"                                                        \
+    ".8byte _.stapsdt.base\n"                                                   \
+    ".8byte 0\n"                                                                \
+    ".asciz \"" SONDA_TEXTO(PROVEEDOR) "\"\n"                                   \
+    ".asciz \"" #nombre "\"\n"                                                  \
+    ".asciz \"" argumentos "\"\n"                                               \
+    "994: .balign 4\n"                                                          \
+    ".popsection\n"                                                             \
+    ".ifndef _.stapsdt.base\n"                                                  \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"     \
+    ".weak _.stapsdt.base\n"                                                    \
+    ".hidden _.stapsdt.base\n"                                                  \
+    "_.stapsdt.base: .space 1\n"                                                \
+    ".size _.stapsdt.base, 1\n"                                                 \
+    ".popsection\n"                                                             \
+    ".endif\n"
+
+#define SONDA0(nombre) \
+    __asm__ __volatile__(SONDA_NOTA(nombre, ""))
+#define SONDA1(nombre, a) \
+    __asm__ __volatile__(SONDA_NOTA(nombre, "8@%0") :: "nor"(SONDA_ARG(a)))
+#define SONDA2(nombre, a, b) \
+    __asm__ __volatile__(SONDA_NOTA(nombre, "8@%0 8@%1") :: "nor"(SONDA_ARG(a)), "nor"(SONDA_ARG(b)))
+#define SONDA3(nombre, a, b, c) \
+    __asm__ __volatile__(SONDA_NOTA(nombre, "8@%0 8@%1 8@%2") :: "nor"(SONDA_ARG(a)), "nor"(SONDA_ARG(b)), "nor"(SONDA_ARG(c)))
+
+#else
+
+#define SONDA0(nombre) do { } while (0)
+#define SONDA1(nombre, a) do { (void)(a); } while (0)
+#define SONDA2(nombre, a, b) do { (void)(a); (void)(b); } while (0)
+#define SONDA3(nombre, a, b, c) do { (void)(a); (void)(b); (void)(c); } while (0)
+
+#endif
+
+#endif
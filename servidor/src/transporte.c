@@ -0,0 +1,266 @@
+/*!
+ * @file    transporte.c
+ * @brief   Ajuste del transporte TCP de cada conexion: tamanio de bloque y buffers del socket.
+ *          Las conexiones locales (socket Unix) usan lo mismo salvo las opciones propias de TCP.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Iniciar y finalizar el estado de cada conexion con un cliente.
+ *          - Configurar el socket para mensajes de control (TCP_NODELAY).
+ *          - Medir RTT y rendimiento para elegir el tamanio de bloque y de SO_SNDBUF.
+ *          - Enviar tramas por la conexion desde el hilo del cliente y los hilos de sus canales.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "transporte.h"
+#include "protocolo.h"
+#include "canciones.h"
+#include "bitacora.h"
+
+/*!
+ * @brief   Obtiene el RTT suavizado de la conexion informado por TCP.
+ * @param sock Descriptor del socket.
+ * @return RTT en segundos, o 0 si no se pudo obtener.
+*/
+static double leer_rtt(int sock)
+{
+    struct tcp_info info;
+    socklen_t largo = sizeof(info);
+
+    if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &largo) < 0)
+    {
+        return 0;
+    }
+    return info.tcpi_rtt / 1e6;
+}
+
+/*!
+ * @brief   Redondea hacia arriba a potencia de dos y acota al rango de bloques permitido.
+ * @param bytes Tamanio deseado.
+ * @return Tamanio de bloque entre BLOQUE_MIN y BLOQUE_MAX.
+*/
+static size_t acotar_bloque(double bytes)
+{
+    size_t bloque = BLOQUE_MIN;
+
+    while (bloque < bytes && bloque < BLOQUE_MAX)
+    {
+        bloque *= 2;
+    }
+    return bloque;
+}
+
+/*!
+ * @brief   Inicia el estado de una conexion recien aceptada.
+ *          Reserva el bloque de envio, inicia la cubeta del planificador y, si es TCP, activa TCP_NODELAY
+ *          para que los mensajes de control salgan sin demora.
+ * @param conexion Conexion a iniciar.
+ * @param sock     Descriptor del socket del cliente.
+ * @return OK(0) si se inicia correctamente, ERROR_DE_MEMORIA(-3) si no se pudo reservar el bloque.
+*/
+int conexion_iniciar(Conexion* conexion, int sock)
+{
+    int activo = 1, dominio = AF_INET;
+    socklen_t largo = sizeof(dominio);
+
+    conexion->sock = sock;
+    if ((conexion->bloque = malloc(BLOQUE_MAX)) == NULL)
+    {
+        bitacora_error("Error al reservar bloque de envio.\n");
+        return ERROR_DE_MEMORIA;
+    }
+    conexion->tamanio_bloque = BLOQUE_INICIAL;
+    conexion->rtt = leer_rtt(sock);
+    conexion->rendimiento = 0;
+    conexion->buffer_envio = 0;
+    conexion->bytes_ventana = 0;
+    clock_gettime(CLOCK_MONOTONIC, &conexion->inicio_ventana);
+    cubeta_conexion_iniciar(&conexion->cubeta);
+    pthread_mutex_init(&conexion->envio, NULL);
+    pthread_mutex_init(&conexion->canales_mutex, NULL);
+    pthread_cond_init(&conexion->canales_cond, NULL);
+    conexion->canales = NULL;
+    conexion->cantidad_canales = 0;
+    conexion->cerrada = 0;
+    getsockopt(sock, SOL_SOCKET, SO_DOMAIN, &dominio, &largo);
+    conexion->local = (dominio == AF_UNIX);
+    if (conexion->local)
+    {
+        conexion->tamanio_bloque = BLOQUE_MAX;
+    }
+    // los mensajes de control son cortos y no deben esperar al algoritmo de Nagle.
+    if (!conexion->local && setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &activo, sizeof(activo)) < 0)
+    {
+        bitacora_error("Error al activar TCP_NODELAY.\n");
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Libera los recursos de una conexion y cierra su socket.
+ *          Los canales de la conexion ya deben estar cerrados (ver canales_cerrar()).
+ * @param conexion Conexion a finalizar.
+*/
+void conexion_finalizar(Conexion* conexion)
+{
+    free(conexion->bloque);
+    conexion->bloque = NULL;
+    pthread_mutex_destroy(&conexion->envio);
+    pthread_mutex_destroy(&conexion->canales_mutex);
+    pthread_cond_destroy(&conexion->canales_cond);
+    close(conexion->sock);
+}
+
+/*!
+ * @brief   Envia una trama por la conexion.
+ *          Puede llamarse desde varios hilos: cada trama sale entera, sin mezclarse con otras.
+ *          Los bytes de las tramas de datos se registran en la medicion del transporte.
+ * @param conexion Conexion por la que se envia.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param carga    Carga util (puede ser NULL si longitud es 0).
+ * @param longitud Bytes de carga util.
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int transporte_enviar(Conexion* conexion, uint32_t id, uint8_t tipo, const void* carga, size_t longitud)
+{
+    int estado;
+
+    pthread_mutex_lock(&conexion->envio);
+    if ((estado = enviar_trama(conexion->sock, id, tipo, carga, longitud)) == OK && tipo == RESP_DATOS)
+    {
+        transporte_medir(conexion, longitud);
+    }
+    pthread_mutex_unlock(&conexion->envio);
+    return estado;
+}
+
+/*!
+ * @brief   Envia por la conexion una trama cuya carga es una cadena de texto.
+ * @param conexion Conexion por la que se envia.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param texto    Cadena a enviar (sin el terminador).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int transporte_enviar_texto(Conexion* conexion, uint32_t id, uint8_t tipo, const char* texto)
+{
+    return transporte_enviar(conexion, id, tipo, texto, strlen(texto));
+}
+
+/*!
+ * @brief   Envia por una conexion local una trama con un descriptor adjunto (ver SOL_DESCRIPTOR).
+ * @param conexion   Conexion por la que se envia (debe ser local).
+ * @param id         Identificador de la solicitud.
+ * @param tipo       Tipo de trama.
+ * @param texto      Cadena a enviar (sin el terminador).
+ * @param descriptor Descriptor a pasar (el del servidor sigue abierto).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema o la conexion no es local.
+*/
+int transporte_enviar_descriptor(Conexion* conexion, uint32_t id, uint8_t tipo, const char* texto, int descriptor)
+{
+    int estado;
+
+    if (!conexion->local)
+    {
+        return ERROR;
+    }
+    pthread_mutex_lock(&conexion->envio);
+    estado = enviar_trama_descriptor(conexion->sock, id, tipo, texto, strlen(texto), descriptor);
+    pthread_mutex_unlock(&conexion->envio);
+    return estado;
+}
+
+/*!
+ * @brief   Devuelve el tamanio de bloque de envio elegido actualmente para la conexion.
+ * @param conexion Conexion a consultar.
+ * @return Tamanio de bloque entre BLOQUE_MIN y BLOQUE_MAX.
+*/
+size_t transporte_bloque(Conexion* conexion)
+{
+    size_t bloque;
+
+    pthread_mutex_lock(&conexion->envio);
+    bloque = conexion->tamanio_bloque;
+    pthread_mutex_unlock(&conexion->envio);
+    return bloque;
+}
+
+/*!
+ * @brief   Reinicia la ventana de medicion, por ejemplo al comenzar un envio tras un periodo inactivo.
+ * @param conexion Conexion a reiniciar.
+*/
+void transporte_reiniciar_medicion(Conexion* conexion)
+{
+    pthread_mutex_lock(&conexion->envio);
+    conexion->bytes_ventana = 0;
+    clock_gettime(CLOCK_MONOTONIC, &conexion->inicio_ventana);
+    pthread_mutex_unlock(&conexion->envio);
+}
+
+/*!
+ * @brief   Registra bytes enviados y reajusta el transporte al cerrar cada ventana de medicion.
+ *          Con el RTT de TCP y el rendimiento medido estima el producto ancho de banda por demora,
+ *          y con el elige el tamanio de bloque y, si hace falta, agranda SO_SNDBUF.
+ * @param conexion Conexion sobre la que se envio.
+ * @param bytes    Cantidad de bytes enviados.
+*/
+void transporte_medir(Conexion* conexion, size_t bytes)
+{
+    int buffer, actual;
+    double transcurrido, rtt, bdp;
+    struct timespec ahora;
+    socklen_t largo = sizeof(actual);
+
+    conexion->bytes_ventana += bytes;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    transcurrido = (ahora.tv_sec - conexion->inicio_ventana.tv_sec) + (ahora.tv_nsec - conexion->inicio_ventana.tv_nsec) / 1e9;
+    if (transcurrido < VENTANA_MEDICION || transcurrido < 4 * conexion->rtt)
+    {
+        return;
+    }
+    // actualizamos rendimiento (promedio movil) y RTT.
+    if (conexion->rendimiento == 0)
+    {
+        conexion->rendimiento = conexion->bytes_ventana / transcurrido;
+    } else
+    {
+        conexion->rendimiento = 0.75 * conexion->rendimiento + 0.25 * (conexion->bytes_ventana / transcurrido);
+    }
+    if ((rtt = leer_rtt(conexion->sock)) > 0)
+    {
+        conexion->rtt = rtt;
+    }
+    conexion->bytes_ventana = 0;
+    conexion->inicio_ventana = ahora;
+    // un socket Unix no tiene RTT ni ventana de congestion: el bloque mas grande es el que menos llamadas hace.
+    if (conexion->local)
+    {
+        conexion->tamanio_bloque = BLOQUE_MAX;
+        return;
+    }
+    // un bloque de un cuarto del BDP mantiene la conexion ocupada sin rafagas excesivas.
+    bdp = conexion->rendimiento * conexion->rtt;
+    conexion->tamanio_bloque = acotar_bloque(bdp / 4);
+    // solo agrandamos SO_SNDBUF si el BDP supera lo que el kernel ya asigno. Mientras no se toca, el kernel lo
+    // ajusta solo; el primer setsockopt apaga ese autoajuste para siempre: el buffer queda fijo en lo pedido
+    // (y solo vuelve a crecer desde aca), aunque despues el BDP baje.
+    buffer = (2 * bdp > BUFFER_SOCKET_MAX) ? BUFFER_SOCKET_MAX : (int)(2 * bdp);
+    if (buffer > conexion->buffer_envio)
+    {
+        if (getsockopt(conexion->sock, SOL_SOCKET, SO_SNDBUF, &actual, &largo) == 0 && actual >= buffer)
+        {
+            return;
+        }
+        if (setsockopt(conexion->sock, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer)) == 0)
+        {
+            conexion->buffer_envio = buffer;
+        }
+    }
+}
@@ -0,0 +1,155 @@
+/*!
+ * @file    transporte.h
+ * @brief   Definiciones y declaraciones para el ajuste del transporte TCP de cada conexion del servidor.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - La estructura Conexion, con el estado propio de cada cliente conectado.
+ *          - Constantes para el tamanio de bloque de envio y de los buffers del socket.
+ *          - Declaraciones de funciones para elegir el tamanio de bloque y los buffers segun el RTT
+ *            y el rendimiento medidos.
+ *          - Declaraciones de funciones para enviar tramas por la conexion desde varios hilos a la vez.
+*/
+
+#ifndef TRANSPORTE_H
+#define TRANSPORTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "planificador.h"
+
+/*!
+ * @def BLOQUE_MIN
+ * @brief Tamanio minimo del bloque de envio de datos masivos.
+*/
+#define BLOQUE_MIN (4 * 1024)
+
+/*!
+ * @def BLOQUE_INICIAL
+ * @brief Tamanio del bloque de envio antes de tener mediciones de la conexion.
+*/
+#define BLOQUE_INICIAL (16 * 1024)
+
+/*!
+ * @def BLOQUE_MAX
+ * @brief Tamanio maximo del bloque de envio de datos masivos.
+*/
+#define BLOQUE_MAX (256 * 1024)
+
+/*!
+ * @def BUFFER_SOCKET_MAX
+ * @brief Tamanio maximo que se pide para el buffer de envio del socket.
+*/
+#define BUFFER_SOCKET_MAX (8 * 1024 * 1024)
+
+/*!
+ * @def VENTANA_MEDICION
+ * @brief Duracion minima en segundos de cada ventana de medicion de rendimiento.
+*/
+#define VENTANA_MEDICION 0.02
+
+/*!
+ * @struct Conexion
+ * @brief Estado de la conexion con un cliente.
+ *        Agrupa el socket, la cubeta del planificador de salida, el bloque de envio,
+ *        las mediciones usadas para ajustar el transporte y los canales de descarga abiertos.
+ *        El hilo que atiende al cliente y los hilos de sus canales envian por el mismo socket;
+ *        el mutex envio protege cada trama y las mediciones.
+*/
+typedef struct Conexion
+{
+    int sock;                     /**< Descriptor del socket del cliente. */
+    Cubeta cubeta;                /**< Cubeta de la conexion en el planificador de salida. */
+    char* bloque;                 /**< Buffer de envio masivo (BLOQUE_MAX bytes). */
+    size_t tamanio_bloque;        /**< Tamanio de bloque de envio elegido para la conexion. */
+    double rtt;                   /**< Ultimo RTT suavizado informado por TCP, en segundos. */
+    double rendimiento;           /**< Rendimiento medido en bytes por segundo (promedio movil). */
+    int buffer_envio;             /**< Tamanio fijado en SO_SNDBUF (0 si lo ajusta el kernel). */
+    size_t bytes_ventana;         /**< Bytes enviados en la ventana de medicion actual. */
+    struct timespec inicio_ventana; /**< Inicio de la ventana de medicion actual. */
+    pthread_mutex_t envio;        /**< Serializa las tramas enviadas y las mediciones. */
+    pthread_mutex_t canales_mutex; /**< Protege la lista de canales y sus ventanas. */
+    pthread_cond_t canales_cond;  /**< Se avisa al cambiar una ventana o al cerrarse un canal. */
+    struct Canal* canales;        /**< Canales de descarga abiertos (ver canales.h). */
+    int cantidad_canales;         /**< Cantidad de canales abiertos. */
+    int cerrada;                  /**< 1 cuando la conexion se esta cerrando. */
+    uint32_t sesion;              /**< Sesion de la conexion en la bitacora. */
+    int local;                    /**< 1 si llego por el socket Unix (sin opciones TCP; admite SOL_DESCRIPTOR). */
+} Conexion;
+
+/*!
+ * @brief   Inicia el estado de una conexion recien aceptada.
+ *          Reserva el bloque de envio, inicia la cubeta del planificador y, si es TCP, activa TCP_NODELAY
+ *          para que los mensajes de control salgan sin demora.
+ * @param conexion Conexion a iniciar.
+ * @param sock     Descriptor del socket del cliente.
+ * @return OK(0) si se inicia correctamente, ERROR_DE_MEMORIA(-3) si no se pudo reservar el bloque.
+*/
+int conexion_iniciar(Conexion* conexion, int sock);
+
+/*!
+ * @brief   Libera los recursos de una conexion y cierra su socket.
+ * @param conexion Conexion a finalizar.
+*/
+void conexion_finalizar(Conexion* conexion);
+
+/*!
+ * @brief   Envia una trama por la conexion.
+ *          Puede llamarse desde varios hilos: cada trama sale entera, sin mezclarse con otras.
+ *          Los bytes de las tramas de datos se registran en la medicion del transporte.
+ * @param conexion Conexion por la que se envia.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param carga    Carga util (puede ser NULL si longitud es 0).
+ * @param longitud Bytes de carga util.
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int transporte_enviar(Conexion* conexion, uint32_t id, uint8_t tipo, const void* carga, size_t longitud);
+
+/*!
+ * @brief   Envia por la conexion una trama cuya carga es una cadena de texto.
+ * @param conexion Conexion por la que se envia.
+ * @param id       Identificador de la solicitud.
+ * @param tipo     Tipo de trama.
+ * @param texto    Cadena a enviar (sin el terminador).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema.
+*/
+int transporte_enviar_texto(Conexion* conexion, uint32_t id, uint8_t tipo, const char* texto);
+
+/*!
+ * @brief   Envia por una conexion local una trama con un descriptor adjunto (ver SOL_DESCRIPTOR).
+ * @param conexion   Conexion por la que se envia (debe ser local).
+ * @param id         Identificador de la solicitud.
+ * @param tipo       Tipo de trama.
+ * @param texto      Cadena a enviar (sin el terminador).
+ * @param descriptor Descriptor a pasar (el del servidor sigue abierto).
+ * @return OK(0) si se envia la trama, ERROR(-1) si ocurre un problema o la conexion no es local.
+*/
+int transporte_enviar_descriptor(Conexion* conexion, uint32_t id, uint8_t tipo, const char* texto, int descriptor);
+
+/*!
+ * @brief   Devuelve el tamanio de bloque de envio elegido actualmente para la conexion.
+ * @param conexion Conexion a consultar.
+ * @return Tamanio de bloque entre BLOQUE_MIN y BLOQUE_MAX.
+*/
+size_t transporte_bloque(Conexion* conexion);
+
+/*!
+ * @brief   Reinicia la ventana de medicion, por ejemplo al comenzar un envio tras un periodo inactivo.
+ * @param conexion Conexion a reiniciar.
+*/
+void transporte_reiniciar_medicion(Conexion* conexion);
+
+/*!
+ * @brief   Registra bytes enviados y reajusta el transporte al cerrar cada ventana de medicion.
+ *          Con el RTT de TCP y el rendimiento medido estima el producto ancho de banda por demora,
+ *          y con el elige el tamanio de bloque y, si hace falta, agranda SO_SNDBUF.
+ *          Debe llamarse con el mutex envio tomado (transporte_enviar ya lo hace).
+ * @param conexion Conexion sobre la que se envio.
+ * @param bytes    Cantidad de bytes enviados.
+*/
+void transporte_medir(Conexion* conexion, size_t bytes);
+
+#endif
@@ -0,0 +1,530 @@
+/*!
+ * @file    trigramas.c
+ * @brief   Indice de trigramas y busqueda aproximada sobre el catalogo de canciones.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo implementa las funciones necesarias para:
+ *          - Normalizar textos en simbolos y partirlos en trigramas.
+ *          - Construir el indice de trigramas de los valores distintos de titulo, artista y album.
+ *          - Buscar los valores que comparten mas trigramas con un texto, dentro de un presupuesto fijo.
+ *          - Reordenar los candidatos por distancia de edicion acotada y devolver sus canciones.
+*/
+
+#include <stdlib.h>
+#include "trigramas.h"
+#include "transporte.h"
+#include "canciones.h"
+
+/*!
+ * @struct Candidato
+ * @brief Valor que comparte trigramas con el texto buscado.
+*/
+typedef struct Candidato
+{
+    uint32_t valor;      /**< Posicion del valor en Trigramas.valores. */
+    int comunes;         /**< Trigramas que comparte con el texto buscado. */
+    int puntaje;         /**< Distancia con el texto buscado (menor es mejor, ver puntuar()). */
+} Candidato;
+
+/*!
+ * @struct Clave
+ * @brief Trigrama del texto buscado con el largo de su lista.
+*/
+typedef struct Clave
+{
+    int trigrama;        /**< Trigrama. */
+    uint32_t largo;      /**< Cantidad de valores que lo contienen. */
+} Clave;
+
+/*!
+ * @brief   Convierte un caracter en un simbolo de los trigramas.
+ * @param c Caracter.
+ * @return Simbolo: 1 a 26 para las letras, 27 a 36 para los digitos y 0 (espacio) para el resto.
+*/
+static int simbolo(unsigned char c)
+{
+    if (c >= 'a' && c <= 'z')
+    {
+        return c - 'a' + 1;
+    }
+    if (c >= 'A' && c <= 'Z')
+    {
+        return c - 'A' + 1;
+    }
+    if (c >= '0' && c <= '9')
+    {
+        return 27 + c - '0';
+    }
+    return 0;
+}
+
+/*!
+ * @brief   Normaliza un texto: minusculas, letras y digitos, con un solo espacio entre palabras y uno al
+ *          principio y al final. Los bytes no ASCII (letras acentuadas en UTF-8) se ignoran.
+ * @param texto    Texto a normalizar.
+ * @param simbolos Simbolos resultantes (TEXTO_MAX elementos).
+ * @return Cantidad de simbolos, contando los espacios de los extremos (1 si el texto no tiene letras ni digitos).
+*/
+static int normalizar(const char* texto, unsigned char* simbolos)
+{
+    int largo = 1;
+    int actual;
+
+    simbolos[0] = 0;
+    for (; *texto != '\0' && largo < TEXTO_MAX - 1; texto++)
+    {
+        if ((unsigned char)*texto >= 0x80)
+        {
+            continue;
+        }
+        actual = simbolo(*texto);
+        if (actual != 0 || simbolos[largo - 1] != 0)
+        {
+            simbolos[largo++] = actual;
+        }
+    }
+    if (simbolos[largo - 1] != 0)
+    {
+        simbolos[largo++] = 0;
+    }
+    return largo;
+}
+
+/*!
+ * @brief   Compara dos trigramas para ordenarlos.
+ * @param a Primer trigrama.
+ * @param b Segundo trigrama.
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_trigramas(const void* a, const void* b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+/*!
+ * @brief   Parte un texto normalizado en sus trigramas distintos.
+ * @param simbolos Texto normalizado.
+ * @param largo    Cantidad de simbolos.
+ * @param claves   Trigramas distintos (TEXTO_MAX elementos), ordenados.
+ * @return Cantidad de trigramas distintos.
+*/
+static int partir(const unsigned char* simbolos, int largo, int* claves)
+{
+    int i, distintos = 0;
+
+    for (i = 0; i + 2 < largo; i++)
+    {
+        claves[i] = (simbolos[i] * SIMBOLOS + simbolos[i + 1]) * SIMBOLOS + simbolos[i + 2];
+    }
+    if (i == 0)
+    {
+        return 0;
+    }
+    qsort(claves, i, sizeof(int), comparar_trigramas);
+    for (largo = 0; largo < i; largo++)
+    {
+        if (distintos == 0 || claves[largo] != claves[distintos - 1])
+        {
+            claves[distintos++] = claves[largo];
+        }
+    }
+    return distintos;
+}
+
+/*!
+ * @brief   Devuelve el texto de un valor del indice.
+ * @param catalogo Catalogo.
+ * @param valor    Valor.
+ * @return Texto del campo de la primera cancion del valor.
+*/
+static const char* texto_valor(const Catalogo* catalogo, const Valor* valor)
+{
+    return catalogo_texto(catalogo, catalogo->orden[catalogo_orden_campo(valor->campo)][valor->inicio], valor->campo);
+}
+
+/*!
+ * @brief   Arma la lista de valores distintos de titulo, artista y album recorriendo sus permutaciones:
+ *          las canciones con la misma clase (el mismo valor sin distinguir mayusculas) estan juntas.
+ * @param catalogo  Catalogo ya ordenado.
+ * @param trigramas Indice donde dejar los valores.
+ * @return OK(0) si se arma, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+static int armar_valores(const Catalogo* catalogo, Trigramas* trigramas)
+{
+    int i, j;
+    Cancion* const* orden = NULL;
+    static const int campos[] = { TITULO, ARTISTA, ALBUM };
+
+    if ((trigramas->valores = malloc((3 * catalogo->completas + 1) * sizeof(Valor))) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < 3; i++)
+    {
+        orden = catalogo->orden[catalogo_orden_campo(campos[i])];
+        for (j = 0; j < catalogo->completas; j++)
+        {
+            if (j == 0 || catalogo_clase(catalogo, orden[j - 1], campos[i]) != catalogo_clase(catalogo, orden[j], campos[i]))
+            {
+                trigramas->valores[trigramas->cantidad_valores].campo = campos[i];
+                trigramas->valores[trigramas->cantidad_valores].inicio = j;
+                trigramas->valores[trigramas->cantidad_valores].cantidad = 0;
+                trigramas->cantidad_valores++;
+            }
+            trigramas->valores[trigramas->cantidad_valores - 1].cantidad++;
+        }
+    }
+    return OK;
+}
+
+/*!
+ * @brief   Construye el indice de trigramas de un catalogo ya ordenado.
+ *          Primero cuenta cuantos valores contienen cada trigrama y despues llena las listas, que quedan
+ *          en orden creciente de valor.
+ * @param catalogo Catalogo (se completa catalogo->trigramas).
+ * @return OK(0) si se construye, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int trigramas_construir(Catalogo* catalogo)
+{
+    int i, j, distintos;
+    int claves[TEXTO_MAX];
+    unsigned char simbolos[TEXTO_MAX];
+    uint32_t* posiciones = NULL;
+    Trigramas* trigramas = NULL;
+
+    if ((trigramas = calloc(1, sizeof(Trigramas))) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    catalogo->trigramas = trigramas;
+    if (armar_valores(catalogo, trigramas) != OK
+        || (trigramas->inicios = calloc(TRIGRAMAS + 1, sizeof(uint32_t))) == NULL
+        || (posiciones = malloc(TRIGRAMAS * sizeof(uint32_t))) == NULL)
+    {
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < trigramas->cantidad_valores; i++)
+    {
+        distintos = partir(simbolos, normalizar(texto_valor(catalogo, &trigramas->valores[i]), simbolos), claves);
+        for (j = 0; j < distintos; j++)
+        {
+            trigramas->inicios[claves[j] + 1]++;
+        }
+    }
+    for (i = 0; i < TRIGRAMAS; i++)
+    {
+        trigramas->inicios[i + 1] += trigramas->inicios[i];
+        posiciones[i] = trigramas->inicios[i];
+    }
+    if ((trigramas->apariciones = malloc((trigramas->inicios[TRIGRAMAS] + 1) * sizeof(uint32_t))) == NULL)
+    {
+        free(posiciones);
+        return ERROR_DE_MEMORIA;
+    }
+    for (i = 0; i < trigramas->cantidad_valores; i++)
+    {
+        distintos = partir(simbolos, normalizar(texto_valor(catalogo, &trigramas->valores[i]), simbolos), claves);
+        for (j = 0; j < distintos; j++)
+        {
+            trigramas->apariciones[posiciones[claves[j]]++] = i;
+        }
+    }
+    free(posiciones);
+    return OK;
+}
+
+/*!
+ * @brief   Libera un indice de trigramas.
+ * @param trigramas Indice a liberar (puede ser NULL).
+*/
+void trigramas_liberar(Trigramas* trigramas)
+{
+    if (trigramas == NULL)
+    {
+        return;
+    }
+    free(trigramas->apariciones);
+    free(trigramas->inicios);
+    free(trigramas->valores);
+    free(trigramas);
+}
+
+/*!
+ * @brief   Distancia de edicion (Levenshtein) acotada entre dos textos normalizados, sin sus espacios de los extremos.
+ *          Deja de calcular en cuanto todas las alineaciones superan la cota.
+ * @param a       Texto buscado.
+ * @param largo_a Largo del texto buscado.
+ * @param b       Texto del valor.
+ * @param largo_b Largo del texto del valor.
+ * @param parcial 1 para comparar a con el fragmento de b que mejor coincide, 0 para comparar los textos completos.
+ * @param cota    Distancia maxima que interesa.
+ * @return Distancia, o cota + 1 si la supera.
+*/
+static int distancia(const unsigned char* a, int largo_a, const unsigned char* b, int largo_b, int parcial, int cota)
+{
+    int i, j, diagonal, arriba, minimo;
+    int fila[TEXTO_MAX + 1];
+
+    if (!parcial && abs(largo_a - largo_b) > cota)
+    {
+        return cota + 1;
+    }
+    for (j = 0; j <= largo_b; j++)
+    {
+        fila[j] = parcial ? 0 : j;
+    }
+    for (i = 1; i <= largo_a; i++)
+    {
+        diagonal = fila[0];
+        fila[0] = i;
+        minimo = fila[0];
+        for (j = 1; j <= largo_b; j++)
+        {
+            arriba = fila[j];
+            fila[j] = diagonal + (a[i - 1] != b[j - 1]);
+            if (arriba + 1 < fila[j])
+            {
+                fila[j] = arriba + 1;
+            }
+            if (fila[j - 1] + 1 < fila[j])
+            {
+                fila[j] = fila[j - 1] + 1;
+            }
+            diagonal = arriba;
+            if (fila[j] < minimo)
+            {
+                minimo = fila[j];
+            }
+        }
+        if (minimo > cota)
+        {
+            return cota + 1;
+        }
+    }
+    if (!parcial)
+    {
+        return fila[largo_b] > cota ? cota + 1 : fila[largo_b];
+    }
+    return minimo; // el fragmento puede terminar en cualquier posicion de b.
+}
+
+/*!
+ * @brief   Puntua un candidato: primero los valores completos a distancia acotada del texto buscado y despues
+ *          los que lo contienen con errores, ej: "floid" en "Pink Floyd".
+ * @param buscado Texto buscado normalizado.
+ * @param largo   Cantidad de simbolos del texto buscado.
+ * @param texto   Texto del valor.
+ * @param cota    Distancia maxima admitida.
+ * @return Distancia (0 a cota), o cota + 1 mas la distancia al mejor fragmento del valor.
+*/
+static int puntuar(const unsigned char* buscado, int largo, const char* texto, int cota)
+{
+    int largo_valor, completa;
+    unsigned char simbolos[TEXTO_MAX];
+
+    largo_valor = normalizar(texto, simbolos);
+    completa = distancia(buscado + 1, largo - 2, simbolos + 1, largo_valor - 2, 0, cota);
+    if (completa <= cota)
+    {
+        return completa;
+    }
+    return cota + 1 + distancia(buscado + 1, largo - 2, simbolos + 1, largo_valor - 2, 1, cota);
+}
+
+/*!
+ * @brief   Compara dos trigramas del texto buscado por el largo de su lista.
+ * @param a Primer trigrama.
+ * @param b Segundo trigrama.
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_claves(const void* a, const void* b)
+{
+    const Clave* x = a;
+    const Clave* y = b;
+
+    if (x->largo != y->largo)
+    {
+        return x->largo < y->largo ? -1 : 1;
+    }
+    return x->trigrama - y->trigrama;
+}
+
+/*!
+ * @brief   Compara dos candidatos: menor puntaje, mas trigramas en comun y, a igualdad, el primer valor.
+ * @param a Primer candidato.
+ * @param b Segundo candidato.
+ * @return Negativo, cero o positivo segun el orden.
+*/
+static int comparar_candidatos(const void* a, const void* b)
+{
+    const Candidato* x = a;
+    const Candidato* y = b;
+
+    if (x->puntaje != y->puntaje)
+    {
+        return x->puntaje - y->puntaje;
+    }
+    if (x->comunes != y->comunes)
+    {
+        return y->comunes - x->comunes;
+    }
+    return x->valor < y->valor ? -1 : (x->valor > y->valor);
+}
+
+/*!
+ * @brief   Cuenta cuantos trigramas del texto buscado comparte cada valor, recorriendo las listas de la mas
+ *          corta a la mas larga hasta gastar BUSQUEDA_PRESUPUESTO apariciones.
+ * @param trigramas Indice.
+ * @param claves    Trigramas del texto buscado (se reordenan).
+ * @param distintos Cantidad de trigramas del texto buscado.
+ * @param comunes   Trigramas en comun de cada valor (empieza en cero).
+ * @param tocados   Valores con algun trigrama en comun, en el orden en que aparecen.
+ * @param cantidad  Cantidad de valores tocados.
+ * @return Cantidad de trigramas recorridos.
+*/
+static int contar(const Trigramas* trigramas, Clave* claves, int distintos, uint8_t* comunes, uint32_t* tocados, int* cantidad)
+{
+    int i;
+    uint32_t j, largo, presupuesto = BUSQUEDA_PRESUPUESTO;
+    const uint32_t* lista = NULL;
+
+    for (i = 0; i < distintos; i++)
+    {
+        claves[i].largo = trigramas->inicios[claves[i].trigrama + 1] - trigramas->inicios[claves[i].trigrama];
+    }
+    qsort(claves, distintos, sizeof(Clave), comparar_claves);
+    *cantidad = 0;
+    for (i = 0; i < distintos && presupuesto > 0; i++)
+    {
+        lista = trigramas->apariciones + trigramas->inicios[claves[i].trigrama];
+        largo = claves[i].largo < presupuesto ? claves[i].largo : presupuesto;
+        for (j = 0; j < largo; j++)
+        {
+            if (comunes[lista[j]]++ == 0)
+            {
+                tocados[(*cantidad)++] = lista[j];
+            }
+        }
+        presupuesto -= largo;
+    }
+    return i;
+}
+
+/*!
+ * @brief   Elige hasta BUSQUEDA_CANDIDATOS valores con mas trigramas en comun, con al menos un tercio de los
+ *          trigramas recorridos. A igualdad en el corte quedan los primeros que aparecieron.
+ * @param comunes    Trigramas en comun de cada valor.
+ * @param tocados    Valores con algun trigrama en comun.
+ * @param cantidad   Cantidad de valores tocados.
+ * @param recorridos Cantidad de trigramas recorridos.
+ * @param candidatos Candidatos elegidos (BUSQUEDA_CANDIDATOS elementos).
+ * @return Cantidad de candidatos.
+*/
+static int elegir(const uint8_t* comunes, const uint32_t* tocados, int cantidad, int recorridos, Candidato* candidatos)
+{
+    int i, corte, elegidos = 0, acumulados = 0;
+    int por_cantidad[TEXTO_MAX] = { 0 };
+    int minimo = (recorridos + 2) / 3;
+
+    for (i = 0; i < cantidad; i++)
+    {
+        por_cantidad[comunes[tocados[i]]]++;
+    }
+    for (corte = recorridos; corte > minimo && acumulados + por_cantidad[corte] < BUSQUEDA_CANDIDATOS; corte--)
+    {
+        acumulados += por_cantidad[corte];
+    }
+    for (i = 0; i < cantidad && elegidos < BUSQUEDA_CANDIDATOS; i++)
+    {
+        if (comunes[tocados[i]] > corte || (comunes[tocados[i]] == corte && acumulados < BUSQUEDA_CANDIDATOS))
+        {
+            acumulados += (comunes[tocados[i]] == corte);
+            candidatos[elegidos].valor = tocados[i];
+            candidatos[elegidos].comunes = comunes[tocados[i]];
+            elegidos++;
+        }
+    }
+    return elegidos;
+}
+
+/*!
+ * @brief   Agrega las canciones de un valor al resultado, sin repetir las que ya estan.
+ * @param catalogo  Catalogo.
+ * @param valor     Valor elegido.
+ * @param resultado Canciones encontradas (BUSQUEDA_FILAS elementos).
+ * @param cantidad  Cantidad de canciones encontradas.
+*/
+static void agregar_canciones(const Catalogo* catalogo, const Valor* valor, Cancion** resultado, int* cantidad)
+{
+    int i, j;
+    Cancion* const* orden = catalogo->orden[catalogo_orden_campo(valor->campo)] + valor->inicio;
+
+    for (i = 0; i < valor->cantidad && *cantidad < BUSQUEDA_FILAS; i++)
+    {
+        for (j = 0; j < *cantidad && resultado[j] != orden[i]; j++)
+        {
+        }
+        if (j == *cantidad)
+        {
+            resultado[(*cantidad)++] = orden[i];
+        }
+    }
+}
+
+/*!
+ * @brief   Busca canciones cuyo titulo, artista o album se parecen a un texto, tolerando errores de tipeo.
+ * @param catalogo  Catalogo donde buscar.
+ * @param texto     Texto buscado.
+ * @param resultado Canciones encontradas, de los valores mas parecidos a los menos y, dentro de cada valor,
+ *                  en el orden del archivo (se libera con free()).
+ * @param cantidad  Cantidad de canciones encontradas (hasta BUSQUEDA_FILAS).
+ * @return OK(0) si se busca, ERROR(-1) si el texto no tiene letras ni digitos, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int trigramas_buscar(const Catalogo* catalogo, const char* texto, Cancion*** resultado, int* cantidad)
+{
+    int i, largo, distintos, recorridos, tocados_cantidad, elegidos, cota;
+    int trigramas_texto[TEXTO_MAX];
+    unsigned char buscado[TEXTO_MAX];
+    Clave claves[TEXTO_MAX];
+    Candidato candidatos[BUSQUEDA_CANDIDATOS];
+    const Trigramas* trigramas = catalogo->trigramas;
+    uint8_t* comunes = NULL;
+    uint32_t* tocados = NULL;
+
+    *resultado = NULL;
+    *cantidad = 0;
+    largo = normalizar(texto, buscado);
+    if ((distintos = partir(buscado, largo, trigramas_texto)) == 0)
+    {
+        return ERROR;
+    }
+    for (i = 0; i < distintos; i++)
+    {
+        claves[i].trigrama = trigramas_texto[i];
+    }
+    if ((comunes = calloc(trigramas->cantidad_valores + 1, sizeof(uint8_t))) == NULL
+        || (tocados = malloc((trigramas->cantidad_valores < BUSQUEDA_PRESUPUESTO ? trigramas->cantidad_valores + 1
+                                                                                 : BUSQUEDA_PRESUPUESTO) * sizeof(uint32_t))) == NULL
+        || (*resultado = malloc(BUSQUEDA_FILAS * sizeof(Cancion*))) == NULL)
+    {
+        free(comunes);
+        free(tocados);
+        return ERROR_DE_MEMORIA;
+    }
+    recorridos = contar(trigramas, claves, distintos, comunes, tocados, &tocados_cantidad);
+    elegidos = elegir(comunes, tocados, tocados_cantidad, recorridos, candidatos);
+    free(comunes);
+    free(tocados);
+
+    cota = (largo - 2) / 4 > 1 ? (largo - 2) / 4 : 1;
+    for (i = 0; i < elegidos; i++)
+    {
+        candidatos[i].puntaje = puntuar(buscado, largo, texto_valor(catalogo, &trigramas->valores[candidatos[i].valor]), cota);
+    }
+    qsort(candidatos, elegidos, sizeof(Candidato), comparar_candidatos);
+    for (i = 0; i < elegidos && i < BUSQUEDA_K; i++)
+    {
+        agregar_canciones(catalogo, &trigramas->valores[candidatos[i].valor], *resultado, cantidad);
+    }
+    return OK;
+}
@@ -0,0 +1,115 @@
+/*!
+ * @file    trigramas.h
+ * @brief   Definiciones y declaraciones del indice de trigramas del catalogo, para la busqueda aproximada.
+ * @author  Grupo 3
+ * @date    18/12/2024
+ * @details Este archivo contiene:
+ *          - Los parametros de la busqueda aproximada y la estructura Trigramas.
+ *          - Declaraciones de funciones para construir el indice y buscar con errores de tipeo.
+ *          El indice cubre los valores distintos de titulo, artista y album. Cada valor se normaliza
+ *          (minusculas, letras y digitos; el resto cuenta como un espacio) y se parte en trigramas: las
+ *          secuencias de tres simbolos consecutivos, con un espacio agregado al principio y al final.
+ *          Hay 37 simbolos, asi que cada trigrama es un numero menor que 37^3 y el indice guarda, para cada
+ *          uno, la lista de valores que lo contienen, todas juntas en un solo arreglo.
+ *          Al buscar se recorren las listas de los trigramas del texto empezando por las mas cortas y
+ *          contando cuantos comparte cada valor, hasta un presupuesto fijo de apariciones (asi la latencia
+ *          no crece con trigramas muy comunes). Los valores que mas comparten se reordenan por distancia de
+ *          edicion acotada con el texto buscado y se devuelven las canciones de los BUSQUEDA_K mejores.
+*/
+
+#ifndef TRIGRAMAS_H
+#define TRIGRAMAS_H
+
+#include <stdint.h>
+#include "catalogo.h"
+
+/*!
+ * @def SIMBOLOS
+ * @brief Simbolos de los trigramas: espacio (0), letras (1 a 26) y digitos (27 a 36).
+*/
+#define SIMBOLOS 37
+
+/*!
+ * @def TRIGRAMAS
+ * @brief Cantidad de trigramas posibles.
+*/
+#define TRIGRAMAS (SIMBOLOS * SIMBOLOS * SIMBOLOS)
+
+/*!
+ * @def BUSQUEDA_K
+ * @brief Cantidad de valores (titulos, artistas o albumes) que devuelve una busqueda.
+*/
+#define BUSQUEDA_K 10
+
+/*!
+ * @def BUSQUEDA_FILAS
+ * @brief Cantidad maxima de canciones que devuelve una busqueda.
+*/
+#define BUSQUEDA_FILAS 100
+
+/*!
+ * @def BUSQUEDA_PRESUPUESTO
+ * @brief Apariciones que puede recorrer una busqueda; acota su latencia en catalogos grandes.
+*/
+#define BUSQUEDA_PRESUPUESTO (1 << 18)
+
+/*!
+ * @def BUSQUEDA_CANDIDATOS
+ * @brief Valores que se reordenan por distancia de edicion.
+*/
+#define BUSQUEDA_CANDIDATOS 256
+
+/*!
+ * @def TEXTO_MAX
+ * @brief Largo maximo de un texto normalizado; los mas largos se recortan.
+*/
+#define TEXTO_MAX 256
+
+/*!
+ * @struct Valor
+ * @brief Valor distinto de un campo: una racha de canciones en la permutacion de ese campo.
+*/
+typedef struct Valor
+{
+    int campo;       /**< Campo (TITULO, ARTISTA o ALBUM). */
+    int inicio;      /**< Posicion de la primera cancion en la permutacion del campo. */
+    int cantidad;    /**< Cantidad de canciones con el valor. */
+} Valor;
+
+/*!
+ * @struct Trigramas
+ * @brief Indice de trigramas de un catalogo.
+*/
+typedef struct Trigramas
+{
+    Valor* valores;              /**< Valores distintos de titulo, artista y album. */
+    int cantidad_valores;        /**< Cantidad de valores. */
+    uint32_t* inicios;           /**< Para cada trigrama, donde empieza su lista en apariciones (TRIGRAMAS + 1 elementos). */
+    uint32_t* apariciones;       /**< Listas de valores de todos los trigramas, una detras de otra. */
+} Trigramas;
+
+/*!
+ * @brief   Construye el indice de trigramas de un catalogo ya ordenado.
+ * @param catalogo Catalogo (se completa catalogo->trigramas).
+ * @return OK(0) si se construye, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int trigramas_construir(Catalogo* catalogo);
+
+/*!
+ * @brief   Libera un indice de trigramas.
+ * @param trigramas Indice a liberar (puede ser NULL).
+*/
+void trigramas_liberar(Trigramas* trigramas);
+
+/*!
+ * @brief   Busca canciones cuyo titulo, artista o album se parecen a un texto, tolerando errores de tipeo.
+ * @param catalogo  Catalogo donde buscar.
+ * @param texto     Texto buscado.
+ * @param resultado Canciones encontradas, de los valores mas parecidos a los menos y, dentro de cada valor,
+ *                  en el orden del archivo (se libera con free()).
+ * @param cantidad  Cantidad de canciones encontradas (hasta BUSQUEDA_FILAS).
+ * @return OK(0) si se busca, ERROR(-1) si el texto no tiene letras ni digitos, ERROR_DE_MEMORIA(-3) si no hay memoria.
+*/
+int trigramas_buscar(const Catalogo* catalogo, const char* texto, Cancion*** resultado, int* cantidad);
+
+#endif
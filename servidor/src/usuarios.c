@@ -4,7 +4,7 @@
  * @author  Grupo 3
  * @date    18/12/2024
  * @details Este archivo contiene funciones para:
- *          - Establecer conexion con el cliente mediante sockets.
+ *          - Establecer conexion con el cliente mediante sockets (TCP y, para la misma maquina, Unix).
  *          - Validar credenciales de usuario para inicio de sesion.
  *          - Registrar nuevos usuarios y almacenarlos en un archivo db.
 */
@@ -13,9 +13,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
+#include "transporte.h"
+#include "protocolo.h"
+#include "canales.h"
+#include "avisos.h"
 #include "usuarios.h"
 #include "canciones.h"
+#include "estadisticas.h"
+#include "bitacora.h"
+#include "sondas.h"
+
+static pthread_mutex_t base_datos_mutex = PTHREAD_MUTEX_INITIALIZER; // serializa accesos a usuarios.db.
 
 /*!
  * @brief   Establece conexion con el cliente mediante un socket.
@@ -29,156 +42,292 @@
 
 int conexion(int* server_sock, const char* server_ip, int server_port)
 {
+    int reusar = 1;
     struct sockaddr_in server_addr;
     
     // crear el socket del servidor.
     if (((*server_sock) = socket(AF_INET, SOCK_STREAM, 0)) < 0)
     {
-        perror("Error al crear el socket del servidor.\n");
+        bitacora_error("Error al crear el socket del servidor.\n");
         return ERROR;
     }
+    // permitir reiniciar el servidor sin esperar que se liberen las conexiones anteriores.
+    setsockopt(*server_sock, SOL_SOCKET, SO_REUSEADDR, &reusar, sizeof(reusar));
     // configurar direccion del servidor.
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(server_port);
     if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0)
     {
-        perror("Error al convertir direccion IP.\n");
+        bitacora_error("Error al convertir direccion IP.\n");
         close(*server_sock);
         return ERROR;
     }
     // enlazar el socket a la direccion y puerto especificados.
     if (bind((*server_sock), (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
     {
-        perror("Error al enlazar el socket.\n");
+        bitacora_error("Error al enlazar el socket.\n");
         close(*server_sock);
         return ERROR;
     }
     // escuchar conexiones entrantes.
-    if (listen((*server_sock), 1) < 0)
+    if (listen((*server_sock), SOMAXCONN) < 0)
     {
-        perror("Error al escuchar en el socket.\n");
+        bitacora_error("Error al escuchar en el socket.\n");
         close(*server_sock);
         return ERROR;
     }
-    printf("Servidor en espera de conexiones en el puerto %d...\n", server_port);
+    bitacora(NIVEL_INFO, "Servidor en espera de conexiones en el puerto %d...\n", server_port);
     
     return OK;
 }
 
+/*!
+ * @brief   Hilo que acepta a los clientes del socket Unix.
+ * @param arg Puntero (reservado con malloc) al descriptor del socket que escucha. Se libera aqui.
+ * @return NULL al finalizar.
+*/
+static void* aceptar_locales(void* arg)
+{
+    int local_sock = *(int*)arg;
+
+    free(arg);
+    menu_bucle_servidor(local_sock);
+    return NULL;
+}
+
+/*!
+ * @brief   Escucha en un socket Unix a los clientes de la misma maquina y los atiende en un hilo propio, igual
+ *          que a los que llegan por TCP. Por este socket se puede pedir SOL_DESCRIPTOR.
+ * @param ruta Ruta del socket (ver LOCAL_RUTA). Si ya existe, se reemplaza.
+ * @return OK(0) si se escucha, ERROR(-1) si no se pudo crear el socket o el hilo.
+*/
+int conexion_local(const char* ruta)
+{
+    int* local_sock = malloc(sizeof(int));
+    struct sockaddr_un direccion;
+    pthread_t hilo;
+
+    if (local_sock == NULL || strlen(ruta) >= sizeof(direccion.sun_path))
+    {
+        free(local_sock);
+        return ERROR;
+    }
+    memset(&direccion, 0, sizeof(direccion));
+    direccion.sun_family = AF_UNIX;
+    strcpy(direccion.sun_path, ruta);
+    unlink(ruta); // un socket que quedo de una ejecucion anterior.
+    if ((*local_sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+        bitacora_error("Error al crear el socket local.\n");
+        free(local_sock);
+        return ERROR;
+    }
+    // los clientes locales igual inician sesion; el permiso solo limita quien puede intentarlo.
+    if (bind(*local_sock, (struct sockaddr*)&direccion, sizeof(direccion)) < 0 || chmod(ruta, 0660) < 0
+        || listen(*local_sock, SOMAXCONN) < 0)
+    {
+        bitacora_error("Error al enlazar el socket local.\n");
+        close(*local_sock);
+        free(local_sock);
+        return ERROR;
+    }
+    if (pthread_create(&hilo, NULL, aceptar_locales, local_sock) != 0)
+    {
+        bitacora_error("Error al crear hilo del socket local.\n");
+        close(*local_sock);
+        free(local_sock);
+        return ERROR;
+    }
+    pthread_detach(hilo);
+    bitacora(NIVEL_INFO, "Servidor en espera de conexiones locales en %s...\n", ruta);
+    return OK;
+}
+
 /*!
  * @brief   Bucle principal para gestionar las solicitudes del cliente.
- *          Acepta conexiones entrantes y procesa las solicitudes de los clientes, como inicio de sesion y registro.
+ *          Acepta conexiones entrantes y atiende a cada cliente en un hilo propio, de modo que
+ *          varios clientes puedan estar conectados a la vez.
  * @param server_sock Descriptor del socket del servidor.
 */
 void menu_bucle_servidor(int server_sock)
 {
-    int client_sock, opcion;
-    ssize_t bytes_received;
-    char buffer[BUFFER_SIZE];
-    char* opcion_aux = NULL;
-    struct sockaddr_in client_addr;
-    Cuenta usuario;
-    socklen_t addr_len = sizeof(client_addr);
+    int client_sock;
+    int* sock_hilo = NULL;
+    pthread_t hilo;
+    struct sockaddr_storage client_addr; // direccion IP, o vacia si llega por el socket local.
+    socklen_t addr_len;
 
-    while (1) // bucle para recibir y responder al cliente.
+    while (1) // bucle para aceptar clientes.
     {   
-        printf("Esperando cliente.\n");
+        bitacora(NIVEL_DEPURACION, "Esperando cliente.\n");
         // aceptar una conexion entrante.
+        addr_len = sizeof(client_addr);
         if ((client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &addr_len)) < 0)
         {
-            perror("Error al aceptar la conexion.\n");
+            bitacora_error("Error al aceptar la conexion.\n");
             continue;
         }
-        printf("Nuevo cliente conectado.\n");
-        while(1)
+        bitacora(NIVEL_INFO, "Nuevo cliente conectado%s.\n", (client_addr.ss_family == AF_UNIX) ? " (local)" : "");
+        SONDA2(sesion_aceptada, client_sock, (client_addr.ss_family == AF_INET) ? ntohl(((struct sockaddr_in*)&client_addr)->sin_addr.s_addr) : 0);
+        if ((sock_hilo = malloc(sizeof(int))) == NULL)
         {
-            // recibir usuario, contrasenia y opcion.
-            if ((bytes_received = recv(client_sock, buffer, BUFFER_SIZE, 0)) < 0)
+            bitacora_error("Error al reservar memoria para el cliente.\n");
+            close(client_sock);
+            continue;
+        }
+        *sock_hilo = client_sock;
+        // atender al cliente en su propio hilo.
+        if (pthread_create(&hilo, NULL, atender_cliente, sock_hilo) != 0)
+        {
+            bitacora_error("Error al crear hilo del cliente.\n");
+            free(sock_hilo);
+            close(client_sock);
+            continue;
+        }
+        pthread_detach(hilo);
+    }
+    // cerrar socket servidor.
+    close(server_sock);
+}
+
+/*!
+ * @brief   Atiende a un cliente conectado hasta que finaliza la conexion.
+ *          Recibe las solicitudes del cliente en orden y las procesa: inicio de sesion y registro
+ *          en cualquier momento, y solicitudes de canciones una vez autenticado. El cliente puede
+ *          enviar varias solicitudes seguidas sin esperar cada respuesta; las descargas siguen
+ *          en sus propios canales mientras se atienden las demas. Cada conexion
+ *          tiene su propio estado de transporte y su cubeta en el planificador de salida.
+ * @param arg Puntero (reservado con malloc) al descriptor del socket del cliente. Se libera aqui.
+ * @return NULL al finalizar.
+*/
+void* atender_cliente(void* arg)
+{
+    int client_sock = *(int*)arg;
+    int estado, autenticado = 0;
+    double inicio;
+    char buffer[BUFFER_SIZE];
+    char* campo = NULL;
+    Cabecera cabecera;
+    Cuenta usuario;
+    Conexion conexion;
+
+    free(arg);
+    if (conexion_iniciar(&conexion, client_sock) != OK)
+    {
+        close(client_sock);
+        return NULL;
+    }
+    // los mensajes de este hilo y de sus canales llevan la sesion de la conexion.
+    conexion.sesion = bitacora_nueva_sesion();
+    bitacora_sesion(conexion.sesion);
+    estadisticas_conexion(1);
+    while(1)
+    {
+        // recibir la siguiente solicitud.
+        if ((estado = recibir_trama(client_sock, &cabecera, buffer, BUFFER_SIZE)) == SALIR)
+        {
+            bitacora(NIVEL_INFO, "Conexion finalizada por el cliente.\n");
+            break;
+        } else if (estado != OK)
+        {
+            bitacora_error("Error al recibir solicitud.\n");
+            break;
+        }
+        if (cabecera.tipo == SOL_INICIO || cabecera.tipo == SOL_REGISTRO)
+        {
+            // separar usuario y contrasenia.
+            memset(&usuario, 0, sizeof(usuario));
+            if ((campo = strchr(buffer, ':')) != NULL)
             {
-                perror("Error al recibir datos de usuario.\n");
-                break;
+                *campo++ = '\0';
+                snprintf(usuario.contrasenia, sizeof(usuario.contrasenia), "%.25s", campo);
             }
-            else if (bytes_received == 0)
+            snprintf(usuario.usuario, sizeof(usuario.usuario), "%.25s", buffer);
+            // procesar y responder segun la opcion.
+            inicio = estadisticas_ahora();
+            estado = procesar_opcion(&conexion, cabecera.id, cabecera.tipo, usuario);
+            estadisticas_registrar((cabecera.tipo == SOL_INICIO) ? OP_INICIO : OP_REGISTRO, estadisticas_ahora() - inicio, estado == OK, 0);
+            if (estado == SALIR)
             {
-                printf("Conexion finalizada por el cliente.\n");
                 break;
             }
-            buffer[bytes_received] = '\0';
-            // separar usuario, contrasenia y opcion.
-            opcion_aux = strtok(buffer, ":");
-            strcpy(usuario.usuario, strtok(NULL, ":"));
-            strcpy(usuario.contrasenia, strtok(NULL, ":"));
-            opcion = atoi(opcion_aux);
-            // procesar y responder segun la opcion.
-            if (procesar_opcion(client_sock, opcion, buffer, usuario) == SALIR)
+            // un inicio fallido no cierra la sesion que ya tenia la conexion.
+            if (estado == OK)
+            {
+                autenticado = 1;
+            }
+        } else if (!autenticado)
+        {
+            if (transporte_enviar_texto(&conexion, cabecera.id, RESP_ERROR, ERROR_SIN_SESION) != OK)
             {
                 break;
             }
+        } else if (atender_solicitud_canciones(&conexion, cabecera.id, cabecera.tipo, buffer, cabecera.longitud) != OK)
+        {
+            break;
         }
-        // cerrar socket cliente.
-        close(client_sock);
     }
-    // cerrar socket servidor.
-    close(server_sock);
+    // terminar la suscripcion y las descargas en curso y cerrar socket cliente.
+    avisos_cerrar(&conexion);
+    canales_cerrar(&conexion);
+    conexion_finalizar(&conexion);
+    estadisticas_conexion(-1);
+    return NULL;
 }
 
 /*!
  * @brief   Procesa opciones seleccionadas por el cliente.
- *          Gestiona el inicio de sesion y registro de usuarios segun la opcion seleccionada por el cliente.
- * @param client_sock Descriptor del socket del cliente.
- * @param opcion      Opcion seleccionada por el cliente.
- * @param buffer      Buffer utilizado para enviar y recibir datos.
- * @param usuario     Estructura de datos del usuario (nombre de usuario y contrasenia).
- * @return OK(0) si la operacion se realiza correctamente, SALIR(-4) si el cliente finaliza la conexion.
+ *          Gestiona el inicio de sesion y registro de usuarios segun la solicitud recibida.
+ *          Responde con una trama RESP_FIN con el mensaje de exito, o RESP_ERROR con el motivo del rechazo.
+ * @param conexion Estado de la conexion con el cliente.
+ * @param id       Identificador de la solicitud.
+ * @param opcion   Tipo de solicitud (SOL_INICIO o SOL_REGISTRO).
+ * @param usuario  Estructura de datos del usuario (nombre de usuario y contrasenia).
+ * @return OK(0) si el usuario queda autenticado, ERROR_USUARIO(-2) si se rechaza,
+ *         SALIR(-4) si hay que finalizar la conexion.
 */
-int procesar_opcion(int client_sock, int opcion, char* buffer, Cuenta usuario)
+int procesar_opcion(Conexion* conexion, uint32_t id, int opcion, Cuenta usuario)
 {
-    if (opcion == 1) // iniciar sesion.
+    int guardado;
+    char* respuesta = ERROR_USUARIO_USUARIOS;
+
+    if (opcion == SOL_INICIO) // iniciar sesion.
     {
-        printf("Ingreso a iniciar sesion.\n");
-        // enviar respuesta.
-        snprintf(buffer, BUFFER_SIZE, "%s", validar_inicio(usuario.usuario, usuario.contrasenia));
-        if (send(client_sock, buffer, strlen(buffer), 0) < 0)
-        {
-            perror("Error al enviar respuesta inicio de sesion.\n");
-            return SALIR;
-        }
-        if (strcmp(buffer, EXITO) == 0)
-        {
-            menu_canciones_servidor(client_sock, buffer);
-            return SALIR;
-        }
-    } else if (opcion == 2) // registrar usuario.
+        bitacora(NIVEL_DEPURACION, "Ingreso a iniciar sesion.\n");
+        pthread_mutex_lock(&base_datos_mutex);
+        respuesta = validar_inicio(usuario.usuario, usuario.contrasenia);
+        pthread_mutex_unlock(&base_datos_mutex);
+    } else if (opcion == SOL_REGISTRO) // registrar usuario.
     {
-        printf("Ingreso a registrar usuario.\n");
-        snprintf(buffer, BUFFER_SIZE, "%s", (validar_registro(usuario.usuario)));
-        if (strcmp(buffer, EXITO) == 0)
+        bitacora(NIVEL_DEPURACION, "Ingreso a registrar usuario.\n");
+        // validamos y guardamos sin que otro hilo registre el mismo usuario en el medio.
+        pthread_mutex_lock(&base_datos_mutex);
+        respuesta = validar_registro(usuario.usuario);
+        guardado = (strcmp(respuesta, EXITO) == 0) ? guardar_cuenta(usuario) : OK;
+        pthread_mutex_unlock(&base_datos_mutex);
+        if (guardado == ERROR) // si hay error, terminamos todo.
         {
-            if (guardar_cuenta(usuario) == ERROR) // si hay error, terminamos todo.
-            {
-                snprintf(buffer, BUFFER_SIZE, "%s", ERROR_GUARDAR); 
-                if (send(client_sock, buffer, strlen(buffer), 0) < 0)
-                {
-                    perror("Error al enviar respuesta validar registro.\n");
-                    return SALIR;
-                }
-                return SALIR;
-            }
-            if (send(client_sock, buffer, strlen(buffer), 0) < 0)
-            {
-                perror("Error al enviar respuesta validar registro.\n");
-                return SALIR;
-            }
-            menu_canciones_servidor(client_sock, buffer);
+            transporte_enviar_texto(conexion, id, RESP_ERROR, ERROR_GUARDAR);
             return SALIR;
         }
-        if (send(client_sock, buffer, strlen(buffer), 0) < 0)
+    }
+    SONDA3(sesion_resultado, conexion->sesion, opcion, strcmp(respuesta, EXITO) == 0);
+    // enviar respuesta.
+    if (strcmp(respuesta, EXITO) == 0)
+    {
+        if (transporte_enviar_texto(conexion, id, RESP_FIN, respuesta) != OK)
         {
-            perror("Error al enviar respuesta validar registro.\n");
+            bitacora_error("Error al enviar respuesta de sesion.\n");
             return SALIR;
         }
+        return OK;
+    }
+    if (transporte_enviar_texto(conexion, id, RESP_ERROR, respuesta) != OK)
+    {
+        bitacora_error("Error al enviar respuesta de sesion.\n");
+        return SALIR;
     }
-    return OK;    
+    return ERROR_USUARIO;
 }
 
 /*!
@@ -202,7 +351,7 @@ char* validar_inicio(const char *usuario, const char *contrasenia)
     {
         if (ferror(baseDatos) != 0)
         {
-            perror("Error al leer archivo de usuarios.\n");
+            bitacora_error("Error al leer archivo de usuarios.\n");
             fclose(baseDatos);
             return ERROR_MEMORIA_USUARIOS;
         }
@@ -221,7 +370,7 @@ char* validar_inicio(const char *usuario, const char *contrasenia)
     }
     if (ferror(baseDatos) != 0)
     {
-        perror("Error al leer archivo de usuarios.\n");
+        bitacora_error("Error al leer archivo de usuarios.\n");
         fclose(baseDatos);
         return ERROR_MEMORIA_USUARIOS;
     }
@@ -245,7 +394,7 @@ char* validar_registro(const char *usuario)
     {
         if ((baseDatos = fopen("usuarios.db", "rb")) == NULL)
         {
-            perror("Error al leer archivo de registro.\n");
+            bitacora_error("Error al leer archivo de registro.\n");
             return ERROR_MEMORIA_USUARIOS;
         }
     }
@@ -253,7 +402,7 @@ char* validar_registro(const char *usuario)
     {
         if ((baseDatos = fopen("usuarios.db", "wb")) == NULL)
         {
-            perror("Error al crear archivo de registro.\n");
+            bitacora_error("Error al crear archivo de registro.\n");
             return ERROR_MEMORIA_USUARIOS;
         }
         fclose(baseDatos);
@@ -270,7 +419,7 @@ char* validar_registro(const char *usuario)
     }
     if (ferror(baseDatos) != 0)
     {
-        perror("Error al leer archivo de usuarios.\n");
+        bitacora_error("Error al leer archivo de usuarios.\n");
         fclose(baseDatos);
         return ERROR_MEMORIA_USUARIOS;
     }
@@ -290,17 +439,17 @@ int guardar_cuenta(Cuenta usuario)
     FILE *baseDatos = fopen("usuarios.db", "ab");
     if (baseDatos == NULL)
     {
-        perror("No se pudo abrir o crear archivo de datos.\n");
+        bitacora_error("No se pudo abrir o crear archivo de datos.\n");
         return ERROR;
     }
 
     if (fwrite(&usuario, sizeof(Cuenta), 1, baseDatos) != 1)
     {
-        perror("Error al escribir nuevo usuario.\n");
+        bitacora_error("Error al escribir nuevo usuario.\n");
         fclose(baseDatos);
         return ERROR;
     }
-    printf("Usuario registrado exitosamente.\n");
+    bitacora(NIVEL_INFO, "Usuario registrado exitosamente.\n");
     
     fclose(baseDatos);
     return OK;
@@ -57,6 +57,18 @@ typedef struct Cuenta
 */
 #define ERROR_GUARDAR "Error al guardar nuevo usuario."
 
+/*!
+ * @def ERROR_SIN_SESION
+ * @brief Mensaje de error al pedir canciones sin haber iniciado sesion.
+*/
+#define ERROR_SIN_SESION "Error: Inicie sesion primero."
+
+/*!
+ * @def LOCAL_RUTA
+ * @brief Socket Unix para los clientes de la misma maquina, relativo al directorio del servidor.
+*/
+#define LOCAL_RUTA "infotify.sock"
+
 /*!
  * @brief   Establece conexion con el cliente mediante un socket.
  *          Crea un socket, configura la direccion del servidor y lo enlaza a un puerto.
@@ -67,13 +79,29 @@ typedef struct Cuenta
 */
 int conexion(int* server_sock, const char* server_ip, int server_port);
 
+/*!
+ * @brief   Escucha en un socket Unix a los clientes de la misma maquina y los atiende en un hilo propio, igual
+ *          que a los que llegan por TCP. Por este socket se puede pedir SOL_DESCRIPTOR.
+ * @param ruta Ruta del socket (ver LOCAL_RUTA). Si ya existe, se reemplaza.
+ * @return OK(0) si se escucha, ERROR(-1) si no se pudo crear el socket o el hilo.
+*/
+int conexion_local(const char* ruta);
+
 /*!
  * @brief   Bucle principal para gestionar las solicitudes del cliente.
- *          Acepta conexiones entrantes y procesa las solicitudes de los clientes, como inicio de sesion y registro.
+ *          Acepta conexiones entrantes y atiende a cada cliente en un hilo propio.
  * @param server_sock Descriptor del socket del servidor.
 */
 void menu_bucle_servidor(int server_sock);
 
+/*!
+ * @brief   Atiende a un cliente conectado hasta que finaliza la conexion.
+ *          Procesa en orden las solicitudes del cliente: inicio de sesion, registro y canciones.
+ * @param arg Puntero (reservado con malloc) al descriptor del socket del cliente. Se libera al iniciar.
+ * @return NULL al finalizar.
+*/
+void* atender_cliente(void* arg);
+
 /*!
  * @brief   Valida las credenciales de inicio de sesion del cliente.
  *          Compara el nombre de usuario y la contrasenia ingresados con los almacenados en la base de datos.
@@ -101,11 +129,12 @@ int guardar_cuenta(Cuenta usuario);
 
 /*!
  * @brief   Procesa las opciones seleccionadas por el cliente.
- *          Gestiona el inicio de sesion y registro de usuarios segun la opcion seleccionada por el cliente.
- * @param client_sock Descriptor del socket del cliente.
- * @param opcion      Opcion seleccionada por el cliente.
- * @param buffer      Buffer utilizado para enviar y recibir datos.
- * @param usuario     Datos del usuario (nombre de usuario y contrasenia).
- * @return OK(0) si la operacion se realiza correctamente, SALIR(-4) si el cliente finaliza la conexion.
-*/
-int procesar_opcion(int client_sock, int opcion, char* buffer, Cuenta usuario);
\ No newline at end of file
+ *          Gestiona el inicio de sesion y registro de usuarios segun la solicitud recibida.
+ * @param conexion Estado de la conexion con el cliente.
+ * @param id       Identificador de la solicitud.
+ * @param opcion   Tipo de solicitud (SOL_INICIO o SOL_REGISTRO).
+ * @param usuario  Datos del usuario (nombre de usuario y contrasenia).
+ * @return OK(0) si el usuario queda autenticado, ERROR_USUARIO(-2) si se rechaza,
+ *         SALIR(-4) si hay que finalizar la conexion.
+*/
+int procesar_opcion(Conexion* conexion, uint32_t id, int opcion, Cuenta usuario);
\ No newline at end of file